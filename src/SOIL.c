@@ -39,10 +39,96 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#ifdef WIN32
+#include <sys/utime.h>
+#include <process.h>
+#else
+#include <dirent.h>
+#include <unistd.h>
+#include <utime.h>
+#include <pthread.h>
+#endif
 
 /*	error reporting	*/
 char *result_string_pointer = "SOIL initialized";
 
+/*	for saving PNGs	*/
+static int PNG_compression_level = 6;
+/*	the user's threads, if they gave me any (see SOIL_set_parallel_for)	*/
+static SOIL_parallel_for parallel_for_installed = NULL;
+static void *parallel_for_context = NULL;
+/*	runs body(data, 0..count-1), on the user's threads if there are any	*/
+static void SOIL_run_parallel(int count, SOIL_parallel_body body, void *data) {
+  int i;
+  if (parallel_for_installed && (count > 1)) {
+    parallel_for_installed(parallel_for_context, count, body, data);
+    return;
+  }
+  for (i = 0; i < count; ++i) {
+    body(data, i);
+  }
+}
+
+/*	for the on-disk texture cache (see SOIL_set_texture_cache)	*/
+static char *texture_cache_directory = NULL;
+static unsigned long texture_cache_max_bytes = 0;
+/*	numbers every temp file written in this process, under the shared lock
+        (see SOIL_cache_store)	*/
+static unsigned int texture_cache_writes = 0;
+/*	bump this whenever what goes into a cached texture changes	*/
+#define SOIL_TEXTURE_CACHE_VERSION 1
+
+/*	for handing out one texture to identical loads (see
+ * SOIL_set_texture_dedup)	*/
+typedef struct SOIL_shared_texture {
+  /*	the key: a hash of the filename, or of the contents if there is none	*/
+  unsigned int hash[2];
+  char *filename;
+  int buffer_length;
+  int force_channels;
+  unsigned int flags;
+  /*	and what it maps to	*/
+  unsigned int tex_id;
+  int references;
+  struct SOIL_shared_texture *next_by_key, *next_by_ID;
+} SOIL_shared_texture;
+static int texture_dedup_enabled = 0;
+static SOIL_shared_texture **shared_by_key = NULL, **shared_by_ID = NULL;
+static int shared_bucket_count = 0, shared_texture_count = 0;
+#ifdef WIN32
+static SRWLOCK shared_texture_lock = SRWLOCK_INIT;
+#define SOIL_lock_shared() AcquireSRWLockExclusive(&shared_texture_lock)
+#define SOIL_unlock_shared() ReleaseSRWLockExclusive(&shared_texture_lock)
+#else
+static pthread_mutex_t shared_texture_lock = PTHREAD_MUTEX_INITIALIZER;
+#define SOIL_lock_shared() pthread_mutex_lock(&shared_texture_lock)
+#define SOIL_unlock_shared() pthread_mutex_unlock(&shared_texture_lock)
+#endif
+
+/*	for keeping SOIL's textures within a memory budget (see
+ * SOIL_set_texture_budget), under the same lock	*/
+typedef struct SOIL_tracked_texture {
+  unsigned int tex_id;
+  unsigned int opengl_texture_type;
+  int levels;
+  unsigned long bytes;
+  int resident;
+  /*	how to load it again, if SOIL loaded it from a file	*/
+  char *filename;
+  int force_channels;
+  unsigned int flags;
+  /*	the LRU list runs newest to oldest	*/
+  struct SOIL_tracked_texture *newer, *older, *next_by_ID;
+} SOIL_tracked_texture;
+static int texture_budget_enabled = 0;
+static unsigned long texture_budget_bytes = 0;
+static SOIL_tracked_texture **tracked_by_ID = NULL;
+static SOIL_tracked_texture *tracked_newest = NULL, *tracked_oldest = NULL;
+static int tracked_bucket_count = 0, tracked_texture_count = 0;
+static unsigned long tracked_total_bytes = 0, tracked_resident_bytes = 0;
+
 /*	for loading cube maps	*/
 enum {
   SOIL_CAPABILITY_UNKNOWN = -1,
@@ -52,6 +138,7 @@ enum {
 static int has_cubemap_capability = SOIL_CAPABILITY_UNKNOWN;
 int query_cubemap_capability(void);
 #define SOIL_TEXTURE_WRAP_R 0x8072
+#define SOIL_TEXTURE_MAX_LEVEL 0x813D
 #define SOIL_CLAMP_TO_EDGE 0x812F
 #define SOIL_NORMAL_MAP 0x8511
 #define SOIL_REFLECTION_MAP 0x8512
@@ -72,6 +159,7 @@ int query_NPOT_capability(void);
 static int has_tex_rectangle_capability = SOIL_CAPABILITY_UNKNOWN;
 int query_tex_rectangle_capability(void);
 #define SOIL_TEXTURE_RECTANGLE_ARB 0x84F5
+#define SOIL_TEXTURE_BINDING_RECTANGLE_ARB 0x84F6
 #define SOIL_MAX_RECTANGLE_TEXTURE_SIZE_ARB 0x84F8
 /*	for using DXT compression	*/
 static int has_DXT_capability = SOIL_CAPABILITY_UNKNOWN;
@@ -80,10 +168,104 @@ int query_DXT_capability(void);
 #define SOIL_RGBA_S3TC_DXT1 0x83F1
 #define SOIL_RGBA_S3TC_DXT3 0x83F2
 #define SOIL_RGBA_S3TC_DXT5 0x83F3
+/*	for BC4 / BC5 compressed 1 & 2 channel images	*/
+static int has_LATC_capability = SOIL_CAPABILITY_UNKNOWN;
+int query_LATC_capability(void);
+static int has_RGTC_capability = SOIL_CAPABILITY_UNKNOWN;
+int query_RGTC_capability(void);
+static int has_swizzle_capability = SOIL_CAPABILITY_UNKNOWN;
+int query_swizzle_capability(void);
+#define SOIL_COMPRESSED_LUMINANCE_LATC1 0x8C70
+#define SOIL_COMPRESSED_LUMINANCE_ALPHA_LATC2 0x8C72
+#define SOIL_COMPRESSED_RED_RGTC1 0x8DBB
+#define SOIL_COMPRESSED_RG_RGTC2 0x8DBD
+#define SOIL_TEXTURE_SWIZZLE_RGBA 0x8E46
+#define SOIL_RED 0x1903
+#define SOIL_GREEN 0x1904
+/*	for BC6H / BC7 compressed images	*/
+static int has_BPTC_capability = SOIL_CAPABILITY_UNKNOWN;
+int query_BPTC_capability(void);
+#define SOIL_COMPRESSED_SIGNED_RED_RGTC1 0x8DBC
+#define SOIL_COMPRESSED_SIGNED_RG_RGTC2 0x8DBE
+#define SOIL_COMPRESSED_RGBA_BPTC_UNORM 0x8E8C
+#define SOIL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM 0x8E8D
+#define SOIL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT 0x8E8E
+#define SOIL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT 0x8E8F
+#define SOIL_COMPRESSED_SRGB_S3TC_DXT1 0x8C4C
+#define SOIL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1 0x8C4D
+#define SOIL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3 0x8C4E
+#define SOIL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5 0x8C4F
+/*	for ETC2 / EAC compressed images	*/
+static int has_ETC2_capability = SOIL_CAPABILITY_UNKNOWN;
+int query_ETC2_capability(void);
+#define SOIL_COMPRESSED_R11_EAC 0x9270
+#define SOIL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC 0x9279
+/*	for texture arrays	*/
+static int has_2D_array_capability = SOIL_CAPABILITY_UNKNOWN;
+int query_2D_array_capability(void);
+#define SOIL_TEXTURE_2D_ARRAY 0x8C1A
+#define SOIL_TEXTURE_BINDING_2D_ARRAY 0x8C1D
+/*	for volume textures	*/
+static int has_3D_capability = SOIL_CAPABILITY_UNKNOWN;
+int query_3D_capability(void);
+#define SOIL_TEXTURE_3D 0x806F
+#define SOIL_TEXTURE_BINDING_3D 0x806A
+/*	for sRGB textures	*/
+static int has_sRGB_capability = SOIL_CAPABILITY_UNKNOWN;
+int query_sRGB_capability(void);
+#define SOIL_SRGB8 0x8C41
+#define SOIL_SRGB8_ALPHA8 0x8C43
+#define SOIL_SLUMINANCE8_ALPHA8 0x8C45
+#define SOIL_SLUMINANCE8 0x8C47
+#define SOIL_FOURCC(a, b, c, d)                                                \
+  ((unsigned int)(a) | ((unsigned int)(b) << 8) | ((unsigned int)(c) << 16) |  \
+   ((unsigned int)(d) << 24))
 typedef void(APIENTRY *P_SOIL_GLCOMPRESSEDTEXIMAGE2DPROC)(
     GLenum target, GLint level, GLenum internalformat, GLsizei width,
     GLsizei height, GLint border, GLsizei imageSize, const GLvoid *data);
 P_SOIL_GLCOMPRESSEDTEXIMAGE2DPROC soilGlCompressedTexImage2D = NULL;
+static int query_compressed_tex_image_2D(void);
+typedef void(APIENTRY *P_SOIL_GLTEXIMAGE3DPROC)(
+    GLenum target, GLint level, GLint internalformat, GLsizei width,
+    GLsizei height, GLsizei depth, GLint border, GLenum format, GLenum type,
+    const GLvoid *data);
+P_SOIL_GLTEXIMAGE3DPROC soilGlTexImage3D = NULL;
+typedef void(APIENTRY *P_SOIL_GLCOMPRESSEDTEXIMAGE3DPROC)(
+    GLenum target, GLint level, GLenum internalformat, GLsizei width,
+    GLsizei height, GLsizei depth, GLint border, GLsizei imageSize,
+    const GLvoid *data);
+P_SOIL_GLCOMPRESSEDTEXIMAGE3DPROC soilGlCompressedTexImage3D = NULL;
+static int query_tex_image_3D(void);
+static int has_tex_storage_capability = SOIL_CAPABILITY_UNKNOWN;
+int query_tex_storage_capability(void);
+#define SOIL_MAX_ARRAY_TEXTURE_LAYERS 0x88FF
+#define SOIL_TEXTURE_IMMUTABLE_FORMAT 0x912F
+#define SOIL_TEXTURE_IMMUTABLE_LEVELS 0x82DF
+#define SOIL_TEXTURE_DEPTH 0x8071
+typedef void(APIENTRY *P_SOIL_GLTEXSTORAGE2DPROC)(GLenum target, GLsizei levels,
+                                                  GLenum internalformat,
+                                                  GLsizei width,
+                                                  GLsizei height);
+P_SOIL_GLTEXSTORAGE2DPROC soilGlTexStorage2D = NULL;
+typedef void(APIENTRY *P_SOIL_GLCOMPRESSEDTEXSUBIMAGE2DPROC)(
+    GLenum target, GLint level, GLint xoffset, GLint yoffset, GLsizei width,
+    GLsizei height, GLenum format, GLsizei imageSize, const GLvoid *data);
+P_SOIL_GLCOMPRESSEDTEXSUBIMAGE2DPROC soilGlCompressedTexSubImage2D = NULL;
+typedef void(APIENTRY *P_SOIL_GLTEXSTORAGE3DPROC)(GLenum target, GLsizei levels,
+                                                  GLenum internalformat,
+                                                  GLsizei width, GLsizei height,
+                                                  GLsizei depth);
+P_SOIL_GLTEXSTORAGE3DPROC soilGlTexStorage3D = NULL;
+typedef void(APIENTRY *P_SOIL_GLTEXSUBIMAGE3DPROC)(
+    GLenum target, GLint level, GLint xoffset, GLint yoffset, GLint zoffset,
+    GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLenum type,
+    const GLvoid *data);
+P_SOIL_GLTEXSUBIMAGE3DPROC soilGlTexSubImage3D = NULL;
+typedef void(APIENTRY *P_SOIL_GLCOMPRESSEDTEXSUBIMAGE3DPROC)(
+    GLenum target, GLint level, GLint xoffset, GLint yoffset, GLint zoffset,
+    GLsizei width, GLsizei height, GLsizei depth, GLenum format,
+    GLsizei imageSize, const GLvoid *data);
+P_SOIL_GLCOMPRESSEDTEXSUBIMAGE3DPROC soilGlCompressedTexSubImage3D = NULL;
 unsigned int SOIL_direct_load_DDS(const char *filename,
                                   unsigned int reuse_texture_ID, int flags,
                                   int loading_as_cubemap);
@@ -92,21 +274,145 @@ unsigned int SOIL_direct_load_DDS_from_memory(const unsigned char *const buffer,
                                               unsigned int reuse_texture_ID,
                                               int flags,
                                               int loading_as_cubemap);
+unsigned int SOIL_direct_load_KTX(const char *filename,
+                                  unsigned int reuse_texture_ID, int flags,
+                                  int loading_as_cubemap);
+unsigned int SOIL_direct_load_KTX_from_memory(const unsigned char *const buffer,
+                                              int buffer_length,
+                                              unsigned int reuse_texture_ID,
+                                              int flags,
+                                              int loading_as_cubemap);
+/*	what SOIL_internal_create_OGL_texture uploaded, so it can be cached	*/
+typedef struct {
+  unsigned int internal_format;
+  int width, height, levels;
+  /*	every level, back to back	*/
+  unsigned char *data;
+  int size;
+  /*	set if any of it was something I can't store	*/
+  int failed;
+} SOIL_texture_capture;
+static void SOIL_capture_level(SOIL_texture_capture *capture,
+                               unsigned int internal_format, int width,
+                               int height, const unsigned char *data,
+                               int size);
+static char *SOIL_cache_path(const unsigned char *const buffer,
+                             int buffer_length, int force_channels,
+                             unsigned int flags);
+static void SOIL_cache_touch(const char *path);
+static void SOIL_hash_bytes(const unsigned char *bytes, int length,
+                            unsigned int hash[2]);
+static unsigned int SOIL_shared_acquire(const SOIL_shared_texture *key,
+                                        unsigned int tex_id);
+static unsigned int SOIL_internal_load_OGL_texture(
+    const char *filename, int force_channels, unsigned int reuse_texture_ID,
+    unsigned int flags);
+static void SOIL_track_texture(unsigned int tex_id,
+                               unsigned int opengl_texture_type,
+                               unsigned int internal_format, int levels,
+                               int width, int height, int depth);
+static void SOIL_track_source(unsigned int tex_id, const char *filename,
+                              int force_channels, unsigned int flags);
+static void SOIL_untrack_texture(unsigned int tex_id);
+static SOIL_tracked_texture **SOIL_find_tracked(unsigned int tex_id);
+static void SOIL_tracked_make_newest(SOIL_tracked_texture *entry);
+static void SOIL_enforce_texture_budget(unsigned int keep_tex_id);
+static unsigned int SOIL_internal_load_OGL_texture_from_memory(
+    const unsigned char *const buffer, int buffer_length, int force_channels,
+    unsigned int reuse_texture_ID, unsigned int flags);
+static unsigned int SOIL_decode_OGL_texture(const char *filename,
+                                            int force_channels,
+                                            unsigned int reuse_texture_ID,
+                                            unsigned int flags);
+static unsigned int SOIL_decode_OGL_texture_from_memory(
+    const unsigned char *const buffer, int buffer_length, int force_channels,
+    unsigned int reuse_texture_ID, unsigned int flags);
+static void SOIL_cache_store(const char *path,
+                             const SOIL_texture_capture *capture);
 /*	other functions	*/
 unsigned int SOIL_internal_create_OGL_texture(
     const unsigned char *const data, int width, int height, int channels,
-    unsigned int reuse_texture_ID, unsigned int flags,
+    int stride, unsigned int reuse_texture_ID, unsigned int flags,
     unsigned int opengl_texture_type, unsigned int opengl_texture_target,
-    unsigned int texture_check_size_enum);
+    unsigned int texture_check_size_enum, SOIL_texture_capture *capture);
 
 /*	and the code magic begins here [8^)	*/
 unsigned int SOIL_load_OGL_texture(const char *filename, int force_channels,
                                    unsigned int reuse_texture_ID,
                                    unsigned int flags) {
+  SOIL_shared_texture key;
+  unsigned int tex_id;
+  /*	a texture the caller wants filled in is never shared	*/
+  if (!texture_dedup_enabled || reuse_texture_ID || (NULL == filename)) {
+    tex_id = SOIL_internal_load_OGL_texture(filename, force_channels,
+                                            reuse_texture_ID, flags);
+    SOIL_track_source(tex_id, filename, force_channels, flags);
+    return tex_id;
+  }
+  memset(&key, 0, sizeof(SOIL_shared_texture));
+  SOIL_hash_bytes((const unsigned char *)filename, (int)strlen(filename),
+                  key.hash);
+  key.filename = (char *)filename;
+  key.force_channels = force_channels;
+  key.flags = flags;
+  tex_id = SOIL_shared_acquire(&key, 0);
+  if (tex_id) {
+    result_string_pointer = "Image already loaded, sharing its texture";
+    return tex_id;
+  }
+  tex_id = SOIL_internal_load_OGL_texture(filename, force_channels, 0, flags);
+  SOIL_track_source(tex_id, filename, force_channels, flags);
+  return tex_id ? SOIL_shared_acquire(&key, tex_id) : 0;
+}
+
+static unsigned int SOIL_internal_load_OGL_texture(
+    const char *filename, int force_channels, unsigned int reuse_texture_ID,
+    unsigned int flags) {
+  unsigned int tex_id;
+  /*	everything the load needs only while it runs comes out of this
+          thread's scratch arena (if it has one)	*/
+  image_scratch_begin();
+  tex_id = SOIL_decode_OGL_texture(filename, force_channels, reuse_texture_ID,
+                                   flags);
+  image_scratch_end();
+  return tex_id;
+}
+
+static unsigned int SOIL_decode_OGL_texture(const char *filename,
+                                            int force_channels,
+                                            unsigned int reuse_texture_ID,
+                                            unsigned int flags) {
   /*	variables	*/
   unsigned char *img;
   int width, height, channels;
   unsigned int tex_id;
+  /*	the texture cache is keyed on the file's contents, not its name	*/
+  if ((NULL != texture_cache_directory) &&
+      !(flags & SOIL_FLAG_TEXTURE_RECTANGLE)) {
+    FILE *f = fopen(filename, "rb");
+    if (NULL != f) {
+      long buffer_length;
+      unsigned char *buffer = NULL;
+      fseek(f, 0, SEEK_END);
+      buffer_length = ftell(f);
+      fseek(f, 0, SEEK_SET);
+      if (buffer_length > 0) {
+        buffer = (unsigned char *)image_malloc(buffer_length);
+      }
+      if ((NULL != buffer) &&
+          (fread(buffer, 1, buffer_length, f) == (size_t)buffer_length)) {
+        fclose(f);
+        tex_id = SOIL_internal_load_OGL_texture_from_memory(
+            buffer, (int)buffer_length, force_channels, reuse_texture_ID,
+            flags);
+        SOIL_free_image_data(buffer);
+        return tex_id;
+      }
+      /*	fall back to the uncached path, it'll report the error	*/
+      SOIL_free_image_data(buffer);
+      fclose(f);
+    }
+  }
   /*	does the user want direct uploading of the image as a DDS file?	*/
   if (flags & SOIL_FLAG_DDS_LOAD_DIRECT) {
     /*	1st try direct loading of the image as a DDS file
@@ -129,12 +435,13 @@ unsigned int SOIL_load_OGL_texture(const char *filename, int force_channels,
   if (NULL == img) {
     /*	image loading failed	*/
     result_string_pointer = stbi_failure_reason();
-    return 0;
+    /*	but KTX files never get decoded, they only go up as-is	*/
+    return SOIL_direct_load_KTX(filename, reuse_texture_ID, flags, 0);
   }
   /*	OK, make it a texture!	*/
   tex_id = SOIL_internal_create_OGL_texture(
-      img, width, height, channels, reuse_texture_ID, flags, GL_TEXTURE_2D,
-      GL_TEXTURE_2D, GL_MAX_TEXTURE_SIZE);
+      img, width, height, channels, 0, reuse_texture_ID, flags, GL_TEXTURE_2D,
+      GL_TEXTURE_2D, GL_MAX_TEXTURE_SIZE, NULL);
   /*	and nuke the image data	*/
   SOIL_free_image_data(img);
   /*	and return the handle, such as it is	*/
@@ -174,8 +481,8 @@ unsigned int SOIL_load_OGL_HDR_texture(const char *filename,
   }
   /*	OK, make it a texture!	*/
   tex_id = SOIL_internal_create_OGL_texture(
-      img, width, height, channels, reuse_texture_ID, flags, GL_TEXTURE_2D,
-      GL_TEXTURE_2D, GL_MAX_TEXTURE_SIZE);
+      img, width, height, channels, 0, reuse_texture_ID, flags, GL_TEXTURE_2D,
+      GL_TEXTURE_2D, GL_MAX_TEXTURE_SIZE, NULL);
   /*	and nuke the image data	*/
   SOIL_free_image_data(img);
   /*	and return the handle, such as it is	*/
@@ -185,10 +492,48 @@ unsigned int SOIL_load_OGL_HDR_texture(const char *filename,
 unsigned int SOIL_load_OGL_texture_from_memory(
     const unsigned char *const buffer, int buffer_length, int force_channels,
     unsigned int reuse_texture_ID, unsigned int flags) {
+  SOIL_shared_texture key;
+  unsigned int tex_id;
+  if (!texture_dedup_enabled || reuse_texture_ID || (NULL == buffer) ||
+      (buffer_length <= 0)) {
+    return SOIL_internal_load_OGL_texture_from_memory(
+        buffer, buffer_length, force_channels, reuse_texture_ID, flags);
+  }
+  memset(&key, 0, sizeof(SOIL_shared_texture));
+  SOIL_hash_bytes(buffer, buffer_length, key.hash);
+  key.buffer_length = buffer_length;
+  key.force_channels = force_channels;
+  key.flags = flags;
+  tex_id = SOIL_shared_acquire(&key, 0);
+  if (tex_id) {
+    result_string_pointer = "Image already loaded, sharing its texture";
+    return tex_id;
+  }
+  tex_id = SOIL_internal_load_OGL_texture_from_memory(
+      buffer, buffer_length, force_channels, 0, flags);
+  return tex_id ? SOIL_shared_acquire(&key, tex_id) : 0;
+}
+
+static unsigned int SOIL_internal_load_OGL_texture_from_memory(
+    const unsigned char *const buffer, int buffer_length, int force_channels,
+    unsigned int reuse_texture_ID, unsigned int flags) {
+  unsigned int tex_id;
+  image_scratch_begin();
+  tex_id = SOIL_decode_OGL_texture_from_memory(
+      buffer, buffer_length, force_channels, reuse_texture_ID, flags);
+  image_scratch_end();
+  return tex_id;
+}
+
+static unsigned int SOIL_decode_OGL_texture_from_memory(
+    const unsigned char *const buffer, int buffer_length, int force_channels,
+    unsigned int reuse_texture_ID, unsigned int flags) {
   /*	variables	*/
   unsigned char *img;
   int width, height, channels;
   unsigned int tex_id;
+  char *cache_path;
+  SOIL_texture_capture capture;
   /*	does the user want direct uploading of the image as a DDS file?	*/
   if (flags & SOIL_FLAG_DDS_LOAD_DIRECT) {
     /*	1st try direct loading of the image as a DDS file
@@ -202,6 +547,17 @@ unsigned int SOIL_load_OGL_texture_from_memory(
       return tex_id;
     }
   }
+  /*	has this already been decoded and compressed on an earlier run?	*/
+  cache_path =
+      SOIL_cache_path(buffer, buffer_length, force_channels, flags);
+  if (NULL != cache_path) {
+    tex_id = SOIL_direct_load_DDS(cache_path, reuse_texture_ID, flags, 0);
+    if (tex_id) {
+      SOIL_cache_touch(cache_path);
+      image_free(cache_path);
+      return tex_id;
+    }
+  }
   /*	try to load the image	*/
   img = SOIL_load_image_from_memory(buffer, buffer_length, &width, &height,
                                     &channels, force_channels);
@@ -213,14 +569,25 @@ unsigned int SOIL_load_OGL_texture_from_memory(
   if (NULL == img) {
     /*	image loading failed	*/
     result_string_pointer = stbi_failure_reason();
-    return 0;
+    image_free(cache_path);
+    /*	but KTX files never get decoded, they only go up as-is	*/
+    return SOIL_direct_load_KTX_from_memory(buffer, buffer_length,
+                                            reuse_texture_ID, flags, 0);
   }
   /*	OK, make it a texture!	*/
+  memset(&capture, 0, sizeof(SOIL_texture_capture));
   tex_id = SOIL_internal_create_OGL_texture(
-      img, width, height, channels, reuse_texture_ID, flags, GL_TEXTURE_2D,
-      GL_TEXTURE_2D, GL_MAX_TEXTURE_SIZE);
+      img, width, height, channels, 0, reuse_texture_ID, flags, GL_TEXTURE_2D,
+      GL_TEXTURE_2D, GL_MAX_TEXTURE_SIZE,
+      (NULL != cache_path) ? &capture : NULL);
   /*	and nuke the image data	*/
   SOIL_free_image_data(img);
+  /*	keep what went up for next time	*/
+  if (tex_id && (NULL != cache_path)) {
+    SOIL_cache_store(cache_path, &capture);
+  }
+  image_free(capture.data);
+  image_free(cache_path);
   /*	and return the handle, such as it is	*/
   return tex_id;
 }
@@ -258,9 +625,9 @@ unsigned int SOIL_load_OGL_cubemap(
   }
   /*	upload the texture, and create a texture ID if necessary	*/
   tex_id = SOIL_internal_create_OGL_texture(
-      img, width, height, channels, reuse_texture_ID, flags,
+      img, width, height, channels, 0, reuse_texture_ID, flags,
       SOIL_TEXTURE_CUBE_MAP, SOIL_TEXTURE_CUBE_MAP_POSITIVE_X,
-      SOIL_MAX_CUBE_MAP_TEXTURE_SIZE);
+      SOIL_MAX_CUBE_MAP_TEXTURE_SIZE, NULL);
   /*	and nuke the image data	*/
   SOIL_free_image_data(img);
   /*	continue?	*/
@@ -280,8 +647,9 @@ unsigned int SOIL_load_OGL_cubemap(
     }
     /*	upload the texture, but reuse the assigned texture ID	*/
     tex_id = SOIL_internal_create_OGL_texture(
-        img, width, height, channels, tex_id, flags, SOIL_TEXTURE_CUBE_MAP,
-        SOIL_TEXTURE_CUBE_MAP_NEGATIVE_X, SOIL_MAX_CUBE_MAP_TEXTURE_SIZE);
+        img, width, height, channels, 0, tex_id, flags, SOIL_TEXTURE_CUBE_MAP,
+        SOIL_TEXTURE_CUBE_MAP_NEGATIVE_X, SOIL_MAX_CUBE_MAP_TEXTURE_SIZE,
+        NULL);
     /*	and nuke the image data	*/
     SOIL_free_image_data(img);
   }
@@ -302,8 +670,9 @@ unsigned int SOIL_load_OGL_cubemap(
     }
     /*	upload the texture, but reuse the assigned texture ID	*/
     tex_id = SOIL_internal_create_OGL_texture(
-        img, width, height, channels, tex_id, flags, SOIL_TEXTURE_CUBE_MAP,
-        SOIL_TEXTURE_CUBE_MAP_POSITIVE_Y, SOIL_MAX_CUBE_MAP_TEXTURE_SIZE);
+        img, width, height, channels, 0, tex_id, flags, SOIL_TEXTURE_CUBE_MAP,
+        SOIL_TEXTURE_CUBE_MAP_POSITIVE_Y, SOIL_MAX_CUBE_MAP_TEXTURE_SIZE,
+        NULL);
     /*	and nuke the image data	*/
     SOIL_free_image_data(img);
   }
@@ -324,8 +693,9 @@ unsigned int SOIL_load_OGL_cubemap(
     }
     /*	upload the texture, but reuse the assigned texture ID	*/
     tex_id = SOIL_internal_create_OGL_texture(
-        img, width, height, channels, tex_id, flags, SOIL_TEXTURE_CUBE_MAP,
-        SOIL_TEXTURE_CUBE_MAP_NEGATIVE_Y, SOIL_MAX_CUBE_MAP_TEXTURE_SIZE);
+        img, width, height, channels, 0, tex_id, flags, SOIL_TEXTURE_CUBE_MAP,
+        SOIL_TEXTURE_CUBE_MAP_NEGATIVE_Y, SOIL_MAX_CUBE_MAP_TEXTURE_SIZE,
+        NULL);
     /*	and nuke the image data	*/
     SOIL_free_image_data(img);
   }
@@ -346,8 +716,9 @@ unsigned int SOIL_load_OGL_cubemap(
     }
     /*	upload the texture, but reuse the assigned texture ID	*/
     tex_id = SOIL_internal_create_OGL_texture(
-        img, width, height, channels, tex_id, flags, SOIL_TEXTURE_CUBE_MAP,
-        SOIL_TEXTURE_CUBE_MAP_POSITIVE_Z, SOIL_MAX_CUBE_MAP_TEXTURE_SIZE);
+        img, width, height, channels, 0, tex_id, flags, SOIL_TEXTURE_CUBE_MAP,
+        SOIL_TEXTURE_CUBE_MAP_POSITIVE_Z, SOIL_MAX_CUBE_MAP_TEXTURE_SIZE,
+        NULL);
     /*	and nuke the image data	*/
     SOIL_free_image_data(img);
   }
@@ -368,8 +739,9 @@ unsigned int SOIL_load_OGL_cubemap(
     }
     /*	upload the texture, but reuse the assigned texture ID	*/
     tex_id = SOIL_internal_create_OGL_texture(
-        img, width, height, channels, tex_id, flags, SOIL_TEXTURE_CUBE_MAP,
-        SOIL_TEXTURE_CUBE_MAP_NEGATIVE_Z, SOIL_MAX_CUBE_MAP_TEXTURE_SIZE);
+        img, width, height, channels, 0, tex_id, flags, SOIL_TEXTURE_CUBE_MAP,
+        SOIL_TEXTURE_CUBE_MAP_NEGATIVE_Z, SOIL_MAX_CUBE_MAP_TEXTURE_SIZE,
+        NULL);
     /*	and nuke the image data	*/
     SOIL_free_image_data(img);
   }
@@ -416,9 +788,9 @@ unsigned int SOIL_load_OGL_cubemap_from_memory(
   }
   /*	upload the texture, and create a texture ID if necessary	*/
   tex_id = SOIL_internal_create_OGL_texture(
-      img, width, height, channels, reuse_texture_ID, flags,
+      img, width, height, channels, 0, reuse_texture_ID, flags,
       SOIL_TEXTURE_CUBE_MAP, SOIL_TEXTURE_CUBE_MAP_POSITIVE_X,
-      SOIL_MAX_CUBE_MAP_TEXTURE_SIZE);
+      SOIL_MAX_CUBE_MAP_TEXTURE_SIZE, NULL);
   /*	and nuke the image data	*/
   SOIL_free_image_data(img);
   /*	continue?	*/
@@ -438,8 +810,9 @@ unsigned int SOIL_load_OGL_cubemap_from_memory(
     }
     /*	upload the texture, but reuse the assigned texture ID	*/
     tex_id = SOIL_internal_create_OGL_texture(
-        img, width, height, channels, tex_id, flags, SOIL_TEXTURE_CUBE_MAP,
-        SOIL_TEXTURE_CUBE_MAP_NEGATIVE_X, SOIL_MAX_CUBE_MAP_TEXTURE_SIZE);
+        img, width, height, channels, 0, tex_id, flags, SOIL_TEXTURE_CUBE_MAP,
+        SOIL_TEXTURE_CUBE_MAP_NEGATIVE_X, SOIL_MAX_CUBE_MAP_TEXTURE_SIZE,
+        NULL);
     /*	and nuke the image data	*/
     SOIL_free_image_data(img);
   }
@@ -460,8 +833,9 @@ unsigned int SOIL_load_OGL_cubemap_from_memory(
     }
     /*	upload the texture, but reuse the assigned texture ID	*/
     tex_id = SOIL_internal_create_OGL_texture(
-        img, width, height, channels, tex_id, flags, SOIL_TEXTURE_CUBE_MAP,
-        SOIL_TEXTURE_CUBE_MAP_POSITIVE_Y, SOIL_MAX_CUBE_MAP_TEXTURE_SIZE);
+        img, width, height, channels, 0, tex_id, flags, SOIL_TEXTURE_CUBE_MAP,
+        SOIL_TEXTURE_CUBE_MAP_POSITIVE_Y, SOIL_MAX_CUBE_MAP_TEXTURE_SIZE,
+        NULL);
     /*	and nuke the image data	*/
     SOIL_free_image_data(img);
   }
@@ -482,8 +856,9 @@ unsigned int SOIL_load_OGL_cubemap_from_memory(
     }
     /*	upload the texture, but reuse the assigned texture ID	*/
     tex_id = SOIL_internal_create_OGL_texture(
-        img, width, height, channels, tex_id, flags, SOIL_TEXTURE_CUBE_MAP,
-        SOIL_TEXTURE_CUBE_MAP_NEGATIVE_Y, SOIL_MAX_CUBE_MAP_TEXTURE_SIZE);
+        img, width, height, channels, 0, tex_id, flags, SOIL_TEXTURE_CUBE_MAP,
+        SOIL_TEXTURE_CUBE_MAP_NEGATIVE_Y, SOIL_MAX_CUBE_MAP_TEXTURE_SIZE,
+        NULL);
     /*	and nuke the image data	*/
     SOIL_free_image_data(img);
   }
@@ -504,8 +879,9 @@ unsigned int SOIL_load_OGL_cubemap_from_memory(
     }
     /*	upload the texture, but reuse the assigned texture ID	*/
     tex_id = SOIL_internal_create_OGL_texture(
-        img, width, height, channels, tex_id, flags, SOIL_TEXTURE_CUBE_MAP,
-        SOIL_TEXTURE_CUBE_MAP_POSITIVE_Z, SOIL_MAX_CUBE_MAP_TEXTURE_SIZE);
+        img, width, height, channels, 0, tex_id, flags, SOIL_TEXTURE_CUBE_MAP,
+        SOIL_TEXTURE_CUBE_MAP_POSITIVE_Z, SOIL_MAX_CUBE_MAP_TEXTURE_SIZE,
+        NULL);
     /*	and nuke the image data	*/
     SOIL_free_image_data(img);
   }
@@ -526,8 +902,9 @@ unsigned int SOIL_load_OGL_cubemap_from_memory(
     }
     /*	upload the texture, but reuse the assigned texture ID	*/
     tex_id = SOIL_internal_create_OGL_texture(
-        img, width, height, channels, tex_id, flags, SOIL_TEXTURE_CUBE_MAP,
-        SOIL_TEXTURE_CUBE_MAP_NEGATIVE_Z, SOIL_MAX_CUBE_MAP_TEXTURE_SIZE);
+        img, width, height, channels, 0, tex_id, flags, SOIL_TEXTURE_CUBE_MAP,
+        SOIL_TEXTURE_CUBE_MAP_NEGATIVE_Z, SOIL_MAX_CUBE_MAP_TEXTURE_SIZE,
+        NULL);
     /*	and nuke the image data	*/
     SOIL_free_image_data(img);
   }
@@ -585,7 +962,8 @@ unsigned int SOIL_load_OGL_single_cubemap(const char *filename,
   if (NULL == img) {
     /*	image loading failed	*/
     result_string_pointer = stbi_failure_reason();
-    return 0;
+    /*	but KTX files never get decoded, they only go up as-is	*/
+    return SOIL_direct_load_KTX(filename, reuse_texture_ID, flags, 1);
   }
   /*	now, does this image have the right dimensions?	*/
   if ((width != 6 * height) && (6 * width != height)) {
@@ -652,7 +1030,9 @@ unsigned int SOIL_load_OGL_single_cubemap_from_memory(
   if (NULL == img) {
     /*	image loading failed	*/
     result_string_pointer = stbi_failure_reason();
-    return 0;
+    /*	but KTX files never get decoded, they only go up as-is	*/
+    return SOIL_direct_load_KTX_from_memory(buffer, buffer_length,
+                                            reuse_texture_ID, flags, 1);
   }
   /*	now, does this image have the right dimensions?	*/
   if ((width != 6 * height) && (6 * width != height)) {
@@ -674,7 +1054,6 @@ unsigned int SOIL_create_OGL_single_cubemap(const unsigned char *const data,
                                             unsigned int reuse_texture_ID,
                                             unsigned int flags) {
   /*	variables	*/
-  unsigned char *sub_img;
   int dw, dh, sz, i;
   unsigned int tex_id;
   /*	error checking	*/
@@ -710,18 +1089,13 @@ unsigned int SOIL_create_OGL_single_cubemap(const unsigned char *const data,
     dh = width;
   }
   sz = dw + dh;
-  sub_img = (unsigned char *)malloc(sz * sz * channels);
   /*	do the splitting and uploading	*/
   tex_id = reuse_texture_ID;
   for (i = 0; i < 6; ++i) {
-    int x, y, idx = 0;
     unsigned int cubemap_target = 0;
-    /*	copy in the sub-image	*/
-    for (y = i * dh; y < i * dh + sz; ++y) {
-      for (x = i * dw * channels; x < (i * dw + sz) * channels; ++x) {
-        sub_img[idx++] = data[y * width * channels + x];
-      }
-    }
+    /*	each face is a square piece of the strip, whose rows are still
+            a whole strip apart	*/
+    const unsigned char *face = data + (i * dh * width + i * dw) * channels;
     /*	what is my texture target?
             remember, this coordinate system is
             LHS if viewed from inside the cube!	*/
@@ -747,11 +1121,10 @@ unsigned int SOIL_create_OGL_single_cubemap(const unsigned char *const data,
     }
     /*	upload it as a texture	*/
     tex_id = SOIL_internal_create_OGL_texture(
-        sub_img, sz, sz, channels, tex_id, flags, SOIL_TEXTURE_CUBE_MAP,
-        cubemap_target, SOIL_MAX_CUBE_MAP_TEXTURE_SIZE);
+        face, sz, sz, channels, width * channels, tex_id, flags,
+        SOIL_TEXTURE_CUBE_MAP, cubemap_target, SOIL_MAX_CUBE_MAP_TEXTURE_SIZE,
+        NULL);
   }
-  /*	and nuke the image and sub-image data	*/
-  SOIL_free_image_data(sub_img);
   /*	and return the handle, such as it is	*/
   return tex_id;
 }
@@ -762,8 +1135,17 @@ unsigned int SOIL_create_OGL_texture(const unsigned char *const data, int width,
                                      unsigned int flags) {
   /*	wrapper function for 2D textures	*/
   return SOIL_internal_create_OGL_texture(
-      data, width, height, channels, reuse_texture_ID, flags, GL_TEXTURE_2D,
-      GL_TEXTURE_2D, GL_MAX_TEXTURE_SIZE);
+      data, width, height, channels, 0, reuse_texture_ID, flags, GL_TEXTURE_2D,
+      GL_TEXTURE_2D, GL_MAX_TEXTURE_SIZE, NULL);
+}
+
+unsigned int SOIL_create_OGL_texture_with_stride(
+    const unsigned char *const data, int width, int height, int channels,
+    int stride, unsigned int reuse_texture_ID, unsigned int flags) {
+  /*	the same, for rows that aren't packed	*/
+  return SOIL_internal_create_OGL_texture(
+      data, width, height, channels, stride, reuse_texture_ID, flags,
+      GL_TEXTURE_2D, GL_TEXTURE_2D, GL_MAX_TEXTURE_SIZE, NULL);
 }
 
 #if SOIL_CHECK_FOR_GL_ERRORS
@@ -781,48 +1163,258 @@ void check_for_GL_errors(const char *calling_location) {
 }
 #endif
 
-unsigned int SOIL_internal_create_OGL_texture(
-    const unsigned char *const data, int width, int height, int channels,
-    unsigned int reuse_texture_ID, unsigned int flags,
-    unsigned int opengl_texture_type, unsigned int opengl_texture_target,
-    unsigned int texture_check_size_enum) {
-  /*	variables	*/
-  unsigned char *img;
-  unsigned int tex_id;
-  unsigned int internal_texture_format = 0, original_texture_format = 0;
-  int DXT_mode = SOIL_CAPABILITY_UNKNOWN;
-  int max_supported_size;
-  /*	If the user wants to use the texture rectangle I kill a few flags
-   */
-  if (flags & SOIL_FLAG_TEXTURE_RECTANGLE) {
-    /*	well, the user asked for it, can we do that?	*/
-    if (query_tex_rectangle_capability() == SOIL_CAPABILITY_PRESENT) {
-      /*	only allow this if the user in _NOT_ trying to do a cubemap!
-       */
-      if (opengl_texture_type == GL_TEXTURE_2D) {
-        /*	clean out the flags that cannot be used with texture rectangles
-         */
-        flags &= ~(SOIL_FLAG_POWER_OF_TWO | SOIL_FLAG_MIPMAPS |
-                   SOIL_FLAG_TEXTURE_REPEATS);
-        /*	and change my target	*/
-        opengl_texture_target = SOIL_TEXTURE_RECTANGLE_ARB;
-        opengl_texture_type = SOIL_TEXTURE_RECTANGLE_ARB;
-      } else {
-        /*	not allowed for any other uses (yes, I'm looking at you,
-         * cubemaps!)	*/
-        flags &= ~SOIL_FLAG_TEXTURE_RECTANGLE;
-      }
+/*	the sized version of an unsized format, for glTexStorage	*/
+static unsigned int sized_texture_format(unsigned int format) {
+  switch (format) {
+  case GL_LUMINANCE:
+    return GL_LUMINANCE8;
+  case GL_LUMINANCE_ALPHA:
+    return GL_LUMINANCE8_ALPHA8;
+  case GL_RGB:
+    return GL_RGB8;
+  case GL_RGBA:
+    return GL_RGBA8;
+  }
+  /*	compressed formats are sized already	*/
+  return format;
+}
 
-    } else {
-      /*	can't do it, and that is a breakable offense (uv coords use
-       * pixels instead of [0,1]!)	*/
-      result_string_pointer = "Texture Rectangle extension unsupported";
-      return 0;
+/*	gives the bound texture all its levels in one go, if the driver can
+        (a depth of 0 means 2D or cubemap, anything else means 3D or array).
+        returns 1 if it did, and then the levels have to be filled with
+        glTexSubImage / glCompressedTexSubImage (see SOIL_upload_level),
+        or -1 if the texture already has storage of another shape	*/
+static int SOIL_allocate_storage(unsigned int tex_id,
+                                 unsigned int opengl_texture_type,
+                                 unsigned int opengl_texture_target,
+                                 int levels, unsigned int internal_format,
+                                 int width, int height, int depth) {
+  unsigned int sized_format = sized_texture_format(internal_format);
+  GLint immutable = 0;
+  if (query_tex_storage_capability() == SOIL_CAPABILITY_PRESENT) {
+    glGetTexParameteriv(opengl_texture_type, SOIL_TEXTURE_IMMUTABLE_FORMAT,
+                        &immutable);
+  }
+  if (immutable) {
+    /*	a reused texture (or another face of this cubemap) that already
+            has its storage: if it is the right shape, just fill it in	*/
+    GLint old_levels = 0, old_width = 0, old_height = 0, old_depth = 0;
+    GLint old_format = 0;
+    glGetTexParameteriv(opengl_texture_type, SOIL_TEXTURE_IMMUTABLE_LEVELS,
+                        &old_levels);
+    glGetTexLevelParameteriv(opengl_texture_target, 0, GL_TEXTURE_WIDTH,
+                             &old_width);
+    glGetTexLevelParameteriv(opengl_texture_target, 0, GL_TEXTURE_HEIGHT,
+                             &old_height);
+    glGetTexLevelParameteriv(opengl_texture_target, 0,
+                             GL_TEXTURE_INTERNAL_FORMAT, &old_format);
+    if (depth > 0) {
+      glGetTexLevelParameteriv(opengl_texture_target, 0, SOIL_TEXTURE_DEPTH,
+                               &old_depth);
+    }
+    if ((old_levels != levels) || (old_width != width) ||
+        (old_height != height) || (old_depth != depth) ||
+        ((unsigned int)old_format != sized_format)) {
+      /*	immutable storage can't be redefined, and the caller's name
+              has to stay theirs, so leave the texture as it is	*/
+      result_string_pointer = "Reused texture has immutable storage of a "
+                              "different size or format";
+      return -1;
+    }
+  }
+  /*	every texture SOIL makes comes through here, so count it	*/
+  SOIL_track_texture(tex_id, opengl_texture_type, internal_format, levels,
+                     width, height, depth);
+  if (immutable) {
+    return 1;
+  }
+  /*	while there is a budget, textures have to stay resizable so they can
+          be evicted without losing their name	*/
+  if ((0 == tex_id) ||
+      (query_tex_storage_capability() != SOIL_CAPABILITY_PRESENT) ||
+      (texture_budget_enabled && (texture_budget_bytes > 0))) {
+    return 0;
+  }
+  if (depth > 0) {
+    soilGlTexStorage3D(opengl_texture_type, levels, sized_format, width,
+                       height, depth);
+  } else {
+    soilGlTexStorage2D(opengl_texture_type, levels, sized_format, width,
+                       height);
+  }
+  check_for_GL_errors("glTexStorage");
+  return 1;
+}
+
+/*	uploads one level of a 2D texture or cubemap face, into the storage
+        SOIL_allocate_storage made, or the old way.  format is 0 if the
+        data is already compressed in internal_format	*/
+static void SOIL_upload_level(int use_storage,
+                              unsigned int opengl_texture_target, int level,
+                              unsigned int internal_format, unsigned int format,
+                              unsigned int type, int width, int height,
+                              int data_size, const unsigned char *data) {
+  if (use_storage && format) {
+    glTexSubImage2D(opengl_texture_target, level, 0, 0, width, height, format,
+                    type, data);
+    check_for_GL_errors("glTexSubImage2D");
+  } else if (use_storage) {
+    soilGlCompressedTexSubImage2D(opengl_texture_target, level, 0, 0, width,
+                                  height, internal_format, data_size, data);
+    check_for_GL_errors("glCompressedTexSubImage2D");
+  } else if (format) {
+    glTexImage2D(opengl_texture_target, level, internal_format, width, height,
+                 0, format, type, data);
+    check_for_GL_errors("glTexImage2D");
+  } else {
+    soilGlCompressedTexImage2D(opengl_texture_target, level, internal_format,
+                               width, height, 0, data_size, data);
+    check_for_GL_errors("glCompressedTexImage2D");
+  }
+}
+
+/*	the same, for a whole level of a 3D texture or texture array	*/
+static void SOIL_upload_level_3D(int use_storage,
+                                 unsigned int opengl_texture_type, int level,
+                                 unsigned int internal_format,
+                                 unsigned int format, unsigned int type,
+                                 int width, int height, int depth,
+                                 int data_size, const unsigned char *data) {
+  if (use_storage && format) {
+    soilGlTexSubImage3D(opengl_texture_type, level, 0, 0, 0, width, height,
+                        depth, format, type, data);
+    check_for_GL_errors("glTexSubImage3D");
+  } else if (use_storage) {
+    soilGlCompressedTexSubImage3D(opengl_texture_type, level, 0, 0, 0, width,
+                                  height, depth, internal_format, data_size,
+                                  data);
+    check_for_GL_errors("glCompressedTexSubImage3D");
+  } else if (format) {
+    soilGlTexImage3D(opengl_texture_type, level, internal_format, width, height,
+                     depth, 0, format, type, data);
+    check_for_GL_errors("glTexImage3D");
+  } else {
+    soilGlCompressedTexImage3D(opengl_texture_type, level, internal_format,
+                               width, height, depth, 0, data_size, data);
+    check_for_GL_errors("glCompressedTexImage3D");
+  }
+}
+
+/*	works out what size an image will be uploaded at: a power of two if
+        it needs to be, then brought down to what the driver can take	*/
+static void SOIL_texture_size(int width, int height, unsigned int flags,
+                              int max_supported_size, int *new_width,
+                              int *new_height) {
+  *new_width = width;
+  *new_height = height;
+  /*	only when the user asked for it, or the driver can't do without
+          (MIPmaps of any size are fine if it does NPOT at all)	*/
+  if (flags & SOIL_FLAG_POWER_OF_TWO) {
+    *new_width = 1;
+    *new_height = 1;
+    while (*new_width < width) {
+      *new_width *= 2;
+    }
+    while (*new_height < height) {
+      *new_height *= 2;
+    }
+    /*	now, if it is too large, halve it until it fits	*/
+    if (*new_width > max_supported_size) {
+      *new_width /= *new_width / max_supported_size;
+    }
+    if (*new_height > max_supported_size) {
+      *new_height /= *new_height / max_supported_size;
     }
+  } else {
+    /*	any size will do, as long as it isn't too large	*/
+    if (*new_width > max_supported_size) {
+      *new_width = max_supported_size;
+    }
+    if (*new_height > max_supported_size) {
+      *new_height = max_supported_size;
+    }
+  }
+}
+
+/*	resizes img (rows stride bytes apart, 0 if packed) straight to
+        new_width x new_height in one pass, or returns NULL.  Pure
+        enlargements stay bilinear, anything that shrinks gets filtered
+        properly	*/
+static unsigned char *SOIL_resize_image(const unsigned char *img, int width,
+                                        int height, int channels, int stride,
+                                        int new_width, int new_height,
+                                        resample_parallel_for parallel_for) {
+  unsigned char *resampled =
+      (unsigned char *)image_malloc(channels * new_width * new_height);
+  int ok;
+  if (NULL == resampled) {
+    return NULL;
+  }
+  if ((new_width >= width) && (new_height >= height) && (new_width > 1) &&
+      (new_height > 1)) {
+    ok = up_scale_image(img, width, height, channels, stride, resampled,
+                        new_width, new_height, parallel_for);
+  } else {
+    ok = resample_image(img, width, height, channels, stride, resampled,
+                        new_width, new_height, RESAMPLE_MITCHELL,
+                        parallel_for);
+  }
+  if (!ok) {
+    SOIL_free_image_data(resampled);
+    return NULL;
+  }
+  return resampled;
+}
+
+/*	one MIPmap level, averaged straight from the full size image (it comes
+        out max(1, size >> level) each way), as linear light if it's sRGB	*/
+static int SOIL_mipmap_level(const unsigned char *img, int width, int height,
+                             int channels, int stride,
+                             unsigned char *resampled, int level,
+                             unsigned int flags,
+                             resample_parallel_for parallel_for) {
+  if (flags & SOIL_FLAG_SRGB_COLOR_SPACE) {
+    int MIPwidth = width >> level;
+    int MIPheight = height >> level;
+    return srgb_scale_image(img, width, height, channels, stride, resampled,
+                            (MIPwidth < 1) ? 1 : MIPwidth,
+                            (MIPheight < 1) ? 1 : MIPheight, parallel_for);
   }
-  /*	create a copy the image data	*/
-  img = (unsigned char *)malloc(width * height * channels);
-  memcpy(img, data, width * height * channels);
+  return mipmap_image(img, width, height, channels, stride, resampled,
+                      (1 << level), (1 << level), parallel_for);
+}
+
+/*	runs my own compressor for whichever compressed format was picked	*/
+static unsigned char *compress_image_for_GL(unsigned int internal_format,
+                                            const unsigned char *const img,
+                                            int width, int height,
+                                            int channels, int stride,
+                                            int *out_size) {
+  switch (internal_format) {
+  case SOIL_RGB_S3TC_DXT1:
+  case SOIL_COMPRESSED_SRGB_S3TC_DXT1:
+    return convert_image_to_DXT1(img, width, height, channels, stride,
+                                 out_size);
+  case SOIL_RGBA_S3TC_DXT5:
+  case SOIL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5:
+    return convert_image_to_DXT5(img, width, height, channels, stride,
+                                 out_size);
+  case SOIL_COMPRESSED_LUMINANCE_LATC1:
+  case SOIL_COMPRESSED_RED_RGTC1:
+    return convert_image_to_RGTC1(img, width, height, channels, stride,
+                                  out_size);
+  case SOIL_COMPRESSED_LUMINANCE_ALPHA_LATC2:
+  case SOIL_COMPRESSED_RG_RGTC2:
+    return convert_image_to_RGTC2(img, width, height, channels, stride,
+                                  out_size);
+  }
+  *out_size = 0;
+  return NULL;
+}
+
+/*	inverts, NTSC-scales and pre-multiplies the image, as the flags ask	*/
+static void apply_image_flags(unsigned char *img, int width, int height,
+                              int channels, unsigned int flags) {
   /*	does the user want me to invert the image?	*/
   if (flags & SOIL_FLAG_INVERT_Y) {
     int i, j;
@@ -841,7 +1433,7 @@ unsigned int SOIL_internal_create_OGL_texture(
   /*	does the user want me to scale the colors into the NTSC safe RGB range?
    */
   if (flags & SOIL_FLAG_NTSC_SAFE_RGB) {
-    scale_image_RGB_to_NTSC_safe(img, width, height, channels);
+    scale_image_RGB_to_NTSC_safe(img, width, height, channels, 0);
   }
   /*	does the user want me to convert from straight to pre-multiplied alpha?
           (and do we even _have_ alpha?)	*/
@@ -865,6 +1457,127 @@ unsigned int SOIL_internal_create_OGL_texture(
       break;
     }
   }
+}
+
+/*	which compressed format (if any) an image with this many channels
+        should go up as, 0 if the driver has none of them	*/
+static unsigned int compressed_format_for_channels(int channels) {
+  if ((channels < 3) && (query_LATC_capability() == SOIL_CAPABILITY_PRESENT)) {
+    /*	L or LA, LATC keeps the meaning of the channels	*/
+    return (channels == 1) ? SOIL_COMPRESSED_LUMINANCE_LATC1
+                           : SOIL_COMPRESSED_LUMINANCE_ALPHA_LATC2;
+  }
+  if ((channels < 3) && (query_RGTC_capability() == SOIL_CAPABILITY_PRESENT) &&
+      (query_swizzle_capability() == SOIL_CAPABILITY_PRESENT)) {
+    /*	L or LA as R or RG, swizzled back when it is bound	*/
+    return (channels == 1) ? SOIL_COMPRESSED_RED_RGTC1
+                           : SOIL_COMPRESSED_RG_RGTC2;
+  }
+  if (query_DXT_capability() == SOIL_CAPABILITY_PRESENT) {
+    /*	I can use DXT, whether I compress it or OpenGL does	*/
+    if ((channels & 1) == 1) {
+      /*	1 or 3 channels = DXT1	*/
+      return SOIL_RGB_S3TC_DXT1;
+    } else {
+      /*	2 or 4 channels = DXT5	*/
+      return SOIL_RGBA_S3TC_DXT5;
+    }
+  }
+  return 0;
+}
+
+/*	the sRGB version of an internal format, 0 if there isn't one	*/
+static unsigned int sRGB_texture_format(unsigned int format) {
+  switch (format) {
+  case GL_LUMINANCE:
+    return SOIL_SLUMINANCE8;
+  case GL_LUMINANCE_ALPHA:
+    return SOIL_SLUMINANCE8_ALPHA8;
+  case GL_RGB:
+    return SOIL_SRGB8;
+  case GL_RGBA:
+    return SOIL_SRGB8_ALPHA8;
+  case SOIL_RGB_S3TC_DXT1:
+    return SOIL_COMPRESSED_SRGB_S3TC_DXT1;
+  case SOIL_RGBA_S3TC_DXT5:
+    return SOIL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5;
+  }
+  /*	LATC and RGTC are linear only	*/
+  return 0;
+}
+
+/*	L / LA stored as RGTC1 / RGTC2 has to be read back as R,R,R,(1 or G)	*/
+static void swizzle_RGTC_to_luminance(unsigned int opengl_texture_type,
+                                      unsigned int internal_texture_format,
+                                      int channels) {
+  if ((internal_texture_format == SOIL_COMPRESSED_RED_RGTC1) ||
+      (internal_texture_format == SOIL_COMPRESSED_RG_RGTC2)) {
+    /*	read R as luminance, and G (if there is one) as alpha	*/
+    GLint swizzle[4] = {SOIL_RED, SOIL_RED, SOIL_RED, GL_ONE};
+    if (channels == 2) {
+      swizzle[3] = SOIL_GREEN;
+    }
+    glTexParameteriv(opengl_texture_type, SOIL_TEXTURE_SWIZZLE_RGBA, swizzle);
+    check_for_GL_errors("GL_TEXTURE_SWIZZLE_RGBA");
+  }
+}
+
+unsigned int SOIL_internal_create_OGL_texture(
+    const unsigned char *const data, int width, int height, int channels,
+    int stride, unsigned int reuse_texture_ID, unsigned int flags,
+    unsigned int opengl_texture_type, unsigned int opengl_texture_target,
+    unsigned int texture_check_size_enum, SOIL_texture_capture *capture) {
+  /*	variables	*/
+  unsigned char *img = NULL;
+  const unsigned char *pixels = data;
+  unsigned int tex_id;
+  unsigned int internal_texture_format = 0, original_texture_format = 0;
+  int DXT_mode = SOIL_CAPABILITY_UNKNOWN;
+  int max_supported_size;
+  int levels = 1, use_storage;
+  int new_width, new_height;
+  GLint old_alignment = 4, old_row_length = 0;
+  /*	0 means the rows are packed	*/
+  if (0 == stride) {
+    stride = width * channels;
+  }
+  if ((NULL == data) || (width < 1) || (height < 1) || (channels < 1) ||
+      (stride < width * channels)) {
+    result_string_pointer = "Invalid image data or row stride";
+    return 0;
+  }
+  /*	If the user wants to use the texture rectangle I kill a few flags
+   */
+  if (flags & SOIL_FLAG_TEXTURE_RECTANGLE) {
+    /*	well, the user asked for it, can we do that?	*/
+    if (query_tex_rectangle_capability() == SOIL_CAPABILITY_PRESENT) {
+      /*	only allow this if the user in _NOT_ trying to do a cubemap!
+       */
+      if (opengl_texture_type == GL_TEXTURE_2D) {
+        /*	clean out the flags that cannot be used with texture rectangles
+         */
+        flags &= ~(SOIL_FLAG_POWER_OF_TWO | SOIL_FLAG_MIPMAPS |
+                   SOIL_FLAG_TEXTURE_REPEATS);
+        /*	and change my target	*/
+        opengl_texture_target = SOIL_TEXTURE_RECTANGLE_ARB;
+        opengl_texture_type = SOIL_TEXTURE_RECTANGLE_ARB;
+      } else {
+        /*	not allowed for any other uses (yes, I'm looking at you,
+         * cubemaps!)	*/
+        flags &= ~SOIL_FLAG_TEXTURE_RECTANGLE;
+      }
+
+    } else {
+      /*	can't do it, and that is a breakable offense (uv coords use
+       * pixels instead of [0,1]!)	*/
+      result_string_pointer = "Texture Rectangle extension unsupported";
+      return 0;
+    }
+  }
+  /*	YCoCg isn't sRGB any more, whatever it was before	*/
+  if (flags & SOIL_FLAG_CoCg_Y) {
+    flags &= ~SOIL_FLAG_SRGB_COLOR_SPACE;
+  }
   /*	if the user can't support NPOT textures, make sure we force the POT
    * option	*/
   if ((query_NPOT_capability() == SOIL_CAPABILITY_NONE) &&
@@ -876,70 +1589,67 @@ unsigned int SOIL_internal_create_OGL_texture(
   /*	texture_check_size_enum will be GL_MAX_TEXTURE_SIZE or
    * SOIL_MAX_CUBE_MAP_TEXTURE_SIZE	*/
   glGetIntegerv(texture_check_size_enum, &max_supported_size);
-  /*	do I need to make it a power of 2?	*/
-  if ((flags & SOIL_FLAG_POWER_OF_TWO) || /*	user asked for it	*/
-      (flags & SOIL_FLAG_MIPMAPS) ||      /*	need it for the MIP-maps	*/
-      (width >
-       max_supported_size) ||        /*	it's too big, (make sure it's	*/
-      (height > max_supported_size)) /*	2^n for later down-sampling)	*/
-  {
-    int new_width = 1;
-    int new_height = 1;
-    while (new_width < width) {
-      new_width *= 2;
-    }
-    while (new_height < height) {
-      new_height *= 2;
-    }
-    /*	still?	*/
-    if ((new_width != width) || (new_height != height)) {
-      /*	yep, resize	*/
-      unsigned char *resampled =
-          (unsigned char *)malloc(channels * new_width * new_height);
-      up_scale_image(img, width, height, channels, resampled, new_width,
-                     new_height);
-      /*	OJO	this is for debug only!	*/
-      /*
-      SOIL_save_image( "\\showme.bmp", SOIL_SAVE_TYPE_BMP,
-                                      new_width, new_height, channels,
-                                      resampled );
-      */
-      /*	nuke the old guy, then point it at the new guy	*/
+  /*	work out the final size first, then get there in one resize
+          (an oversized NPOT image never gets blown up to the next power of
+          two only to be shrunk right back down)	*/
+  SOIL_texture_size(width, height, flags, max_supported_size, &new_width,
+                    &new_height);
+  /*	the copies and MIPmaps only last until the upload	*/
+  image_scratch_begin();
+  /*	the caller's rows are only copied if the pixels have to change
+          before they get resized (or uploaded, if they don't), or if
+          GL_UNPACK_ROW_LENGTH can't step over them	*/
+  if ((flags & (SOIL_FLAG_INVERT_Y | SOIL_FLAG_NTSC_SAFE_RGB |
+                SOIL_FLAG_MULTIPLY_ALPHA)) ||
+      (((new_width == width) && (new_height == height)) &&
+       ((flags & SOIL_FLAG_CoCg_Y) || (stride % channels) ||
+        ((NULL != capture) && (stride != width * channels))))) {
+    int j;
+    img = (unsigned char *)image_malloc(width * height * channels);
+    if (NULL == img) {
+      image_scratch_end();
+      result_string_pointer = "Failed to copy the image";
+      return 0;
+    }
+    /*	inverting it on the way	*/
+    for (j = 0; j < height; ++j) {
+      int from = (flags & SOIL_FLAG_INVERT_Y) ? height - 1 - j : j;
+      memcpy(img + j * width * channels, data + from * stride,
+             width * channels);
+    }
+    apply_image_flags(img, width, height, channels,
+                      flags & ~SOIL_FLAG_INVERT_Y);
+    pixels = img;
+    stride = width * channels;
+  }
+  if ((new_width != width) || (new_height != height)) {
+    unsigned char *resampled =
+        SOIL_resize_image(pixels, width, height, channels, stride, new_width,
+                          new_height, SOIL_run_parallel);
+    if (NULL == resampled) {
       SOIL_free_image_data(img);
-      img = resampled;
-      width = new_width;
-      height = new_height;
-    }
-  }
-  /*	now, if it is too large...	*/
-  if ((width > max_supported_size) || (height > max_supported_size)) {
-    /*	I've already made it a power of two, so simply use the MIPmapping
-            code to reduce its size to the allowable maximum.	*/
-    unsigned char *resampled;
-    int reduce_block_x = 1, reduce_block_y = 1;
-    int new_width, new_height;
-    if (width > max_supported_size) {
-      reduce_block_x = width / max_supported_size;
-    }
-    if (height > max_supported_size) {
-      reduce_block_y = height / max_supported_size;
-    }
-    new_width = width / reduce_block_x;
-    new_height = height / reduce_block_y;
-    resampled = (unsigned char *)malloc(channels * new_width * new_height);
-    /*	perform the actual reduction	*/
-    mipmap_image(img, width, height, channels, resampled, reduce_block_x,
-                 reduce_block_y);
+      image_scratch_end();
+      result_string_pointer = "Failed to resize the image";
+      return 0;
+    }
+    /*	OJO	this is for debug only!	*/
+    /*
+    SOIL_save_image( "\\showme.bmp", SOIL_SAVE_TYPE_BMP,
+                                    new_width, new_height, channels,
+                                    resampled );
+    */
     /*	nuke the old guy, then point it at the new guy	*/
     SOIL_free_image_data(img);
-    img = resampled;
+    pixels = img = resampled;
     width = new_width;
     height = new_height;
+    stride = width * channels;
   }
   /*	does the user want us to use YCoCg color space?	*/
   if (flags & SOIL_FLAG_CoCg_Y) {
-    /*	this will only work with RGB and RGBA images */
-    convert_RGB_to_YCoCg(img, width, height, channels);
+    /*	this will only work with RGB and RGBA images (and by now img
+            is a copy of them)	*/
+    convert_RGB_to_YCoCg(img, width, height, channels, 0);
     /*
     save_image_as_DDS( "CoCg_Y.dds", width, height, channels, img );
     */
@@ -971,105 +1681,150 @@ unsigned int SOIL_internal_create_OGL_texture(
     internal_texture_format = original_texture_format;
     /*	does the user want me to, and can I, save as DXT?	*/
     if (flags & SOIL_FLAG_COMPRESS_TO_DXT) {
-      DXT_mode = query_DXT_capability();
-      if (DXT_mode == SOIL_CAPABILITY_PRESENT) {
-        /*	I can use DXT, whether I compress it or OpenGL does	*/
-        if ((channels & 1) == 1) {
-          /*	1 or 3 channels = DXT1	*/
-          internal_texture_format = SOIL_RGB_S3TC_DXT1;
-        } else {
-          /*	2 or 4 channels = DXT5	*/
-          internal_texture_format = SOIL_RGBA_S3TC_DXT5;
-        }
+      unsigned int compressed_format = compressed_format_for_channels(channels);
+      if (compressed_format) {
+        DXT_mode = SOIL_CAPABILITY_PRESENT;
+        internal_texture_format = compressed_format;
+      }
+    }
+    /*	sRGB colors go up as sRGB, so they get sampled right	*/
+    if ((flags & SOIL_FLAG_SRGB_COLOR_SPACE) &&
+        (query_sRGB_capability() == SOIL_CAPABILITY_PRESENT)) {
+      unsigned int sRGB_format = sRGB_texture_format(internal_texture_format);
+      if (0 == sRGB_format) {
+        /*	that compression has no sRGB version, so skip it	*/
+        DXT_mode = SOIL_CAPABILITY_NONE;
+        sRGB_format = sRGB_texture_format(original_texture_format);
       }
+      internal_texture_format = sRGB_format;
     }
     /*  bind an OpenGL texture ID	*/
     glBindTexture(opengl_texture_type, tex_id);
     check_for_GL_errors("glBindTexture");
+    /*	how many MIPmap levels will there be?	*/
+    if (flags & SOIL_FLAG_MIPMAPS) {
+      while (((1 << levels) <= width) || ((1 << levels) <= height)) {
+        ++levels;
+      }
+    }
+    /*	allocate them all at once, if the driver lets me	*/
+    use_storage = SOIL_allocate_storage(
+        tex_id, opengl_texture_type, opengl_texture_target, levels,
+        internal_texture_format, width, height, 0);
+    if (use_storage < 0) {
+      SOIL_free_image_data(img);
+      image_scratch_end();
+      return 0;
+    }
+    /*	parameters go on once the storage is there	*/
+    swizzle_RGTC_to_luminance(opengl_texture_type, internal_texture_format,
+                              channels);
+    /*	SOIL's own rows are packed with no padding, the caller's are
+            stride bytes apart	*/
+    glGetIntegerv(GL_UNPACK_ALIGNMENT, &old_alignment);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    if (stride != width * channels) {
+      glGetIntegerv(GL_UNPACK_ROW_LENGTH, &old_row_length);
+      glPixelStorei(GL_UNPACK_ROW_LENGTH, stride / channels);
+    }
     /*  upload the main image	*/
     if (DXT_mode == SOIL_CAPABILITY_PRESENT) {
       /*	user wants me to do the DXT conversion!	*/
       int DDS_size;
-      unsigned char *DDS_data = NULL;
-      if ((channels & 1) == 1) {
-        /*	RGB, use DXT1	*/
-        DDS_data =
-            convert_image_to_DXT1(img, width, height, channels, &DDS_size);
-      } else {
-        /*	RGBA, use DXT5	*/
-        DDS_data =
-            convert_image_to_DXT5(img, width, height, channels, &DDS_size);
-      }
+      unsigned char *DDS_data =
+          compress_image_for_GL(internal_texture_format, pixels, width,
+                                height, channels, stride, &DDS_size);
       if (DDS_data) {
-        soilGlCompressedTexImage2D(opengl_texture_target, 0,
-                                   internal_texture_format, width, height, 0,
-                                   DDS_size, DDS_data);
-        check_for_GL_errors("glCompressedTexImage2D");
+        SOIL_upload_level(use_storage, opengl_texture_target, 0,
+                          internal_texture_format, 0, GL_UNSIGNED_BYTE, width,
+                          height, DDS_size, DDS_data);
+        SOIL_capture_level(capture, internal_texture_format, width, height,
+                           DDS_data, DDS_size);
         SOIL_free_image_data(DDS_data);
         /*	printf( "Internal DXT compressor\n" );	*/
       } else {
         /*	my compression failed, try the OpenGL driver's version	*/
-        glTexImage2D(opengl_texture_target, 0, internal_texture_format, width,
-                     height, 0, original_texture_format, GL_UNSIGNED_BYTE, img);
-        check_for_GL_errors("glTexImage2D");
+        SOIL_upload_level(use_storage, opengl_texture_target, 0,
+                          internal_texture_format, original_texture_format,
+                          GL_UNSIGNED_BYTE, width, height, 0, pixels);
+        /*	and only the driver knows what came out	*/
+        SOIL_capture_level(capture, internal_texture_format, width, height,
+                           NULL, 0);
         /*	printf( "OpenGL DXT compressor\n" );	*/
       }
     } else {
       /*	user want OpenGL to do all the work!	*/
-      glTexImage2D(opengl_texture_target, 0, internal_texture_format, width,
-                   height, 0, original_texture_format, GL_UNSIGNED_BYTE, img);
-      check_for_GL_errors("glTexImage2D");
+      SOIL_upload_level(use_storage, opengl_texture_target, 0,
+                        internal_texture_format, original_texture_format,
+                        GL_UNSIGNED_BYTE, width, height, 0, pixels);
+      SOIL_capture_level(capture, internal_texture_format, width, height,
+                         pixels, width * height * channels);
       /*printf( "OpenGL DXT compressor\n" );	*/
     }
+    /*	the MIPmaps are all SOIL's own	*/
+    if (stride != width * channels) {
+      glPixelStorei(GL_UNPACK_ROW_LENGTH, old_row_length);
+    }
     /*	are any MIPmaps desired?	*/
     if (flags & SOIL_FLAG_MIPMAPS) {
       int MIPlevel = 1;
-      int MIPwidth = (width + 1) / 2;
-      int MIPheight = (height + 1) / 2;
+      int MIPwidth = (width > 1) ? width / 2 : 1;
+      int MIPheight = (height > 1) ? height / 2 : 1;
       unsigned char *resampled =
-          (unsigned char *)malloc(channels * MIPwidth * MIPheight);
-      while (((1 << MIPlevel) <= width) || ((1 << MIPlevel) <= height)) {
+          (unsigned char *)image_malloc(channels * MIPwidth * MIPheight);
+      while (MIPlevel < levels) {
         /*	do this MIPmap level	*/
-        mipmap_image(img, width, height, channels, resampled, (1 << MIPlevel),
-                     (1 << MIPlevel));
+        if ((NULL == resampled) ||
+            !SOIL_mipmap_level(pixels, width, height, channels, stride,
+                               resampled, MIPlevel, flags,
+                               SOIL_run_parallel)) {
+          /*	out of memory: stop at the levels that made it, and don't
+                  cache the short chain	*/
+          glTexParameteri(opengl_texture_type, SOIL_TEXTURE_MAX_LEVEL,
+                          MIPlevel - 1);
+          if (NULL != capture) {
+            capture->failed = 1;
+          }
+          break;
+        }
         /*  upload the MIPmaps	*/
         if (DXT_mode == SOIL_CAPABILITY_PRESENT) {
           /*	user wants me to do the DXT conversion!	*/
           int DDS_size;
-          unsigned char *DDS_data = NULL;
-          if ((channels & 1) == 1) {
-            /*	RGB, use DXT1	*/
-            DDS_data = convert_image_to_DXT1(resampled, MIPwidth, MIPheight,
-                                             channels, &DDS_size);
-          } else {
-            /*	RGBA, use DXT5	*/
-            DDS_data = convert_image_to_DXT5(resampled, MIPwidth, MIPheight,
-                                             channels, &DDS_size);
-          }
+          unsigned char *DDS_data =
+              compress_image_for_GL(internal_texture_format, resampled,
+                                    MIPwidth, MIPheight, channels, 0,
+                                    &DDS_size);
           if (DDS_data) {
-            soilGlCompressedTexImage2D(opengl_texture_target, MIPlevel,
-                                       internal_texture_format, MIPwidth,
-                                       MIPheight, 0, DDS_size, DDS_data);
-            check_for_GL_errors("glCompressedTexImage2D");
+            SOIL_upload_level(use_storage, opengl_texture_target, MIPlevel,
+                              internal_texture_format, 0, GL_UNSIGNED_BYTE,
+                              MIPwidth, MIPheight, DDS_size, DDS_data);
+            SOIL_capture_level(capture, internal_texture_format, MIPwidth,
+                               MIPheight, DDS_data, DDS_size);
             SOIL_free_image_data(DDS_data);
           } else {
             /*	my compression failed, try the OpenGL driver's version	*/
-            glTexImage2D(opengl_texture_target, MIPlevel,
-                         internal_texture_format, MIPwidth, MIPheight, 0,
-                         original_texture_format, GL_UNSIGNED_BYTE, resampled);
-            check_for_GL_errors("glTexImage2D");
+            SOIL_upload_level(use_storage, opengl_texture_target, MIPlevel,
+                              internal_texture_format, original_texture_format,
+                              GL_UNSIGNED_BYTE, MIPwidth, MIPheight, 0,
+                              resampled);
+            SOIL_capture_level(capture, internal_texture_format, MIPwidth,
+                               MIPheight, NULL, 0);
           }
         } else {
           /*	user want OpenGL to do all the work!	*/
-          glTexImage2D(opengl_texture_target, MIPlevel, internal_texture_format,
-                       MIPwidth, MIPheight, 0, original_texture_format,
-                       GL_UNSIGNED_BYTE, resampled);
-          check_for_GL_errors("glTexImage2D");
+          SOIL_upload_level(use_storage, opengl_texture_target, MIPlevel,
+                            internal_texture_format, original_texture_format,
+                            GL_UNSIGNED_BYTE, MIPwidth, MIPheight, 0,
+                            resampled);
+          SOIL_capture_level(capture, internal_texture_format, MIPwidth,
+                             MIPheight, resampled,
+                             MIPwidth * MIPheight * channels);
         }
         /*	prep for the next level	*/
         ++MIPlevel;
-        MIPwidth = (MIPwidth + 1) / 2;
-        MIPheight = (MIPheight + 1) / 2;
+        MIPwidth = (MIPwidth > 1) ? MIPwidth / 2 : 1;
+        MIPheight = (MIPheight > 1) ? MIPheight / 2 : 1;
       }
       SOIL_free_image_data(resampled);
       /*	instruct OpenGL to use the MIPmaps	*/
@@ -1083,6 +1838,7 @@ unsigned int SOIL_internal_create_OGL_texture(
       glTexParameteri(opengl_texture_type, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
       check_for_GL_errors("GL_TEXTURE_MIN/MAG_FILTER");
     }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, old_alignment);
     /*	does the user want clamping, or wrapping?	*/
     if (flags & SOIL_FLAG_TEXTURE_REPEATS) {
       glTexParameteri(opengl_texture_type, GL_TEXTURE_WRAP_S, GL_REPEAT);
@@ -1094,8 +1850,7 @@ unsigned int SOIL_internal_create_OGL_texture(
       }
       check_for_GL_errors("GL_TEXTURE_WRAP_*");
     } else {
-      /*	unsigned int clamp_mode = SOIL_CLAMP_TO_EDGE;	*/
-      unsigned int clamp_mode = GL_CLAMP;
+      unsigned int clamp_mode = SOIL_CLAMP_TO_EDGE;
       glTexParameteri(opengl_texture_type, GL_TEXTURE_WRAP_S, clamp_mode);
       glTexParameteri(opengl_texture_type, GL_TEXTURE_WRAP_T, clamp_mode);
       if (opengl_texture_type == SOIL_TEXTURE_CUBE_MAP) {
@@ -1113,36 +1868,409 @@ unsigned int SOIL_internal_create_OGL_texture(
         "Failed to generate an OpenGL texture name; missing OpenGL context?";
   }
   SOIL_free_image_data(img);
+  image_scratch_end();
   return tex_id;
 }
 
-int SOIL_save_screenshot(const char *filename, int image_type, int x, int y,
-                         int width, int height) {
-  unsigned char *pixel_data;
-  int i, j;
-  int save_result;
+/*	everything the layer workers of SOIL_load_OGL_texture_array share	*/
+typedef struct {
+  const char *const *filenames;
+  int force_channels;
+  unsigned int flags;
+  /*	one decoded image per layer (or why it couldn't be)	*/
+  unsigned char **images;
+  char **reasons;
+  int *widths, *heights, *channels;
+  /*	what every layer ends up as	*/
+  int width, height, num_channels;
+  unsigned int internal_format;
+  int levels;
+  /*	each level holds all the layers, back to back	*/
+  unsigned char *level_data[32];
+  int level_size[32];
+  int *failed;
+} SOIL_array_build;
 
-  /*	error checks	*/
-  if ((width < 1) || (height < 1)) {
-    result_string_pointer = "Invalid screenshot dimensions";
-    return 0;
+static void SOIL_array_decode_layer(void *data, int layer) {
+  SOIL_array_build *build = (SOIL_array_build *)data;
+  if (NULL != build->images[layer]) {
+    /*	already decoded with the right number of channels	*/
+    return;
   }
-  if ((x < 0) || (y < 0)) {
-    result_string_pointer = "Invalid screenshot location";
-    return 0;
+  /*	straight to stb_image: SOIL_load_image would set the result string
+          from every thread at once	*/
+  build->images[layer] = stbi_load(
+      build->filenames[layer], &build->widths[layer], &build->heights[layer],
+      &build->channels[layer], build->force_channels);
+  if (NULL == build->images[layer]) {
+    /*	stb_image keeps a reason per thread, so this one is this layer's	*/
+    build->reasons[layer] = stbi_failure_reason();
   }
-  if (filename == NULL) {
-    result_string_pointer = "Invalid screenshot filename";
-    return 0;
+  if (build->force_channels != SOIL_LOAD_AUTO) {
+    build->channels[layer] = build->force_channels;
   }
+}
 
-  /*  Get the data from OpenGL	*/
-  pixel_data = (unsigned char *)malloc(3 * width * height);
-  glReadPixels(x, y, width, height, GL_RGB, GL_UNSIGNED_BYTE, pixel_data);
-
-  /*	invert the image	*/
-  for (j = 0; j * 2 < height; ++j) {
-    int index1 = j * width * 3;
+static void SOIL_array_prepare_layer(void *data, int layer) {
+  SOIL_array_build *build = (SOIL_array_build *)data;
+  unsigned char *img = build->images[layer];
+  int width = build->widths[layer];
+  int height = build->heights[layer];
+  int channels = build->num_channels;
+  int level;
+  apply_image_flags(img, width, height, channels, build->flags);
+  /*	make it the same size as everybody else, in one go (the layers
+          are already spread over the threads)	*/
+  if ((width != build->width) || (height != build->height)) {
+    unsigned char *resampled = SOIL_resize_image(
+        img, width, height, channels, 0, build->width, build->height, NULL);
+    if (NULL == resampled) {
+      build->failed[layer] = 1;
+      return;
+    }
+    SOIL_free_image_data(img);
+    img = build->images[layer] = resampled;
+    width = build->width;
+    height = build->height;
+  }
+  if (build->flags & SOIL_FLAG_CoCg_Y) {
+    convert_RGB_to_YCoCg(img, width, height, channels, 0);
+  }
+  /*	then write each MIPmap level into this layer's slot	*/
+  for (level = 0; level < build->levels; ++level) {
+    int MIPwidth = width >> level;
+    int MIPheight = height >> level;
+    unsigned char *slot =
+        build->level_data[level] + layer * build->level_size[level];
+    unsigned char *resampled = img;
+    if (MIPwidth < 1) {
+      MIPwidth = 1;
+    }
+    if (MIPheight < 1) {
+      MIPheight = 1;
+    }
+    if (level > 0) {
+      if (build->internal_format) {
+        resampled =
+            (unsigned char *)image_malloc(channels * MIPwidth * MIPheight);
+        if (NULL == resampled) {
+          build->failed[layer] = 1;
+          return;
+        }
+      } else {
+        /*	uncompressed levels can go straight into place	*/
+        resampled = slot;
+      }
+      if (!SOIL_mipmap_level(img, width, height, channels, 0, resampled,
+                             level, build->flags, NULL)) {
+        if (resampled != slot) {
+          SOIL_free_image_data(resampled);
+        }
+        build->failed[layer] = 1;
+        return;
+      }
+    }
+    if (build->internal_format) {
+      int DDS_size;
+      unsigned char *DDS_data =
+          compress_image_for_GL(build->internal_format, resampled, MIPwidth,
+                                MIPheight, channels, 0, &DDS_size);
+      if ((NULL != DDS_data) && (DDS_size == build->level_size[level])) {
+        memcpy(slot, DDS_data, DDS_size);
+      } else {
+        build->failed[layer] = 1;
+      }
+      SOIL_free_image_data(DDS_data);
+      if (resampled != img) {
+        SOIL_free_image_data(resampled);
+      }
+    } else if (level == 0) {
+      memcpy(slot, img, channels * width * height);
+    }
+  }
+}
+
+unsigned int SOIL_load_OGL_texture_array(const char *const *filenames,
+                                         int num_layers, int force_channels,
+                                         unsigned int reuse_texture_ID,
+                                         unsigned int flags) {
+  /*	variables	*/
+  SOIL_array_build build;
+  unsigned int tex_id = 0;
+  unsigned int original_texture_format = 0, uncompressed_format = 0;
+  unsigned int internal_texture_format = 0;
+  int use_storage = 0;
+  int max_supported_size, max_layers;
+  GLint old_alignment = 4;
+  int i, level, failed = 0;
+  /*	do nothing if the OpenGL can't do texture arrays	*/
+  if ((NULL == filenames) || (num_layers < 1)) {
+    result_string_pointer = "Invalid texture array parameters";
+    return 0;
+  }
+  if (query_2D_array_capability() != SOIL_CAPABILITY_PRESENT) {
+    result_string_pointer = "No texture array support";
+    return 0;
+  }
+  glGetIntegerv(SOIL_MAX_ARRAY_TEXTURE_LAYERS, &max_layers);
+  if (num_layers > max_layers) {
+    result_string_pointer = "Too many layers for a texture array";
+    return 0;
+  }
+  memset(&build, 0, sizeof(SOIL_array_build));
+  build.filenames = filenames;
+  build.force_channels = force_channels;
+  build.images =
+      (unsigned char **)image_calloc(num_layers, sizeof(unsigned char *));
+  build.reasons = (char **)image_calloc(num_layers, sizeof(char *));
+  build.widths = (int *)image_calloc(4 * num_layers, sizeof(int));
+  if ((NULL == build.images) || (NULL == build.reasons) ||
+      (NULL == build.widths)) {
+    image_free(build.images);
+    image_free(build.reasons);
+    image_free(build.widths);
+    result_string_pointer = "malloc failed";
+    return 0;
+  }
+  build.heights = build.widths + num_layers;
+  build.channels = build.heights + num_layers;
+  build.failed = build.channels + num_layers;
+  /*	decode every layer (on the user's threads, if I have them)	*/
+  SOIL_run_parallel(num_layers, SOIL_array_decode_layer, &build);
+  for (i = 0; i < num_layers; ++i) {
+    if (NULL == build.images[i]) {
+      /*	the decoder said why	*/
+      result_string_pointer = build.reasons[i];
+      failed = 1;
+      break;
+    }
+    if (build.channels[i] > build.num_channels) {
+      build.num_channels = build.channels[i];
+    }
+    if (build.widths[i] > build.width) {
+      build.width = build.widths[i];
+    }
+    if (build.heights[i] > build.height) {
+      build.height = build.heights[i];
+    }
+  }
+  /*	all the layers need the same number of channels, so re-decode
+          the ones that came in with fewer than the widest one	*/
+  if (!failed && (force_channels == SOIL_LOAD_AUTO)) {
+    for (i = 0; i < num_layers; ++i) {
+      if (build.channels[i] != build.num_channels) {
+        SOIL_free_image_data(build.images[i]);
+        build.images[i] = NULL;
+      }
+    }
+    build.force_channels = build.num_channels;
+    SOIL_run_parallel(num_layers, SOIL_array_decode_layer, &build);
+    for (i = 0; i < num_layers; ++i) {
+      if (NULL == build.images[i]) {
+        result_string_pointer = build.reasons[i];
+        failed = 1;
+      }
+    }
+  }
+  if (!failed) {
+    /*	the same size rules as SOIL_internal_create_OGL_texture	*/
+    if (query_NPOT_capability() == SOIL_CAPABILITY_NONE) {
+      flags |= SOIL_FLAG_POWER_OF_TWO;
+    }
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_supported_size);
+    SOIL_texture_size(build.width, build.height, flags, max_supported_size,
+                      &build.width, &build.height);
+    if (flags & SOIL_FLAG_CoCg_Y) {
+      flags &= ~SOIL_FLAG_SRGB_COLOR_SPACE;
+    }
+    build.flags = flags;
+    /*	and what type am I using as the internal texture format?	*/
+    switch (build.num_channels) {
+    case 1:
+      original_texture_format = GL_LUMINANCE;
+      break;
+    case 2:
+      original_texture_format = GL_LUMINANCE_ALPHA;
+      break;
+    case 3:
+      original_texture_format = GL_RGB;
+      break;
+    case 4:
+      original_texture_format = GL_RGBA;
+      break;
+    }
+    if ((flags & SOIL_FLAG_COMPRESS_TO_DXT) &&
+        query_compressed_tex_image_2D()) {
+      build.internal_format =
+          compressed_format_for_channels(build.num_channels);
+    }
+    uncompressed_format = original_texture_format;
+    if ((flags & SOIL_FLAG_SRGB_COLOR_SPACE) &&
+        (query_sRGB_capability() == SOIL_CAPABILITY_PRESENT)) {
+      /*	(and no compression, if it has no sRGB version)	*/
+      uncompressed_format = sRGB_texture_format(original_texture_format);
+      build.internal_format = sRGB_texture_format(build.internal_format);
+    }
+    /*	how many levels, and how big is each one?	*/
+    build.levels = 1;
+    if (flags & SOIL_FLAG_MIPMAPS) {
+      while (((1 << build.levels) <= build.width) ||
+             ((1 << build.levels) <= build.height)) {
+        ++build.levels;
+      }
+    }
+    for (level = 0; level < build.levels; ++level) {
+      int MIPwidth = build.width >> level;
+      int MIPheight = build.height >> level;
+      if (MIPwidth < 1) {
+        MIPwidth = 1;
+      }
+      if (MIPheight < 1) {
+        MIPheight = 1;
+      }
+      if (build.internal_format) {
+        /*	DXT1, LATC1 and RGTC1 use 8 bytes per 4x4 block, the rest 16
+         */
+        int block_size = ((build.internal_format == SOIL_RGB_S3TC_DXT1) ||
+                          (build.internal_format ==
+                           SOIL_COMPRESSED_SRGB_S3TC_DXT1) ||
+                          (build.internal_format ==
+                           SOIL_COMPRESSED_LUMINANCE_LATC1) ||
+                          (build.internal_format == SOIL_COMPRESSED_RED_RGTC1))
+                             ? 8
+                             : 16;
+        build.level_size[level] =
+            ((MIPwidth + 3) / 4) * ((MIPheight + 3) / 4) * block_size;
+      } else {
+        build.level_size[level] = MIPwidth * MIPheight * build.num_channels;
+      }
+      build.level_data[level] =
+          (unsigned char *)image_malloc(build.level_size[level] * num_layers);
+      if (NULL == build.level_data[level]) {
+        result_string_pointer = "malloc failed";
+        failed = 1;
+        break;
+      }
+    }
+  }
+  if (!failed) {
+    /*	resize, MIPmap and compress every layer (in parallel, again)	*/
+    SOIL_run_parallel(num_layers, SOIL_array_prepare_layer, &build);
+    for (i = 0; i < num_layers; ++i) {
+      if (build.failed[i]) {
+        result_string_pointer = "Failed to prepare a texture array layer";
+        failed = 1;
+      }
+    }
+  }
+  if (!failed) {
+    /*	create the OpenGL texture ID handle	*/
+    tex_id = reuse_texture_ID;
+    if (tex_id == 0) {
+      glGenTextures(1, &tex_id);
+    }
+    check_for_GL_errors("glGenTextures");
+  }
+  if (tex_id) {
+    glBindTexture(SOIL_TEXTURE_2D_ARRAY, tex_id);
+    check_for_GL_errors("glBindTexture");
+    /*	one allocation for every layer & level	*/
+    internal_texture_format =
+        build.internal_format ? build.internal_format : uncompressed_format;
+    use_storage = SOIL_allocate_storage(
+        tex_id, SOIL_TEXTURE_2D_ARRAY, SOIL_TEXTURE_2D_ARRAY, build.levels,
+        internal_texture_format, build.width, build.height, num_layers);
+    if (use_storage < 0) {
+      failed = 1;
+      tex_id = 0;
+    }
+  }
+  if (tex_id) {
+    swizzle_RGTC_to_luminance(SOIL_TEXTURE_2D_ARRAY, build.internal_format,
+                              build.num_channels);
+    /*	my rows are packed, whatever their width	*/
+    glGetIntegerv(GL_UNPACK_ALIGNMENT, &old_alignment);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (level = 0; level < build.levels; ++level) {
+      int MIPwidth = build.width >> level;
+      int MIPheight = build.height >> level;
+      if (MIPwidth < 1) {
+        MIPwidth = 1;
+      }
+      if (MIPheight < 1) {
+        MIPheight = 1;
+      }
+      SOIL_upload_level_3D(use_storage, SOIL_TEXTURE_2D_ARRAY, level,
+                           internal_texture_format,
+                           build.internal_format ? 0 : original_texture_format,
+                           GL_UNSIGNED_BYTE, MIPwidth, MIPheight, num_layers,
+                           build.level_size[level] * num_layers,
+                           build.level_data[level]);
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, old_alignment);
+    /*	did I have MIPmaps?	*/
+    glTexParameteri(SOIL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    if (build.levels > 1) {
+      glTexParameteri(SOIL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER,
+                      GL_LINEAR_MIPMAP_LINEAR);
+    } else {
+      glTexParameteri(SOIL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    }
+    /*	does the user want clamping, or wrapping?	*/
+    if (flags & SOIL_FLAG_TEXTURE_REPEATS) {
+      glTexParameteri(SOIL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+      glTexParameteri(SOIL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    } else {
+      unsigned int clamp_mode = SOIL_CLAMP_TO_EDGE;
+      glTexParameteri(SOIL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, clamp_mode);
+      glTexParameteri(SOIL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, clamp_mode);
+    }
+    check_for_GL_errors("GL_TEXTURE_WRAP_*");
+    result_string_pointer = "Images loaded as an OpenGL texture array";
+  } else if (!failed) {
+    result_string_pointer =
+        "Failed to generate an OpenGL texture name; missing OpenGL context?";
+  }
+  /*	clean up	*/
+  for (level = 0; level < build.levels; ++level) {
+    SOIL_free_image_data(build.level_data[level]);
+  }
+  for (i = 0; i < num_layers; ++i) {
+    SOIL_free_image_data(build.images[i]);
+  }
+  image_free(build.images);
+  image_free(build.reasons);
+  image_free(build.widths);
+  return tex_id;
+}
+
+int SOIL_save_screenshot(const char *filename, int image_type, int x, int y,
+                         int width, int height) {
+  unsigned char *pixel_data;
+  int i, j;
+  int save_result;
+
+  /*	error checks	*/
+  if ((width < 1) || (height < 1)) {
+    result_string_pointer = "Invalid screenshot dimensions";
+    return 0;
+  }
+  if ((x < 0) || (y < 0)) {
+    result_string_pointer = "Invalid screenshot location";
+    return 0;
+  }
+  if (filename == NULL) {
+    result_string_pointer = "Invalid screenshot filename";
+    return 0;
+  }
+
+  /*  Get the data from OpenGL	*/
+  pixel_data = (unsigned char *)image_malloc(3 * width * height);
+  glReadPixels(x, y, width, height, GL_RGB, GL_UNSIGNED_BYTE, pixel_data);
+
+  /*	invert the image	*/
+  for (j = 0; j * 2 < height; ++j) {
+    int index1 = j * width * 3;
     int index2 = (height - 1 - j) * width * 3;
     for (i = width * 3; i > 0; --i) {
       unsigned char temp = pixel_data[index1];
@@ -1188,6 +2316,111 @@ unsigned char *SOIL_load_image_from_memory(const unsigned char *const buffer,
   return result;
 }
 
+int SOIL_load_image_info(const char *filename, int *width, int *height,
+                         int *channels) {
+  if (!stbi_info(filename, width, height, channels)) {
+    result_string_pointer = stbi_failure_reason();
+    return 0;
+  }
+  result_string_pointer = "Image header read";
+  return 1;
+}
+
+int SOIL_load_image_info_from_memory(const unsigned char *const buffer,
+                                     int buffer_length, int *width,
+                                     int *height, int *channels) {
+  if (!stbi_info_from_memory(buffer, buffer_length, width, height,
+                             channels)) {
+    result_string_pointer = stbi_failure_reason();
+    return 0;
+  }
+  result_string_pointer = "Image header read from memory";
+  return 1;
+}
+
+/*	works out what SOIL_load_image_into will write from the header, and
+        whether dst has room for it (before anything is decoded)	*/
+static int SOIL_image_fits(int width, int height, int *channels,
+                           int force_channels, unsigned char *dst,
+                           size_t dst_size, int *dst_stride) {
+  if ((force_channels >= 1) && (force_channels <= 4)) {
+    *channels = force_channels;
+  } else if (*channels > 4) {
+    /*	(a PSD with extra channels, only RGBA of which is decoded)	*/
+    *channels = 4;
+  }
+  if (0 == *dst_stride) {
+    *dst_stride = width * *channels;
+  }
+  if ((NULL == dst) || (*channels < 1) || (*channels > 4) ||
+      (*dst_stride < width * *channels) ||
+      ((size_t)(height - 1) * *dst_stride + (size_t)width * *channels >
+       dst_size)) {
+    result_string_pointer = "Destination buffer too small";
+    return 0;
+  }
+  return 1;
+}
+
+int SOIL_load_image_into(const char *filename, unsigned char *dst,
+                         size_t dst_size, int dst_stride, int *width,
+                         int *height, int *channels, int force_channels) {
+  int out_channels, decoded_channels, loaded;
+  if (!SOIL_load_image_info(filename, width, height, channels)) {
+    return 0;
+  }
+  out_channels = *channels;
+  if (!SOIL_image_fits(*width, *height, &out_channels, force_channels, dst,
+                       dst_size, &dst_stride)) {
+    return 0;
+  }
+  /*	the decoder's own buffers come out of the scratch arena	*/
+  image_scratch_begin();
+  loaded = stbi_load_into(filename, dst,
+                          (dst_size > 0x7FFFFFFF) ? 0x7FFFFFFF : (int)dst_size,
+                          dst_stride, width, height, &decoded_channels,
+                          out_channels);
+  image_scratch_end();
+  if (!loaded) {
+    result_string_pointer = stbi_failure_reason();
+    return 0;
+  }
+  /*	the decoder reports what the file had, not what it wrote	*/
+  *channels = out_channels;
+  result_string_pointer = "Image loaded";
+  return 1;
+}
+
+int SOIL_load_image_into_from_memory(const unsigned char *const buffer,
+                                     int buffer_length, unsigned char *dst,
+                                     size_t dst_size, int dst_stride,
+                                     int *width, int *height, int *channels,
+                                     int force_channels) {
+  int out_channels, decoded_channels, loaded;
+  if (!SOIL_load_image_info_from_memory(buffer, buffer_length, width, height,
+                                        channels)) {
+    return 0;
+  }
+  out_channels = *channels;
+  if (!SOIL_image_fits(*width, *height, &out_channels, force_channels, dst,
+                       dst_size, &dst_stride)) {
+    return 0;
+  }
+  image_scratch_begin();
+  loaded = stbi_load_into_from_memory(
+      buffer, buffer_length, dst,
+      (dst_size > 0x7FFFFFFF) ? 0x7FFFFFFF : (int)dst_size, dst_stride, width,
+      height, &decoded_channels, out_channels);
+  image_scratch_end();
+  if (!loaded) {
+    result_string_pointer = stbi_failure_reason();
+    return 0;
+  }
+  *channels = out_channels;
+  result_string_pointer = "Image loaded from memory";
+  return 1;
+}
+
 int SOIL_save_image(const char *filename, int image_type, int width, int height,
                     int channels, const unsigned char *const data) {
   int save_result;
@@ -1206,6 +2439,9 @@ int SOIL_save_image(const char *filename, int image_type, int width, int height,
   } else if (image_type == SOIL_SAVE_TYPE_DDS) {
     save_result = save_image_as_DDS(filename, width, height, channels,
                                     (const unsigned char *const)data);
+  } else if (image_type == SOIL_SAVE_TYPE_PNG) {
+    save_result = stbi_write_png(filename, width, height, channels,
+                                 (void *)data, PNG_compression_level);
   } else {
     save_result = 0;
   }
@@ -1217,83 +2453,439 @@ int SOIL_save_image(const char *filename, int image_type, int width, int height,
   return save_result;
 }
 
-void SOIL_free_image_data(unsigned char *img_data) { free((void *)img_data); }
+unsigned char *SOIL_save_image_to_memory(int image_type, int width,
+                                         int height, int channels,
+                                         const unsigned char *const data,
+                                         int *buffer_length) {
+  unsigned char *buffer;
 
-const char *SOIL_last_result(void) { return result_string_pointer; }
+  /*	error check	*/
+  if ((width < 1) || (height < 1) || (channels < 1) || (channels > 4) ||
+      (data == NULL) || (buffer_length == NULL)) {
+    result_string_pointer = "Invalid parameters for saving the image";
+    return NULL;
+  }
+  if (image_type == SOIL_SAVE_TYPE_BMP) {
+    buffer =
+        stbi_write_bmp_to_mem(width, height, channels, (void *)data,
+                              buffer_length);
+  } else if (image_type == SOIL_SAVE_TYPE_TGA) {
+    buffer =
+        stbi_write_tga_to_mem(width, height, channels, (void *)data,
+                              buffer_length);
+  } else if (image_type == SOIL_SAVE_TYPE_DDS) {
+    buffer = save_image_as_DDS_to_memory(width, height, channels, data,
+                                         buffer_length);
+  } else if (image_type == SOIL_SAVE_TYPE_PNG) {
+    buffer = stbi_write_png_to_mem(width, height, channels, (void *)data,
+                                   PNG_compression_level, buffer_length);
+  } else {
+    buffer = NULL;
+  }
+  if (buffer == NULL) {
+    result_string_pointer = "Saving the image failed";
+  } else {
+    result_string_pointer = "Image saved to memory";
+  }
+  return buffer;
+}
 
-unsigned int SOIL_direct_load_DDS_from_memory(const unsigned char *const buffer,
-                                              int buffer_length,
-                                              unsigned int reuse_texture_ID,
-                                              int flags,
-                                              int loading_as_cubemap) {
-  /*	variables	*/
-  DDS_header header;
-  unsigned int buffer_index = 0;
-  unsigned int tex_ID = 0;
-  /*	file reading variables	*/
-  unsigned int S3TC_type = 0;
-  unsigned char *DDS_data;
-  unsigned int DDS_main_size;
-  unsigned int DDS_full_size;
-  unsigned int width, height;
-  int mipmaps, cubemap, uncompressed, block_size = 16;
-  unsigned int flag;
-  unsigned int cf_target, ogl_target_start, ogl_target_end;
-  unsigned int opengl_texture_type;
-  int i;
-  /*	1st off, does the filename even exist?	*/
-  if (NULL == buffer) {
-    /*	we can't do it!	*/
-    result_string_pointer = "NULL buffer";
+int SOIL_save_DDS_texture(const char *filename, int width, int height,
+                          int channels, int faces, unsigned int flags,
+                          const unsigned char *const data) {
+  int save_result;
+
+  /*	error check	*/
+  if ((width < 1) || (height < 1) || (channels < 1) || (channels > 4) ||
+      (data == NULL) || (filename == NULL)) {
+    result_string_pointer = "Invalid parameters for saving the image";
     return 0;
   }
-  if (buffer_length < sizeof(DDS_header)) {
-    /*	we can't do it!	*/
-    result_string_pointer = "DDS file was too small to contain the DDS header";
+  if ((faces != 1) && ((faces != 6) || (width != height))) {
+    result_string_pointer = "A DDS cubemap needs 6 square faces";
     return 0;
   }
-  /*	try reading in the header	*/
-  memcpy((void *)(&header), (const void *)buffer, sizeof(DDS_header));
-  buffer_index = sizeof(DDS_header);
-  /*	guilty until proven innocent	*/
-  result_string_pointer = "Failed to read a known DDS header";
-  /*	validate the header (warning, "goto"'s ahead, shield your eyes!!)
-   */
-  flag = ('D' << 0) | ('D' << 8) | ('S' << 16) | (' ' << 24);
-  if (header.dwMagic != flag) {
-    goto quick_exit;
-  }
-  if (header.dwSize != 124) {
-    goto quick_exit;
+  save_result = save_DDS_texture(filename, width, height, channels, faces,
+                                 (flags & SOIL_FLAG_MIPMAPS) != 0, data);
+  if (save_result == 0) {
+    result_string_pointer = "Saving the image failed";
+  } else {
+    result_string_pointer = "Image saved";
   }
-  /*	I need all of these	*/
-  flag = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT;
-  if ((header.dwFlags & flag) != flag) {
-    goto quick_exit;
+  return save_result;
+}
+
+unsigned char *SOIL_save_DDS_texture_to_memory(int width, int height,
+                                               int channels, int faces,
+                                               unsigned int flags,
+                                               const unsigned char *const data,
+                                               int *buffer_length) {
+  unsigned char *buffer;
+
+  /*	error check	*/
+  if ((width < 1) || (height < 1) || (channels < 1) || (channels > 4) ||
+      (data == NULL) || (buffer_length == NULL)) {
+    result_string_pointer = "Invalid parameters for saving the image";
+    return NULL;
   }
-  /*	According to the MSDN spec, the dwFlags should contain
-          DDSD_LINEARSIZE if it's compressed, or DDSD_PITCH if
-          uncompressed.  Some DDS writers do not conform to the
-          spec, so I need to make my reader more tolerant	*/
-  /*	I need one of these	*/
-  flag = DDPF_FOURCC | DDPF_RGB;
-  if ((header.sPixelFormat.dwFlags & flag) == 0) {
-    goto quick_exit;
+  if ((faces != 1) && ((faces != 6) || (width != height))) {
+    result_string_pointer = "A DDS cubemap needs 6 square faces";
+    return NULL;
   }
-  if (header.sPixelFormat.dwSize != 32) {
-    goto quick_exit;
+  buffer = save_DDS_texture_to_memory(width, height, channels, faces,
+                                      (flags & SOIL_FLAG_MIPMAPS) != 0, data,
+                                      buffer_length);
+  if (buffer == NULL) {
+    result_string_pointer = "Saving the image failed";
+  } else {
+    result_string_pointer = "Image saved to memory";
   }
-  if ((header.sCaps.dwCaps1 & DDSCAPS_TEXTURE) == 0) {
-    goto quick_exit;
+  return buffer;
+}
+
+void SOIL_set_PNG_compression_level(int level) {
+  if (level < 0) {
+    level = 0;
+  } else if (level > 9) {
+    level = 9;
   }
-  /*	make sure it is a type we can upload	*/
-  if ((header.sPixelFormat.dwFlags & DDPF_FOURCC) &&
-      !((header.sPixelFormat.dwFourCC ==
-         (('D' << 0) | ('X' << 8) | ('T' << 16) | ('1' << 24))) ||
-        (header.sPixelFormat.dwFourCC ==
-         (('D' << 0) | ('X' << 8) | ('T' << 16) | ('3' << 24))) ||
-        (header.sPixelFormat.dwFourCC ==
-         (('D' << 0) | ('X' << 8) | ('T' << 16) | ('5' << 24))))) {
+  PNG_compression_level = level;
+}
+
+void SOIL_set_parallel_for(SOIL_parallel_for parallel_for, void *context) {
+  parallel_for_installed = parallel_for;
+  parallel_for_context = context;
+  stbi_install_parallel_for((stbi_parallel_for)parallel_for, context);
+}
+
+void SOIL_set_allocator(SOIL_malloc_func malloc_fn,
+                        SOIL_realloc_func realloc_fn, SOIL_free_func free_fn,
+                        void *user) {
+  image_set_allocator(malloc_fn, realloc_fn, free_fn, user);
+}
+
+int SOIL_set_scratch_arena(void *memory, size_t size) {
+  if (!image_scratch_set(memory, size)) {
+    result_string_pointer = "Scratch arena in use or too small";
+    return 0;
+  }
+  return 1;
+}
+
+void SOIL_set_texture_dedup(int enabled) { texture_dedup_enabled = enabled; }
+
+void SOIL_release_texture(unsigned int tex_id) {
+  SOIL_shared_texture **link, *entry = NULL;
+  int last = 1;
+  if (0 == tex_id) {
+    return;
+  }
+  SOIL_lock_shared();
+  if (shared_bucket_count > 0) {
+    link = &shared_by_ID[tex_id & (shared_bucket_count - 1)];
+    while ((NULL != *link) && ((*link)->tex_id != tex_id)) {
+      link = &(*link)->next_by_ID;
+    }
+    entry = *link;
+    if ((NULL != entry) && (--entry->references > 0)) {
+      last = 0;
+    } else if (NULL != entry) {
+      /*	that was the last one, take it off both chains	*/
+      *link = entry->next_by_ID;
+      link = &shared_by_key[entry->hash[0] & (shared_bucket_count - 1)];
+      while (*link != entry) {
+        link = &(*link)->next_by_key;
+      }
+      *link = entry->next_by_key;
+      --shared_texture_count;
+      image_free(entry->filename);
+      image_free(entry);
+    }
+  }
+  SOIL_unlock_shared();
+  if (last) {
+    SOIL_untrack_texture(tex_id);
+    glDeleteTextures(1, &tex_id);
+  }
+}
+
+void SOIL_set_texture_budget(int enabled, unsigned long max_bytes) {
+  SOIL_lock_shared();
+  texture_budget_enabled = enabled;
+  texture_budget_bytes = max_bytes;
+  if (!enabled) {
+    /*	forget everything, it won't be kept up to date any more	*/
+    while (NULL != tracked_newest) {
+      SOIL_tracked_texture *entry = tracked_newest;
+      tracked_newest = entry->older;
+      image_free(entry->filename);
+      image_free(entry);
+    }
+    image_free(tracked_by_ID);
+    tracked_by_ID = NULL;
+    tracked_newest = tracked_oldest = NULL;
+    tracked_bucket_count = tracked_texture_count = 0;
+    tracked_total_bytes = tracked_resident_bytes = 0;
+  } else {
+    SOIL_enforce_texture_budget(0);
+  }
+  SOIL_unlock_shared();
+}
+
+unsigned int SOIL_use_texture(unsigned int tex_id) {
+  SOIL_tracked_texture **link, *entry = NULL;
+  char *filename = NULL;
+  int force_channels = 0;
+  unsigned int flags = 0;
+  SOIL_lock_shared();
+  link = SOIL_find_tracked(tex_id);
+  if ((NULL != link) && (NULL != *link)) {
+    entry = *link;
+    SOIL_tracked_make_newest(entry);
+    if (!entry->resident && (NULL != entry->filename)) {
+      /*	it was evicted, so it has to be loaded again (outside the lock,
+              as that will want it too)	*/
+      filename = (char *)image_malloc(strlen(entry->filename) + 1);
+      if (NULL != filename) {
+        strcpy(filename, entry->filename);
+      }
+      force_channels = entry->force_channels;
+      flags = entry->flags;
+    }
+  }
+  SOIL_unlock_shared();
+  if (NULL != filename) {
+    tex_id = SOIL_internal_load_OGL_texture(filename, force_channels, tex_id,
+                                            flags);
+    image_free(filename);
+  }
+  return tex_id;
+}
+
+int SOIL_get_texture_usage(unsigned int tex_id, unsigned long *bytes,
+                           int *resident) {
+  SOIL_tracked_texture **link;
+  int found = 0;
+  SOIL_lock_shared();
+  link = SOIL_find_tracked(tex_id);
+  if ((NULL != link) && (NULL != *link)) {
+    found = 1;
+    if (NULL != bytes) {
+      *bytes = (*link)->bytes;
+    }
+    if (NULL != resident) {
+      *resident = (*link)->resident;
+    }
+  }
+  SOIL_unlock_shared();
+  return found;
+}
+
+void SOIL_get_texture_budget_usage(unsigned long *resident_bytes,
+                                   unsigned long *evicted_bytes,
+                                   int *textures) {
+  SOIL_lock_shared();
+  if (NULL != resident_bytes) {
+    *resident_bytes = tracked_resident_bytes;
+  }
+  if (NULL != evicted_bytes) {
+    *evicted_bytes = tracked_total_bytes - tracked_resident_bytes;
+  }
+  if (NULL != textures) {
+    *textures = tracked_texture_count;
+  }
+  SOIL_unlock_shared();
+}
+
+void SOIL_set_texture_cache(const char *directory, unsigned long max_bytes) {
+  image_free(texture_cache_directory);
+  texture_cache_directory = NULL;
+  texture_cache_max_bytes = max_bytes;
+  if (NULL != directory) {
+    texture_cache_directory = (char *)image_heap_malloc(strlen(directory) + 1);
+    if (NULL != texture_cache_directory) {
+      strcpy(texture_cache_directory, directory);
+    }
+  }
+}
+
+void SOIL_free_image_data(unsigned char *img_data) {
+  image_free((void *)img_data);
+}
+
+const char *SOIL_last_result(void) { return result_string_pointer; }
+
+/*	the OpenGL format for a compressed DXGI format (0 if I don't know it)	*/
+static unsigned int DXGI_to_GL_format(unsigned int dxgi_format,
+                                      int *block_size) {
+  *block_size = 16;
+  switch (dxgi_format) {
+  case DXGI_FORMAT_BC1_UNORM:
+    *block_size = 8;
+    return SOIL_RGBA_S3TC_DXT1;
+  case DXGI_FORMAT_BC1_UNORM_SRGB:
+    *block_size = 8;
+    return SOIL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1;
+  case DXGI_FORMAT_BC2_UNORM:
+    return SOIL_RGBA_S3TC_DXT3;
+  case DXGI_FORMAT_BC2_UNORM_SRGB:
+    return SOIL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3;
+  case DXGI_FORMAT_BC3_UNORM:
+    return SOIL_RGBA_S3TC_DXT5;
+  case DXGI_FORMAT_BC3_UNORM_SRGB:
+    return SOIL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5;
+  case DXGI_FORMAT_BC4_UNORM:
+    *block_size = 8;
+    return SOIL_COMPRESSED_RED_RGTC1;
+  case DXGI_FORMAT_BC4_SNORM:
+    *block_size = 8;
+    return SOIL_COMPRESSED_SIGNED_RED_RGTC1;
+  case DXGI_FORMAT_BC5_UNORM:
+    return SOIL_COMPRESSED_RG_RGTC2;
+  case DXGI_FORMAT_BC5_SNORM:
+    return SOIL_COMPRESSED_SIGNED_RG_RGTC2;
+  case DXGI_FORMAT_BC6H_UF16:
+    return SOIL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT;
+  case DXGI_FORMAT_BC6H_SF16:
+    return SOIL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT;
+  case DXGI_FORMAT_BC7_UNORM:
+    return SOIL_COMPRESSED_RGBA_BPTC_UNORM;
+  case DXGI_FORMAT_BC7_UNORM_SRGB:
+    return SOIL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM;
+  }
+  return 0;
+}
+
+/*	can the driver take this compressed format as-is?	*/
+static int compressed_format_capability(unsigned int GL_format) {
+  switch (GL_format) {
+  case SOIL_RGB_S3TC_DXT1:
+  case SOIL_RGBA_S3TC_DXT1:
+  case SOIL_RGBA_S3TC_DXT3:
+  case SOIL_RGBA_S3TC_DXT5:
+  case SOIL_COMPRESSED_SRGB_S3TC_DXT1:
+  case SOIL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1:
+  case SOIL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3:
+  case SOIL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5:
+    return query_DXT_capability();
+  case SOIL_COMPRESSED_RED_RGTC1:
+  case SOIL_COMPRESSED_SIGNED_RED_RGTC1:
+  case SOIL_COMPRESSED_RG_RGTC2:
+  case SOIL_COMPRESSED_SIGNED_RG_RGTC2:
+    return query_RGTC_capability();
+  case SOIL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT:
+  case SOIL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT:
+  case SOIL_COMPRESSED_RGBA_BPTC_UNORM:
+  case SOIL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM:
+    return query_BPTC_capability();
+  }
+  if ((GL_format >= SOIL_COMPRESSED_R11_EAC) &&
+      (GL_format <= SOIL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC)) {
+    return query_ETC2_capability();
+  }
+  /*	anything else I leave up to the driver	*/
+  return query_compressed_tex_image_2D() ? SOIL_CAPABILITY_PRESENT
+                                         : SOIL_CAPABILITY_NONE;
+}
+
+unsigned int SOIL_direct_load_DDS_from_memory(const unsigned char *const buffer,
+                                              int buffer_length,
+                                              unsigned int reuse_texture_ID,
+                                              int flags,
+                                              int loading_as_cubemap) {
+  /*	variables	*/
+  DDS_header header;
+  DDS_header_DXT10 header10;
+  unsigned int buffer_index = 0;
+  unsigned int tex_ID = 0;
+  /*	file reading variables	*/
+  unsigned int S3TC_type = 0;
+  unsigned char *DDS_data;
+  unsigned int DDS_main_size;
+  unsigned int DDS_full_size;
+  unsigned int width, height;
+  int mipmaps, cubemap, uncompressed, block_size = 16;
+  int dx10 = 0, swap_BGR = 1, volume;
+  unsigned int layers = 1, depth = 1;
+  unsigned int flag;
+  unsigned int cf_target, ogl_target_start, ogl_target_end;
+  unsigned int opengl_texture_type;
+  int i, use_storage;
+  /*	1st off, does the filename even exist?	*/
+  if (NULL == buffer) {
+    /*	we can't do it!	*/
+    result_string_pointer = "NULL buffer";
+    return 0;
+  }
+  if (buffer_length < sizeof(DDS_header)) {
+    /*	we can't do it!	*/
+    result_string_pointer = "DDS file was too small to contain the DDS header";
+    return 0;
+  }
+  /*	try reading in the header	*/
+  memcpy((void *)(&header), (const void *)buffer, sizeof(DDS_header));
+  buffer_index = sizeof(DDS_header);
+  /*	guilty until proven innocent	*/
+  result_string_pointer = "Failed to read a known DDS header";
+  /*	validate the header (warning, "goto"'s ahead, shield your eyes!!)
+   */
+  flag = ('D' << 0) | ('D' << 8) | ('S' << 16) | (' ' << 24);
+  if (header.dwMagic != flag) {
+    goto quick_exit;
+  }
+  if (header.dwSize != 124) {
+    goto quick_exit;
+  }
+  /*	I need all of these	*/
+  flag = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT;
+  if ((header.dwFlags & flag) != flag) {
+    goto quick_exit;
+  }
+  /*	According to the MSDN spec, the dwFlags should contain
+          DDSD_LINEARSIZE if it's compressed, or DDSD_PITCH if
+          uncompressed.  Some DDS writers do not conform to the
+          spec, so I need to make my reader more tolerant	*/
+  /*	I need one of these	*/
+  flag = DDPF_FOURCC | DDPF_RGB;
+  if ((header.sPixelFormat.dwFlags & flag) == 0) {
+    goto quick_exit;
+  }
+  if (header.sPixelFormat.dwSize != 32) {
+    goto quick_exit;
+  }
+  if ((header.sCaps.dwCaps1 & DDSCAPS_TEXTURE) == 0) {
+    goto quick_exit;
+  }
+  /*	make sure it is a type we can upload	*/
+  if ((header.sPixelFormat.dwFlags & DDPF_FOURCC) &&
+      (header.sPixelFormat.dwFourCC == SOIL_FOURCC('D', 'X', '1', '0'))) {
+    /*	the format lives in the DX10 header, right after this one	*/
+    if (buffer_length < sizeof(DDS_header) + sizeof(DDS_header_DXT10)) {
+      goto quick_exit;
+    }
+    memcpy((void *)(&header10), (const void *)(&buffer[buffer_index]),
+           sizeof(DDS_header_DXT10));
+    buffer_index += sizeof(DDS_header_DXT10);
+    dx10 = 1;
+    if ((header10.resourceDimension != DDS_DIMENSION_TEXTURE2D) &&
+        (header10.resourceDimension != DDS_DIMENSION_TEXTURE3D)) {
+      goto quick_exit;
+    }
+  } else if ((header.sPixelFormat.dwFlags & DDPF_FOURCC) &&
+             !((header.sPixelFormat.dwFourCC ==
+                SOIL_FOURCC('D', 'X', 'T', '1')) ||
+               (header.sPixelFormat.dwFourCC ==
+                SOIL_FOURCC('D', 'X', 'T', '3')) ||
+               (header.sPixelFormat.dwFourCC ==
+                SOIL_FOURCC('D', 'X', 'T', '5')) ||
+               (header.sPixelFormat.dwFourCC ==
+                SOIL_FOURCC('A', 'T', 'I', '1')) ||
+               (header.sPixelFormat.dwFourCC ==
+                SOIL_FOURCC('B', 'C', '4', 'U')) ||
+               (header.sPixelFormat.dwFourCC ==
+                SOIL_FOURCC('A', 'T', 'I', '2')) ||
+               (header.sPixelFormat.dwFourCC ==
+                SOIL_FOURCC('B', 'C', '5', 'U')))) {
     goto quick_exit;
   }
   /*	OK, validated the header, let's load the image data	*/
@@ -1302,15 +2894,48 @@ unsigned int SOIL_direct_load_DDS_from_memory(const unsigned char *const buffer,
   height = header.dwHeight;
   uncompressed = 1 - (header.sPixelFormat.dwFlags & DDPF_FOURCC) / DDPF_FOURCC;
   cubemap = (header.sCaps.dwCaps2 & DDSCAPS2_CUBEMAP) / DDSCAPS2_CUBEMAP;
-  if (uncompressed) {
+  volume = (header.sCaps.dwCaps2 & DDSCAPS2_VOLUME) / DDSCAPS2_VOLUME;
+  if (dx10) {
+    /*	DX10 cubemaps and arrays are flagged in the extended header	*/
+    cubemap = (header10.miscFlag & DDS_RESOURCE_MISC_TEXTURECUBE) /
+              DDS_RESOURCE_MISC_TEXTURECUBE;
+    volume = (header10.resourceDimension == DDS_DIMENSION_TEXTURE3D);
+    if ((header10.arraySize > 1) && !volume) {
+      layers = header10.arraySize;
+    }
+    if (cubemap && (layers > 1)) {
+      result_string_pointer = "DDS cubemap arrays are not supported";
+      return 0;
+    }
+    if ((header10.dxgiFormat == DXGI_FORMAT_R8G8B8A8_UNORM) ||
+        (header10.dxgiFormat == DXGI_FORMAT_B8G8R8A8_UNORM)) {
+      /*	the only uncompressed ones, and only one of those is BGRA	*/
+      uncompressed = 1;
+      swap_BGR = (header10.dxgiFormat == DXGI_FORMAT_B8G8R8A8_UNORM);
+      S3TC_type = GL_RGBA;
+      block_size = 4;
+    } else {
+      uncompressed = 0;
+      S3TC_type = DXGI_to_GL_format(header10.dxgiFormat, &block_size);
+      if (0 == S3TC_type) {
+        result_string_pointer = "DDS file uses a DXGI format SOIL can't upload";
+        return 0;
+      }
+      if (compressed_format_capability(S3TC_type) != SOIL_CAPABILITY_PRESENT) {
+        result_string_pointer = "Direct upload of this DXGI format not "
+                                "supported by the OpenGL driver";
+        return 0;
+      }
+    }
+  } else if (uncompressed) {
     S3TC_type = GL_RGB;
     block_size = 3;
     if (header.sPixelFormat.dwFlags & DDPF_ALPHAPIXELS) {
       S3TC_type = GL_RGBA;
       block_size = 4;
     }
-    DDS_main_size = width * height * block_size;
-  } else {
+  } else if ((header.sPixelFormat.dwFourCC & 0x00FFFFFF) ==
+             SOIL_FOURCC('D', 'X', 'T', 0)) {
     /*	can we even handle direct uploading to OpenGL DXT compressed images?
      */
     if (query_DXT_capability() != SOIL_CAPABILITY_PRESENT) {
@@ -1334,7 +2959,39 @@ unsigned int SOIL_direct_load_DDS_from_memory(const unsigned char *const buffer,
       block_size = 16;
       break;
     }
-    DDS_main_size = ((width + 3) >> 2) * ((height + 3) >> 2) * block_size;
+  } else {
+    /*	BC4 / BC5, these go up as red and red-green	*/
+    if (query_RGTC_capability() != SOIL_CAPABILITY_PRESENT) {
+      /*	we can't do it!	*/
+      result_string_pointer =
+          "Direct upload of RGTC images not supported by the OpenGL driver";
+      return 0;
+    }
+    if ((header.sPixelFormat.dwFourCC ==
+         SOIL_FOURCC('A', 'T', 'I', '1')) ||
+        (header.sPixelFormat.dwFourCC ==
+         SOIL_FOURCC('B', 'C', '4', 'U'))) {
+      S3TC_type = SOIL_COMPRESSED_RED_RGTC1;
+      block_size = 8;
+    } else {
+      S3TC_type = SOIL_COMPRESSED_RG_RGTC2;
+      block_size = 16;
+    }
+  }
+  if (volume) {
+    /*	a volume holds all of its slices one after the other, per level	*/
+    if (cubemap) {
+      goto quick_exit;
+    }
+    if (header.dwDepth > 1) {
+      depth = header.dwDepth;
+    }
+  }
+  if (uncompressed) {
+    DDS_main_size = width * height * block_size * depth;
+  } else {
+    DDS_main_size =
+        ((width + 3) >> 2) * ((height + 3) >> 2) * block_size * depth;
   }
   if (cubemap) {
     /* does the user want a cubemap?	*/
@@ -1363,6 +3020,26 @@ unsigned int SOIL_direct_load_DDS_from_memory(const unsigned char *const buffer,
     ogl_target_start = GL_TEXTURE_2D;
     ogl_target_end = GL_TEXTURE_2D;
     opengl_texture_type = GL_TEXTURE_2D;
+    if (layers > 1) {
+      /*	can we even handle texture arrays with the OpenGL driver?	*/
+      if (query_2D_array_capability() != SOIL_CAPABILITY_PRESENT) {
+        /*	we can't do it!	*/
+        result_string_pointer = "Direct upload of texture arrays not "
+                                "supported by the OpenGL driver";
+        return 0;
+      }
+      opengl_texture_type = SOIL_TEXTURE_2D_ARRAY;
+    }
+    if (volume) {
+      /*	can we even handle volume textures with the OpenGL driver?	*/
+      if (query_3D_capability() != SOIL_CAPABILITY_PRESENT) {
+        /*	we can't do it!	*/
+        result_string_pointer = "Direct upload of volume textures not "
+                                "supported by the OpenGL driver";
+        return 0;
+      }
+      opengl_texture_type = SOIL_TEXTURE_3D;
+    }
   }
   if ((header.sCaps.dwCaps1 & DDSCAPS_MIPMAP) && (header.dwMipMapCount > 1)) {
     int shift_offset;
@@ -1375,159 +3052,1524 @@ unsigned int SOIL_direct_load_DDS_from_memory(const unsigned char *const buffer,
       /*	compressed DDS, MIPmap size calculation is block based	*/
       shift_offset = 2;
     }
-    for (i = 1; i <= mipmaps; ++i) {
-      int w, h;
-      w = width >> (shift_offset + i);
-      h = height >> (shift_offset + i);
-      if (w < 1) {
-        w = 1;
-      }
-      if (h < 1) {
-        h = 1;
-      }
-      DDS_full_size += w * h * block_size;
+    for (i = 1; i <= mipmaps; ++i) {
+      int w, h, d;
+      w = width >> i;
+      h = height >> i;
+      d = depth >> i;
+      if (w < 1) {
+        w = 1;
+      }
+      if (h < 1) {
+        h = 1;
+      }
+      if (d < 1) {
+        d = 1;
+      }
+      /*	round up, a partial block still takes a whole one	*/
+      w = (w + (1 << shift_offset) - 1) >> shift_offset;
+      h = (h + (1 << shift_offset) - 1) >> shift_offset;
+      DDS_full_size += w * h * d * block_size;
+    }
+  } else {
+    mipmaps = 0;
+    DDS_full_size = DDS_main_size;
+  }
+  if (((layers > 1) || volume) &&
+      ((DDS_full_size == 0) ||
+       (layers > (buffer_length - buffer_index) / DDS_full_size))) {
+    result_string_pointer = "DDS file was too small for expected image data";
+    return 0;
+  }
+  DDS_data = (unsigned char *)image_malloc(DDS_full_size * layers);
+  /*	got the image data RAM, create or use an existing OpenGL texture handle
+   */
+  tex_ID = reuse_texture_ID;
+  if (tex_ID == 0) {
+    glGenTextures(1, &tex_ID);
+  }
+  /*  bind an OpenGL texture ID	*/
+  glBindTexture(opengl_texture_type, tex_ID);
+  /*	and allocate every level (and face, or layer) in one go, if I can	*/
+  use_storage = SOIL_allocate_storage(
+      tex_ID, opengl_texture_type,
+      ((layers > 1) || volume) ? opengl_texture_type : ogl_target_start,
+      mipmaps + 1, S3TC_type, width, height,
+      ((layers > 1) || volume) ? layers * depth : 0);
+  if (use_storage < 0) {
+    SOIL_free_image_data(DDS_data);
+    return 0;
+  }
+  if ((layers > 1) || volume) {
+    /*	the file holds each layer's MIPmap chain in turn, but OpenGL
+            wants every layer of a level at once, so gather them up
+            (a volume is one layer, its slices are already together)	*/
+    unsigned int byte_offset = 0, layer;
+    for (i = 0; i <= mipmaps; ++i) {
+      int w, h, d, mip_size;
+      w = width >> i;
+      h = height >> i;
+      d = depth >> i;
+      if (w < 1) {
+        w = 1;
+      }
+      if (h < 1) {
+        h = 1;
+      }
+      if (d < 1) {
+        d = 1;
+      }
+      if (uncompressed) {
+        mip_size = w * h * d * block_size;
+      } else {
+        mip_size = ((w + 3) / 4) * ((h + 3) / 4) * d * block_size;
+      }
+      for (layer = 0; layer < layers; ++layer) {
+        memcpy((void *)(&DDS_data[layer * mip_size]),
+               (const void *)(&buffer[buffer_index + layer * DDS_full_size +
+                                      byte_offset]),
+               mip_size);
+      }
+      if (uncompressed && swap_BGR) {
+        unsigned int j;
+        for (j = 0; j < layers * mip_size; j += block_size) {
+          unsigned char temp = DDS_data[j];
+          DDS_data[j] = DDS_data[j + 2];
+          DDS_data[j + 2] = temp;
+        }
+      }
+      SOIL_upload_level_3D(use_storage, opengl_texture_type, i, S3TC_type,
+                           uncompressed ? S3TC_type : 0, GL_UNSIGNED_BYTE, w,
+                           h, layers * d, layers * mip_size, DDS_data);
+      byte_offset += mip_size;
+    }
+    result_string_pointer = "DDS file loaded";
+    /*	skip the per face uploads	*/
+    ogl_target_start = ogl_target_end + 1;
+  }
+  /*	do this for each face of the cubemap!	*/
+  for (cf_target = ogl_target_start; cf_target <= ogl_target_end; ++cf_target) {
+    if (buffer_index + DDS_full_size <= buffer_length) {
+      unsigned int byte_offset = DDS_main_size;
+      memcpy((void *)DDS_data, (const void *)(&buffer[buffer_index]),
+             DDS_full_size);
+      buffer_index += DDS_full_size;
+      /*	upload the main chunk	*/
+      if (uncompressed) {
+        /*	and remember, DXT uncompressed uses BGR(A),
+                so swap to RGB(A) for ALL MIPmap levels	*/
+        for (i = 0; swap_BGR && (i < DDS_full_size); i += block_size) {
+          unsigned char temp = DDS_data[i];
+          DDS_data[i] = DDS_data[i + 2];
+          DDS_data[i + 2] = temp;
+        }
+      }
+      SOIL_upload_level(use_storage, cf_target, 0, S3TC_type,
+                        uncompressed ? S3TC_type : 0, GL_UNSIGNED_BYTE, width,
+                        height, DDS_main_size, DDS_data);
+      /*	upload the mipmaps, if we have them	*/
+      for (i = 1; i <= mipmaps; ++i) {
+        int w, h, mip_size;
+        w = width >> i;
+        h = height >> i;
+        if (w < 1) {
+          w = 1;
+        }
+        if (h < 1) {
+          h = 1;
+        }
+        /*	upload this mipmap	*/
+        if (uncompressed) {
+          mip_size = w * h * block_size;
+        } else {
+          mip_size = ((w + 3) / 4) * ((h + 3) / 4) * block_size;
+        }
+        SOIL_upload_level(use_storage, cf_target, i, S3TC_type,
+                          uncompressed ? S3TC_type : 0, GL_UNSIGNED_BYTE, w, h,
+                          mip_size, &DDS_data[byte_offset]);
+        /*	and move to the next mipmap	*/
+        byte_offset += mip_size;
+      }
+      /*	it worked!	*/
+      result_string_pointer = "DDS file loaded";
+    } else {
+      glDeleteTextures(1, &tex_ID);
+      tex_ID = 0;
+      cf_target = ogl_target_end + 1;
+      result_string_pointer = "DDS file was too small for expected image data";
+    }
+  } /* end reading each face */
+  SOIL_free_image_data(DDS_data);
+  if (tex_ID) {
+    /*	did I have MIPmaps?	*/
+    if (mipmaps > 0) {
+      /*	instruct OpenGL to use the MIPmaps	*/
+      glTexParameteri(opengl_texture_type, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+      glTexParameteri(opengl_texture_type, GL_TEXTURE_MIN_FILTER,
+                      GL_LINEAR_MIPMAP_LINEAR);
+    } else {
+      /*	instruct OpenGL _NOT_ to use the MIPmaps	*/
+      glTexParameteri(opengl_texture_type, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+      glTexParameteri(opengl_texture_type, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    }
+    /*	does the user want clamping, or wrapping?	*/
+    if (flags & SOIL_FLAG_TEXTURE_REPEATS) {
+      glTexParameteri(opengl_texture_type, GL_TEXTURE_WRAP_S, GL_REPEAT);
+      glTexParameteri(opengl_texture_type, GL_TEXTURE_WRAP_T, GL_REPEAT);
+      glTexParameteri(opengl_texture_type, SOIL_TEXTURE_WRAP_R, GL_REPEAT);
+    } else {
+      unsigned int clamp_mode = SOIL_CLAMP_TO_EDGE;
+      glTexParameteri(opengl_texture_type, GL_TEXTURE_WRAP_S, clamp_mode);
+      glTexParameteri(opengl_texture_type, GL_TEXTURE_WRAP_T, clamp_mode);
+      glTexParameteri(opengl_texture_type, SOIL_TEXTURE_WRAP_R, clamp_mode);
+    }
+  }
+
+quick_exit:
+  /*	report success or failure	*/
+  return tex_ID;
+}
+
+unsigned int SOIL_direct_load_DDS(const char *filename,
+                                  unsigned int reuse_texture_ID, int flags,
+                                  int loading_as_cubemap) {
+  FILE *f;
+  unsigned char *buffer;
+  size_t buffer_length, bytes_read;
+  unsigned int tex_ID = 0;
+  /*	error checks	*/
+  if (NULL == filename) {
+    result_string_pointer = "NULL filename";
+    return 0;
+  }
+  f = fopen(filename, "rb");
+  if (NULL == f) {
+    /*	the file doesn't seem to exist (or be open-able)	*/
+    result_string_pointer = "Can not find DDS file";
+    return 0;
+  }
+  fseek(f, 0, SEEK_END);
+  buffer_length = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  buffer = (unsigned char *)image_malloc(buffer_length);
+  if (NULL == buffer) {
+    result_string_pointer = "malloc failed";
+    fclose(f);
+    return 0;
+  }
+  bytes_read = fread((void *)buffer, 1, buffer_length, f);
+  fclose(f);
+  if (bytes_read < buffer_length) {
+    /*	huh?	*/
+    buffer_length = bytes_read;
+  }
+  /*	now try to do the loading	*/
+  tex_ID = SOIL_direct_load_DDS_from_memory((const unsigned char *const)buffer,
+                                            buffer_length, reuse_texture_ID,
+                                            flags, loading_as_cubemap);
+  SOIL_free_image_data(buffer);
+  return tex_ID;
+}
+
+static void SOIL_hash_bytes(const unsigned char *bytes, int length,
+                            unsigned int hash[2]) {
+  /*	two independent 32-bit hashes (FNV-1a and djb2) make up 64 bits.
+          a hash of 0 is taken to mean "start a new one"	*/
+  unsigned int fnv = hash[0], djb = hash[1];
+  int i;
+  if ((0 == fnv) && (0 == djb)) {
+    fnv = 2166136261u;
+    djb = 5381u;
+  }
+  for (i = 0; i < length; ++i) {
+    fnv = (fnv ^ bytes[i]) * 16777619u;
+    djb = (djb * 33u) ^ bytes[i];
+  }
+  hash[0] = fnv;
+  hash[1] = djb;
+}
+
+static void SOIL_capture_level(SOIL_texture_capture *capture,
+                               unsigned int internal_format, int width,
+                               int height, const unsigned char *data,
+                               int size) {
+  unsigned char *grown;
+  int expect_w, expect_h;
+  if ((NULL == capture) || capture->failed) {
+    return;
+  }
+  /*	only what the DDS loader can put back exactly	*/
+  if ((NULL == data) || (size <= 0) ||
+      ((internal_format != SOIL_RGB_S3TC_DXT1) &&
+       (internal_format != SOIL_RGBA_S3TC_DXT5) &&
+       (internal_format != GL_RGB) && (internal_format != GL_RGBA)) ||
+      ((capture->levels > 0) &&
+       (internal_format != capture->internal_format))) {
+    capture->failed = 1;
+    return;
+  }
+  /*	and DDS MIPmaps always halve, rounding down	*/
+  if (capture->levels > 0) {
+    expect_w = capture->width >> capture->levels;
+    expect_h = capture->height >> capture->levels;
+    if (((expect_w < 1 ? 1 : expect_w) != width) ||
+        ((expect_h < 1 ? 1 : expect_h) != height)) {
+      capture->failed = 1;
+      return;
+    }
+  }
+  grown = (unsigned char *)image_heap_realloc(capture->data,
+                                              capture->size + size);
+  if (NULL == grown) {
+    capture->failed = 1;
+    return;
+  }
+  memcpy(grown + capture->size, data, size);
+  capture->data = grown;
+  capture->size += size;
+  if (0 == capture->levels) {
+    capture->internal_format = internal_format;
+    capture->width = width;
+    capture->height = height;
+  }
+  ++capture->levels;
+}
+
+static char *SOIL_cache_path(const unsigned char *const buffer,
+                             int buffer_length, int force_channels,
+                             unsigned int flags) {
+  unsigned int hash[2] = {0, 0}, key[3];
+  char *path;
+  if ((NULL == texture_cache_directory) || (NULL == buffer) ||
+      (buffer_length <= 0) || (flags & SOIL_FLAG_TEXTURE_RECTANGLE)) {
+    return NULL;
+  }
+  SOIL_hash_bytes(buffer, buffer_length, hash);
+  /*	the same bytes loaded differently are a different texture	*/
+  key[0] = (unsigned int)force_channels;
+  key[1] = flags;
+  key[2] = SOIL_TEXTURE_CACHE_VERSION;
+  SOIL_hash_bytes((const unsigned char *)key, (int)sizeof(key), hash);
+  path = (char *)image_malloc(strlen(texture_cache_directory) + 1 + 16 + 4 + 1);
+  if (NULL != path) {
+    sprintf(path, "%s/%08x%08x.dds", texture_cache_directory, hash[0],
+            hash[1]);
+  }
+  return path;
+}
+
+static void SOIL_cache_touch(const char *path) {
+  /*	a hit makes it the most recently used	*/
+#ifdef WIN32
+  _utime(path, NULL);
+#else
+  utime(path, NULL);
+#endif
+}
+
+typedef struct {
+  char *path;
+  double mtime;
+  unsigned long size;
+} SOIL_cache_entry;
+
+static int SOIL_cache_entry_compare(const void *a, const void *b) {
+  double ta = ((const SOIL_cache_entry *)a)->mtime;
+  double tb = ((const SOIL_cache_entry *)b)->mtime;
+  return (ta < tb) ? -1 : (ta > tb) ? 1 : 0;
+}
+
+static int SOIL_cache_add_entry(SOIL_cache_entry **entries, int *count,
+                                int *capacity, const char *name) {
+  struct stat info;
+  char *path;
+  size_t name_length = strlen(name);
+  /*	only ever touch the files I wrote: 16 hex digits and ".dds"	*/
+  if ((name_length != 20) || (strcmp(name + 16, ".dds") != 0)) {
+    return 1;
+  }
+  path = (char *)image_malloc(strlen(texture_cache_directory) + 1 +
+                              name_length + 1);
+  if (NULL == path) {
+    return 0;
+  }
+  sprintf(path, "%s/%s", texture_cache_directory, name);
+  if (stat(path, &info) != 0) {
+    image_free(path);
+    return 1;
+  }
+  if (*count == *capacity) {
+    int new_capacity = (*capacity > 0) ? 2 * *capacity : 64;
+    SOIL_cache_entry *grown = (SOIL_cache_entry *)image_realloc(
+        *entries, new_capacity * sizeof(SOIL_cache_entry));
+    if (NULL == grown) {
+      image_free(path);
+      return 0;
+    }
+    *entries = grown;
+    *capacity = new_capacity;
+  }
+  (*entries)[*count].path = path;
+  (*entries)[*count].mtime = (double)info.st_mtime;
+  (*entries)[*count].size = (unsigned long)info.st_size;
+  ++*count;
+  return 1;
+}
+
+static void SOIL_cache_evict(void) {
+  SOIL_cache_entry *entries = NULL;
+  int count = 0, capacity = 0, i;
+  unsigned long total = 0;
+#ifdef WIN32
+  WIN32_FIND_DATAA found;
+  HANDLE find;
+  char *pattern;
+#else
+  DIR *dir;
+  struct dirent *found;
+#endif
+  if (0 == texture_cache_max_bytes) {
+    /*	unbounded	*/
+    return;
+  }
+#ifdef WIN32
+  pattern = (char *)image_malloc(strlen(texture_cache_directory) + 7);
+  if (NULL == pattern) {
+    return;
+  }
+  sprintf(pattern, "%s/*.dds", texture_cache_directory);
+  find = FindFirstFileA(pattern, &found);
+  image_free(pattern);
+  if (INVALID_HANDLE_VALUE == find) {
+    return;
+  }
+  do {
+    if (!SOIL_cache_add_entry(&entries, &count, &capacity, found.cFileName)) {
+      break;
+    }
+  } while (FindNextFileA(find, &found));
+  FindClose(find);
+#else
+  dir = opendir(texture_cache_directory);
+  if (NULL == dir) {
+    return;
+  }
+  while (NULL != (found = readdir(dir))) {
+    if (!SOIL_cache_add_entry(&entries, &count, &capacity, found->d_name)) {
+      break;
+    }
+  }
+  closedir(dir);
+#endif
+  for (i = 0; i < count; ++i) {
+    total += entries[i].size;
+  }
+  /*	oldest first, until it all fits again	*/
+  qsort(entries, count, sizeof(SOIL_cache_entry), SOIL_cache_entry_compare);
+  for (i = 0; (i < count) && (total > texture_cache_max_bytes); ++i) {
+    if (0 == remove(entries[i].path)) {
+      total -= entries[i].size;
+    }
+  }
+  for (i = 0; i < count; ++i) {
+    image_free(entries[i].path);
+  }
+  image_free(entries);
+}
+
+static void SOIL_cache_store(const char *path,
+                             const SOIL_texture_capture *capture) {
+  DDS_header header;
+  FILE *f;
+  char *temp_path;
+  unsigned char *data = capture->data;
+  int i, written;
+  if ((NULL == path) || (NULL == capture->data) || capture->failed ||
+      (capture->levels < 1)) {
+    return;
+  }
+  memset(&header, 0, sizeof(DDS_header));
+  header.dwMagic = ('D' << 0) | ('D' << 8) | ('S' << 16) | (' ' << 24);
+  header.dwSize = 124;
+  header.dwFlags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT;
+  header.dwWidth = capture->width;
+  header.dwHeight = capture->height;
+  header.sPixelFormat.dwSize = 32;
+  header.sCaps.dwCaps1 = DDSCAPS_TEXTURE;
+  if (capture->internal_format == SOIL_RGB_S3TC_DXT1) {
+    header.dwFlags |= DDSD_LINEARSIZE;
+    header.dwPitchOrLinearSize =
+        ((capture->width + 3) >> 2) * ((capture->height + 3) >> 2) * 8;
+    header.sPixelFormat.dwFlags = DDPF_FOURCC;
+    header.sPixelFormat.dwFourCC = SOIL_FOURCC('D', 'X', 'T', '1');
+  } else if (capture->internal_format == SOIL_RGBA_S3TC_DXT5) {
+    header.dwFlags |= DDSD_LINEARSIZE;
+    header.dwPitchOrLinearSize =
+        ((capture->width + 3) >> 2) * ((capture->height + 3) >> 2) * 16;
+    header.sPixelFormat.dwFlags = DDPF_FOURCC;
+    header.sPixelFormat.dwFourCC = SOIL_FOURCC('D', 'X', 'T', '5');
+  } else {
+    /*	uncompressed, which DDS wants in BGR order	*/
+    int channels = (capture->internal_format == GL_RGBA) ? 4 : 3;
+    header.dwFlags |= DDSD_PITCH;
+    header.dwPitchOrLinearSize = capture->width * channels;
+    header.sPixelFormat.dwFlags = DDPF_RGB;
+    header.sPixelFormat.dwRGBBitCount = 8 * channels;
+    header.sPixelFormat.dwRBitMask = 0x00FF0000;
+    header.sPixelFormat.dwGBitMask = 0x0000FF00;
+    header.sPixelFormat.dwBBitMask = 0x000000FF;
+    if (channels == 4) {
+      header.sPixelFormat.dwFlags |= DDPF_ALPHAPIXELS;
+      header.sPixelFormat.dwAlphaBitMask = 0xFF000000;
+    }
+    data = (unsigned char *)image_malloc(capture->size);
+    if (NULL == data) {
+      return;
+    }
+    memcpy(data, capture->data, capture->size);
+    for (i = 0; i + 2 < capture->size; i += channels) {
+      unsigned char temp = data[i];
+      data[i] = data[i + 2];
+      data[i + 2] = temp;
+    }
+  }
+  if (capture->levels > 1) {
+    header.dwFlags |= DDSD_MIPMAPCOUNT;
+    header.dwMipMapCount = capture->levels;
+    header.sCaps.dwCaps1 |= DDSCAPS_COMPLEX | DDSCAPS_MIPMAP;
+  }
+  /*	write it off to the side, so nobody ever reads half a file (and
+          give every writer its own, as threads share the process ID)	*/
+  temp_path = (char *)image_malloc(strlen(path) + 48);
+  if (NULL != temp_path) {
+    unsigned int write_number;
+    SOIL_lock_shared();
+    write_number = ++texture_cache_writes;
+    SOIL_unlock_shared();
+#ifdef WIN32
+    sprintf(temp_path, "%s.%d.%u.tmp", path, (int)_getpid(), write_number);
+#else
+    sprintf(temp_path, "%s.%d.%u.tmp", path, (int)getpid(), write_number);
+#endif
+    f = fopen(temp_path, "wb");
+    if (NULL != f) {
+      written = (fwrite(&header, sizeof(DDS_header), 1, f) == 1) &&
+                (fwrite(data, 1, capture->size, f) == (size_t)capture->size);
+      written = (0 == fclose(f)) && written;
+#ifdef WIN32
+      /*	rename won't replace an existing file here	*/
+      if (written) {
+        remove(path);
+      }
+#endif
+      if (!written || (0 != rename(temp_path, path))) {
+        remove(temp_path);
+      }
+    }
+    image_free(temp_path);
+  }
+  if (data != capture->data) {
+    image_free(data);
+  }
+  SOIL_cache_evict();
+}
+
+static int SOIL_shared_matches(const SOIL_shared_texture *a,
+                               const SOIL_shared_texture *b) {
+  if ((a->hash[0] != b->hash[0]) || (a->hash[1] != b->hash[1]) ||
+      (a->force_channels != b->force_channels) || (a->flags != b->flags)) {
+    return 0;
+  }
+  if ((NULL == a->filename) || (NULL == b->filename)) {
+    return (a->filename == b->filename) &&
+           (a->buffer_length == b->buffer_length);
+  }
+  return 0 == strcmp(a->filename, b->filename);
+}
+
+static int SOIL_shared_grow(void) {
+  int new_count = (shared_bucket_count > 0) ? 2 * shared_bucket_count : 64;
+  SOIL_shared_texture **by_key, **by_ID;
+  int i;
+  by_key = (SOIL_shared_texture **)image_heap_calloc(
+      new_count, sizeof(SOIL_shared_texture *));
+  by_ID = (SOIL_shared_texture **)image_heap_calloc(
+      new_count, sizeof(SOIL_shared_texture *));
+  if ((NULL == by_key) || (NULL == by_ID)) {
+    image_free(by_key);
+    image_free(by_ID);
+    return 0;
+  }
+  /*	every entry is on the key chains, so walk those to rehash both	*/
+  for (i = 0; i < shared_bucket_count; ++i) {
+    SOIL_shared_texture *entry = shared_by_key[i];
+    while (NULL != entry) {
+      SOIL_shared_texture *next = entry->next_by_key;
+      int k = entry->hash[0] & (new_count - 1);
+      int t = entry->tex_id & (new_count - 1);
+      entry->next_by_key = by_key[k];
+      by_key[k] = entry;
+      entry->next_by_ID = by_ID[t];
+      by_ID[t] = entry;
+      entry = next;
+    }
+  }
+  image_free(shared_by_key);
+  image_free(shared_by_ID);
+  shared_by_key = by_key;
+  shared_by_ID = by_ID;
+  shared_bucket_count = new_count;
+  return 1;
+}
+
+static unsigned int SOIL_shared_acquire(const SOIL_shared_texture *key,
+                                        unsigned int tex_id) {
+  /*	returns the texture already loaded for this key (with one more
+          reference), or adopts tex_id for it if there is none yet	*/
+  SOIL_shared_texture *entry = NULL;
+  unsigned int found = 0;
+  SOIL_lock_shared();
+  if (shared_bucket_count > 0) {
+    entry = shared_by_key[key->hash[0] & (shared_bucket_count - 1)];
+    while ((NULL != entry) && !SOIL_shared_matches(entry, key)) {
+      entry = entry->next_by_key;
+    }
+  }
+  if (NULL != entry) {
+    ++entry->references;
+    found = entry->tex_id;
+  } else if (tex_id && ((shared_texture_count < shared_bucket_count) ||
+                        SOIL_shared_grow())) {
+    entry =
+        (SOIL_shared_texture *)image_heap_malloc(sizeof(SOIL_shared_texture));
+    if (NULL != entry) {
+      *entry = *key;
+      if (NULL != key->filename) {
+        entry->filename = (char *)image_heap_malloc(strlen(key->filename) + 1);
+        if (NULL == entry->filename) {
+          image_free(entry);
+          entry = NULL;
+        } else {
+          strcpy(entry->filename, key->filename);
+        }
+      }
+    }
+    if (NULL != entry) {
+      int k = entry->hash[0] & (shared_bucket_count - 1);
+      int t = tex_id & (shared_bucket_count - 1);
+      entry->tex_id = tex_id;
+      entry->references = 1;
+      entry->next_by_key = shared_by_key[k];
+      shared_by_key[k] = entry;
+      entry->next_by_ID = shared_by_ID[t];
+      shared_by_ID[t] = entry;
+      ++shared_texture_count;
+    }
+  }
+  SOIL_unlock_shared();
+  if (found && tex_id && (found != tex_id)) {
+    /*	another thread loaded the same thing first, use theirs (and
+            forget mine, or the budget would keep counting it)	*/
+    SOIL_untrack_texture(tex_id);
+    glDeleteTextures(1, &tex_id);
+  }
+  return found ? found : tex_id;
+}
+
+static unsigned long SOIL_texture_bytes(unsigned int opengl_texture_type,
+                                        unsigned int internal_format,
+                                        int levels, int width, int height,
+                                        int depth) {
+  /*	what a texture of this shape takes up in video memory (or near
+          enough: the driver may pad, but never by much)	*/
+  unsigned long total = 0;
+  int block = 4, block_bytes = 16, i;
+  switch (internal_format) {
+  case SOIL_RGB_S3TC_DXT1:
+  case SOIL_RGBA_S3TC_DXT1:
+  case SOIL_COMPRESSED_SRGB_S3TC_DXT1:
+  case SOIL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1:
+  case SOIL_COMPRESSED_LUMINANCE_LATC1:
+  case 0x8C71: /*	signed LATC1	*/
+  case SOIL_COMPRESSED_RED_RGTC1:
+  case SOIL_COMPRESSED_SIGNED_RED_RGTC1:
+  case SOIL_COMPRESSED_R11_EAC:
+  case 0x9271: /*	signed R11 EAC	*/
+  case 0x9274: /*	RGB8 ETC2	*/
+  case 0x9275: /*	sRGB8 ETC2	*/
+  case 0x9276: /*	RGB8 punchthrough alpha ETC2	*/
+  case 0x9277: /*	sRGB8 punchthrough alpha ETC2	*/
+    block_bytes = 8;
+    break;
+  case SOIL_RGBA_S3TC_DXT3:
+  case SOIL_RGBA_S3TC_DXT5:
+  case SOIL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3:
+  case SOIL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5:
+  case SOIL_COMPRESSED_LUMINANCE_ALPHA_LATC2:
+  case 0x8C73: /*	signed LATC2	*/
+  case SOIL_COMPRESSED_RG_RGTC2:
+  case SOIL_COMPRESSED_SIGNED_RG_RGTC2:
+  case SOIL_COMPRESSED_RGBA_BPTC_UNORM:
+  case SOIL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM:
+  case SOIL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT:
+  case SOIL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT:
+  case 0x9272: /*	RG11 EAC	*/
+  case 0x9273: /*	signed RG11 EAC	*/
+  case 0x9278: /*	RGBA8 ETC2 EAC	*/
+  case SOIL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC:
+    break;
+  case GL_ALPHA:
+  case GL_LUMINANCE:
+  case GL_LUMINANCE8:
+  case SOIL_SLUMINANCE8:
+  case 0x8229: /*	GL_R8	*/
+    block = 1;
+    block_bytes = 1;
+    break;
+  case GL_LUMINANCE_ALPHA:
+  case GL_LUMINANCE8_ALPHA8:
+  case SOIL_SLUMINANCE8_ALPHA8:
+  case 0x822B: /*	GL_RG8	*/
+    block = 1;
+    block_bytes = 2;
+    break;
+  case 0x881A: /*	GL_RGBA16F	*/
+    block = 1;
+    block_bytes = 8;
+    break;
+  case 0x8814: /*	GL_RGBA32F	*/
+    block = 1;
+    block_bytes = 16;
+    break;
+  default:
+    /*	RGB(A)8 and friends, RGB gets padded out to 4 bytes anyway	*/
+    block = 1;
+    block_bytes = 4;
+    break;
+  }
+  if (levels < 1) {
+    levels = 1;
+  }
+  if (depth < 1) {
+    depth = 1;
+  }
+  for (i = 0; i < levels; ++i) {
+    unsigned long w = (width >> i) > 0 ? (width >> i) : 1;
+    unsigned long h = (height >> i) > 0 ? (height >> i) : 1;
+    unsigned long d = depth;
+    if (opengl_texture_type == SOIL_TEXTURE_3D) {
+      /*	a volume's MIPmaps shrink in depth too, an array's don't	*/
+      d = (depth >> i) > 0 ? (depth >> i) : 1;
+    }
+    total += ((w + block - 1) / block) * ((h + block - 1) / block) * d *
+             block_bytes;
+  }
+  if (opengl_texture_type == SOIL_TEXTURE_CUBE_MAP) {
+    total *= 6;
+  }
+  return total;
+}
+
+static SOIL_tracked_texture **SOIL_find_tracked(unsigned int tex_id) {
+  /*	the link that points at tex_id's record, or at the NULL ending its
+          chain.  only call this with the lock held	*/
+  SOIL_tracked_texture **link;
+  if (0 == tracked_bucket_count) {
+    return NULL;
+  }
+  link = &tracked_by_ID[tex_id & (tracked_bucket_count - 1)];
+  while ((NULL != *link) && ((*link)->tex_id != tex_id)) {
+    link = &(*link)->next_by_ID;
+  }
+  return link;
+}
+
+static void SOIL_tracked_unlink_LRU(SOIL_tracked_texture *entry) {
+  if ((NULL == entry->newer) && (NULL == entry->older) &&
+      (tracked_newest != entry)) {
+    /*	not on the list yet	*/
+    return;
+  }
+  if (NULL != entry->newer) {
+    entry->newer->older = entry->older;
+  } else {
+    tracked_newest = entry->older;
+  }
+  if (NULL != entry->older) {
+    entry->older->newer = entry->newer;
+  } else {
+    tracked_oldest = entry->newer;
+  }
+  entry->newer = entry->older = NULL;
+}
+
+static void SOIL_tracked_make_newest(SOIL_tracked_texture *entry) {
+  SOIL_tracked_unlink_LRU(entry);
+  entry->older = tracked_newest;
+  if (NULL != tracked_newest) {
+    tracked_newest->newer = entry;
+  } else {
+    tracked_oldest = entry;
+  }
+  tracked_newest = entry;
+}
+
+static int SOIL_tracked_grow(void) {
+  int new_count = (tracked_bucket_count > 0) ? 2 * tracked_bucket_count : 64;
+  SOIL_tracked_texture **by_ID, *entry;
+  by_ID = (SOIL_tracked_texture **)image_heap_calloc(
+      new_count, sizeof(SOIL_tracked_texture *));
+  if (NULL == by_ID) {
+    return 0;
+  }
+  /*	every record is on the LRU list, so walk that to rehash	*/
+  for (entry = tracked_newest; NULL != entry; entry = entry->older) {
+    int t = entry->tex_id & (new_count - 1);
+    entry->next_by_ID = by_ID[t];
+    by_ID[t] = entry;
+  }
+  image_free(tracked_by_ID);
+  tracked_by_ID = by_ID;
+  tracked_bucket_count = new_count;
+  return 1;
+}
+
+static unsigned int SOIL_texture_binding(unsigned int opengl_texture_type) {
+  switch (opengl_texture_type) {
+  case SOIL_TEXTURE_CUBE_MAP:
+    return SOIL_TEXTURE_BINDING_CUBE_MAP;
+  case SOIL_TEXTURE_RECTANGLE_ARB:
+    return SOIL_TEXTURE_BINDING_RECTANGLE_ARB;
+  case SOIL_TEXTURE_2D_ARRAY:
+    return SOIL_TEXTURE_BINDING_2D_ARRAY;
+  case SOIL_TEXTURE_3D:
+    return SOIL_TEXTURE_BINDING_3D;
+  }
+  return GL_TEXTURE_BINDING_2D;
+}
+
+static int SOIL_shrink_texture(const SOIL_tracked_texture *entry) {
+  /*	frees an evicted texture's memory, but hangs on to the name so nobody
+          else gets it before it is loaded again: every level is redefined
+          as a single texel.  returns 0 for immutable storage, which can't
+          be shrunk (SOIL_allocate_storage doesn't make it while textures
+          can be evicted)	*/
+  unsigned int opengl_texture_type = entry->opengl_texture_type;
+  GLint bound = 0, immutable = 0;
+  int level, face;
+  glGetIntegerv(SOIL_texture_binding(opengl_texture_type), &bound);
+  glBindTexture(opengl_texture_type, entry->tex_id);
+  if (query_tex_storage_capability() == SOIL_CAPABILITY_PRESENT) {
+    glGetTexParameteriv(opengl_texture_type, SOIL_TEXTURE_IMMUTABLE_FORMAT,
+                        &immutable);
+  }
+  for (level = 0; !immutable && (level < entry->levels); ++level) {
+    if ((opengl_texture_type == SOIL_TEXTURE_3D) ||
+        (opengl_texture_type == SOIL_TEXTURE_2D_ARRAY)) {
+      soilGlTexImage3D(opengl_texture_type, level, GL_RGBA, 1, 1, 1, 0,
+                       GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    } else if (opengl_texture_type == SOIL_TEXTURE_CUBE_MAP) {
+      for (face = 0; face < 6; ++face) {
+        glTexImage2D(SOIL_TEXTURE_CUBE_MAP_POSITIVE_X + face, level, GL_RGBA,
+                     1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+      }
+    } else {
+      glTexImage2D(opengl_texture_type, level, GL_RGBA, 1, 1, 0, GL_RGBA,
+                   GL_UNSIGNED_BYTE, NULL);
+    }
+  }
+  check_for_GL_errors("glTexImage (evicting)");
+  glBindTexture(opengl_texture_type, (GLuint)bound);
+  return !immutable;
+}
+
+static void SOIL_enforce_texture_budget(unsigned int keep_tex_id) {
+  /*	evicts the least recently used textures SOIL knows how to load again
+          until the resident ones fit.  only call this with the lock held	*/
+  SOIL_tracked_texture *entry = tracked_oldest;
+  while ((texture_budget_bytes > 0) &&
+         (tracked_resident_bytes > texture_budget_bytes) && (NULL != entry)) {
+    if (entry->resident && (NULL != entry->filename) &&
+        (entry->tex_id != keep_tex_id) && SOIL_shrink_texture(entry)) {
+      entry->resident = 0;
+      tracked_resident_bytes -= entry->bytes;
+    }
+    entry = entry->newer;
+  }
+}
+
+static void SOIL_track_texture(unsigned int tex_id,
+                               unsigned int opengl_texture_type,
+                               unsigned int internal_format, int levels,
+                               int width, int height, int depth) {
+  SOIL_tracked_texture **link, *entry;
+  if (!texture_budget_enabled || (0 == tex_id)) {
+    return;
+  }
+  SOIL_lock_shared();
+  link = SOIL_find_tracked(tex_id);
+  entry = (NULL != link) ? *link : NULL;
+  if ((NULL == entry) && ((tracked_texture_count < tracked_bucket_count) ||
+                          SOIL_tracked_grow())) {
+    entry = (SOIL_tracked_texture *)image_heap_calloc(
+        1, sizeof(SOIL_tracked_texture));
+    if (NULL != entry) {
+      link = &tracked_by_ID[tex_id & (tracked_bucket_count - 1)];
+      entry->tex_id = tex_id;
+      entry->next_by_ID = *link;
+      *link = entry;
+      ++tracked_texture_count;
+    }
+  }
+  if (NULL != entry) {
+    /*	a reused texture, or the next face of a cubemap, just replaces
+            what was there	*/
+    tracked_total_bytes -= entry->bytes;
+    if (entry->resident) {
+      tracked_resident_bytes -= entry->bytes;
+    }
+    entry->opengl_texture_type = opengl_texture_type;
+    entry->levels = levels;
+    entry->bytes = SOIL_texture_bytes(opengl_texture_type, internal_format,
+                                      levels, width, height, depth);
+    entry->resident = 1;
+    tracked_total_bytes += entry->bytes;
+    tracked_resident_bytes += entry->bytes;
+    SOIL_tracked_make_newest(entry);
+    SOIL_enforce_texture_budget(tex_id);
+  }
+  SOIL_unlock_shared();
+}
+
+static void SOIL_track_source(unsigned int tex_id, const char *filename,
+                              int force_channels, unsigned int flags) {
+  /*	remembers how to load tex_id again, once it has been evicted	*/
+  SOIL_tracked_texture **link;
+  if (!texture_budget_enabled || (0 == tex_id) || (NULL == filename)) {
+    return;
+  }
+  SOIL_lock_shared();
+  link = SOIL_find_tracked(tex_id);
+  if ((NULL != link) && (NULL != *link)) {
+    SOIL_tracked_texture *entry = *link;
+    image_free(entry->filename);
+    entry->filename = (char *)image_heap_malloc(strlen(filename) + 1);
+    if (NULL != entry->filename) {
+      strcpy(entry->filename, filename);
+    }
+    entry->force_channels = force_channels;
+    entry->flags = flags;
+  }
+  SOIL_unlock_shared();
+}
+
+static void SOIL_untrack_texture(unsigned int tex_id) {
+  SOIL_tracked_texture **link, *entry;
+  SOIL_lock_shared();
+  link = SOIL_find_tracked(tex_id);
+  if ((NULL != link) && (NULL != *link)) {
+    entry = *link;
+    *link = entry->next_by_ID;
+    SOIL_tracked_unlink_LRU(entry);
+    tracked_total_bytes -= entry->bytes;
+    if (entry->resident) {
+      tracked_resident_bytes -= entry->bytes;
+    }
+    --tracked_texture_count;
+    image_free(entry->filename);
+    image_free(entry);
+  }
+  SOIL_unlock_shared();
+}
+
+/*	what I need to know about a KTX (or KTX2) file to upload it	*/
+#define SOIL_KTX_MAX_LEVELS 32
+typedef struct {
+  int version;
+  unsigned int width, height, depth, layers, faces, levels;
+  /*	format & type are 0 for compressed data	*/
+  unsigned int internal_format, format, type;
+  /*	for each level, where it starts and how big one image is
+          (one face of a KTX cubemap, the whole level otherwise)	*/
+  unsigned int level_offset[SOIL_KTX_MAX_LEVELS];
+  unsigned int image_size[SOIL_KTX_MAX_LEVELS];
+} SOIL_KTX_header;
+
+/*	KTX2 names its formats with Vulkan numbers,
+        these are the ones I know how to hand to OpenGL:
+        { VkFormat, internal format, format, type }	*/
+static const unsigned int SOIL_KTX2_formats[][4] = {
+    {9, 0x8229, 0x1903, GL_UNSIGNED_BYTE},   /*	R8		*/
+    {16, 0x822B, 0x8227, GL_UNSIGNED_BYTE},  /*	R8G8		*/
+    {23, 0x8051, GL_RGB, GL_UNSIGNED_BYTE},  /*	R8G8B8		*/
+    {29, 0x8C41, GL_RGB, GL_UNSIGNED_BYTE},  /*	R8G8B8 sRGB	*/
+    {30, 0x8051, 0x80E0, GL_UNSIGNED_BYTE},  /*	B8G8R8		*/
+    {37, 0x8058, GL_RGBA, GL_UNSIGNED_BYTE}, /*	R8G8B8A8	*/
+    {43, 0x8C43, GL_RGBA, GL_UNSIGNED_BYTE}, /*	R8G8B8A8 sRGB	*/
+    {44, 0x8058, 0x80E1, GL_UNSIGNED_BYTE},  /*	B8G8R8A8	*/
+    {50, 0x8C43, 0x80E1, GL_UNSIGNED_BYTE},  /*	B8G8R8A8 sRGB	*/
+    {97, 0x881A, GL_RGBA, 0x140B},           /*	RGBA16 float	*/
+    {109, 0x8814, GL_RGBA, GL_FLOAT},        /*	RGBA32 float	*/
+    {131, SOIL_RGB_S3TC_DXT1, 0, 0},
+    {132, SOIL_COMPRESSED_SRGB_S3TC_DXT1, 0, 0},
+    {133, SOIL_RGBA_S3TC_DXT1, 0, 0},
+    {134, SOIL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1, 0, 0},
+    {135, SOIL_RGBA_S3TC_DXT3, 0, 0},
+    {136, SOIL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3, 0, 0},
+    {137, SOIL_RGBA_S3TC_DXT5, 0, 0},
+    {138, SOIL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5, 0, 0},
+    {139, SOIL_COMPRESSED_RED_RGTC1, 0, 0},
+    {140, SOIL_COMPRESSED_SIGNED_RED_RGTC1, 0, 0},
+    {141, SOIL_COMPRESSED_RG_RGTC2, 0, 0},
+    {142, SOIL_COMPRESSED_SIGNED_RG_RGTC2, 0, 0},
+    {143, SOIL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT, 0, 0},
+    {144, SOIL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT, 0, 0},
+    {145, SOIL_COMPRESSED_RGBA_BPTC_UNORM, 0, 0},
+    {146, SOIL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM, 0, 0},
+    /*	ETC2 & EAC, 147 - 156 map onto 0x9274 - 0x9279 then 0x9270 - 0x9273	*/
+    {147, 0x9274, 0, 0},
+    {148, 0x9275, 0, 0},
+    {149, 0x9276, 0, 0},
+    {150, 0x9277, 0, 0},
+    {151, 0x9278, 0, 0},
+    {152, 0x9279, 0, 0},
+    {153, 0x9270, 0, 0},
+    {154, 0x9271, 0, 0},
+    {155, 0x9272, 0, 0},
+    {156, 0x9273, 0, 0}};
+
+static unsigned int KTX_read32(const unsigned char *p, int big_endian) {
+  if (big_endian) {
+    return ((unsigned int)p[0] << 24) | ((unsigned int)p[1] << 16) |
+           ((unsigned int)p[2] << 8) | (unsigned int)p[3];
+  }
+  return ((unsigned int)p[3] << 24) | ((unsigned int)p[2] << 16) |
+         ((unsigned int)p[1] << 8) | (unsigned int)p[0];
+}
+
+/*	the size of one texel of uncompressed data, 0 if I don't know it	*/
+static unsigned int KTX_texel_bytes(unsigned int format, unsigned int type) {
+  unsigned int components = 0;
+  switch (type) {
+  case 0x8033: /*	4_4_4_4, 5_5_5_1, 5_6_5 and their REVs	*/
+  case 0x8034:
+  case 0x8363:
+  case 0x8364:
+  case 0x8365:
+  case 0x8366:
+    return 2;
+  case 0x8035: /*	8_8_8_8, 10_10_10_2 and their REVs, 10F_11F_11F,
+                        5_9_9_9 and 24_8	*/
+  case 0x8036:
+  case 0x8367:
+  case 0x8368:
+  case 0x8C3B:
+  case 0x8C3E:
+  case 0x84FA:
+    return 4;
+  }
+  switch (format) {
+  case 0x1903: /*	RED	*/
+  case 0x1906: /*	ALPHA	*/
+  case GL_LUMINANCE:
+  case 0x8D94: /*	RED_INTEGER	*/
+    components = 1;
+    break;
+  case 0x8227: /*	RG	*/
+  case GL_LUMINANCE_ALPHA:
+  case 0x8228: /*	RG_INTEGER	*/
+    components = 2;
+    break;
+  case GL_RGB:
+  case 0x80E0: /*	BGR	*/
+  case 0x8D98: /*	RGB_INTEGER	*/
+  case 0x8D9A: /*	BGR_INTEGER	*/
+    components = 3;
+    break;
+  case GL_RGBA:
+  case 0x80E1: /*	BGRA	*/
+  case 0x8D99: /*	RGBA_INTEGER	*/
+  case 0x8D9B: /*	BGRA_INTEGER	*/
+    components = 4;
+    break;
+  }
+  switch (type) {
+  case GL_UNSIGNED_BYTE:
+  case GL_BYTE:
+    return components;
+  case GL_UNSIGNED_SHORT:
+  case GL_SHORT:
+  case 0x140B: /*	HALF_FLOAT	*/
+    return components * 2;
+  case GL_UNSIGNED_INT:
+  case GL_INT:
+  case GL_FLOAT:
+    return components * 4;
+  }
+  return 0;
+}
+
+/*	how many bytes glTex(Sub)Image will read for one uncompressed image of
+        a level (a cubemap face, or the whole level of an array or volume),
+        rows padded as KTX pads them.  0 if that's more than a KTX level
+        can hold, or the format is one I can't size	*/
+static unsigned int KTX_image_bytes(const SOIL_KTX_header *ktx,
+                                    unsigned int level) {
+  unsigned int texel = KTX_texel_bytes(ktx->format, ktx->type);
+  unsigned int align = (ktx->version == 1) ? 4 : 1;
+  unsigned int w = ktx->width >> level, h = ktx->height >> level;
+  unsigned int d = (ktx->depth > 0) ? ktx->depth >> level : ktx->layers;
+  unsigned int row, padded;
+  w = (w < 1) ? 1 : w;
+  h = (h < 1) ? 1 : h;
+  d = (d < 1) ? 1 : d;
+  if ((0 == texel) || (w > 0x0FFFFFFF / texel)) {
+    return 0;
+  }
+  row = w * texel;
+  padded = (row + align - 1) / align * align;
+  /*	the last row needs no padding after it	*/
+  if ((h > 0x0FFFFFFF / d) || (h * d - 1 > (0x0FFFFFFF - row) / padded)) {
+    return 0;
+  }
+  return padded * (h * d - 1) + row;
+}
+
+/*	uncompressed data gets read by its format and size, not by the image
+        size the file gives: a level that says less would have the driver
+        reading past the end of the buffer	*/
+static int SOIL_KTX_level_fits(const SOIL_KTX_header *ktx,
+                               unsigned int level) {
+  unsigned int needed;
+  if (0 == ktx->format) {
+    /*	compressed data goes up with its own size	*/
+    return 1;
+  }
+  needed = KTX_image_bytes(ktx, level);
+  if (0 == needed) {
+    result_string_pointer = "KTX file uses a pixel format or size SOIL can't "
+                            "check";
+    return 0;
+  }
+  if (ktx->image_size[level] < needed) {
+    result_string_pointer = "KTX file has less image data than its format "
+                            "and size need";
+    return 0;
+  }
+  return 1;
+}
+
+/*	reads a KTX or KTX2 header, and (if find_levels) where each MIPmap
+        level lives.  returns 0 if it isn't a KTX file at all, -1 if it is
+        one I can't upload, 1 if all is well	*/
+static int SOIL_parse_KTX(const unsigned char *const buffer,
+                          unsigned int buffer_length, SOIL_KTX_header *ktx,
+                          int find_levels) {
+  static const unsigned char KTX1_id[12] = {0xAB, 'K', 'T',  'X',  ' ',  '1',
+                                            '1',  0xBB, '\r', '\n', 0x1A, '\n'};
+  static const unsigned char KTX2_id[12] = {0xAB, 'K', 'T',  'X',  ' ',  '2',
+                                            '0',  0xBB, '\r', '\n', 0x1A, '\n'};
+  unsigned int i, offset;
+  int big_endian = 0;
+  if ((NULL == buffer) || (buffer_length < 12)) {
+    return 0;
+  }
+  memset(ktx, 0, sizeof(SOIL_KTX_header));
+  if (0 == memcmp(buffer, KTX1_id, 12)) {
+    ktx->version = 1;
+  } else if (0 == memcmp(buffer, KTX2_id, 12)) {
+    ktx->version = 2;
+  } else {
+    return 0;
+  }
+  result_string_pointer = "KTX file was too small to contain the KTX header";
+  if (ktx->version == 1) {
+    unsigned int type_size;
+    if (buffer_length < 64) {
+      return -1;
+    }
+    /*	the writer's byte order, I can read either	*/
+    if (KTX_read32(buffer + 12, 0) != 0x04030201) {
+      big_endian = 1;
+      if (KTX_read32(buffer + 12, 1) != 0x04030201) {
+        result_string_pointer = "KTX file has a bad endianness field";
+        return -1;
+      }
+    }
+    ktx->type = KTX_read32(buffer + 16, big_endian);
+    type_size = KTX_read32(buffer + 20, big_endian);
+    ktx->format = KTX_read32(buffer + 24, big_endian);
+    ktx->internal_format = KTX_read32(buffer + 28, big_endian);
+    ktx->width = KTX_read32(buffer + 36, big_endian);
+    ktx->height = KTX_read32(buffer + 40, big_endian);
+    ktx->depth = KTX_read32(buffer + 44, big_endian);
+    ktx->layers = KTX_read32(buffer + 48, big_endian);
+    ktx->faces = KTX_read32(buffer + 52, big_endian);
+    ktx->levels = KTX_read32(buffer + 56, big_endian);
+    offset = KTX_read32(buffer + 60, big_endian);
+    if (big_endian && (type_size > 1)) {
+      /*	the texels would need swapping too	*/
+      result_string_pointer = "Big-endian KTX files with multi-byte texels "
+                              "are not supported";
+      return -1;
+    }
+    if ((ktx->type == 0) != (ktx->format == 0)) {
+      result_string_pointer = "KTX file has an inconsistent format";
+      return -1;
+    }
+    /*	skip the key/value data	*/
+    if (find_levels && (offset > buffer_length - 64)) {
+      return -1;
+    }
+    offset += 64;
+  } else {
+    const unsigned int *format = NULL;
+    if (buffer_length < 80) {
+      return -1;
+    }
+    for (i = 0; i < sizeof(SOIL_KTX2_formats) / sizeof(SOIL_KTX2_formats[0]);
+         ++i) {
+      if (SOIL_KTX2_formats[i][0] == KTX_read32(buffer + 12, 0)) {
+        format = SOIL_KTX2_formats[i];
+      }
+    }
+    if (NULL == format) {
+      result_string_pointer = "KTX2 file uses a VkFormat SOIL can't upload";
+      return -1;
+    }
+    ktx->internal_format = format[1];
+    ktx->format = format[2];
+    ktx->type = format[3];
+    ktx->width = KTX_read32(buffer + 20, 0);
+    ktx->height = KTX_read32(buffer + 24, 0);
+    ktx->depth = KTX_read32(buffer + 28, 0);
+    ktx->layers = KTX_read32(buffer + 32, 0);
+    ktx->faces = KTX_read32(buffer + 36, 0);
+    ktx->levels = KTX_read32(buffer + 40, 0);
+    if (KTX_read32(buffer + 44, 0) != 0) {
+      result_string_pointer = "Supercompressed KTX2 files are not supported";
+      return -1;
+    }
+    offset = 80;
+  }
+  /*	0 in these means "not that kind of texture"	*/
+  if (ktx->levels == 0) {
+    ktx->levels = 1;
+  }
+  if ((ktx->width == 0) || (ktx->height == 0)) {
+    result_string_pointer = "1D KTX textures are not supported";
+    return -1;
+  }
+  if (((ktx->faces != 1) && (ktx->faces != 6)) ||
+      (ktx->levels > SOIL_KTX_MAX_LEVELS)) {
+    result_string_pointer = "Failed to read a known KTX header";
+    return -1;
+  }
+  if (((ktx->faces == 6) || (ktx->depth > 0)) && (ktx->layers > 0)) {
+    result_string_pointer = "KTX cubemap and volume arrays are not supported";
+    return -1;
+  }
+  if (!find_levels) {
+    return 1;
+  }
+  result_string_pointer = "KTX file was too small for expected image data";
+  for (i = 0; i < ktx->levels; ++i) {
+    if (ktx->version == 1) {
+      /*	imageSize, then the images, then pad to 4 bytes	*/
+      unsigned int image_size, level_size;
+      if (offset > buffer_length - 4) {
+        return -1;
+      }
+      image_size = KTX_read32(buffer + offset, big_endian);
+      offset += 4;
+      level_size = image_size;
+      if ((ktx->faces == 6) && (image_size <= 0x0FFFFFFF)) {
+        /*	each cubemap face is padded out to 4 bytes	*/
+        level_size = 6 * ((image_size + 3) & ~3u);
+      }
+      if ((image_size > 0x0FFFFFFF) || (level_size > buffer_length - offset)) {
+        return -1;
+      }
+      ktx->level_offset[i] = offset;
+      ktx->image_size[i] = image_size;
+      offset = (offset + level_size + 3) & ~3u;
+      if (!SOIL_KTX_level_fits(ktx, i)) {
+        return -1;
+      }
+    } else {
+      /*	the level index: offset & length, as 64 bit numbers	*/
+      const unsigned char *index = buffer + 80 + i * 24;
+      unsigned int level_offset, level_size;
+      if (80 + (i + 1) * 24 > buffer_length) {
+        return -1;
+      }
+      level_offset = KTX_read32(index, 0);
+      level_size = KTX_read32(index + 8, 0);
+      if ((KTX_read32(index + 4, 0) != 0) || (KTX_read32(index + 12, 0) != 0) ||
+          (level_offset > buffer_length) ||
+          (level_size > buffer_length - level_offset)) {
+        return -1;
+      }
+      ktx->level_offset[i] = level_offset;
+      /*	KTX2 cubemap faces are packed back to back	*/
+      ktx->image_size[i] = level_size / ktx->faces;
+      if (!SOIL_KTX_level_fits(ktx, i)) {
+        return -1;
+      }
+    }
+  }
+  return 1;
+}
+
+unsigned int SOIL_direct_load_KTX_from_memory(const unsigned char *const buffer,
+                                              int buffer_length,
+                                              unsigned int reuse_texture_ID,
+                                              int flags,
+                                              int loading_as_cubemap) {
+  /*	variables	*/
+  SOIL_KTX_header ktx;
+  unsigned int tex_ID = 0;
+  unsigned int opengl_texture_type = GL_TEXTURE_2D;
+  GLint old_alignment = 4;
+  unsigned int i, f;
+  int status, use_storage;
+  /*	is it even a KTX file?	*/
+  if (buffer_length < 0) {
+    return 0;
+  }
+  status = SOIL_parse_KTX(buffer, buffer_length, &ktx, 1);
+  if (status <= 0) {
+    return 0;
+  }
+  /*	can the driver take the data as-is?	*/
+  if ((ktx.format == 0) && (compressed_format_capability(ktx.internal_format) !=
+                            SOIL_CAPABILITY_PRESENT)) {
+    result_string_pointer = "Direct upload of this KTX format not supported "
+                            "by the OpenGL driver";
+    return 0;
+  }
+  /*	and what kind of texture is it?	*/
+  if (ktx.faces == 6) {
+    if (query_cubemap_capability() != SOIL_CAPABILITY_PRESENT) {
+      result_string_pointer =
+          "Direct upload of cubemap images not supported by the OpenGL driver";
+      return 0;
+    }
+    opengl_texture_type = SOIL_TEXTURE_CUBE_MAP;
+  } else if (ktx.depth > 0) {
+    if (query_3D_capability() != SOIL_CAPABILITY_PRESENT) {
+      result_string_pointer = "Direct upload of volume textures not "
+                              "supported by the OpenGL driver";
+      return 0;
     }
-  } else {
-    mipmaps = 0;
-    DDS_full_size = DDS_main_size;
+    opengl_texture_type = SOIL_TEXTURE_3D;
+  } else if (ktx.layers > 0) {
+    if (query_2D_array_capability() != SOIL_CAPABILITY_PRESENT) {
+      result_string_pointer = "Direct upload of texture arrays not "
+                              "supported by the OpenGL driver";
+      return 0;
+    }
+    opengl_texture_type = SOIL_TEXTURE_2D_ARRAY;
   }
-  DDS_data = (unsigned char *)malloc(DDS_full_size);
-  /*	got the image data RAM, create or use an existing OpenGL texture handle
-   */
+  if ((ktx.faces == 6) != (loading_as_cubemap != 0)) {
+    result_string_pointer = loading_as_cubemap ? "KTX image was not a cubemap"
+                                               : "KTX image was a cubemap";
+    return 0;
+  }
+  /*	create or use an existing OpenGL texture handle	*/
   tex_ID = reuse_texture_ID;
   if (tex_ID == 0) {
     glGenTextures(1, &tex_ID);
   }
-  /*  bind an OpenGL texture ID	*/
   glBindTexture(opengl_texture_type, tex_ID);
-  /*	do this for each face of the cubemap!	*/
-  for (cf_target = ogl_target_start; cf_target <= ogl_target_end; ++cf_target) {
-    if (buffer_index + DDS_full_size <= buffer_length) {
-      unsigned int byte_offset = DDS_main_size;
-      memcpy((void *)DDS_data, (const void *)(&buffer[buffer_index]),
-             DDS_full_size);
-      buffer_index += DDS_full_size;
-      /*	upload the main chunk	*/
-      if (uncompressed) {
-        /*	and remember, DXT uncompressed uses BGR(A),
-                so swap to RGB(A) for ALL MIPmap levels	*/
-        for (i = 0; i < DDS_full_size; i += block_size) {
-          unsigned char temp = DDS_data[i];
-          DDS_data[i] = DDS_data[i + 2];
-          DDS_data[i + 2] = temp;
-        }
-        glTexImage2D(cf_target, 0, S3TC_type, width, height, 0, S3TC_type,
-                     GL_UNSIGNED_BYTE, DDS_data);
-      } else {
-        soilGlCompressedTexImage2D(cf_target, 0, S3TC_type, width, height, 0,
-                                   DDS_main_size, DDS_data);
-      }
-      /*	upload the mipmaps, if we have them	*/
-      for (i = 1; i <= mipmaps; ++i) {
-        int w, h, mip_size;
-        w = width >> i;
-        h = height >> i;
-        if (w < 1) {
-          w = 1;
-        }
-        if (h < 1) {
-          h = 1;
-        }
-        /*	upload this mipmap	*/
-        if (uncompressed) {
-          mip_size = w * h * block_size;
-          glTexImage2D(cf_target, i, S3TC_type, w, h, 0, S3TC_type,
-                       GL_UNSIGNED_BYTE, &DDS_data[byte_offset]);
+  use_storage = SOIL_allocate_storage(
+      tex_ID, opengl_texture_type,
+      (ktx.faces == 6) ? SOIL_TEXTURE_CUBE_MAP_POSITIVE_X : opengl_texture_type,
+      ktx.levels, ktx.internal_format, ktx.width, ktx.height,
+      (ktx.depth > 0) ? ktx.depth : ktx.layers);
+  if (use_storage < 0) {
+    return 0;
+  }
+  /*	KTX rows are padded to 4 bytes, KTX2 rows are not padded at all	*/
+  glGetIntegerv(GL_UNPACK_ALIGNMENT, &old_alignment);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, (ktx.version == 1) ? 4 : 1);
+  for (i = 0; i < ktx.levels; ++i) {
+    const unsigned char *data = buffer + ktx.level_offset[i];
+    int w, h, d;
+    w = ktx.width >> i;
+    h = ktx.height >> i;
+    d = ktx.depth >> i;
+    if (w < 1) {
+      w = 1;
+    }
+    if (h < 1) {
+      h = 1;
+    }
+    if (d < 1) {
+      d = 1;
+    }
+    if (opengl_texture_type == GL_TEXTURE_2D) {
+      SOIL_upload_level(use_storage, GL_TEXTURE_2D, i, ktx.internal_format,
+                        ktx.format, ktx.type, w, h, ktx.image_size[i], data);
+    } else if (opengl_texture_type == SOIL_TEXTURE_CUBE_MAP) {
+      /*	the faces are in +X, -X, +Y, -Y, +Z, -Z order	*/
+      for (f = 0; f < 6; ++f) {
+        SOIL_upload_level(use_storage, SOIL_TEXTURE_CUBE_MAP_POSITIVE_X + f, i,
+                          ktx.internal_format, ktx.format, ktx.type, w, h,
+                          ktx.image_size[i], data);
+        if (ktx.version == 1) {
+          data += (ktx.image_size[i] + 3) & ~3u;
         } else {
-          mip_size = ((w + 3) / 4) * ((h + 3) / 4) * block_size;
-          soilGlCompressedTexImage2D(cf_target, i, S3TC_type, w, h, 0, mip_size,
-                                     &DDS_data[byte_offset]);
+          data += ktx.image_size[i];
         }
-        /*	and move to the next mipmap	*/
-        byte_offset += mip_size;
       }
-      /*	it worked!	*/
-      result_string_pointer = "DDS file loaded";
-    } else {
-      glDeleteTextures(1, &tex_ID);
-      tex_ID = 0;
-      cf_target = ogl_target_end + 1;
-      result_string_pointer = "DDS file was too small for expected image data";
-    }
-  } /* end reading each face */
-  SOIL_free_image_data(DDS_data);
-  if (tex_ID) {
-    /*	did I have MIPmaps?	*/
-    if (mipmaps > 0) {
-      /*	instruct OpenGL to use the MIPmaps	*/
-      glTexParameteri(opengl_texture_type, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-      glTexParameteri(opengl_texture_type, GL_TEXTURE_MIN_FILTER,
-                      GL_LINEAR_MIPMAP_LINEAR);
-    } else {
-      /*	instruct OpenGL _NOT_ to use the MIPmaps	*/
-      glTexParameteri(opengl_texture_type, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-      glTexParameteri(opengl_texture_type, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    }
-    /*	does the user want clamping, or wrapping?	*/
-    if (flags & SOIL_FLAG_TEXTURE_REPEATS) {
-      glTexParameteri(opengl_texture_type, GL_TEXTURE_WRAP_S, GL_REPEAT);
-      glTexParameteri(opengl_texture_type, GL_TEXTURE_WRAP_T, GL_REPEAT);
-      glTexParameteri(opengl_texture_type, SOIL_TEXTURE_WRAP_R, GL_REPEAT);
     } else {
-      /*	unsigned int clamp_mode = SOIL_CLAMP_TO_EDGE;	*/
-      unsigned int clamp_mode = GL_CLAMP;
-      glTexParameteri(opengl_texture_type, GL_TEXTURE_WRAP_S, clamp_mode);
-      glTexParameteri(opengl_texture_type, GL_TEXTURE_WRAP_T, clamp_mode);
-      glTexParameteri(opengl_texture_type, SOIL_TEXTURE_WRAP_R, clamp_mode);
+      /*	arrays and volumes both go up a whole level at a time	*/
+      if (opengl_texture_type == SOIL_TEXTURE_2D_ARRAY) {
+        d = ktx.layers;
+      }
+      SOIL_upload_level_3D(use_storage, opengl_texture_type, i,
+                           ktx.internal_format, ktx.format, ktx.type, w, h, d,
+                           ktx.image_size[i], data);
     }
   }
-
-quick_exit:
-  /*	report success or failure	*/
+  glPixelStorei(GL_UNPACK_ALIGNMENT, old_alignment);
+  /*	did I have MIPmaps?	*/
+  if (ktx.levels > 1) {
+    /*	instruct OpenGL to use the MIPmaps	*/
+    glTexParameteri(opengl_texture_type, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(opengl_texture_type, GL_TEXTURE_MIN_FILTER,
+                    GL_LINEAR_MIPMAP_LINEAR);
+  } else {
+    /*	instruct OpenGL _NOT_ to use the MIPmaps	*/
+    glTexParameteri(opengl_texture_type, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(opengl_texture_type, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  }
+  /*	does the user want clamping, or wrapping?	*/
+  if (flags & SOIL_FLAG_TEXTURE_REPEATS) {
+    glTexParameteri(opengl_texture_type, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(opengl_texture_type, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(opengl_texture_type, SOIL_TEXTURE_WRAP_R, GL_REPEAT);
+  } else {
+    unsigned int clamp_mode = SOIL_CLAMP_TO_EDGE;
+    glTexParameteri(opengl_texture_type, GL_TEXTURE_WRAP_S, clamp_mode);
+    glTexParameteri(opengl_texture_type, GL_TEXTURE_WRAP_T, clamp_mode);
+    glTexParameteri(opengl_texture_type, SOIL_TEXTURE_WRAP_R, clamp_mode);
+  }
+  result_string_pointer = "KTX file loaded";
   return tex_ID;
 }
 
-unsigned int SOIL_direct_load_DDS(const char *filename,
-                                  unsigned int reuse_texture_ID, int flags,
-                                  int loading_as_cubemap) {
+/*	reads in the whole file if it starts like a KTX file, NULL otherwise	*/
+static unsigned char *SOIL_read_KTX_file(const char *filename,
+                                         unsigned int header_only,
+                                         int *buffer_length) {
   FILE *f;
   unsigned char *buffer;
-  size_t buffer_length, bytes_read;
-  unsigned int tex_ID = 0;
-  /*	error checks	*/
+  long file_length;
+  unsigned char id[12];
+  *buffer_length = 0;
   if (NULL == filename) {
-    result_string_pointer = "NULL filename";
-    return 0;
+    return NULL;
   }
   f = fopen(filename, "rb");
   if (NULL == f) {
-    /*	the file doesn't seem to exist (or be open-able)	*/
-    result_string_pointer = "Can not find DDS file";
-    return 0;
+    return NULL;
+  }
+  /*	don't read in anything that isn't a KTX file	*/
+  if ((fread(id, 1, 12, f) != 12) || (id[0] != 0xAB) || (id[1] != 'K') ||
+      (id[2] != 'T') || (id[3] != 'X')) {
+    fclose(f);
+    return NULL;
   }
   fseek(f, 0, SEEK_END);
-  buffer_length = ftell(f);
+  file_length = ftell(f);
   fseek(f, 0, SEEK_SET);
-  buffer = (unsigned char *)malloc(buffer_length);
+  if ((header_only > 0) && (file_length > (long)header_only)) {
+    file_length = header_only;
+  }
+  buffer = (unsigned char *)image_malloc(file_length);
   if (NULL == buffer) {
     result_string_pointer = "malloc failed";
     fclose(f);
-    return 0;
+    return NULL;
   }
-  bytes_read = fread((void *)buffer, 1, buffer_length, f);
+  *buffer_length = (int)fread((void *)buffer, 1, file_length, f);
   fclose(f);
-  if (bytes_read < buffer_length) {
-    /*	huh?	*/
-    buffer_length = bytes_read;
+  return buffer;
+}
+
+unsigned int SOIL_direct_load_KTX(const char *filename,
+                                  unsigned int reuse_texture_ID, int flags,
+                                  int loading_as_cubemap) {
+  int buffer_length;
+  unsigned int tex_ID;
+  unsigned char *buffer = SOIL_read_KTX_file(filename, 0, &buffer_length);
+  if (NULL == buffer) {
+    return 0;
   }
-  /*	now try to do the loading	*/
-  tex_ID = SOIL_direct_load_DDS_from_memory((const unsigned char *const)buffer,
-                                            buffer_length, reuse_texture_ID,
-                                            flags, loading_as_cubemap);
+  tex_ID = SOIL_direct_load_KTX_from_memory(buffer, buffer_length,
+                                            reuse_texture_ID, flags,
+                                            loading_as_cubemap);
   SOIL_free_image_data(buffer);
   return tex_ID;
 }
 
+int SOIL_get_KTX_info_from_memory(const unsigned char *const buffer,
+                                  int buffer_length, int *width, int *height,
+                                  int *depth, int *layers, int *faces,
+                                  int *mipmaps,
+                                  unsigned int *internal_format) {
+  SOIL_KTX_header ktx;
+  if ((buffer_length < 0) ||
+      (SOIL_parse_KTX(buffer, buffer_length, &ktx, 0) <= 0)) {
+    if ((buffer_length < 12) || (NULL == buffer) || (buffer[0] != 0xAB)) {
+      result_string_pointer = "Not a KTX file";
+    }
+    return 0;
+  }
+  if (width) {
+    *width = ktx.width;
+  }
+  if (height) {
+    *height = ktx.height;
+  }
+  if (depth) {
+    *depth = ktx.depth;
+  }
+  if (layers) {
+    *layers = ktx.layers;
+  }
+  if (faces) {
+    *faces = ktx.faces;
+  }
+  if (mipmaps) {
+    *mipmaps = ktx.levels;
+  }
+  if (internal_format) {
+    *internal_format = ktx.internal_format;
+  }
+  result_string_pointer = "KTX header loaded and validated";
+  return 1;
+}
+
+int SOIL_get_KTX_info(const char *filename, int *width, int *height,
+                      int *depth, int *layers, int *faces, int *mipmaps,
+                      unsigned int *internal_format) {
+  int buffer_length, result;
+  /*	the KTX2 header is the bigger one, at 80 bytes	*/
+  unsigned char *buffer = SOIL_read_KTX_file(filename, 80, &buffer_length);
+  if (NULL == buffer) {
+    result_string_pointer = "Not a KTX file";
+    return 0;
+  }
+  result = SOIL_get_KTX_info_from_memory(buffer, buffer_length, width, height,
+                                         depth, layers, faces, mipmaps,
+                                         internal_format);
+  SOIL_free_image_data(buffer);
+  return result;
+}
+
 int query_NPOT_capability(void) {
   /*	check for the capability	*/
   if (has_NPOT_capability == SOIL_CAPABILITY_UNKNOWN) {
@@ -1585,6 +4627,53 @@ int query_cubemap_capability(void) {
   return has_cubemap_capability;
 }
 
+/*	finds an OpenGL function that isn't in the 1.1 headers	*/
+static void *SOIL_GL_proc_address(const char *proc_name) {
+  void *ext_addr = NULL;
+#ifdef WIN32
+  ext_addr = (void *)wglGetProcAddress(proc_name);
+#elif defined(__APPLE__) || defined(__APPLE_CC__)
+  /*	I can't test this Apple stuff!	*/
+  CFBundleRef bundle;
+  CFURLRef bundleURL = CFURLCreateWithFileSystemPath(
+      kCFAllocatorDefault, CFSTR("/System/Library/Frameworks/OpenGL.framework"),
+      kCFURLPOSIXPathStyle, true);
+  CFStringRef extensionName = CFStringCreateWithCString(
+      kCFAllocatorDefault, proc_name, kCFStringEncodingASCII);
+  bundle = CFBundleCreate(kCFAllocatorDefault, bundleURL);
+  assert(bundle != NULL);
+  ext_addr = CFBundleGetFunctionPointerForName(bundle, extensionName);
+  CFRelease(bundleURL);
+  CFRelease(extensionName);
+  CFRelease(bundle);
+#else
+  ext_addr = (void *)glXGetProcAddressARB((const GLubyte *)proc_name);
+#endif
+  return ext_addr;
+}
+
+static int query_compressed_tex_image_2D(void) {
+  /*	find the address of the extension function, once	*/
+  if (NULL == soilGlCompressedTexImage2D) {
+    soilGlCompressedTexImage2D = (P_SOIL_GLCOMPRESSEDTEXIMAGE2DPROC)
+        SOIL_GL_proc_address("glCompressedTexImage2DARB");
+  }
+  return (NULL != soilGlCompressedTexImage2D);
+}
+
+static int query_tex_image_3D(void) {
+  /*	both of these came along after OpenGL 1.1	*/
+  if (NULL == soilGlTexImage3D) {
+    soilGlTexImage3D =
+        (P_SOIL_GLTEXIMAGE3DPROC)SOIL_GL_proc_address("glTexImage3D");
+  }
+  if (NULL == soilGlCompressedTexImage3D) {
+    soilGlCompressedTexImage3D = (P_SOIL_GLCOMPRESSEDTEXIMAGE3DPROC)
+        SOIL_GL_proc_address("glCompressedTexImage3DARB");
+  }
+  return (NULL != soilGlTexImage3D) && (NULL != soilGlCompressedTexImage3D);
+}
+
 int query_DXT_capability(void) {
   /*	check for the capability	*/
   if (has_DXT_capability == SOIL_CAPABILITY_UNKNOWN) {
@@ -1593,50 +4682,208 @@ int query_DXT_capability(void) {
                        "GL_EXT_texture_compression_s3tc")) {
       /*	not there, flag the failure	*/
       has_DXT_capability = SOIL_CAPABILITY_NONE;
+    } else if (!query_compressed_tex_image_2D()) {
+      /*	hmm, not good!!  This should not happen, but does on my
+              laptop's VIA chipset.  The GL_EXT_texture_compression_s3tc
+              spec requires that ARB_texture_compression be present too.
+              this means I can upload and have the OpenGL drive do the
+              conversion, but I can't use my own routines or load DDS files
+              from disk and upload them directly [8^(	*/
+      has_DXT_capability = SOIL_CAPABILITY_NONE;
     } else {
-      /*	and find the address of the extension function	*/
-      P_SOIL_GLCOMPRESSEDTEXIMAGE2DPROC ext_addr = NULL;
-#ifdef WIN32
-      ext_addr = (P_SOIL_GLCOMPRESSEDTEXIMAGE2DPROC)wglGetProcAddress(
-          "glCompressedTexImage2DARB");
-#elif defined(__APPLE__) || defined(__APPLE_CC__)
-      /*	I can't test this Apple stuff!	*/
-      CFBundleRef bundle;
-      CFURLRef bundleURL = CFURLCreateWithFileSystemPath(
-          kCFAllocatorDefault,
-          CFSTR("/System/Library/Frameworks/OpenGL.framework"),
-          kCFURLPOSIXPathStyle, true);
-      CFStringRef extensionName = CFStringCreateWithCString(
-          kCFAllocatorDefault, "glCompressedTexImage2DARB",
-          kCFStringEncodingASCII);
-      bundle = CFBundleCreate(kCFAllocatorDefault, bundleURL);
-      assert(bundle != NULL);
-      ext_addr =
-          (P_SOIL_GLCOMPRESSEDTEXIMAGE2DPROC)CFBundleGetFunctionPointerForName(
-              bundle, extensionName);
-      CFRelease(bundleURL);
-      CFRelease(extensionName);
-      CFRelease(bundle);
-#else
-      ext_addr = (P_SOIL_GLCOMPRESSEDTEXIMAGE2DPROC)glXGetProcAddressARB(
-          (const GLubyte *)"glCompressedTexImage2DARB");
-#endif
-      /*	Flag it so no checks needed later	*/
-      if (NULL == ext_addr) {
-        /*	hmm, not good!!  This should not happen, but does on my
-                laptop's VIA chipset.  The GL_EXT_texture_compression_s3tc
-                spec requires that ARB_texture_compression be present too.
-                this means I can upload and have the OpenGL drive do the
-                conversion, but I can't use my own routines or load DDS files
-                from disk and upload them directly [8^(	*/
-        has_DXT_capability = SOIL_CAPABILITY_NONE;
-      } else {
-        /*	all's well!	*/
-        soilGlCompressedTexImage2D = ext_addr;
-        has_DXT_capability = SOIL_CAPABILITY_PRESENT;
-      }
+      /*	all's well!	*/
+      has_DXT_capability = SOIL_CAPABILITY_PRESENT;
     }
   }
   /*	let the user know if we can do DXT or not	*/
   return has_DXT_capability;
 }
+
+int query_LATC_capability(void) {
+  /*	check for the capability	*/
+  if (has_LATC_capability == SOIL_CAPABILITY_UNKNOWN) {
+    /*	we haven't yet checked for the capability, do so	*/
+    char const *ext = (char const *)glGetString(GL_EXTENSIONS);
+    if (((NULL == strstr(ext, "GL_EXT_texture_compression_latc")) &&
+         (NULL == strstr(ext, "GL_NV_texture_compression_latc"))) ||
+        !query_compressed_tex_image_2D()) {
+      /*	not there, flag the failure	*/
+      has_LATC_capability = SOIL_CAPABILITY_NONE;
+    } else {
+      /*	it's there!	*/
+      has_LATC_capability = SOIL_CAPABILITY_PRESENT;
+    }
+  }
+  /*	let the user know if we can do LATC or not	*/
+  return has_LATC_capability;
+}
+
+int query_RGTC_capability(void) {
+  /*	check for the capability	*/
+  if (has_RGTC_capability == SOIL_CAPABILITY_UNKNOWN) {
+    /*	we haven't yet checked for the capability, do so	*/
+    char const *ext = (char const *)glGetString(GL_EXTENSIONS);
+    if (((NULL == strstr(ext, "GL_ARB_texture_compression_rgtc")) &&
+         (NULL == strstr(ext, "GL_EXT_texture_compression_rgtc"))) ||
+        !query_compressed_tex_image_2D()) {
+      /*	not there, flag the failure	*/
+      has_RGTC_capability = SOIL_CAPABILITY_NONE;
+    } else {
+      /*	it's there!	*/
+      has_RGTC_capability = SOIL_CAPABILITY_PRESENT;
+    }
+  }
+  /*	let the user know if we can do RGTC or not	*/
+  return has_RGTC_capability;
+}
+
+int query_BPTC_capability(void) {
+  /*	check for the capability	*/
+  if (has_BPTC_capability == SOIL_CAPABILITY_UNKNOWN) {
+    /*	we haven't yet checked for the capability, do so	*/
+    char const *ext = (char const *)glGetString(GL_EXTENSIONS);
+    if (((NULL == strstr(ext, "GL_ARB_texture_compression_bptc")) &&
+         (NULL == strstr(ext, "GL_EXT_texture_compression_bptc"))) ||
+        !query_compressed_tex_image_2D()) {
+      /*	not there, flag the failure	*/
+      has_BPTC_capability = SOIL_CAPABILITY_NONE;
+    } else {
+      /*	it's there!	*/
+      has_BPTC_capability = SOIL_CAPABILITY_PRESENT;
+    }
+  }
+  /*	let the user know if we can do BPTC or not	*/
+  return has_BPTC_capability;
+}
+
+int query_2D_array_capability(void) {
+  /*	check for the capability	*/
+  if (has_2D_array_capability == SOIL_CAPABILITY_UNKNOWN) {
+    /*	we haven't yet checked for the capability, do so	*/
+    if ((NULL == strstr((char const *)glGetString(GL_EXTENSIONS),
+                        "GL_EXT_texture_array")) ||
+        !query_tex_image_3D()) {
+      /*	not there, flag the failure	*/
+      has_2D_array_capability = SOIL_CAPABILITY_NONE;
+    } else {
+      /*	it's there!	*/
+      has_2D_array_capability = SOIL_CAPABILITY_PRESENT;
+    }
+  }
+  /*	let the user know if we can do texture arrays or not	*/
+  return has_2D_array_capability;
+}
+
+int query_ETC2_capability(void) {
+  /*	check for the capability	*/
+  if (has_ETC2_capability == SOIL_CAPABILITY_UNKNOWN) {
+    /*	we haven't yet checked for the capability, do so	*/
+    if ((NULL == strstr((char const *)glGetString(GL_EXTENSIONS),
+                        "GL_ARB_ES3_compatibility")) ||
+        !query_compressed_tex_image_2D()) {
+      /*	not there, flag the failure	*/
+      has_ETC2_capability = SOIL_CAPABILITY_NONE;
+    } else {
+      /*	it's there!	*/
+      has_ETC2_capability = SOIL_CAPABILITY_PRESENT;
+    }
+  }
+  /*	let the user know if we can do ETC2 or not	*/
+  return has_ETC2_capability;
+}
+
+int query_3D_capability(void) {
+  /*	check for the capability	*/
+  if (has_3D_capability == SOIL_CAPABILITY_UNKNOWN) {
+    /*	we haven't yet checked for the capability, do so
+            (3D textures are core from OpenGL 1.2 on)	*/
+    char const *version = (char const *)glGetString(GL_VERSION);
+    if (((NULL == strstr((char const *)glGetString(GL_EXTENSIONS),
+                         "GL_EXT_texture3D")) &&
+         ((NULL == version) || (0 == strncmp(version, "1.0", 3)) ||
+          (0 == strncmp(version, "1.1", 3)))) ||
+        !query_tex_image_3D()) {
+      /*	not there, flag the failure	*/
+      has_3D_capability = SOIL_CAPABILITY_NONE;
+    } else {
+      /*	it's there!	*/
+      has_3D_capability = SOIL_CAPABILITY_PRESENT;
+    }
+  }
+  /*	let the user know if we can do volume textures or not	*/
+  return has_3D_capability;
+}
+
+int query_tex_storage_capability(void) {
+  /*	check for the capability	*/
+  if (has_tex_storage_capability == SOIL_CAPABILITY_UNKNOWN) {
+    /*	we haven't yet checked for the capability, do so	*/
+    char const *version = (char const *)glGetString(GL_VERSION);
+    if ((NULL != strstr((char const *)glGetString(GL_EXTENSIONS),
+                        "GL_ARB_texture_storage")) ||
+        ((NULL != version) && (version[0] >= '4') && (version[1] == '.') &&
+         ((version[0] > '4') || (version[2] >= '2')))) {
+      soilGlTexStorage2D =
+          (P_SOIL_GLTEXSTORAGE2DPROC)SOIL_GL_proc_address("glTexStorage2D");
+      soilGlTexStorage3D =
+          (P_SOIL_GLTEXSTORAGE3DPROC)SOIL_GL_proc_address("glTexStorage3D");
+      soilGlCompressedTexSubImage2D = (P_SOIL_GLCOMPRESSEDTEXSUBIMAGE2DPROC)
+          SOIL_GL_proc_address("glCompressedTexSubImage2D");
+      soilGlTexSubImage3D =
+          (P_SOIL_GLTEXSUBIMAGE3DPROC)SOIL_GL_proc_address("glTexSubImage3D");
+      soilGlCompressedTexSubImage3D = (P_SOIL_GLCOMPRESSEDTEXSUBIMAGE3DPROC)
+          SOIL_GL_proc_address("glCompressedTexSubImage3D");
+    }
+    if ((NULL == soilGlTexStorage2D) || (NULL == soilGlTexStorage3D) ||
+        (NULL == soilGlCompressedTexSubImage2D) ||
+        (NULL == soilGlTexSubImage3D) ||
+        (NULL == soilGlCompressedTexSubImage3D)) {
+      /*	not there, flag the failure	*/
+      has_tex_storage_capability = SOIL_CAPABILITY_NONE;
+    } else {
+      /*	it's there!	*/
+      has_tex_storage_capability = SOIL_CAPABILITY_PRESENT;
+    }
+  }
+  /*	let the user know if we can allocate immutable storage or not	*/
+  return has_tex_storage_capability;
+}
+
+int query_swizzle_capability(void) {
+  /*	check for the capability	*/
+  if (has_swizzle_capability == SOIL_CAPABILITY_UNKNOWN) {
+    /*	we haven't yet checked for the capability, do so	*/
+    char const *ext = (char const *)glGetString(GL_EXTENSIONS);
+    if ((NULL == strstr(ext, "GL_ARB_texture_swizzle")) &&
+        (NULL == strstr(ext, "GL_EXT_texture_swizzle"))) {
+      /*	not there, flag the failure	*/
+      has_swizzle_capability = SOIL_CAPABILITY_NONE;
+    } else {
+      /*	it's there!	*/
+      has_swizzle_capability = SOIL_CAPABILITY_PRESENT;
+    }
+  }
+  /*	let the user know if we can swizzle or not	*/
+  return has_swizzle_capability;
+}
+
+int query_sRGB_capability(void) {
+  /*	check for the capability	*/
+  if (has_sRGB_capability == SOIL_CAPABILITY_UNKNOWN) {
+    /*	we haven't yet checked for the capability, do so
+            (sRGB textures are core from OpenGL 2.1 on)	*/
+    char const *version = (char const *)glGetString(GL_VERSION);
+    if ((NULL == strstr((char const *)glGetString(GL_EXTENSIONS),
+                        "GL_EXT_texture_sRGB")) &&
+        ((NULL == version) || (version[0] < '2') || (version[1] != '.') ||
+         ((version[0] == '2') && (version[2] < '1')))) {
+      /*	not there, flag the failure	*/
+      has_sRGB_capability = SOIL_CAPABILITY_NONE;
+    } else {
+      /*	it's there!	*/
+      has_sRGB_capability = SOIL_CAPABILITY_PRESENT;
+    }
+  }
+  /*	let the user know if we can do sRGB textures or not	*/
+  return has_sRGB_capability;
+}
@@ -21,7 +21,8 @@
 	- BMP		load & save
 	- TGA		load & save
 	- DDS		load & save
-	- PNG		load
+	- KTX / KTX2	load (straight into OpenGL)
+	- PNG		load & save
 	- JPG		load
 
 	OpenGL Texture Features:
@@ -40,6 +41,8 @@
 #ifndef HEADER_SIMPLE_OPENGL_IMAGE_LIBRARY
 #define HEADER_SIMPLE_OPENGL_IMAGE_LIBRARY
 
+#include <stddef.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -66,7 +69,9 @@ enum
 	register a new texture ID using glGenTextures().
 	If the value passed into reuse_texture_ID > 0 then
 	SOIL will just re-use that texture ID (great for
-	reloading image assets in-game!)
+	reloading image assets in-game!)  A texture with immutable storage
+	(glTexStorage) can only be refilled with an image of the same size
+	and format; anything else fails, and leaves that texture as it was.
 **/
 enum
 {
@@ -79,18 +84,25 @@ enum
 	(note that if SOIL_FLAG_DDS_LOAD_DIRECT is used
 	the rest of the flags with the exception of
 	SOIL_FLAG_TEXTURE_REPEATS will be ignored while
-	loading already-compressed DDS files.)
+	loading already-compressed DDS files.
+	DX10 DDS files (BC1-BC7) go up as-is too, a DX10
+	texture array comes back as a GL_TEXTURE_2D_ARRAY and
+	a volume DDS file as a GL_TEXTURE_3D.
+	KTX and KTX2 files are always uploaded as-is, MIPmaps,
+	cubemap faces, array layers and all, so only
+	SOIL_FLAG_TEXTURE_REPEATS applies to them.)
 
 	SOIL_FLAG_POWER_OF_TWO: force the image to be POT
 	SOIL_FLAG_MIPMAPS: generate mipmaps for the texture
 	SOIL_FLAG_TEXTURE_REPEATS: otherwise will clamp
 	SOIL_FLAG_MULTIPLY_ALPHA: for using (GL_ONE,GL_ONE_MINUS_SRC_ALPHA) blending
 	SOIL_FLAG_INVERT_Y: flip the image vertically
-	SOIL_FLAG_COMPRESS_TO_DXT: if the card can display them, will convert RGB to DXT1, RGBA to DXT5
+	SOIL_FLAG_COMPRESS_TO_DXT: if the card can display them, will convert RGB to DXT1, RGBA to DXT5, L / LA to LATC1 / LATC2 (or RGTC1 / RGTC2, swizzled)
 	SOIL_FLAG_DDS_LOAD_DIRECT: will load DDS files directly without _ANY_ additional processing
 	SOIL_FLAG_NTSC_SAFE_RGB: clamps RGB components to the range [16,235]
 	SOIL_FLAG_CoCg_Y: Google YCoCg; RGB=>CoYCg, RGBA=>CoCgAY
 	SOIL_FLAG_TEXTURE_RECTANGE: uses ARB_texture_rectangle ; pixel indexed & no repeat or MIPmaps or cubemaps
+	SOIL_FLAG_SRGB_COLOR_SPACE: the image is sRGB; MIPmaps are filtered in linear light, and it goes up as SRGB8 / SRGB8_ALPHA8 / SRGB DXT if the card has them (ignored with SOIL_FLAG_CoCg_Y)
 **/
 enum
 {
@@ -103,7 +115,8 @@ enum
 	SOIL_FLAG_DDS_LOAD_DIRECT = 64,
 	SOIL_FLAG_NTSC_SAFE_RGB = 128,
 	SOIL_FLAG_CoCg_Y = 256,
-	SOIL_FLAG_TEXTURE_RECTANGLE = 512
+	SOIL_FLAG_TEXTURE_RECTANGLE = 512,
+	SOIL_FLAG_SRGB_COLOR_SPACE = 1024
 };
 
 /**
@@ -111,12 +124,14 @@ enum
 	(TGA supports uncompressed RGB / RGBA)
 	(BMP supports uncompressed RGB)
 	(DDS supports DXT1 and DXT5)
+	(PNG supports lossless 1 to 4 channels, see SOIL_set_PNG_compression_level)
 **/
 enum
 {
 	SOIL_SAVE_TYPE_TGA = 0,
 	SOIL_SAVE_TYPE_BMP = 1,
-	SOIL_SAVE_TYPE_DDS = 2
+	SOIL_SAVE_TYPE_DDS = 2,
+	SOIL_SAVE_TYPE_PNG = 3
 };
 
 /**
@@ -301,6 +316,31 @@ unsigned int
 		unsigned int flags
 	);
 
+/**
+	Loads several image files into the layers of one GL_TEXTURE_2D_ARRAY
+	(layer i comes from filenames[i]).  The files are decoded and prepared
+	on the threads given to SOIL_set_parallel_for, if any.  Layers smaller
+	than the biggest one are scaled up to match it, and all the layers get
+	the channel count of the one with the most channels.  Every layer and
+	MIPmap level is allocated with a single glTexStorage3D call when the
+	driver has ARB_texture_storage.
+	\param filenames the name of the file to upload into each layer
+	\param num_layers how many layers (and filenames) there are
+	\param force_channels 0-image format, 1-luminous, 2-luminous/alpha, 3-RGB, 4-RGBA
+	\param reuse_texture_ID 0-generate a new texture ID, otherwise reuse the texture ID (overwriting the old texture)
+	\param flags can be any of SOIL_FLAG_POWER_OF_TWO | SOIL_FLAG_MIPMAPS | SOIL_FLAG_TEXTURE_REPEATS | SOIL_FLAG_MULTIPLY_ALPHA | SOIL_FLAG_INVERT_Y | SOIL_FLAG_COMPRESS_TO_DXT | SOIL_FLAG_NTSC_SAFE_RGB | SOIL_FLAG_CoCg_Y
+	\return 0-failed, otherwise returns the OpenGL texture handle
+**/
+unsigned int
+	SOIL_load_OGL_texture_array
+	(
+		const char *const *filenames,
+		int num_layers,
+		int force_channels,
+		unsigned int reuse_texture_ID,
+		unsigned int flags
+	);
+
 /**
 	Creates a 2D OpenGL texture from raw image data.  Note that the raw data is
 	_NOT_ freed after the upload (so the user can load various versions).
@@ -321,6 +361,32 @@ unsigned int
 		unsigned int flags
 	);
 
+/**
+	The same as SOIL_create_OGL_texture, but the rows of data are stride
+	bytes apart, so it can be a piece of a larger image (a sub-rectangle of
+	a frame or an atlas) with no copy made of it first.  Unless the flags
+	change the pixels themselves (SOIL_FLAG_INVERT_Y, SOIL_FLAG_NTSC_SAFE_RGB,
+	SOIL_FLAG_MULTIPLY_ALPHA, SOIL_FLAG_CoCg_Y) the rows are resized,
+	compressed or uploaded (with GL_UNPACK_ROW_LENGTH) straight from data.
+	\param data the first pixel of the image
+	\param width the width of the image in pixels
+	\param height the height of the image in pixels
+	\param channels the number of channels: 1-luminous, 2-luminous/alpha, 3-RGB, 4-RGBA
+	\param stride the number of bytes from one row to the next, 0 meaning width*channels
+	\param reuse_texture_ID 0-generate a new texture ID, otherwise reuse the texture ID (overwriting the old texture)
+	\param flags the same as for SOIL_create_OGL_texture
+	\return 0-failed, otherwise returns the OpenGL texture handle
+**/
+unsigned int
+	SOIL_create_OGL_texture_with_stride
+	(
+		const unsigned char *const data,
+		int width, int height, int channels,
+		int stride,
+		unsigned int reuse_texture_ID,
+		unsigned int flags
+	);
+
 /**
 	Creates an OpenGL cubemap texture by splitting up 1 image into 6 parts.
 	\param data the raw data to be uploaded as an OpenGL texture
@@ -390,6 +456,65 @@ unsigned char*
 		int force_channels
 	);
 
+/**
+	Finds out an image's size and channel count without decoding it
+	(only the header is read, except for DDS and HDR files).
+	\return 0 if failed, otherwise returns 1
+**/
+int
+	SOIL_load_image_info
+	(
+		const char *filename,
+		int *width, int *height, int *channels
+	);
+
+/**
+	The same as SOIL_load_image_info, for an image in memory.
+	\return 0 if failed, otherwise returns 1
+**/
+int
+	SOIL_load_image_info_from_memory
+	(
+		const unsigned char *const buffer,
+		int buffer_length,
+		int *width, int *height, int *channels
+	);
+
+/**
+	Loads an image from disk into memory you already have, instead of
+	a new array: row y starts at dst + y * dst_stride, and holds
+	width pixels of force_channels channels (or, for SOIL_LOAD_AUTO,
+	of the channel count SOIL_load_image_info reports, which is what
+	comes back in *channels).  That takes
+	(height - 1) * dst_stride + width * channels bytes; the header is
+	checked first, so nothing gets decoded if dst is too small.
+	JPEGs are decoded straight into dst, other types are copied in.
+	\param dst_stride bytes from one row to the next, 0 for tightly packed
+	\return 0 if failed (dst too small included), otherwise returns 1
+**/
+int
+	SOIL_load_image_into
+	(
+		const char *filename,
+		unsigned char *dst, size_t dst_size, int dst_stride,
+		int *width, int *height, int *channels,
+		int force_channels
+	);
+
+/**
+	The same as SOIL_load_image_into, for an image in memory.
+	\return 0 if failed, otherwise returns 1
+**/
+int
+	SOIL_load_image_into_from_memory
+	(
+		const unsigned char *const buffer,
+		int buffer_length,
+		unsigned char *dst, size_t dst_size, int dst_stride,
+		int *width, int *height, int *channels,
+		int force_channels
+	);
+
 /**
 	Saves an image from an array of unsigned chars (RGBA) to disk
 	\return 0 if failed, otherwise returns 1
@@ -404,8 +529,275 @@ int
 	);
 
 /**
-	Frees the image data (note, this is just C's "free()"...this function is
-	present mostly so C++ programmers don't forget to use "free()" and call
+	Saves an image from an array of unsigned chars (RGBA) into a
+	newly allocated buffer holding the whole file, which is freed
+	with SOIL_free_image_data
+	\return 0 if failed, otherwise returns the buffer (*buffer_length bytes)
+**/
+unsigned char*
+	SOIL_save_image_to_memory
+	(
+		int image_type,
+		int width, int height, int channels,
+		const unsigned char *const data,
+		int *buffer_length
+	);
+
+/**
+	Saves a texture as a DXT1 (1 or 3 channels) or DXT5 (2 or 4 channels)
+	DDS file that SOIL_FLAG_DDS_LOAD_DIRECT can later upload with no
+	run-time compression or MIPmap generation.  faces is 1 for a 2D
+	texture, or 6 for a cubemap: the square faces stacked one above the
+	other in +X, -X, +Y, -Y, +Z, -Z order (the way a cubemap DDS comes
+	back from SOIL_load_image).  With SOIL_FLAG_MIPMAPS in flags every
+	face is stored with its full MIPmap chain; other flags are ignored.
+	\return 0 if failed, otherwise returns 1
+**/
+int
+	SOIL_save_DDS_texture
+	(
+		const char *filename,
+		int width, int height, int channels,
+		int faces, unsigned int flags,
+		const unsigned char *const data
+	);
+
+/**
+	Same as SOIL_save_DDS_texture, but the file goes into a newly
+	allocated buffer, which is freed with SOIL_free_image_data
+	\return 0 if failed, otherwise returns the buffer (*buffer_length bytes)
+**/
+unsigned char*
+	SOIL_save_DDS_texture_to_memory
+	(
+		int width, int height, int channels,
+		int faces, unsigned int flags,
+		const unsigned char *const data,
+		int *buffer_length
+	);
+
+/**
+	Reads just the header of a KTX or KTX2 file, so you can tell what
+	SOIL_load_OGL_texture() would make of it without loading the image
+	data.  depth is 0 unless it's a volume texture, layers is 0 unless
+	it's a texture array, and faces is 6 for a cubemap (1 otherwise).
+	internal_format is the OpenGL internal format the data goes up as.
+	Any of the pointers can be NULL.
+	\return 1 if the header is one SOIL can upload, 0 otherwise
+**/
+int
+	SOIL_get_KTX_info
+	(
+		const char *filename,
+		int *width, int *height, int *depth,
+		int *layers, int *faces, int *mipmaps,
+		unsigned int *internal_format
+	);
+
+/**
+	Same as SOIL_get_KTX_info, but reading the header from memory.
+**/
+int
+	SOIL_get_KTX_info_from_memory
+	(
+		const unsigned char *const buffer,
+		int buffer_length,
+		int *width, int *height, int *depth,
+		int *layers, int *faces, int *mipmaps,
+		unsigned int *internal_format
+	);
+
+/**
+	Sets how hard the PNG writer works to shrink the file: 0 stores
+	the pixels uncompressed (fastest), 1 is fast, and 9 gives the
+	smallest files.  The default is 6.
+**/
+void
+	SOIL_set_PNG_compression_level
+	(
+		int level
+	);
+
+/**
+	Lets SOIL spread independent pieces of work (the row filtering of
+	the PNG writer, the layers of a texture array, and the rows of every
+	resize and MIPmap level) over your own threads; the results are the
+	same, whichever thread does what.  parallel_for
+	must call body(data, i) once for every i in [0,count), in any order
+	or at the same time, and return only once all of those calls are
+	done.  Pass NULL to go back to running them one after another.
+**/
+typedef void (*SOIL_parallel_body)(void *data, int index);
+typedef void (*SOIL_parallel_for)(void *context, int count, SOIL_parallel_body body, void *data);
+void
+	SOIL_set_parallel_for
+	(
+		SOIL_parallel_for parallel_for,
+		void *context
+	);
+
+/**
+	Sends every allocation SOIL makes (and stb_image, the DXT compressor
+	and the image helpers under it: decoded images, zlib and JPEG
+	buffers, MIPmaps, DDS data, all of it) to your own functions, each
+	of which gets user passed back.  realloc_fn and free_fn are never
+	handed NULL.  Set it before loading anything, memory has to go back
+	to whoever it came from: the images SOIL_load_image returns come
+	from malloc_fn, so release them with SOIL_free_image_data.
+	Passing any NULL goes back to malloc, realloc and free.
+**/
+typedef void *(*SOIL_malloc_func)(void *user, size_t size);
+typedef void *(*SOIL_realloc_func)(void *user, void *pointer, size_t size);
+typedef void (*SOIL_free_func)(void *user, void *pointer);
+void
+	SOIL_set_allocator
+	(
+		SOIL_malloc_func malloc_fn,
+		SOIL_realloc_func realloc_fn,
+		SOIL_free_func free_fn,
+		void *user
+	);
+
+/**
+	Gives the calling thread a scratch arena.  Everything a load on
+	this thread needs only while it runs (the file, the decoded image,
+	the resized copy, MIPmaps, DXT blocks...) is then bumped off the
+	arena and all of it goes back at once when the load returns, so
+	once the arena is big enough loading makes no allocations at all.
+	Textures and their bookkeeping still come from the allocator.
+	Off by default; it is per thread, so call it on each loading thread
+	(and with NULL, 0 before that thread exits, to free what it holds).
+	Call it between loads, never during one, and after
+	SOIL_set_allocator.
+	\param memory your own block for the arena, or NULL to have SOIL
+	allocate it (growing it to whatever a load needed)
+	\param size the size of memory, or with NULL the most SOIL may keep
+	between loads (NULL and 0 turns the arena off)
+	
+eturn 0 if it failed (during a load, or memory was too small),
+	otherwise returns 1
+**/
+int
+	SOIL_set_scratch_arena
+	(
+		void *memory,
+		size_t size
+	);
+
+/**
+	Turns sharing of identical loads on (1) or off (0, the default).  While
+	it is on, SOIL_load_OGL_texture and SOIL_load_OGL_texture_from_memory
+	remember what they loaded, keyed on the filename (or the contents of
+	the buffer), force_channels and flags.  Loading the same thing again
+	just hands back the same texture ID with its reference count bumped,
+	nothing is decoded or uploaded.  Loads with a reuse_texture_ID are
+	never shared.  It is safe to call those loaders from several threads
+	(each with its own, shared, OpenGL context).
+	\param enabled 1 to share textures, 0 to create a new one every time
+**/
+void
+	SOIL_set_texture_dedup
+	(
+		int enabled
+	);
+
+/**
+	Gives back a texture you got from SOIL.  A shared texture is only
+	deleted once every load that returned it has been released, anything
+	else is deleted right away.  Use this instead of glDeleteTextures on
+	textures loaded while sharing or the memory budget was on.
+	\param tex_id the OpenGL texture ID to release
+**/
+void
+	SOIL_release_texture
+	(
+		unsigned int tex_id
+	);
+
+/**
+	Turns the texture memory budget on or off (the default).  While it is
+	on, SOIL records how many bytes every texture it creates takes up in
+	video memory.  Whenever the resident ones add up to more than
+	max_bytes, the least recently used textures that came from
+	SOIL_load_OGL_texture are evicted: their memory is freed, but they
+	keep their texture ID.  So that they can, SOIL doesn't give new
+	textures immutable storage (glTexStorage) while max_bytes is set.  Call SOIL_use_texture before drawing with a
+	texture, to mark it used and load it back in if it was evicted.
+	Textures SOIL can't load again (from memory, cubemaps, arrays...) are
+	counted, but never evicted.  Turning the budget off forgets all of it.
+	\param enabled 1 to keep track of texture memory, 0 to stop
+	\param max_bytes the budget (0 = just keep count, never evict)
+**/
+void
+	SOIL_set_texture_budget
+	(
+		int enabled,
+		unsigned long max_bytes
+	);
+
+/**
+	Marks a texture as just used, for the budget's LRU eviction, and loads
+	it again if it was evicted.
+	\param tex_id the OpenGL texture ID
+	\return tex_id, or 0 if it was evicted and could not be loaded again
+**/
+unsigned int
+	SOIL_use_texture
+	(
+		unsigned int tex_id
+	);
+
+/**
+	Looks up what the texture memory budget knows about one texture.
+	\param tex_id the OpenGL texture ID
+	\param bytes how much video memory it takes up when resident (can be NULL)
+	\param resident 1 if it is loaded, 0 if it has been evicted (can be NULL)
+	\return 1 if the texture is being tracked, 0 if not
+**/
+int
+	SOIL_get_texture_usage
+	(
+		unsigned int tex_id,
+		unsigned long *bytes,
+		int *resident
+	);
+
+/**
+	Totals for every texture the memory budget is tracking.
+	\param resident_bytes video memory taken up by the loaded textures (can be NULL)
+	\param evicted_bytes what the evicted ones would take up again (can be NULL)
+	\param textures how many textures are being tracked (can be NULL)
+**/
+void
+	SOIL_get_texture_budget_usage
+	(
+		unsigned long *resident_bytes,
+		unsigned long *evicted_bytes,
+		int *textures
+	);
+
+/**
+	Turns on the on-disk texture cache.  Once it is set, every 2D texture
+	that SOIL_load_OGL_texture or SOIL_load_OGL_texture_from_memory builds
+	as DXT1, DXT5, RGB or RGBA is also written to the directory as a DDS
+	file (MIPmaps and all), named after a hash of the source bytes, the
+	force_channels and the flags.  Loading the same thing again uploads
+	that file directly instead of decoding, resizing and compressing it.
+	Cubemaps, arrays and texture rectangles are never cached.
+	\param directory where to keep the files, it must already exist (NULL turns the cache off)
+	\param max_bytes when the files add up to more than this the least recently used ones are deleted (0 = no limit)
+**/
+void
+	SOIL_set_texture_cache
+	(
+		const char *directory,
+		unsigned long max_bytes
+	);
+
+/**
+	Frees the image data (note, this is just C's "free()", unless
+	SOIL_set_allocator gave it another one...this function is present
+	mostly so C++ programmers don't forget to use "free()" and call
 	"delete []" instead [8^)
 **/
 void
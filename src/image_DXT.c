@@ -8,6 +8,7 @@
 */
 
 #include "image_DXT.h"
+#include "image_helper.h"
 #include <math.h>
 #include <stdlib.h>
 #include <string.h>
@@ -38,6 +39,162 @@ void compress_DDS_alpha_block(
 				const unsigned char *const uncompressed,
 				unsigned char compressed[8] );
 
+/*
+	Compresses every face (and every MIPmap level, if asked for) to
+	DXT1 (no alpha) or DXT5, back to back in DDS order, and fills in
+	the matching DDS header.  Returns the compressed data.
+*/
+static unsigned char*
+	compress_image_for_DDS
+	(
+		int width, int height, int channels,
+		int faces, int mipmaps,
+		const unsigned char *const data,
+		DDS_header *header, int *DDS_size
+	)
+{
+	unsigned char *DDS_data, *resampled = NULL;
+	int block_size = 16, levels = 1;
+	int face, level, w, h, offset = 0;
+	if( (channels & 1) == 1 )
+	{
+		/*	no alpha, just use DXT1	*/
+		block_size = 8;
+	}
+	/*	same chain as SOIL_FLAG_MIPMAPS builds: halve down to 1x1	*/
+	if( mipmaps )
+	{
+		while( ((1 << levels) <= width) || ((1 << levels) <= height) )
+		{
+			++levels;
+		}
+	}
+	/*	how much room for the whole thing?	*/
+	*DDS_size = 0;
+	for( level = 0; level < levels; ++level )
+	{
+		w = width >> level;
+		h = height >> level;
+		if( w < 1 )
+		{
+			w = 1;
+		}
+		if( h < 1 )
+		{
+			h = 1;
+		}
+		*DDS_size += ((w+3) >> 2) * ((h+3) >> 2) * block_size;
+	}
+	*DDS_size *= faces;
+	DDS_data = (unsigned char*)image_malloc( *DDS_size );
+	if( levels > 1 )
+	{
+		w = width >> 1;
+		h = height >> 1;
+		resampled = (unsigned char*)image_malloc( (w > 0 ? w : 1) * (h > 0 ? h : 1) * channels );
+	}
+	if( (NULL == DDS_data) || ((levels > 1) && (NULL == resampled)) )
+	{
+		image_free( DDS_data );
+		image_free( resampled );
+		return NULL;
+	}
+	for( face = 0; face < faces; ++face )
+	{
+		const unsigned char *face_data = data + face*width*height*channels;
+		for( level = 0; level < levels; ++level )
+		{
+			const unsigned char *img = face_data;
+			unsigned char *block_data;
+			int block_data_size;
+			w = width >> level;
+			h = height >> level;
+			if( w < 1 )
+			{
+				w = 1;
+			}
+			if( h < 1 )
+			{
+				h = 1;
+			}
+			if( level > 0 )
+			{
+				/*	each level is averaged straight from the full size face	*/
+				mipmap_image( face_data, width, height, channels, 0, resampled,
+						1 << level, 1 << level, NULL );
+				img = resampled;
+			}
+			/*	Convert the image	*/
+			if( block_size == 8 )
+			{
+				block_data = convert_image_to_DXT1( img, w, h, channels, 0, &block_data_size );
+			} else
+			{
+				/*	has alpha, so use DXT5	*/
+				block_data = convert_image_to_DXT5( img, w, h, channels, 0, &block_data_size );
+			}
+			if( NULL == block_data )
+			{
+				image_free( DDS_data );
+				image_free( resampled );
+				return NULL;
+			}
+			memcpy( DDS_data + offset, block_data, block_data_size );
+			offset += block_data_size;
+			image_free( block_data );
+		}
+	}
+	image_free( resampled );
+	/*	describe it	*/
+	memset( header, 0, sizeof( DDS_header ) );
+	header->dwMagic = ('D' << 0) | ('D' << 8) | ('S' << 16) | (' ' << 24);
+	header->dwSize = 124;
+	header->dwFlags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_LINEARSIZE;
+	header->dwWidth = width;
+	header->dwHeight = height;
+	/*	the linear size is that of the top level only	*/
+	header->dwPitchOrLinearSize = ((width+3) >> 2) * ((height+3) >> 2) * block_size;
+	header->sPixelFormat.dwSize = 32;
+	header->sPixelFormat.dwFlags = DDPF_FOURCC;
+	if( block_size == 8 )
+	{
+		header->sPixelFormat.dwFourCC = ('D' << 0) | ('X' << 8) | ('T' << 16) | ('1' << 24);
+	} else
+	{
+		header->sPixelFormat.dwFourCC = ('D' << 0) | ('X' << 8) | ('T' << 16) | ('5' << 24);
+	}
+	header->sCaps.dwCaps1 = DDSCAPS_TEXTURE;
+	if( levels > 1 )
+	{
+		header->dwFlags |= DDSD_MIPMAPCOUNT;
+		header->dwMipMapCount = levels;
+		header->sCaps.dwCaps1 |= DDSCAPS_COMPLEX | DDSCAPS_MIPMAP;
+	}
+	if( faces == 6 )
+	{
+		header->sCaps.dwCaps1 |= DDSCAPS_COMPLEX;
+		header->sCaps.dwCaps2 = DDSCAPS2_CUBEMAP |
+			DDSCAPS2_CUBEMAP_POSITIVEX | DDSCAPS2_CUBEMAP_NEGATIVEX |
+			DDSCAPS2_CUBEMAP_POSITIVEY | DDSCAPS2_CUBEMAP_NEGATIVEY |
+			DDSCAPS2_CUBEMAP_POSITIVEZ | DDSCAPS2_CUBEMAP_NEGATIVEZ;
+	}
+	return DDS_data;
+}
+
+/*	1 face, or 6 square ones for a cubemap	*/
+static int
+	valid_DDS_texture
+	(
+		int width, int height, int channels, int faces,
+		const unsigned char *const data
+	)
+{
+	return (width >= 1) && (height >= 1) &&
+		(channels >= 1) && (channels <= 4) &&
+		((faces == 1) || ((faces == 6) && (width == height))) &&
+		(data != NULL);
+}
+
 /********* Actual Exposed Functions *********/
 int
 	save_image_as_DDS
@@ -46,61 +203,107 @@ int
 		int width, int height, int channels,
 		const unsigned char *const data
 	)
+{
+	return save_DDS_texture( filename, width, height, channels, 1, 0, data );
+}
+
+unsigned char*
+	save_image_as_DDS_to_memory
+	(
+		int width, int height, int channels,
+		const unsigned char *const data,
+		int *out_size
+	)
+{
+	return save_DDS_texture_to_memory( width, height, channels, 1, 0, data, out_size );
+}
+
+int
+	save_DDS_texture
+	(
+		const char *filename,
+		int width, int height, int channels,
+		int faces, int mipmaps,
+		const unsigned char *const data
+	)
 {
 	/*	variables	*/
 	FILE *fout;
 	unsigned char *DDS_data;
 	DDS_header header;
-	int DDS_size;
+	int DDS_size, ok;
 	/*	error check	*/
 	if( (NULL == filename) ||
-		(width < 1) || (height < 1) ||
-		(channels < 1) || (channels > 4) ||
-		(data == NULL ) )
+		!valid_DDS_texture( width, height, channels, faces, data ) )
 	{
 		return 0;
 	}
 	/*	Convert the image	*/
-	if( (channels & 1) == 1 )
+	DDS_data = compress_image_for_DDS( width, height, channels,
+			faces, mipmaps, data, &header, &DDS_size );
+	if( NULL == DDS_data )
 	{
-		/*	no alpha, just use DXT1	*/
-		DDS_data = convert_image_to_DXT1( data, width, height, channels, &DDS_size );
-	} else
-	{
-		/*	has alpha, so use DXT5	*/
-		DDS_data = convert_image_to_DXT5( data, width, height, channels, &DDS_size );
-	}
-	/*	save it	*/
-	memset( &header, 0, sizeof( DDS_header ) );
-	header.dwMagic = ('D' << 0) | ('D' << 8) | ('S' << 16) | (' ' << 24);
-	header.dwSize = 124;
-	header.dwFlags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_LINEARSIZE;
-	header.dwWidth = width;
-	header.dwHeight = height;
-	header.dwPitchOrLinearSize = DDS_size;
-	header.sPixelFormat.dwSize = 32;
-	header.sPixelFormat.dwFlags = DDPF_FOURCC;
-	if( (channels & 1) == 1 )
-	{
-		header.sPixelFormat.dwFourCC = ('D' << 0) | ('X' << 8) | ('T' << 16) | ('1' << 24);
-	} else
-	{
-		header.sPixelFormat.dwFourCC = ('D' << 0) | ('X' << 8) | ('T' << 16) | ('5' << 24);
+		return 0;
 	}
-	header.sCaps.dwCaps1 = DDSCAPS_TEXTURE;
 	/*	write it out	*/
 	fout = fopen( filename, "wb");
-	fwrite( &header, sizeof( DDS_header ), 1, fout );
-	fwrite( DDS_data, 1, DDS_size, fout );
-	fclose( fout );
+	if( NULL == fout )
+	{
+		image_free( DDS_data );
+		return 0;
+	}
+	ok = (fwrite( &header, sizeof( DDS_header ), 1, fout ) == 1) &&
+		(fwrite( DDS_data, 1, DDS_size, fout ) == (size_t)DDS_size);
+	if( fclose( fout ) != 0 )
+	{
+		ok = 0;
+	}
 	/*	done	*/
-	free( DDS_data );
-	return 1;
+	image_free( DDS_data );
+	return ok;
+}
+
+unsigned char*
+	save_DDS_texture_to_memory
+	(
+		int width, int height, int channels,
+		int faces, int mipmaps,
+		const unsigned char *const data,
+		int *out_size
+	)
+{
+	/*	variables	*/
+	unsigned char *DDS_data, *buffer;
+	DDS_header header;
+	int DDS_size;
+	/*	error check	*/
+	if( (NULL == out_size) ||
+		!valid_DDS_texture( width, height, channels, faces, data ) )
+	{
+		return NULL;
+	}
+	/*	Convert the image	*/
+	DDS_data = compress_image_for_DDS( width, height, channels,
+			faces, mipmaps, data, &header, &DDS_size );
+	if( NULL == DDS_data )
+	{
+		return NULL;
+	}
+	/*	header first, then the blocks	*/
+	buffer = (unsigned char*)image_malloc( sizeof( DDS_header ) + DDS_size );
+	if( NULL != buffer )
+	{
+		memcpy( buffer, &header, sizeof( DDS_header ) );
+		memcpy( buffer + sizeof( DDS_header ), DDS_data, DDS_size );
+		*out_size = (int)sizeof( DDS_header ) + DDS_size;
+	}
+	image_free( DDS_data );
+	return buffer;
 }
 
 unsigned char* convert_image_to_DXT1(
 		const unsigned char *const uncompressed,
-		int width, int height, int channels,
+		int width, int height, int channels, int stride,
 		int *out_size )
 {
 	unsigned char *compressed;
@@ -111,9 +314,14 @@ unsigned char* convert_image_to_DXT1(
 	int block_count = 0;
 	/*	error check	*/
 	*out_size = 0;
+	if( 0 == stride )
+	{
+		stride = width * channels;
+	}
 	if( (width < 1) || (height < 1) ||
 		(NULL == uncompressed) ||
-		(channels < 1) || (channels > 4) )
+		(channels < 1) || (channels > 4) ||
+		(stride < width * channels) )
 	{
 		return NULL;
 	}
@@ -125,7 +333,7 @@ unsigned char* convert_image_to_DXT1(
 	/*	get the RAM for the compressed image
 		(8 bytes per 4x4 pixel block)	*/
 	*out_size = ((width+3) >> 2) * ((height+3) >> 2) * 8;
-	compressed = (unsigned char*)malloc( *out_size );
+	compressed = (unsigned char*)image_malloc( *out_size );
 	/*	go through each block	*/
 	for( j = 0; j < height; j += 4 )
 	{
@@ -146,9 +354,9 @@ unsigned char* convert_image_to_DXT1(
 			{
 				for( x = 0; x < mx; ++x )
 				{
-					ublock[idx++] = uncompressed[(j+y)*width*channels+(i+x)*channels];
-					ublock[idx++] = uncompressed[(j+y)*width*channels+(i+x)*channels+chan_step];
-					ublock[idx++] = uncompressed[(j+y)*width*channels+(i+x)*channels+chan_step+chan_step];
+					ublock[idx++] = uncompressed[(j+y)*stride+(i+x)*channels];
+					ublock[idx++] = uncompressed[(j+y)*stride+(i+x)*channels+chan_step];
+					ublock[idx++] = uncompressed[(j+y)*stride+(i+x)*channels+chan_step+chan_step];
 				}
 				for( x = mx; x < 4; ++x )
 				{
@@ -181,7 +389,7 @@ unsigned char* convert_image_to_DXT1(
 
 unsigned char* convert_image_to_DXT5(
 		const unsigned char *const uncompressed,
-		int width, int height, int channels,
+		int width, int height, int channels, int stride,
 		int *out_size )
 {
 	unsigned char *compressed;
@@ -192,9 +400,14 @@ unsigned char* convert_image_to_DXT5(
 	int block_count = 0, has_alpha;
 	/*	error check	*/
 	*out_size = 0;
+	if( 0 == stride )
+	{
+		stride = width * channels;
+	}
 	if( (width < 1) || (height < 1) ||
 		(NULL == uncompressed) ||
-		(channels < 1) || ( channels > 4) )
+		(channels < 1) || ( channels > 4) ||
+		(stride < width * channels) )
 	{
 		return NULL;
 	}
@@ -208,7 +421,7 @@ unsigned char* convert_image_to_DXT5(
 	/*	get the RAM for the compressed image
 		(16 bytes per 4x4 pixel block)	*/
 	*out_size = ((width+3) >> 2) * ((height+3) >> 2) * 16;
-	compressed = (unsigned char*)malloc( *out_size );
+	compressed = (unsigned char*)image_malloc( *out_size );
 	/*	go through each block	*/
 	for( j = 0; j < height; j += 4 )
 	{
@@ -229,11 +442,11 @@ unsigned char* convert_image_to_DXT5(
 			{
 				for( x = 0; x < mx; ++x )
 				{
-					ublock[idx++] = uncompressed[(j+y)*width*channels+(i+x)*channels];
-					ublock[idx++] = uncompressed[(j+y)*width*channels+(i+x)*channels+chan_step];
-					ublock[idx++] = uncompressed[(j+y)*width*channels+(i+x)*channels+chan_step+chan_step];
+					ublock[idx++] = uncompressed[(j+y)*stride+(i+x)*channels];
+					ublock[idx++] = uncompressed[(j+y)*stride+(i+x)*channels+chan_step];
+					ublock[idx++] = uncompressed[(j+y)*stride+(i+x)*channels+chan_step+chan_step];
 					ublock[idx++] =
-						has_alpha * uncompressed[(j+y)*width*channels+(i+x)*channels+channels-1]
+						has_alpha * uncompressed[(j+y)*stride+(i+x)*channels+channels-1]
 						+ (1-has_alpha)*255;
 				}
 				for( x = mx; x < 4; ++x )
@@ -274,6 +487,124 @@ unsigned char* convert_image_to_DXT5(
 	return compressed;
 }
 
+unsigned char* convert_image_to_RGTC1(
+		const unsigned char *const uncompressed,
+		int width, int height, int channels, int stride,
+		int *out_size )
+{
+	unsigned char *compressed;
+	int i, j, x, y;
+	unsigned char ublock[16*4];
+	int index = 0;
+	/*	error check	*/
+	*out_size = 0;
+	if( 0 == stride )
+	{
+		stride = width * channels;
+	}
+	if( (width < 1) || (height < 1) ||
+		(NULL == uncompressed) ||
+		(channels < 1) || ( channels > 4) ||
+		(stride < width * channels) )
+	{
+		return NULL;
+	}
+	/*	get the RAM for the compressed image
+		(8 bytes per 4x4 pixel block)	*/
+	*out_size = ((width+3) >> 2) * ((height+3) >> 2) * 8;
+	compressed = (unsigned char*)image_malloc( *out_size );
+	/*	go through each block	*/
+	for( j = 0; j < height; j += 4 )
+	{
+		for( i = 0; i < width; i += 4 )
+		{
+			int mx = 4, my = 4;
+			if( j+4 >= height )
+			{
+				my = height - j;
+			}
+			if( i+4 >= width )
+			{
+				mx = width - i;
+			}
+			/*	the block compressor only looks at the 4th byte of each
+				pixel, so that is where the 1st channel goes	*/
+			for( y = 0; y < 4; ++y )
+			{
+				for( x = 0; x < 4; ++x )
+				{
+					ublock[(y*4+x)*4+3] = uncompressed[
+						(j+(y<my?y:0))*stride+(i+(x<mx?x:0))*channels];
+				}
+			}
+			compress_DDS_alpha_block( ublock, compressed + index );
+			index += 8;
+		}
+	}
+	return compressed;
+}
+
+unsigned char* convert_image_to_RGTC2(
+		const unsigned char *const uncompressed,
+		int width, int height, int channels, int stride,
+		int *out_size )
+{
+	unsigned char *compressed;
+	int i, j, x, y;
+	unsigned char ublock[16*4], vblock[16*4];
+	int index = 0, second;
+	/*	error check	*/
+	*out_size = 0;
+	if( 0 == stride )
+	{
+		stride = width * channels;
+	}
+	if( (width < 1) || (height < 1) ||
+		(NULL == uncompressed) ||
+		(channels < 1) || ( channels > 4) ||
+		(stride < width * channels) )
+	{
+		return NULL;
+	}
+	/*	luminance-alpha and RG(B(A)) both keep their 2nd channel,
+		a plain luminance image just gets it twice	*/
+	second = (channels > 1) ? 1 : 0;
+	/*	get the RAM for the compressed image
+		(16 bytes per 4x4 pixel block)	*/
+	*out_size = ((width+3) >> 2) * ((height+3) >> 2) * 16;
+	compressed = (unsigned char*)image_malloc( *out_size );
+	/*	go through each block	*/
+	for( j = 0; j < height; j += 4 )
+	{
+		for( i = 0; i < width; i += 4 )
+		{
+			int mx = 4, my = 4;
+			if( j+4 >= height )
+			{
+				my = height - j;
+			}
+			if( i+4 >= width )
+			{
+				mx = width - i;
+			}
+			for( y = 0; y < 4; ++y )
+			{
+				for( x = 0; x < 4; ++x )
+				{
+					int src = (j+(y<my?y:0))*stride+(i+(x<mx?x:0))*channels;
+					ublock[(y*4+x)*4+3] = uncompressed[src];
+					vblock[(y*4+x)*4+3] = uncompressed[src+second];
+				}
+			}
+			/*	red (or luminance) block first, then green (or alpha)	*/
+			compress_DDS_alpha_block( ublock, compressed + index );
+			compress_DDS_alpha_block( vblock, compressed + index + 8 );
+			index += 16;
+		}
+	}
+	return compressed;
+}
+
 /********* Helper Functions *********/
 int convert_bit_range( int c, int from_bits, int to_bits )
 {
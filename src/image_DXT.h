@@ -24,13 +24,59 @@ save_image_as_DDS
 );
 
 /**
-	take an image and convert it to DXT1 (no alpha)
+	Same as save_image_as_DDS, but the DDS file goes into a malloc'ed
+	buffer instead of onto disk.
+	\return NULL if failed, otherwise the buffer (*out_size bytes long)
+**/
+unsigned char*
+save_image_as_DDS_to_memory
+(
+    int width, int height, int channels,
+    const unsigned char *const data,
+    int *out_size
+);
+
+/**
+	Converts a texture to DXT1 or DXT5 and saves it to disk, ready to
+	be uploaded as-is.  faces is 1, or 6 for a cubemap, in which case
+	data holds the square faces one above the other in +X, -X, +Y, -Y,
+	+Z, -Z order.  If mipmaps is non-zero every face also gets its
+	complete MIPmap chain, down to 1x1.
+	\return 0 if failed, otherwise returns 1
+**/
+int
+save_DDS_texture
+(
+    const char *filename,
+    int width, int height, int channels,
+    int faces, int mipmaps,
+    const unsigned char *const data
+);
+
+/**
+	Same as save_DDS_texture, but the DDS file goes into a malloc'ed
+	buffer instead of onto disk.
+	\return NULL if failed, otherwise the buffer (*out_size bytes long)
+**/
+unsigned char*
+save_DDS_texture_to_memory
+(
+    int width, int height, int channels,
+    int faces, int mipmaps,
+    const unsigned char *const data,
+    int *out_size
+);
+
+/**
+	take an image and convert it to DXT1 (no alpha).
+	These 4 read the rows of uncompressed stride bytes
+	apart, or packed (width*channels) if stride is 0.
 **/
 unsigned char*
 convert_image_to_DXT1
 (
     const unsigned char *const uncompressed,
-    int width, int height, int channels,
+    int width, int height, int channels, int stride,
     int *out_size
 );
 
@@ -41,7 +87,32 @@ unsigned char*
 convert_image_to_DXT5
 (
     const unsigned char *const uncompressed,
-    int width, int height, int channels,
+    int width, int height, int channels, int stride,
+    int *out_size
+);
+
+/**
+	take an image and convert its 1st channel to RGTC1 (aka BC4 / ATI1,
+	also uploadable as LATC1), 8 bytes per 4x4 block
+**/
+unsigned char*
+convert_image_to_RGTC1
+(
+    const unsigned char *const uncompressed,
+    int width, int height, int channels, int stride,
+    int *out_size
+);
+
+/**
+	take an image and convert its first 2 channels (luminance & alpha for
+	a 2 channel image) to RGTC2 (aka BC5 / ATI2, also uploadable as LATC2),
+	16 bytes per 4x4 block
+**/
+unsigned char*
+convert_image_to_RGTC2
+(
+    const unsigned char *const uncompressed,
+    int width, int height, int channels, int stride,
     int *out_size
 );
 
@@ -85,6 +156,18 @@ typedef struct
 }
 DDS_header ;
 
+/**	the "DX10" extended header, which follows DDS_header
+	when sPixelFormat.dwFourCC is "DX10" **/
+typedef struct
+{
+    unsigned int    dxgiFormat;
+    unsigned int    resourceDimension;
+    unsigned int    miscFlag;
+    unsigned int    arraySize;
+    unsigned int    miscFlags2;
+}
+DDS_header_DXT10 ;
+
 /*	the following constants were copied directly off the MSDN website	*/
 
 /*	The dwFlags member of the original DDSURFACEDESC2 structure
@@ -120,4 +203,27 @@ DDS_header ;
 #define DDSCAPS2_CUBEMAP_NEGATIVEZ	0x00008000
 #define DDSCAPS2_VOLUME	0x00200000
 
+/*	DDS_header_DXT10 resourceDimension and miscFlag values	*/
+#define DDS_DIMENSION_TEXTURE2D	3
+#define DDS_DIMENSION_TEXTURE3D	4
+#define DDS_RESOURCE_MISC_TEXTURECUBE	0x00000004
+
+/*	the DXGI_FORMAT values I know what to do with	*/
+#define DXGI_FORMAT_R8G8B8A8_UNORM	28
+#define DXGI_FORMAT_BC1_UNORM	71
+#define DXGI_FORMAT_BC1_UNORM_SRGB	72
+#define DXGI_FORMAT_BC2_UNORM	74
+#define DXGI_FORMAT_BC2_UNORM_SRGB	75
+#define DXGI_FORMAT_BC3_UNORM	77
+#define DXGI_FORMAT_BC3_UNORM_SRGB	78
+#define DXGI_FORMAT_BC4_UNORM	80
+#define DXGI_FORMAT_BC4_SNORM	81
+#define DXGI_FORMAT_BC5_UNORM	83
+#define DXGI_FORMAT_BC5_SNORM	84
+#define DXGI_FORMAT_B8G8R8A8_UNORM	87
+#define DXGI_FORMAT_BC6H_UF16	95
+#define DXGI_FORMAT_BC6H_SF16	96
+#define DXGI_FORMAT_BC7_UNORM	98
+#define DXGI_FORMAT_BC7_UNORM_SRGB	99
+
 #endif /* HEADER_IMAGE_DXT	*/
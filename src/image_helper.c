@@ -8,164 +8,1667 @@
 
 #include "image_helper.h"
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 
-/*	Upscaling the image uses simple bilinear interpolation	*/
+/*	SSE2 code paths are compiled in when the target has it; define
+	SOIL_NO_SIMD to stick to plain C	*/
+#if !defined(SOIL_NO_SIMD) && \
+	(defined(__SSE2__) || defined(_M_X64) || \
+	(defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define IMAGE_HELPER_SSE2
+#include <emmintrin.h>
+#endif
+
+/*	the allocator, C's unless image_set_allocator was given another	*/
+static void*
+	default_malloc
+	(
+		void *user, size_t size
+	)
+{
+	(void)user;
+	return malloc( size );
+}
+
+static void*
+	default_realloc
+	(
+		void *user, void *pointer, size_t size
+	)
+{
+	(void)user;
+	return realloc( pointer, size );
+}
+
+static void
+	default_free
+	(
+		void *user, void *pointer
+	)
+{
+	(void)user;
+	free( pointer );
+}
+
+static image_malloc_func allocator_malloc = default_malloc;
+static image_realloc_func allocator_realloc = default_realloc;
+static image_free_func allocator_free = default_free;
+static void *allocator_user = NULL;
+
+/*	the scratch arena: between image_scratch_begin and image_scratch_end
+	a thread's allocations are bumped off a few big chunks, and all of
+	them go at once at the end.  Freeing the newest one gives it back
+	straight away, anything else just waits for the end.	*/
+#if defined(_MSC_VER)
+#define IMAGE_THREAD_LOCAL __declspec(thread)
+#elif defined(__GNUC__) || defined(__clang__)
+#define IMAGE_THREAD_LOCAL __thread
+#else
+#define IMAGE_THREAD_LOCAL _Thread_local
+#endif
+#define IMAGE_SCRATCH_ALIGN 16
+#define IMAGE_SCRATCH_ROUND(n) (((n) + IMAGE_SCRATCH_ALIGN - 1) & ~(size_t)(IMAGE_SCRATCH_ALIGN - 1))
+#define IMAGE_SCRATCH_MIN_CHUNK 65536
+
+typedef struct image_scratch_chunk
+{
+	struct image_scratch_chunk *next;
+	/*	where it really starts, before lining it up	*/
+	void *memory;
+	unsigned char *base;
+	size_t size, used;
+	int owned;
+} image_scratch_chunk;
+
+typedef struct
+{
+	/*	newest first; a chunk the user handed over is always last	*/
+	image_scratch_chunk *chunks;
+	/*	with no memory from the user, how much to hang on to	*/
+	size_t keep;
+	int enabled, depth;
+	/*	the newest allocation, the only one that can be given back	*/
+	unsigned char *last;
+} image_scratch;
+
+static IMAGE_THREAD_LOCAL image_scratch scratch;
+
+static image_scratch_chunk*
+	scratch_chunk
+	(
+		void *memory, size_t size, int owned
+	)
+{
+	/*	the chunk's own details live at the start of it	*/
+	const size_t header = IMAGE_SCRATCH_ROUND( sizeof(image_scratch_chunk) );
+	unsigned char *start = (unsigned char*)IMAGE_SCRATCH_ROUND( (size_t)memory );
+	image_scratch_chunk *chunk = (image_scratch_chunk*)start;
+	size -= start - (unsigned char*)memory;
+	if( size < header + 2 * IMAGE_SCRATCH_ALIGN )
+	{
+		return NULL;
+	}
+	chunk->next = NULL;
+	chunk->memory = memory;
+	chunk->base = start + header;
+	chunk->size = size - header;
+	chunk->used = 0;
+	chunk->owned = owned;
+	return chunk;
+}
+
+static void*
+	scratch_malloc
+	(
+		size_t size
+	)
+{
+	const size_t need = IMAGE_SCRATCH_ALIGN + IMAGE_SCRATCH_ROUND( size );
+	image_scratch_chunk *chunk = scratch.chunks;
+	unsigned char *p;
+	if( need < size )
+	{
+		return NULL;
+	}
+	if( (NULL == chunk) || (chunk->size - chunk->used < need) )
+	{
+		/*	out of room, so add a chunk (at least twice the last one)	*/
+		size_t chunk_size = need + 2 * IMAGE_SCRATCH_ROUND( sizeof(image_scratch_chunk) );
+		void *memory;
+		if( (NULL != chunk) && (chunk_size < 2 * chunk->size) )
+		{
+			chunk_size = 2 * chunk->size;
+		}
+		if( chunk_size < IMAGE_SCRATCH_MIN_CHUNK )
+		{
+			chunk_size = IMAGE_SCRATCH_MIN_CHUNK;
+		}
+		memory = allocator_malloc( allocator_user, chunk_size );
+		if( NULL == memory )
+		{
+			return NULL;
+		}
+		chunk = scratch_chunk( memory, chunk_size, 1 );
+		if( NULL == chunk )
+		{
+			allocator_free( allocator_user, memory );
+			return NULL;
+		}
+		chunk->next = scratch.chunks;
+		scratch.chunks = chunk;
+	}
+	/*	the size goes just in front, for realloc	*/
+	p = chunk->base + chunk->used;
+	*(size_t*)p = size;
+	chunk->used += need;
+	scratch.last = p + IMAGE_SCRATCH_ALIGN;
+	return scratch.last;
+}
+
+static int
+	scratch_owns
+	(
+		const void *pointer
+	)
+{
+	const image_scratch_chunk *chunk;
+	for( chunk = scratch.chunks; NULL != chunk; chunk = chunk->next )
+	{
+		if( ((const unsigned char*)pointer >= chunk->base) &&
+			((const unsigned char*)pointer < chunk->base + chunk->used) )
+		{
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static void
+	scratch_reset
+	(
+		void
+	)
+{
+	image_scratch_chunk *chunk = scratch.chunks, *users = NULL;
+	size_t total = 0;
+	int owned = 0;
+	for( ; NULL != chunk; chunk = chunk->next )
+	{
+		chunk->used = 0;
+		if( chunk->owned )
+		{
+			total += chunk->size;
+			++owned;
+		} else
+		{
+			users = chunk;
+		}
+	}
+	scratch.last = NULL;
+	if( (NULL == users) && (owned == 1) && (total <= scratch.keep) )
+	{
+		/*	it all fit in one, keep that for next time	*/
+		return;
+	}
+	/*	give back whatever I added...	*/
+	while( (NULL != scratch.chunks) && scratch.chunks->owned )
+	{
+		chunk = scratch.chunks;
+		scratch.chunks = chunk->next;
+		allocator_free( allocator_user, chunk->memory );
+	}
+	/*	...and if that's mine to size, make it one chunk big enough
+		for all of it (so next time there's nothing to allocate)	*/
+	if( (NULL == users) && (total > 0) && (scratch.keep > 0) )
+	{
+		size_t chunk_size = (total < scratch.keep) ? total : scratch.keep;
+		void *memory = allocator_malloc( allocator_user, chunk_size );
+		if( NULL != memory )
+		{
+			scratch.chunks = scratch_chunk( memory, chunk_size, 1 );
+			if( NULL == scratch.chunks )
+			{
+				allocator_free( allocator_user, memory );
+			}
+		}
+	}
+}
+
+int
+	image_scratch_set
+	(
+		void *memory, size_t size
+	)
+{
+	if( scratch.depth > 0 )
+	{
+		/*	not while it's being used	*/
+		return 0;
+	}
+	scratch.keep = 0;
+	scratch_reset();
+	scratch.chunks = NULL;
+	scratch.enabled = 0;
+	if( NULL != memory )
+	{
+		scratch.chunks = scratch_chunk( memory, size, 0 );
+		scratch.enabled = (NULL != scratch.chunks);
+		return scratch.enabled;
+	}
+	scratch.keep = size;
+	scratch.enabled = (size > 0);
+	return 1;
+}
+
+void
+	image_scratch_begin
+	(
+		void
+	)
+{
+	if( scratch.enabled )
+	{
+		++scratch.depth;
+	}
+}
+
+void
+	image_scratch_end
+	(
+		void
+	)
+{
+	if( scratch.enabled && (scratch.depth > 0) && (--scratch.depth == 0) )
+	{
+		scratch_reset();
+	}
+}
+
+static void*
+	scratch_realloc
+	(
+		void *pointer, size_t size
+	)
+{
+	unsigned char *p = (unsigned char*)pointer;
+	size_t old_size = *(size_t*)(p - IMAGE_SCRATCH_ALIGN);
+	void *moved;
+	if( p == scratch.last )
+	{
+		/*	the newest one can just grow (or shrink) where it is	*/
+		image_scratch_chunk *chunk = scratch.chunks;
+		size_t start = p - IMAGE_SCRATCH_ALIGN - chunk->base;
+		size_t need = IMAGE_SCRATCH_ALIGN + IMAGE_SCRATCH_ROUND( size );
+		if( (need >= size) && (chunk->size - start >= need) )
+		{
+			*(size_t*)(p - IMAGE_SCRATCH_ALIGN) = size;
+			chunk->used = start + need;
+			return p;
+		}
+	}
+	moved = scratch_malloc( size );
+	if( NULL != moved )
+	{
+		memcpy( moved, p, (old_size < size) ? old_size : size );
+	}
+	return moved;
+}
+
+void
+	image_set_allocator
+	(
+		image_malloc_func malloc_func,
+		image_realloc_func realloc_func,
+		image_free_func free_func,
+		void *user
+	)
+{
+	if( (NULL == malloc_func) || (NULL == realloc_func) || (NULL == free_func) )
+	{
+		malloc_func = default_malloc;
+		realloc_func = default_realloc;
+		free_func = default_free;
+		user = NULL;
+	}
+	allocator_malloc = malloc_func;
+	allocator_realloc = realloc_func;
+	allocator_free = free_func;
+	allocator_user = user;
+}
+
+void*
+	image_heap_malloc
+	(
+		size_t size
+	)
+{
+	return allocator_malloc( allocator_user, size );
+}
+
+void*
+	image_heap_calloc
+	(
+		size_t count, size_t size
+	)
+{
+	void *pointer;
+	if( (size != 0) && (count > (size_t)-1 / size) )
+	{
+		return NULL;
+	}
+	pointer = image_heap_malloc( count * size );
+	if( NULL != pointer )
+	{
+		memset( pointer, 0, count * size );
+	}
+	return pointer;
+}
+
+void*
+	image_heap_realloc
+	(
+		void *pointer, size_t size
+	)
+{
+	/*	so the user's realloc never has to handle NULL	*/
+	if( NULL == pointer )
+	{
+		return allocator_malloc( allocator_user, size );
+	}
+	return allocator_realloc( allocator_user, pointer, size );
+}
+
+void*
+	image_malloc
+	(
+		size_t size
+	)
+{
+	if( scratch.depth > 0 )
+	{
+		return scratch_malloc( size );
+	}
+	return allocator_malloc( allocator_user, size );
+}
+
+void*
+	image_calloc
+	(
+		size_t count, size_t size
+	)
+{
+	void *pointer;
+	if( (size != 0) && (count > (size_t)-1 / size) )
+	{
+		return NULL;
+	}
+	pointer = image_malloc( count * size );
+	if( NULL != pointer )
+	{
+		memset( pointer, 0, count * size );
+	}
+	return pointer;
+}
+
+void*
+	image_realloc
+	(
+		void *pointer, size_t size
+	)
+{
+	if( NULL == pointer )
+	{
+		return image_malloc( size );
+	}
+	if( (NULL != scratch.chunks) && scratch_owns( pointer ) )
+	{
+		return scratch_realloc( pointer, size );
+	}
+	return image_heap_realloc( pointer, size );
+}
+
+void
+	image_free
+	(
+		void *pointer
+	)
+{
+	if( NULL == pointer )
+	{
+		return;
+	}
+	if( (NULL != scratch.chunks) && scratch_owns( pointer ) )
+	{
+		/*	only the newest one actually goes back, the rest wait
+			for image_scratch_end	*/
+		if( (unsigned char*)pointer == scratch.last )
+		{
+			scratch.chunks->used = (unsigned char*)pointer -
+				IMAGE_SCRATCH_ALIGN - scratch.chunks->base;
+			scratch.last = NULL;
+		}
+		return;
+	}
+	allocator_free( allocator_user, pointer );
+}
+
+/*	splits rows [0,rows) up into jobs of rows_per_job rows, and runs them
+	on parallel_for's threads if there is one.  Every output row is worked
+	out on its own, so the result doesn't depend on who does which.	*/
+static void
+	run_row_jobs
+	(
+		int rows, int rows_per_job,
+		void (*body)( void *data, int job ), void *data,
+		resample_parallel_for parallel_for
+	)
+{
+	const int jobs = (rows + rows_per_job - 1) / rows_per_job;
+	int j;
+	if( (NULL != parallel_for) && (jobs > 1) )
+	{
+		parallel_for( jobs, body, data );
+	} else
+	{
+		for( j = 0; j < jobs; ++j )
+		{
+			body( data, j );
+		}
+	}
+}
+
+/*	enough output rows to a job that each reads a few dozen source rows,
+	which keeps the overhead down	*/
+static int
+	rows_per_job
+	(
+		int rows, int resampled_rows
+	)
+{
+	const int per_job = (int)((32.0 * resampled_rows + rows - 1) / rows);
+	return (per_job < 1) ? 1 : per_job;
+}
+
+/*	Upscaling the image uses simple bilinear interpolation, done in two
+	passes: each source row that is needed gets stretched horizontally
+	once (into 8.8 fixed point), then every output row is a blend of two
+	of those.  The x positions and weights are worked out up front.	*/
+static void
+	up_scale_row
+	(
+		const unsigned char* const orig_row,
+		int channels, int resampled_width,
+		const int* x_index, const int* x_next, const int* x_weight,
+		unsigned short* stretched
+	)
+{
+	int x, c;
+	for( x = 0; x < resampled_width; ++x )
+	{
+		const unsigned char* a = orig_row + x_index[x];
+		const unsigned char* b = a + x_next[x];
+		const int w = x_weight[x];
+		for( c = 0; c < channels; ++c )
+		{
+			*stretched++ = (unsigned short)((a[c] << 8) + (b[c] - a[c]) * w);
+		}
+	}
+}
+
+static void
+	up_scale_blend_rows
+	(
+		const unsigned short* row0, const unsigned short* row1,
+		int weight1, unsigned char* out, int count
+	)
+{
+	/*	out = row0 * (1 - w) + row1 * w, with w in 0.16 fixed point.
+		the SSE2 and plain versions round exactly the same way	*/
+	const unsigned int weight0 = 65536 - weight1;
+	const unsigned int weight1u = (unsigned int)weight1;
+	int i = 0;
+	if( weight1 == 0 )
+	{
+		/*	right on a source row, nothing to blend	*/
+#ifdef IMAGE_HELPER_SSE2
+		const __m128i half = _mm_set1_epi16( 128 );
+		for( ; i + 16 <= count; i += 16 )
+		{
+			__m128i lo = _mm_loadu_si128( (const __m128i*)(row0 + i) );
+			__m128i hi = _mm_loadu_si128( (const __m128i*)(row0 + i + 8) );
+			lo = _mm_srli_epi16( _mm_add_epi16( lo, half ), 8 );
+			hi = _mm_srli_epi16( _mm_add_epi16( hi, half ), 8 );
+			_mm_storeu_si128( (__m128i*)(out + i), _mm_packus_epi16( lo, hi ) );
+		}
+#endif
+		for( ; i < count; ++i )
+		{
+			out[i] = (unsigned char)((row0[i] + 128) >> 8);
+		}
+		return;
+	}
+#ifdef IMAGE_HELPER_SSE2
+	{
+		const __m128i w0 = _mm_set1_epi16( (short)weight0 );
+		const __m128i w1 = _mm_set1_epi16( (short)weight1 );
+		const __m128i half = _mm_set1_epi16( 128 );
+		for( ; i + 16 <= count; i += 16 )
+		{
+			__m128i lo = _mm_add_epi16(
+				_mm_mulhi_epu16( _mm_loadu_si128( (const __m128i*)(row0 + i) ), w0 ),
+				_mm_mulhi_epu16( _mm_loadu_si128( (const __m128i*)(row1 + i) ), w1 ) );
+			__m128i hi = _mm_add_epi16(
+				_mm_mulhi_epu16( _mm_loadu_si128( (const __m128i*)(row0 + i + 8) ), w0 ),
+				_mm_mulhi_epu16( _mm_loadu_si128( (const __m128i*)(row1 + i + 8) ), w1 ) );
+			lo = _mm_srli_epi16( _mm_add_epi16( lo, half ), 8 );
+			hi = _mm_srli_epi16( _mm_add_epi16( hi, half ), 8 );
+			_mm_storeu_si128( (__m128i*)(out + i), _mm_packus_epi16( lo, hi ) );
+		}
+	}
+#endif
+	for( ; i < count; ++i )
+	{
+		unsigned int value =
+			((row0[i] * weight0) >> 16) + ((row1[i] * weight1u) >> 16);
+		out[i] = (unsigned char)((value + 128) >> 8);
+	}
+}
+
+typedef struct
+{
+	const unsigned char *orig;
+	int width, height, channels, stride;
+	unsigned char *resampled;
+	int resampled_width, resampled_height;
+	const int *x_index, *x_next, *x_weight;
+	int rows_per_job;
+	unsigned char *failed;
+} up_scale_job;
+
+static void
+	up_scale_rows
+	(
+		void *data, int job
+	)
+{
+	const up_scale_job *s = (const up_scale_job*)data;
+	const int row_size = s->resampled_width * s->channels;
+	unsigned short *stretched_rows, *stretched[2];
+	int stretched_row[2] = { -1, -1 };
+	int y = job * s->rows_per_job;
+	int y_end = y + s->rows_per_job;
+	if( y_end > s->resampled_height )
+	{
+		y_end = s->resampled_height;
+	}
+	stretched_rows = (unsigned short*)image_malloc( 2 * row_size * sizeof(unsigned short) );
+	if( NULL == stretched_rows )
+	{
+		s->failed[job] = 1;
+		return;
+	}
+	stretched[0] = stretched_rows;
+	stretched[1] = stretched_rows + row_size;
+	for( ; y < y_end; ++y )
+	{
+		/* find the base y index and fractional offset from that	*/
+		unsigned int position = (unsigned int)y * (s->height - 1);
+		unsigned int remainder = position % (s->resampled_height - 1);
+		int inty = position / (s->resampled_height - 1);
+		int weight = (int)((remainder * 65536.0 + (s->resampled_height - 1) / 2) /
+			(s->resampled_height - 1));
+		if( weight == 65536 )
+		{
+			++inty;
+			weight = 0;
+		}
+		/*	each source row only gets stretched once: the one below
+			this output row is often the one above the next	*/
+		if( stretched_row[1] == inty )
+		{
+			unsigned short *temp = stretched[0];
+			stretched[0] = stretched[1];
+			stretched[1] = temp;
+			stretched_row[1] = stretched_row[0];
+			stretched_row[0] = inty;
+		}
+		if( stretched_row[0] != inty )
+		{
+			up_scale_row( s->orig + inty * s->stride, s->channels,
+				s->resampled_width, s->x_index, s->x_next, s->x_weight, stretched[0] );
+			stretched_row[0] = inty;
+		}
+		if( (weight > 0) && (stretched_row[1] != inty + 1) )
+		{
+			up_scale_row( s->orig + (inty + 1) * s->stride, s->channels,
+				s->resampled_width, s->x_index, s->x_next, s->x_weight, stretched[1] );
+			stretched_row[1] = inty + 1;
+		}
+		up_scale_blend_rows( stretched[0], stretched[1], weight,
+			s->resampled + y * row_size, row_size );
+	}
+	image_free( stretched_rows );
+}
+
 int
 	up_scale_image
 	(
-		const unsigned char* const orig,
-		int width, int height, int channels,
-		unsigned char* resampled,
-		int resampled_width, int resampled_height
+		const unsigned char* const orig,
+		int width, int height, int channels, int stride,
+		unsigned char* resampled,
+		int resampled_width, int resampled_height,
+		resample_parallel_for parallel_for
+	)
+{
+	up_scale_job job;
+	int *x_index, *x_next, *x_weight;
+	int x, jobs, ok = 1;
+
+	/*	0 means the rows are packed	*/
+	if( 0 == stride )
+	{
+		stride = width * channels;
+	}
+    /* error(s) check	*/
+    if ( 	(width < 1) || (height < 1) ||
+            (resampled_width < 2) || (resampled_height < 2) ||
+            (channels < 1) || (stride < width * channels) ||
+            (NULL == orig) || (NULL == resampled) )
+    {
+        /*	signify badness	*/
+        return 0;
+    }
+	job.rows_per_job = rows_per_job( height, resampled_height );
+	jobs = (resampled_height + job.rows_per_job - 1) / job.rows_per_job;
+	x_index = (int*)image_malloc( 3 * resampled_width * sizeof(int) );
+	job.failed = (unsigned char*)image_calloc( jobs, 1 );
+	if( (NULL == x_index) || (NULL == job.failed) )
+	{
+		image_free( x_index );
+		image_free( job.failed );
+		return 0;
+	}
+	x_next = x_index + resampled_width;
+	x_weight = x_next + resampled_width;
+    /*
+		for each given pixel in the new map, find the exact location
+		from the original map which would contribute to this guy:
+		x * (width-1) / (resampled_width-1), worked out in integers.
+		The last one lands right on the last source pixel.
+	*/
+	for( x = 0; x < resampled_width; ++x )
+	{
+		unsigned int position = (unsigned int)x * (width - 1);
+		unsigned int remainder = position % (resampled_width - 1);
+		int intx = position / (resampled_width - 1);
+		x_index[x] = intx * channels;
+		x_next[x] = (intx < width - 1) ? channels : 0;
+		x_weight[x] = (int)((remainder * 256.0 + (resampled_width - 1) / 2) /
+			(resampled_width - 1));
+	}
+	job.orig = orig;
+	job.width = width;
+	job.height = height;
+	job.channels = channels;
+	job.stride = stride;
+	job.resampled = resampled;
+	job.resampled_width = resampled_width;
+	job.resampled_height = resampled_height;
+	job.x_index = x_index;
+	job.x_next = x_next;
+	job.x_weight = x_weight;
+	run_row_jobs( resampled_height, job.rows_per_job, up_scale_rows, &job, parallel_for );
+	for( x = 0; x < jobs; ++x )
+	{
+		if( job.failed[x] )
+		{
+			ok = 0;
+		}
+	}
+	image_free( x_index );
+	image_free( job.failed );
+    /*	done	*/
+    return ok;
+}
+
+typedef struct
+{
+	const unsigned char *orig;
+	int width, height, channels, stride;
+	unsigned char *resampled;
+	int block_size_x, block_size_y;
+	int mip_width, mip_height;
+	int rows_per_job;
+} mipmap_job;
+
+static void
+	mipmap_rows
+	(
+		void *data, int job
+	)
+{
+	const mipmap_job *s = (const mipmap_job*)data;
+	const unsigned char* const orig = s->orig;
+	const int width = s->width, height = s->height, channels = s->channels;
+	const int stride = s->stride;
+	const int block_size_x = s->block_size_x, block_size_y = s->block_size_y;
+	const int mip_width = s->mip_width;
+	int i, c;
+	int j = job * s->rows_per_job;
+	int j_end = j + s->rows_per_job;
+	if( j_end > s->mip_height )
+	{
+		j_end = s->mip_height;
+	}
+	for( ; j < j_end; ++j )
+	{
+		for( i = 0; i < mip_width; ++i )
+		{
+			for( c = 0; c < channels; ++c )
+			{
+				const int index = (j*block_size_y)*stride + (i*block_size_x)*channels + c;
+				int sum_value;
+				int u,v;
+				int u_block = block_size_x;
+				int v_block = block_size_y;
+				int block_area;
+				/*	do a bit of checking so we don't over-run the boundaries
+					(necessary for non-square textures!)	*/
+				if( block_size_x * (i+1) > width )
+				{
+					u_block = width - i*block_size_y;
+				}
+				if( block_size_y * (j+1) > height )
+				{
+					v_block = height - j*block_size_y;
+				}
+				block_area = u_block*v_block;
+				/*	for this pixel, see what the average
+					of all the values in the block are.
+					note: start the sum at the rounding value, not at 0	*/
+				sum_value = block_area >> 1;
+				for( v = 0; v < v_block; ++v )
+				for( u = 0; u < u_block; ++u )
+				{
+					sum_value += orig[index + v*stride + u*channels];
+				}
+				s->resampled[j*mip_width*channels + i*channels + c] = sum_value / block_area;
+			}
+		}
+	}
+}
+
+int
+	mipmap_image
+	(
+		const unsigned char* const orig,
+		int width, int height, int channels, int stride,
+		unsigned char* resampled,
+		int block_size_x, int block_size_y,
+		resample_parallel_for parallel_for
+	)
+{
+	mipmap_job job;
+	int mip_width, mip_height;
+
+	/*	0 means the rows are packed	*/
+	if( 0 == stride )
+	{
+		stride = width * channels;
+	}
+	/*	error check	*/
+	if( (width < 1) || (height < 1) ||
+		(channels < 1) || (stride < width * channels) ||
+		(orig == NULL) || (resampled == NULL) ||
+		(block_size_x < 1) || (block_size_y < 1) )
+	{
+		/*	nothing to do	*/
+		return 0;
+	}
+	mip_width = width / block_size_x;
+	mip_height = height / block_size_y;
+	if( mip_width < 1 )
+	{
+		mip_width = 1;
+	}
+	if( mip_height < 1 )
+	{
+		mip_height = 1;
+	}
+	if( (width % block_size_x) || (height % block_size_y) )
+	{
+		/*	non-power-of-two, so the blocks don't line up with the pixels:
+			average exactly what each new pixel covers instead	*/
+		return area_scale_image( orig, width, height, channels, stride,
+				resampled, mip_width, mip_height, parallel_for );
+	}
+	job.orig = orig;
+	job.width = width;
+	job.height = height;
+	job.channels = channels;
+	job.stride = stride;
+	job.resampled = resampled;
+	job.block_size_x = block_size_x;
+	job.block_size_y = block_size_y;
+	job.mip_width = mip_width;
+	job.mip_height = mip_height;
+	job.rows_per_job = rows_per_job( height, mip_height );
+	run_row_jobs( mip_height, job.rows_per_job, mipmap_rows, &job, parallel_for );
+	return 1;
+}
+
+/*	for every new pixel along one axis: the first original pixel it
+	covers, how many it covers, and how much of each (in 1/new_size
+	original pixels, so a whole one is new_size)	*/
+static int
+	area_scale_axis
+	(
+		int size, int new_size,
+		int *first, int *count, unsigned int **weights, int *taps
+	)
+{
+	int i, j;
+	*taps = (size + new_size - 1) / new_size + 1;
+	*weights = (unsigned int*)image_malloc( new_size * *taps * sizeof(unsigned int) );
+	if( NULL == *weights )
+	{
+		return 0;
+	}
+	for( i = 0; i < new_size; ++i )
+	{
+		/*	this new pixel spans [i*size, (i+1)*size) in those units	*/
+		const unsigned int start = (unsigned int)i * size;
+		const unsigned int end = start + size;
+		first[i] = start / new_size;
+		count[i] = (end - 1) / new_size - first[i] + 1;
+		for( j = 0; j < count[i]; ++j )
+		{
+			unsigned int lo = (unsigned int)(first[i] + j) * new_size;
+			unsigned int hi = lo + new_size;
+			(*weights)[i * *taps + j] =
+				((hi < end) ? hi : end) - ((lo > start) ? lo : start);
+		}
+	}
+	return 1;
+}
+
+/*	the sRGB curve, both ways.  Decoding is a straight 256 entry table;
+	encoding compares against the linear value each byte starts at,
+	with a table on the top bits of the value to say where to start
+	looking (never more than a step or two, and always exact)	*/
+#define SRGB_GUESS_SIZE 4096
+typedef struct
+{
+	float to_linear[256];
+	float start[256];
+	unsigned char guess[SRGB_GUESS_SIZE + 1];
+} srgb_tables;
+
+static double
+	srgb_decode
+	(
+		double s
+	)
+{
+	return (s <= 0.04045) ? s / 12.92 : pow( (s + 0.055) / 1.055, 2.4 );
+}
+
+static void
+	srgb_build_tables
+	(
+		srgb_tables *t
+	)
+{
+	int i, b = 0;
+	for( i = 0; i < 256; ++i )
+	{
+		t->to_linear[i] = (float)srgb_decode( i / 255.0 );
+		t->start[i] = (i > 0) ? (float)srgb_decode( (i - 0.5) / 255.0 ) : 0.0f;
+	}
+	for( i = 0; i <= SRGB_GUESS_SIZE; ++i )
+	{
+		const float v = (float)i / SRGB_GUESS_SIZE;
+		while( (b < 255) && (v >= t->start[b + 1]) )
+		{
+			++b;
+		}
+		t->guess[i] = (unsigned char)b;
+	}
+}
+
+static unsigned char
+	srgb_encode
+	(
+		const srgb_tables *t, float v
+	)
+{
+	int b;
+	if( v <= 0.0f )
+	{
+		return 0;
+	}
+	if( v >= 1.0f )
+	{
+		return 255;
+	}
+	b = t->guess[(int)(v * SRGB_GUESS_SIZE)];
+	while( (b < 255) && (v >= t->start[b + 1]) )
+	{
+		++b;
+	}
+	return (unsigned char)b;
+}
+
+/*	what area_scale_image and srgb_scale_image share: the coverage of
+	each new column and row, worked out once for all of the jobs	*/
+typedef struct
+{
+	const unsigned char *orig;
+	int width, height, channels, stride;
+	unsigned char *resampled;
+	int resampled_width, resampled_height;
+	int *x_first, *x_count, *y_first, *y_count;
+	unsigned int *x_weights, *y_weights;
+	int x_taps, y_taps;
+	const srgb_tables *tables;
+	int rows_per_job;
+	unsigned char *failed;
+} area_scale_job;
+
+static int
+	area_scale_run
+	(
+		area_scale_job *job,
+		void (*rows)( void *data, int job ),
+		resample_parallel_for parallel_for
 	)
 {
-	float dx, dy;
-	int x, y, c;
+	const int resampled_width = job->resampled_width;
+	const int resampled_height = job->resampled_height;
+	int jobs, j, ok = 0;
+	job->rows_per_job = rows_per_job( job->height, resampled_height );
+	jobs = (resampled_height + job->rows_per_job - 1) / job->rows_per_job;
+	job->x_weights = job->y_weights = NULL;
+	job->x_first = (int*)image_malloc( 2 * (resampled_width + resampled_height) * sizeof(int) );
+	job->failed = (unsigned char*)image_calloc( jobs, 1 );
+	if( (NULL == job->x_first) || (NULL == job->failed) )
+	{
+		goto done;
+	}
+	job->x_count = job->x_first + resampled_width;
+	job->y_first = job->x_count + resampled_width;
+	job->y_count = job->y_first + resampled_height;
+	if( !area_scale_axis( job->width, resampled_width, job->x_first, job->x_count,
+			&job->x_weights, &job->x_taps ) ||
+		!area_scale_axis( job->height, resampled_height, job->y_first, job->y_count,
+			&job->y_weights, &job->y_taps ) )
+	{
+		goto done;
+	}
+	run_row_jobs( resampled_height, job->rows_per_job, rows, job, parallel_for );
+	ok = 1;
+	for( j = 0; j < jobs; ++j )
+	{
+		if( job->failed[j] )
+		{
+			ok = 0;
+		}
+	}
+done:
+	image_free( job->x_first );
+	image_free( job->x_weights );
+	image_free( job->y_weights );
+	image_free( job->failed );
+	return ok;
+}
 
-    /* error(s) check	*/
-    if ( 	(width < 1) || (height < 1) ||
-            (resampled_width < 2) || (resampled_height < 2) ||
-            (channels < 1) ||
-            (NULL == orig) || (NULL == resampled) )
-    {
-        /*	signify badness	*/
-        return 0;
-    }
-    /*
-		for each given pixel in the new map, find the exact location
-		from the original map which would contribute to this guy
-	*/
-    dx = (width - 1.0f) / (resampled_width - 1.0f);
-    dy = (height - 1.0f) / (resampled_height - 1.0f);
-    for ( y = 0; y < resampled_height; ++y )
-    {
-    	/* find the base y index and fractional offset from that	*/
-    	float sampley = y * dy;
-    	int inty = (int)sampley;
-    	/*	if( inty < 0 ) { inty = 0; } else	*/
-		if( inty > height - 2 ) { inty = height - 2; }
-		sampley -= inty;
-        for ( x = 0; x < resampled_width; ++x )
-        {
-			float samplex = x * dx;
-			int intx = (int)samplex;
-			int base_index;
-			/* find the base x index and fractional offset from that	*/
-			/*	if( intx < 0 ) { intx = 0; } else	*/
-			if( intx > width - 2 ) { intx = width - 2; }
-			samplex -= intx;
-			/*	base index into the original image	*/
-			base_index = (inty * width + intx) * channels;
-            for ( c = 0; c < channels; ++c )
-            {
-            	/*	do the sampling	*/
-				float value = 0.5f;
-				value += orig[base_index]
-							*(1.0f-samplex)*(1.0f-sampley);
-				value += orig[base_index+channels]
-							*(samplex)*(1.0f-sampley);
-				value += orig[base_index+width*channels]
-							*(1.0f-samplex)*(sampley);
-				value += orig[base_index+width*channels+channels]
-							*(samplex)*(sampley);
-				/*	move to the next channel	*/
-				++base_index;
-            	/*	save the new value	*/
-            	resampled[y*resampled_width*channels+x*channels+c] =
-						(unsigned char)(value);
-            }
-        }
-    }
-    /*	done	*/
-    return 1;
+static void
+	area_scale_rows
+	(
+		void *data, int job
+	)
+{
+	const area_scale_job *s = (const area_scale_job*)data;
+	const int channels = s->channels, width = s->width;
+	const int resampled_width = s->resampled_width;
+	const int row_size = resampled_width * channels;
+	unsigned int *row;
+	double *sum, total, half;
+	int x, c, k;
+	int y = job * s->rows_per_job;
+	int y_end = y + s->rows_per_job;
+	if( y_end > s->resampled_height )
+	{
+		y_end = s->resampled_height;
+	}
+	row = (unsigned int*)image_malloc( row_size * sizeof(unsigned int) );
+	sum = (double*)image_malloc( row_size * sizeof(double) );
+	if( (NULL == row) || (NULL == sum) )
+	{
+		s->failed[job] = 1;
+		image_free( row );
+		image_free( sum );
+		return;
+	}
+	/*	every new pixel is the average of width*height weighted pieces,
+		rounded the same way mipmap_image does it	*/
+	total = (double)width * s->height;
+	half = floor( total / 2.0 );
+	for( ; y < y_end; ++y )
+	{
+		unsigned char *out = s->resampled + y * row_size;
+		for( k = 0; k < row_size; ++k )
+		{
+			sum[k] = half;
+		}
+		for( k = 0; k < s->y_count[y]; ++k )
+		{
+			/*	squash one original row down to the new width...	*/
+			const unsigned char *in = s->orig + (s->y_first[y] + k) * s->stride;
+			const double wy = s->y_weights[y * s->y_taps + k];
+			unsigned int *r = row;
+			for( x = 0; x < resampled_width; ++x )
+			{
+				const unsigned char *p = in + s->x_first[x] * channels;
+				const unsigned int *wx = s->x_weights + x * s->x_taps;
+				for( c = 0; c < channels; ++c )
+				{
+					unsigned int acc = 0;
+					int j;
+					for( j = 0; j < s->x_count[x]; ++j )
+					{
+						acc += wx[j] * p[j * channels + c];
+					}
+					*r++ = acc;
+				}
+			}
+			/*	...and add in its share of this new row	*/
+			for( x = 0; x < row_size; ++x )
+			{
+				sum[x] += wy * row[x];
+			}
+		}
+		for( x = 0; x < row_size; ++x )
+		{
+			out[x] = (unsigned char)floor( sum[x] / total );
+		}
+	}
+	image_free( row );
+	image_free( sum );
 }
 
 int
-	mipmap_image
+	area_scale_image
 	(
 		const unsigned char* const orig,
-		int width, int height, int channels,
+		int width, int height, int channels, int stride,
 		unsigned char* resampled,
-		int block_size_x, int block_size_y
+		int resampled_width, int resampled_height,
+		resample_parallel_for parallel_for
 	)
 {
-	int mip_width, mip_height;
-	int i, j, c;
-
+	area_scale_job job;
+	/*	0 means the rows are packed	*/
+	if( 0 == stride )
+	{
+		stride = width * channels;
+	}
 	/*	error check	*/
 	if( (width < 1) || (height < 1) ||
-		(channels < 1) || (orig == NULL) ||
-		(resampled == NULL) ||
-		(block_size_x < 1) || (block_size_y < 1) )
+		(resampled_width < 1) || (resampled_height < 1) ||
+		(resampled_width > width) || (resampled_height > height) ||
+		(channels < 1) || (stride < width * channels) ||
+		(orig == NULL) || (resampled == NULL) )
 	{
 		/*	nothing to do	*/
 		return 0;
 	}
-	mip_width = width / block_size_x;
-	mip_height = height / block_size_y;
-	if( mip_width < 1 )
+	job.orig = orig;
+	job.width = width;
+	job.height = height;
+	job.channels = channels;
+	job.stride = stride;
+	job.resampled = resampled;
+	job.resampled_width = resampled_width;
+	job.resampled_height = resampled_height;
+	job.tables = NULL;
+	return area_scale_run( &job, area_scale_rows, parallel_for );
+}
+
+static void
+	srgb_scale_rows
+	(
+		void *data, int job
+	)
+{
+	const area_scale_job *s = (const area_scale_job*)data;
+	const srgb_tables *tables = s->tables;
+	const int channels = s->channels, width = s->width;
+	const int resampled_width = s->resampled_width;
+	const int row_size = resampled_width * channels;
+	const int alpha = ((channels == 2) || (channels == 4)) ? channels - 1 : -1;
+	const float scale = 1.0f / ((float)width * s->height);
+	float *line, *row, *sum;
+	int x, c, k;
+	int y = job * s->rows_per_job;
+	int y_end = y + s->rows_per_job;
+	if( y_end > s->resampled_height )
 	{
-		mip_width = 1;
+		y_end = s->resampled_height;
 	}
-	if( mip_height < 1 )
+	line = (float*)image_malloc( width * channels * sizeof(float) );
+	row = (float*)image_malloc( row_size * sizeof(float) );
+	sum = (float*)image_malloc( row_size * sizeof(float) );
+	if( (NULL == line) || (NULL == row) || (NULL == sum) )
 	{
-		mip_height = 1;
+		s->failed[job] = 1;
+		image_free( line );
+		image_free( row );
+		image_free( sum );
+		return;
 	}
-	for( j = 0; j < mip_height; ++j )
+	for( ; y < y_end; ++y )
 	{
-		for( i = 0; i < mip_width; ++i )
+		unsigned char *out = s->resampled + y * row_size;
+		for( x = 0; x < row_size; ++x )
 		{
-			for( c = 0; c < channels; ++c )
+			sum[x] = 0.0f;
+		}
+		for( k = 0; k < s->y_count[y]; ++k )
+		{
+			/*	take one original row to linear light...	*/
+			const unsigned char *in = s->orig + (s->y_first[y] + k) * s->stride;
+			const float wy = (float)s->y_weights[y * s->y_taps + k];
+			float *r = row;
+			for( x = 0; x < width * channels; x += channels )
 			{
-				const int index = (j*block_size_y)*width*channels + (i*block_size_x)*channels + c;
-				int sum_value;
-				int u,v;
-				int u_block = block_size_x;
-				int v_block = block_size_y;
-				int block_area;
-				/*	do a bit of checking so we don't over-run the boundaries
-					(necessary for non-square textures!)	*/
-				if( block_size_x * (i+1) > width )
+				for( c = 0; c < channels; ++c )
 				{
-					u_block = width - i*block_size_y;
+					line[x + c] = (c == alpha) ?
+						in[x + c] * (1.0f / 255.0f) :
+						tables->to_linear[in[x + c]];
 				}
-				if( block_size_y * (j+1) > height )
+			}
+			/*	...squash it down to the new width...	*/
+			for( x = 0; x < resampled_width; ++x )
+			{
+				const float *p = line + s->x_first[x] * channels;
+				const unsigned int *wx = s->x_weights + x * s->x_taps;
+				for( c = 0; c < channels; ++c )
 				{
-					v_block = height - j*block_size_y;
+					float acc = 0.0f;
+					int j;
+					for( j = 0; j < s->x_count[x]; ++j )
+					{
+						acc += (float)wx[j] * p[j * channels + c];
+					}
+					*r++ = acc;
 				}
-				block_area = u_block*v_block;
-				/*	for this pixel, see what the average
-					of all the values in the block are.
-					note: start the sum at the rounding value, not at 0	*/
-				sum_value = block_area >> 1;
-				for( v = 0; v < v_block; ++v )
-				for( u = 0; u < u_block; ++u )
+			}
+			/*	...and add in its share of this new row	*/
+			x = 0;
+#ifdef IMAGE_HELPER_SSE2
+			{
+				const __m128 w = _mm_set1_ps( wy );
+				for( ; x + 4 <= row_size; x += 4 )
 				{
-					sum_value += orig[index + v*width*channels + u*channels];
+					_mm_storeu_ps( sum + x, _mm_add_ps( _mm_loadu_ps( sum + x ),
+						_mm_mul_ps( w, _mm_loadu_ps( row + x ) ) ) );
 				}
-				resampled[j*mip_width*channels + i*channels + c] = sum_value / block_area;
 			}
+#endif
+			for( ; x < row_size; ++x )
+			{
+				sum[x] += wy * row[x];
+			}
+		}
+		/*	then back to bytes	*/
+		x = 0;
+#ifdef IMAGE_HELPER_SSE2
+		{
+			const __m128 s4 = _mm_set1_ps( scale );
+			for( ; x + 4 <= row_size; x += 4 )
+			{
+				_mm_storeu_ps( sum + x, _mm_mul_ps( _mm_loadu_ps( sum + x ), s4 ) );
+			}
+		}
+#endif
+		for( ; x < row_size; ++x )
+		{
+			sum[x] *= scale;
+		}
+		for( x = 0; x < row_size; x += channels )
+		{
+			for( c = 0; c < channels; ++c )
+			{
+				out[x + c] = (c == alpha) ?
+					(unsigned char)(sum[x + c] * 255.0f + 0.5f) :
+					srgb_encode( tables, sum[x + c] );
+			}
+		}
+	}
+	image_free( line );
+	image_free( row );
+	image_free( sum );
+}
+
+int
+	srgb_scale_image
+	(
+		const unsigned char* const orig,
+		int width, int height, int channels, int stride,
+		unsigned char* resampled,
+		int resampled_width, int resampled_height,
+		resample_parallel_for parallel_for
+	)
+{
+	/*	small enough to build on every call, which keeps it thread safe	*/
+	srgb_tables tables;
+	area_scale_job job;
+	/*	0 means the rows are packed	*/
+	if( 0 == stride )
+	{
+		stride = width * channels;
+	}
+	/*	error check	*/
+	if( (width < 1) || (height < 1) ||
+		(resampled_width < 1) || (resampled_height < 1) ||
+		(resampled_width > width) || (resampled_height > height) ||
+		(channels < 1) || (stride < width * channels) ||
+		(orig == NULL) || (resampled == NULL) )
+	{
+		/*	nothing to do	*/
+		return 0;
+	}
+	srgb_build_tables( &tables );
+	job.orig = orig;
+	job.width = width;
+	job.height = height;
+	job.channels = channels;
+	job.stride = stride;
+	job.resampled = resampled;
+	job.resampled_width = resampled_width;
+	job.resampled_height = resampled_height;
+	job.tables = &tables;
+	return area_scale_run( &job, srgb_scale_rows, parallel_for );
+}
+
+/*	the resampling filters, and how far out (in source pixels, at
+	1:1) each of them reaches	*/
+static double
+	resample_filter
+	(
+		int filter, double x
+	)
+{
+	if( x < 0.0 )
+	{
+		x = -x;
+	}
+	switch( filter )
+	{
+	case RESAMPLE_MITCHELL:
+		{
+			/*	B = C = 1/3	*/
+			const double B = 1.0 / 3.0, C = 1.0 / 3.0;
+			if( x < 1.0 )
+			{
+				return ((12.0 - 9.0*B - 6.0*C) * x*x*x
+					+ (-18.0 + 12.0*B + 6.0*C) * x*x
+					+ (6.0 - 2.0*B)) / 6.0;
+			}
+			if( x < 2.0 )
+			{
+				return ((-B - 6.0*C) * x*x*x
+					+ (6.0*B + 30.0*C) * x*x
+					+ (-12.0*B - 48.0*C) * x
+					+ (8.0*B + 24.0*C)) / 6.0;
+			}
+			return 0.0;
+		}
+	case RESAMPLE_LANCZOS3:
+		if( x < 1e-8 )
+		{
+			return 1.0;
+		}
+		if( x < 3.0 )
+		{
+			const double pi_x = 3.14159265358979323846 * x;
+			return 3.0 * sin( pi_x ) * sin( pi_x / 3.0 ) / (pi_x * pi_x);
+		}
+		return 0.0;
+	}
+	/*	box	*/
+	return (x < 0.5) ? 1.0 : 0.0;
+}
+
+static double
+	resample_filter_support
+	(
+		int filter
+	)
+{
+	switch( filter )
+	{
+	case RESAMPLE_MITCHELL:
+		return 2.0;
+	case RESAMPLE_LANCZOS3:
+		return 3.0;
+	}
+	return 0.5;
+}
+
+/*	weights are fixed point, with this many fractional bits (leaving room
+	for 8-bit pixels times the negative lobes in a signed 32-bit sum)	*/
+#define RESAMPLE_PRECISION_BITS 22
+
+/*	for every output pixel along one axis: the first source pixel it
+	reads, how many it reads, and their weights	*/
+typedef struct
+{
+	int taps;
+	int *first;
+	int *count;
+	int *weights;
+}
+resample_axis;
+
+static int
+	resample_axis_weights
+	(
+		resample_axis *axis, int in_size, int out_size, int filter
+	)
+{
+	const double scale = (double)in_size / out_size;
+	const double filter_scale = (scale > 1.0) ? scale : 1.0;
+	const double support = resample_filter_support( filter ) * filter_scale;
+	double *row_weights;
+	int i, j;
+	axis->taps = (int)ceil( support ) * 2 + 1;
+	axis->first = (int*)image_malloc( 2 * out_size * sizeof(int) );
+	axis->weights = (int*)image_malloc( out_size * axis->taps * sizeof(int) );
+	row_weights = (double*)image_malloc( axis->taps * sizeof(double) );
+	if( (NULL == axis->first) || (NULL == axis->weights) || (NULL == row_weights) )
+	{
+		image_free( axis->first );
+		image_free( axis->weights );
+		image_free( row_weights );
+		axis->first = axis->weights = NULL;
+		return 0;
+	}
+	axis->count = axis->first + out_size;
+	for( i = 0; i < out_size; ++i )
+	{
+		const double center = (i + 0.5) * scale;
+		double total = 0.0;
+		int first = (int)(center - support + 0.5);
+		int last = (int)(center + support + 0.5);
+		if( first < 0 )
+		{
+			first = 0;
+		}
+		if( last > in_size )
+		{
+			last = in_size;
+		}
+		if( last - first > axis->taps )
+		{
+			last = first + axis->taps;
+		}
+		for( j = first; j < last; ++j )
+		{
+			row_weights[j - first] =
+				resample_filter( filter, (j - center + 0.5) / filter_scale );
+			total += row_weights[j - first];
+		}
+		if( total == 0.0 )
+		{
+			/*	too narrow to hit anything, take the nearest pixel	*/
+			first = (int)center;
+			if( first >= in_size )
+			{
+				first = in_size - 1;
+			}
+			last = first + 1;
+			row_weights[0] = total = 1.0;
+		}
+		axis->first[i] = first;
+		axis->count[i] = last - first;
+		for( j = 0; j < last - first; ++j )
+		{
+			double w = row_weights[j] / total;
+			axis->weights[i * axis->taps + j] = (int)floor(
+				w * (1 << RESAMPLE_PRECISION_BITS) + 0.5 );
 		}
 	}
+	image_free( row_weights );
 	return 1;
 }
 
+static unsigned char
+	resample_clamp
+	(
+		int sum
+	)
+{
+	sum >>= RESAMPLE_PRECISION_BITS;
+	return (unsigned char)((sum < 0) ? 0 : ((sum > 255) ? 255 : sum));
+}
+
+/*	what each pass needs, and how the rows get split up between threads	*/
+typedef struct
+{
+	const unsigned char *in;
+	unsigned char *out;
+	int in_width, out_width, rows, channels;
+	int in_stride;
+	const resample_axis *axis;
+	int rows_per_job;
+}
+resample_pass;
+
+static void
+	resample_horizontal_rows
+	(
+		void *data, int job
+	)
+{
+	const resample_pass *pass = (const resample_pass*)data;
+	const int channels = pass->channels;
+	int y = job * pass->rows_per_job;
+	int y_end = y + pass->rows_per_job;
+	if( y_end > pass->rows )
+	{
+		y_end = pass->rows;
+	}
+	for( ; y < y_end; ++y )
+	{
+		const unsigned char *in_row = pass->in + y * pass->in_stride;
+		unsigned char *out = pass->out + y * pass->out_width * channels;
+		int x, c, k;
+		for( x = 0; x < pass->out_width; ++x )
+		{
+			const unsigned char *in = in_row + pass->axis->first[x] * channels;
+			const int *w = pass->axis->weights + x * pass->axis->taps;
+			const int count = pass->axis->count[x];
+			for( c = 0; c < channels; ++c )
+			{
+				int sum = 1 << (RESAMPLE_PRECISION_BITS - 1);
+				for( k = 0; k < count; ++k )
+				{
+					sum += in[k * channels + c] * w[k];
+				}
+				*out++ = resample_clamp( sum );
+			}
+		}
+	}
+}
+
+static void
+	resample_vertical_rows
+	(
+		void *data, int job
+	)
+{
+	const resample_pass *pass = (const resample_pass*)data;
+	const int row_size = pass->in_width * pass->channels;
+	const int in_stride = pass->in_stride;
+	int y = job * pass->rows_per_job;
+	int y_end = y + pass->rows_per_job;
+	if( y_end > pass->rows )
+	{
+		y_end = pass->rows;
+	}
+	for( ; y < y_end; ++y )
+	{
+		const unsigned char *in = pass->in + pass->axis->first[y] * in_stride;
+		unsigned char *out = pass->out + y * row_size;
+		const int *w = pass->axis->weights + y * pass->axis->taps;
+		const int count = pass->axis->count[y];
+		int i, k;
+		for( i = 0; i < row_size; ++i )
+		{
+			int sum = 1 << (RESAMPLE_PRECISION_BITS - 1);
+			for( k = 0; k < count; ++k )
+			{
+				sum += in[k * in_stride + i] * w[k];
+			}
+			out[i] = resample_clamp( sum );
+		}
+	}
+}
+
+static void
+	resample_run
+	(
+		resample_pass *pass, void (*rows)(void*, int),
+		resample_parallel_for parallel_for
+	)
+{
+	pass->rows_per_job = 32;
+	run_row_jobs( pass->rows, pass->rows_per_job, rows, pass, parallel_for );
+}
+
+int
+	resample_image
+	(
+		const unsigned char* const orig,
+		int width, int height, int channels, int stride,
+		unsigned char* resampled,
+		int resampled_width, int resampled_height,
+		int filter,
+		resample_parallel_for parallel_for
+	)
+{
+	resample_axis x_axis, y_axis;
+	resample_pass pass;
+	unsigned char *between = NULL;
+	int ok = 0;
+	/*	0 means the rows are packed	*/
+	if( 0 == stride )
+	{
+		stride = width * channels;
+	}
+	/*	error check	*/
+	if( (width < 1) || (height < 1) ||
+		(resampled_width < 1) || (resampled_height < 1) ||
+		(channels < 1) || (stride < width * channels) ||
+		(orig == NULL) || (resampled == NULL) )
+	{
+		/*	nothing to do	*/
+		return 0;
+	}
+	if( !resample_axis_weights( &x_axis, width, resampled_width, filter ) )
+	{
+		return 0;
+	}
+	if( !resample_axis_weights( &y_axis, height, resampled_height, filter ) )
+	{
+		image_free( x_axis.first );
+		image_free( x_axis.weights );
+		return 0;
+	}
+	pass.channels = channels;
+	/*	go across first, then down (through a resampled_width x height
+		image), or the other way around: whichever is less work	*/
+	if( (double)resampled_width * height * x_axis.taps +
+		(double)resampled_width * resampled_height * y_axis.taps <=
+		(double)width * resampled_height * y_axis.taps +
+		(double)resampled_width * resampled_height * x_axis.taps )
+	{
+		between = (unsigned char*)image_malloc( resampled_width * height * channels );
+		if( NULL != between )
+		{
+			pass.in = orig;
+			pass.out = between;
+			pass.in_width = width;
+			pass.in_stride = stride;
+			pass.out_width = resampled_width;
+			pass.rows = height;
+			pass.axis = &x_axis;
+			resample_run( &pass, resample_horizontal_rows, parallel_for );
+			pass.in = between;
+			pass.out = resampled;
+			pass.in_width = resampled_width;
+			pass.in_stride = resampled_width * channels;
+			pass.rows = resampled_height;
+			pass.axis = &y_axis;
+			resample_run( &pass, resample_vertical_rows, parallel_for );
+			ok = 1;
+		}
+	} else
+	{
+		between = (unsigned char*)image_malloc( width * resampled_height * channels );
+		if( NULL != between )
+		{
+			pass.in = orig;
+			pass.out = between;
+			pass.in_width = width;
+			pass.in_stride = stride;
+			pass.rows = resampled_height;
+			pass.axis = &y_axis;
+			resample_run( &pass, resample_vertical_rows, parallel_for );
+			pass.in = between;
+			pass.out = resampled;
+			pass.in_width = width;
+			pass.in_stride = width * channels;
+			pass.out_width = resampled_width;
+			pass.rows = resampled_height;
+			pass.axis = &x_axis;
+			resample_run( &pass, resample_horizontal_rows, parallel_for );
+			ok = 1;
+		}
+	}
+	image_free( between );
+	image_free( x_axis.first );
+	image_free( x_axis.weights );
+	image_free( y_axis.first );
+	image_free( y_axis.weights );
+	return ok;
+}
+
 int
 	scale_image_RGB_to_NTSC_safe
 	(
 		unsigned char* orig,
-		int width, int height, int channels
+		int width, int height, int channels, int stride
 	)
 {
 	const float scale_lo = 16.0f - 0.499f;
 	const float scale_hi = 235.0f + 0.499f;
-	int i, j;
+	int i, j, y;
 	int nc = channels;
 	unsigned char scale_LUT[256];
+	/*	0 means the rows are packed	*/
+	if( 0 == stride )
+	{
+		stride = width * channels;
+	}
 	/*	error check	*/
 	if( (width < 1) || (height < 1) ||
-		(channels < 1) || (orig == NULL) )
+		(channels < 1) || (stride < width * channels) ||
+		(orig == NULL) )
 	{
 		/*	nothing to do	*/
 		return 0;
@@ -178,7 +1681,8 @@ int
 	/*	for channels = 2 or 4, ignore the alpha component	*/
 	nc -= 1 - (channels & 1);
 	/*	OK, go through the image and scale any non-alpha components	*/
-	for( i = 0; i < width*height*channels; i += channels )
+	for( y = 0; y < height; ++y, orig += stride )
+	for( i = 0; i < width*channels; i += channels )
 	{
 		for( j = 0; j < nc; ++j )
 		{
@@ -201,14 +1705,19 @@ int
 	convert_RGB_to_YCoCg
 	(
 		unsigned char* orig,
-		int width, int height, int channels
+		int width, int height, int channels, int stride
 	)
 {
-	int i;
+	int i, y;
+	/*	0 means the rows are packed	*/
+	if( 0 == stride )
+	{
+		stride = width * channels;
+	}
 	/*	error check	*/
 	if( (width < 1) || (height < 1) ||
 		(channels < 3) || (channels > 4) ||
-		(orig == NULL) )
+		(stride < width * channels) || (orig == NULL) )
 	{
 		/*	nothing to do	*/
 		return -1;
@@ -216,7 +1725,8 @@ int
 	/*	do the conversion	*/
 	if( channels == 3 )
 	{
-		for( i = 0; i < width*height*3; i += 3 )
+		for( y = 0; y < height; ++y, orig += stride )
+		for( i = 0; i < width*3; i += 3 )
 		{
 			int r = orig[i+0];
 			int g = (orig[i+1] + 1) >> 1;
@@ -231,7 +1741,8 @@ int
 		}
 	} else
 	{
-		for( i = 0; i < width*height*4; i += 4 )
+		for( y = 0; y < height; ++y, orig += stride )
+		for( i = 0; i < width*4; i += 4 )
 		{
 			int r = orig[i+0];
 			int g = (orig[i+1] + 1) >> 1;
@@ -260,14 +1771,19 @@ int
 	convert_YCoCg_to_RGB
 	(
 		unsigned char* orig,
-		int width, int height, int channels
+		int width, int height, int channels, int stride
 	)
 {
-	int i;
+	int i, y;
+	/*	0 means the rows are packed	*/
+	if( 0 == stride )
+	{
+		stride = width * channels;
+	}
 	/*	error check	*/
 	if( (width < 1) || (height < 1) ||
 		(channels < 3) || (channels > 4) ||
-		(orig == NULL) )
+		(stride < width * channels) || (orig == NULL) )
 	{
 		/*	nothing to do	*/
 		return -1;
@@ -275,7 +1791,8 @@ int
 	/*	do the conversion	*/
 	if( channels == 3 )
 	{
-		for( i = 0; i < width*height*3; i += 3 )
+		for( y = 0; y < height; ++y, orig += stride )
+		for( i = 0; i < width*3; i += 3 )
 		{
 			int co = orig[i+0] - 128;
 			int y  = orig[i+1];
@@ -289,7 +1806,8 @@ int
 		}
 	} else
 	{
-		for( i = 0; i < width*height*4; i += 4 )
+		for( y = 0; y < height; ++y, orig += stride )
+		for( i = 0; i < width*4; i += 4 )
 		{
 			int co = orig[i+0] - 128;
 			int cg = orig[i+1] - 128;
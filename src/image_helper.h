@@ -9,38 +9,152 @@
 #ifndef HEADER_IMAGE_HELPER
 #define HEADER_IMAGE_HELPER
 
+#include <stddef.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/**
+	Where all of the memory comes from: SOIL, stb_image, image_DXT and
+	these helpers all go through image_malloc & co.  Until
+	image_set_allocator says otherwise that is malloc, realloc and free
+	(passing any NULL puts those back).
+**/
+typedef void* (*image_malloc_func)( void *user, size_t size );
+typedef void* (*image_realloc_func)( void *user, void *pointer, size_t size );
+typedef void (*image_free_func)( void *user, void *pointer );
+void
+	image_set_allocator
+	(
+		image_malloc_func malloc_func,
+		image_realloc_func realloc_func,
+		image_free_func free_func,
+		void *user
+	);
+void* image_malloc( size_t size );
+void* image_calloc( size_t count, size_t size );
+void* image_realloc( void *pointer, size_t size );
+void image_free( void *pointer );
+
+/**
+	A scratch arena for the memory that only lasts one load.  Once a
+	thread has one (image_scratch_set: memory and its size, or NULL
+	and how much it may keep between loads, or NULL and 0 for none),
+	image_malloc & co. between image_scratch_begin and the matching
+	image_scratch_end come out of it, and it all goes back at the end.
+	Anything that has to outlive that uses the image_heap_ versions
+	instead, and so does anything freed on another thread.
+**/
+int image_scratch_set( void *memory, size_t size );
+void image_scratch_begin( void );
+void image_scratch_end( void );
+void* image_heap_malloc( size_t size );
+void* image_heap_calloc( size_t count, size_t size );
+void* image_heap_realloc( void *pointer, size_t size );
+
+/**
+	Runs body(data, i) for every i in [0,count), possibly at the same
+	time on several threads, and returns once they are all done.
+**/
+typedef void (*resample_parallel_for)( int count, void (*body)( void *data, int index ), void *data );
+
 /**
 	This function upscales an image.
 	Not to be used to create MIPmaps,
 	but to make it square,
 	or to make it a power-of-two sized.
+	(All of the scaling functions below split the output
+	rows up between parallel_for's threads, if it isn't
+	NULL; the result is the same either way.  They read
+	orig's rows stride bytes apart, 0 meaning packed, so
+	orig can be a piece of a bigger image; resampled is
+	always packed.)
 **/
 int
 	up_scale_image
 	(
 		const unsigned char* const orig,
-		int width, int height, int channels,
+		int width, int height, int channels, int stride,
 		unsigned char* resampled,
-		int resampled_width, int resampled_height
+		int resampled_width, int resampled_height,
+		resample_parallel_for parallel_for
 	);
 
 /**
 	This function downscales an image.
-	Used for creating MIPmaps,
-	the incoming image should be a
-	power-of-two sized.
+	Used for creating MIPmaps: the new
+	size is size/block_size, rounded down.
+	If the blocks don't fit the image
+	evenly (non-power-of-two) it falls
+	back on area_scale_image.
 **/
 int
 	mipmap_image
 	(
 		const unsigned char* const orig,
-		int width, int height, int channels,
+		int width, int height, int channels, int stride,
+		unsigned char* resampled,
+		int block_size_x, int block_size_y,
+		resample_parallel_for parallel_for
+	);
+
+/**
+	This function downscales an image to any smaller size, each new
+	pixel being the exact average of the part of the original it
+	covers.  Used for the MIPmaps of non-power-of-two images, where
+	each level is floor(size/2) and the blocks don't line up (for
+	power-of-two images it gives the same result as mipmap_image).
+**/
+int
+	area_scale_image
+	(
+		const unsigned char* const orig,
+		int width, int height, int channels, int stride,
+		unsigned char* resampled,
+		int resampled_width, int resampled_height,
+		resample_parallel_for parallel_for
+	);
+
+/**
+	The same as area_scale_image, but for sRGB encoded color: the
+	colors are averaged as linear light, not as the gamma encoded
+	bytes (which darkens them), then encoded back.  With 2 or 4
+	channels the last one is alpha, which is linear already.
+**/
+int
+	srgb_scale_image
+	(
+		const unsigned char* const orig,
+		int width, int height, int channels, int stride,
+		unsigned char* resampled,
+		int resampled_width, int resampled_height,
+		resample_parallel_for parallel_for
+	);
+
+/**	the filters resample_image can use	**/
+enum
+{
+	RESAMPLE_BOX = 0,
+	RESAMPLE_MITCHELL = 1,
+	RESAMPLE_LANCZOS3 = 2
+};
+
+/**
+	This function resizes an image to any size, up or down, in one
+	pass with a proper filter: box, Mitchell or Lanczos3.  The weights
+	for every row and column are worked out once, and the two directions
+	are done separately.
+**/
+int
+	resample_image
+	(
+		const unsigned char* const orig,
+		int width, int height, int channels, int stride,
 		unsigned char* resampled,
-		int block_size_x, int block_size_y
+		int resampled_width, int resampled_height,
+		int filter,
+		resample_parallel_for parallel_for
 	);
 
 /**
@@ -49,12 +163,14 @@ int
 	This makes the colors "Safe" for display on NTSC
 	displays.  Note that this is _NOT_ a good idea for
 	loading images like normal- or height-maps!
+	(This and the YCoCg conversions work in place, on rows
+	stride bytes apart, 0 meaning packed.)
 **/
 int
 	scale_image_RGB_to_NTSC_safe
 	(
 		unsigned char* orig,
-		int width, int height, int channels
+		int width, int height, int channels, int stride
 	);
 
 /**
@@ -68,7 +184,7 @@ int
 	convert_RGB_to_YCoCg
 	(
 		unsigned char* orig,
-		int width, int height, int channels
+		int width, int height, int channels, int stride
 	);
 
 /**
@@ -79,7 +195,7 @@ int
 	convert_YCoCg_to_RGB
 	(
 		unsigned char* orig,
-		int width, int height, int channels
+		int width, int height, int channels, int stride
 	);
 
 /**
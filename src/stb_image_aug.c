@@ -11,14 +11,11 @@
       TGA (not sure what subset, if a subset)
       PSD (composited view only, no extra channels)
       HDR (radiance rgbE format)
-      writes BMP,TGA (define STBI_NO_WRITE to remove code)
+      writes BMP,TGA,PNG (define STBI_NO_WRITE to remove code)
       decoded from memory or through stdio FILE (define STBI_NO_STDIO to remove
    code) supports installable dequantizing-IDCT, YCbCr-to-RGB conversion (define
    STBI_SIMD)
 
-   TODO:
-      stbi_info_*
-
    history:
       1.16   major bugfix - convert_format converted one too many pixels
       1.15   initialize some fields for thread safety
@@ -76,6 +73,12 @@
 #include <stdarg.h>
 #include <stdlib.h>
 
+// all memory comes from SOIL's allocator (see SOIL_set_allocator)
+#include "image_helper.h"
+#define STBI_MALLOC(sz) image_malloc(sz)
+#define STBI_REALLOC(p, sz) image_realloc(p, sz)
+#define STBI_FREE(p) image_free(p)
+
 
 #ifndef _MSC_VER
 #ifdef __cplusplus
@@ -92,10 +95,24 @@ typedef signed short int16;
 typedef unsigned int uint32;
 typedef signed int int32;
 typedef unsigned int uint;
+#ifdef _MSC_VER
+typedef unsigned __int64 uint64;
+#else
+typedef unsigned long long uint64;
+#endif
 
 // should produce compiler error if size is wrong
 typedef unsigned char validate_uint32[sizeof(uint32) == 4];
 
+// SSE2 code paths are compiled in when the target has it; define
+// STBI_NO_SIMD to stick to plain C (unrelated to STBI_SIMD below)
+#if !defined(STBI_NO_SIMD) &&                                                  \
+    (defined(__SSE2__) || defined(_M_X64) ||                                   \
+     (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define STBI_SSE2
+#include <emmintrin.h>
+#endif
+
 #if defined(STBI_NO_STDIO) && !defined(STBI_NO_WRITE)
 #define STBI_NO_WRITE
 #endif
@@ -112,8 +129,18 @@ typedef unsigned char validate_uint32[sizeof(uint32) == 4];
 // Generic API that works on all image types
 //
 
-// this is not threadsafe
-static char *failure_reason;
+// one per thread, so decodes running side by side (SOIL decodes texture
+// array layers that way) each keep their own
+#ifndef STBI_THREAD_LOCAL
+#if defined(_MSC_VER)
+#define STBI_THREAD_LOCAL __declspec(thread)
+#elif defined(__GNUC__)
+#define STBI_THREAD_LOCAL __thread
+#else
+#define STBI_THREAD_LOCAL
+#endif
+#endif
+static STBI_THREAD_LOCAL char *failure_reason;
 
 char *stbi_failure_reason(void) { return failure_reason; }
 
@@ -134,7 +161,15 @@ static int e(char *str) {
 #define epuc(x, y) ((unsigned char *)(e(x, y) ? NULL : NULL))
 
 void stbi_image_free(void *retval_from_stbi_load) {
-  free(retval_from_stbi_load);
+  STBI_FREE(retval_from_stbi_load);
+}
+
+// does an x*y image of n components, rows stride bytes apart, fit in
+// out_size bytes?
+static int fits_into(int x, int y, int n, int out_size, int stride) {
+  if (x < 1 || y < 1 || stride < x * n || out_size < x * n)
+    return 0;
+  return y - 1 <= (out_size - x * n) / stride;
 }
 
 #define MAX_LOADERS 32
@@ -158,6 +193,25 @@ int stbi_register_loader(stbi_loader *loader) {
   return 0;
 }
 
+static stbi_parallel_for parallel_for_installed;
+static void *parallel_for_context;
+
+void stbi_install_parallel_for(stbi_parallel_for func, void *context) {
+  parallel_for_installed = func;
+  parallel_for_context = context;
+}
+
+// runs body(data, 0..count-1), on the installed threads if there are any
+static void stbi_run_parallel(int count, stbi_parallel_body body, void *data) {
+  int i;
+  if (parallel_for_installed && count > 1) {
+    parallel_for_installed(parallel_for_context, count, body, data);
+    return;
+  }
+  for (i = 0; i < count; ++i)
+    body(data, i);
+}
+
 #ifndef STBI_NO_HDR
 static float *ldr_to_hdr(stbi_uc *data, int x, int y, int comp);
 static stbi_uc *hdr_to_ldr(float *data, int x, int y, int comp);
@@ -310,14 +364,6 @@ extern int stbi_is_hdr_from_file(FILE *f) {
 
 #endif
 
-// @TODO: get image dimensions & components without fully decoding
-#ifndef STBI_NO_STDIO
-extern int stbi_info(char const *filename, int *x, int *y, int *comp);
-extern int stbi_info_from_file(FILE *f, int *x, int *y, int *comp);
-#endif
-extern int stbi_info_from_memory(stbi_uc const *buffer, int len, int *x, int *y,
-                                 int *comp);
-
 #ifndef STBI_NO_HDR
 static float h2l_gamma_i = 1.0f / 2.2f, h2l_scale_i = 1.0f;
 static float l2h_gamma = 2.2f, l2h_scale = 1.0f;
@@ -448,9 +494,9 @@ static unsigned char *convert_format(unsigned char *data, int img_n,
     return data;
   assert(req_comp >= 1 && req_comp <= 4);
 
-  good = (unsigned char *)malloc(req_comp * x * y);
+  good = (unsigned char *)STBI_MALLOC(req_comp * x * y);
   if (good == NULL) {
-    free(data);
+    STBI_FREE(data);
     return epuc("outofmem", "Out of memory");
   }
 
@@ -498,16 +544,16 @@ static unsigned char *convert_format(unsigned char *data, int img_n,
 #undef CASE
   }
 
-  free(data);
+  STBI_FREE(data);
   return good;
 }
 
 #ifndef STBI_NO_HDR
 static float *ldr_to_hdr(stbi_uc *data, int x, int y, int comp) {
   int i, k, n;
-  float *output = (float *)malloc(x * y * comp * sizeof(float));
+  float *output = (float *)STBI_MALLOC(x * y * comp * sizeof(float));
   if (output == NULL) {
-    free(data);
+    STBI_FREE(data);
     return epf("outofmem", "Out of memory");
   }
   // compute number of non-alpha components
@@ -523,16 +569,16 @@ static float *ldr_to_hdr(stbi_uc *data, int x, int y, int comp) {
     if (k < comp)
       output[i * comp + k] = data[i * comp + k] / 255.0f;
   }
-  free(data);
+  STBI_FREE(data);
   return output;
 }
 
 #define float2int(x) ((int)(x))
 static stbi_uc *hdr_to_ldr(float *data, int x, int y, int comp) {
   int i, k, n;
-  stbi_uc *output = (stbi_uc *)malloc(x * y * comp);
+  stbi_uc *output = (stbi_uc *)STBI_MALLOC(x * y * comp);
   if (output == NULL) {
-    free(data);
+    STBI_FREE(data);
     return epuc("outofmem", "Out of memory");
   }
   // compute number of non-alpha components
@@ -560,7 +606,7 @@ static stbi_uc *hdr_to_ldr(float *data, int x, int y, int comp) {
       output[i * comp + k] = float2int(z);
     }
   }
-  free(data);
+  STBI_FREE(data);
   return output;
 }
 #endif
@@ -1310,10 +1356,10 @@ static int process_frame_header(jpeg *z, int scan) {
     z->img_comp[i].w2 = z->img_mcu_x * z->img_comp[i].h * 8;
     z->img_comp[i].h2 = z->img_mcu_y * z->img_comp[i].v * 8;
     z->img_comp[i].raw_data =
-        malloc(z->img_comp[i].w2 * z->img_comp[i].h2 + 15);
+        STBI_MALLOC(z->img_comp[i].w2 * z->img_comp[i].h2 + 15);
     if (z->img_comp[i].raw_data == NULL) {
       for (--i; i >= 0; --i) {
-        free(z->img_comp[i].raw_data);
+        STBI_FREE(z->img_comp[i].raw_data);
         z->img_comp[i].data = NULL;
       }
       return e("outofmem", "Out of memory");
@@ -1496,7 +1542,8 @@ static void YCbCr_to_RGB_row(uint8 *out, uint8 *y, uint8 *pcb, uint8 *pcr,
     out[0] = (uint8)r;
     out[1] = (uint8)g;
     out[2] = (uint8)b;
-    out[3] = 255;
+    if (step == 4)
+      out[3] = 255;
     out += step;
   }
 }
@@ -1514,11 +1561,11 @@ static void cleanup_jpeg(jpeg *j) {
   int i;
   for (i = 0; i < j->s.img_n; ++i) {
     if (j->img_comp[i].data) {
-      free(j->img_comp[i].raw_data);
+      STBI_FREE(j->img_comp[i].raw_data);
       j->img_comp[i].data = NULL;
     }
     if (j->img_comp[i].linebuf) {
-      free(j->img_comp[i].linebuf);
+      STBI_FREE(j->img_comp[i].linebuf);
       j->img_comp[i].linebuf = NULL;
     }
   }
@@ -1533,8 +1580,10 @@ typedef struct {
   int ypos;    // which pre-expansion row we're on
 } stbi_resample;
 
-static uint8 *load_jpeg_image(jpeg *z, int *out_x, int *out_y, int *comp,
-                              int req_comp) {
+// output (out_size bytes, rows stride bytes apart) is where the pixels go,
+// or NULL to allocate it
+static uint8 *load_jpeg_image(jpeg *z, uint8 *output, int out_size, int stride,
+                              int *out_x, int *out_y, int *comp, int req_comp) {
   int n, decode_n;
   // validate req_comp
   if (req_comp < 0 || req_comp > 4)
@@ -1550,6 +1599,11 @@ static uint8 *load_jpeg_image(jpeg *z, int *out_x, int *out_y, int *comp,
   // determine actual number of components to generate
   n = req_comp ? req_comp : z->s.img_n;
 
+  if (output && !fits_into(z->s.img_x, z->s.img_y, n, out_size, stride)) {
+    cleanup_jpeg(z);
+    return epuc("too small", "Destination buffer too small");
+  }
+
   if (z->s.img_n == 3 && n < 3)
     decode_n = 1;
   else
@@ -1559,7 +1613,6 @@ static uint8 *load_jpeg_image(jpeg *z, int *out_x, int *out_y, int *comp,
   {
     int k;
     uint i, j;
-    uint8 *output;
     uint8 *coutput[4];
 
     stbi_resample res_comp[4];
@@ -1569,7 +1622,7 @@ static uint8 *load_jpeg_image(jpeg *z, int *out_x, int *out_y, int *comp,
 
       // allocate line buffer big enough for upsampling off the edges
       // with upsample factor of 4
-      z->img_comp[k].linebuf = (uint8 *)malloc(z->s.img_x + 3);
+      z->img_comp[k].linebuf = (uint8 *)STBI_MALLOC(z->s.img_x + 3);
       if (!z->img_comp[k].linebuf) {
         cleanup_jpeg(z);
         return epuc("outofmem", "Out of memory");
@@ -1595,15 +1648,18 @@ static uint8 *load_jpeg_image(jpeg *z, int *out_x, int *out_y, int *comp,
     }
 
     // can't error after this so, this is safe
-    output = (uint8 *)malloc(n * z->s.img_x * z->s.img_y + 1);
     if (!output) {
-      cleanup_jpeg(z);
-      return epuc("outofmem", "Out of memory");
+      output = (uint8 *)STBI_MALLOC(n * z->s.img_x * z->s.img_y + 1);
+      if (!output) {
+        cleanup_jpeg(z);
+        return epuc("outofmem", "Out of memory");
+      }
+      stride = n * z->s.img_x;
     }
 
     // now go ahead and resample
     for (j = 0; j < z->s.img_y; ++j) {
-      uint8 *out = output + n * z->s.img_x * j;
+      uint8 *out = output + stride * j;
       for (k = 0; k < decode_n; ++k) {
         stbi_resample *r = &res_comp[k];
         int y_bot = r->ystep >= (r->vs >> 1);
@@ -1628,7 +1684,8 @@ static uint8 *load_jpeg_image(jpeg *z, int *out_x, int *out_y, int *comp,
         } else
           for (i = 0; i < z->s.img_x; ++i) {
             out[0] = out[1] = out[2] = y[i];
-            out[3] = 255; // not used if n==3
+            if (n == 4)
+              out[3] = 255;
             out += n;
           }
       } else {
@@ -1655,7 +1712,7 @@ unsigned char *stbi_jpeg_load_from_file(FILE *f, int *x, int *y, int *comp,
                                         int req_comp) {
   jpeg j;
   start_file(&j.s, f);
-  return load_jpeg_image(&j, x, y, comp, req_comp);
+  return load_jpeg_image(&j, NULL, 0, 0, x, y, comp, req_comp);
 }
 
 unsigned char *stbi_jpeg_load(char const *filename, int *x, int *y, int *comp,
@@ -1675,7 +1732,7 @@ unsigned char *stbi_jpeg_load_from_memory(stbi_uc const *buffer, int len,
                                           int req_comp) {
   jpeg j;
   start_mem(&j.s, buffer, len);
-  return load_jpeg_image(&j, x, y, comp, req_comp);
+  return load_jpeg_image(&j, NULL, 0, 0, x, y, comp, req_comp);
 }
 
 #ifndef STBI_NO_STDIO
@@ -1696,20 +1753,55 @@ int stbi_jpeg_test_memory(stbi_uc const *buffer, int len) {
   return decode_jpeg_header(&j, SCAN_type);
 }
 
-// @TODO:
+static int jpeg_info(jpeg *j, int *x, int *y, int *comp) {
+  if (!decode_jpeg_header(j, SCAN_header))
+    return 0;
+  *x = j->s.img_x;
+  *y = j->s.img_y;
+  if (comp)
+    *comp = j->s.img_n;
+  return 1;
+}
+
 #ifndef STBI_NO_STDIO
-extern int stbi_jpeg_info(char const *filename, int *x, int *y, int *comp);
-extern int stbi_jpeg_info_from_file(FILE *f, int *x, int *y, int *comp);
+int stbi_jpeg_info(char const *filename, int *x, int *y, int *comp) {
+  int r;
+  FILE *f = fopen(filename, "rb");
+  if (!f)
+    return e("can't fopen", "Unable to open file");
+  r = stbi_jpeg_info_from_file(f, x, y, comp);
+  fclose(f);
+  return r;
+}
+
+int stbi_jpeg_info_from_file(FILE *f, int *x, int *y, int *comp) {
+  int n, r;
+  jpeg j;
+  n = ftell(f);
+  start_file(&j.s, f);
+  r = jpeg_info(&j, x, y, comp);
+  fseek(f, n, SEEK_SET);
+  return r;
+}
 #endif
-extern int stbi_jpeg_info_from_memory(stbi_uc const *buffer, int len, int *x,
-                                      int *y, int *comp);
+
+int stbi_jpeg_info_from_memory(stbi_uc const *buffer, int len, int *x, int *y,
+                               int *comp) {
+  jpeg j;
+  start_mem(&j.s, buffer, len);
+  return jpeg_info(&j, x, y, comp);
+}
 
 // public domain zlib decode    v0.2  Sean Barrett 2006-11-18
 //    simple implementation
 //      - all input must be provided in an upfront buffer
 //      - all output is written to a single output buffer (can malloc/realloc)
 //    performance
-//      - fast huffman
+//      - fast huffman, table entries carry both code size and symbol
+//      - 64-bit bit buffer, refilled a whole word at a time
+//      - runs of literals decoded without refilling the bit buffer
+//      - matches copied 8 or 16 bytes at a time when they can't overlap
+//      - fixed huffman tables built once and reused
 
 // fast-way is faster to check than jpeg huffman, but slow way is slower
 #define ZFAST_BITS 9 // accelerate all cases in default tables
@@ -1718,7 +1810,7 @@ extern int stbi_jpeg_info_from_memory(stbi_uc const *buffer, int len, int *x,
 // zlib-style huffman encoding
 // (jpegs packs from left, zlib from right, so can't share code)
 typedef struct {
-  uint16 fast[1 << ZFAST_BITS];
+  uint16 fast[1 << ZFAST_BITS]; // (size << 9) | symbol, 0 if not in fast table
   uint16 firstcode[16];
   int maxcode[17];
   uint16 firstsymbol[16];
@@ -1747,7 +1839,7 @@ static int zbuild_huffman(zhuffman *z, uint8 *sizelist, int num) {
 
   // DEFLATE spec for generating codes
   memset(sizes, 0, sizeof(sizes));
-  memset(z->fast, 255, sizeof(z->fast));
+  memset(z->fast, 0, sizeof(z->fast));
   for (i = 0; i < num; ++i)
     ++sizes[sizelist[i]];
   sizes[0] = 0;
@@ -1776,7 +1868,7 @@ static int zbuild_huffman(zhuffman *z, uint8 *sizelist, int num) {
       if (s <= ZFAST_BITS) {
         int k = bit_reverse(next_code[s], s);
         while (k < (1 << ZFAST_BITS)) {
-          z->fast[k] = (uint16)c;
+          z->fast[k] = (uint16)((s << 9) | i);
           k += (1 << s);
         }
       }
@@ -1787,15 +1879,19 @@ static int zbuild_huffman(zhuffman *z, uint8 *sizelist, int num) {
 }
 
 // zlib-from-memory implementation for PNG reading
-//    because PNG allows splitting the zlib stream arbitrarily,
-//    and it's annoying structurally to have PNG call ZLIB call PNG,
-//    we require PNG read all the IDATs and combine them into a single
-//    memory buffer
+//    because PNG allows splitting the zlib stream arbitrarily, the input
+//    buffer can be topped up through 'refill' whenever it runs dry; PNG
+//    uses that to hand over one IDAT chunk at a time
 
 typedef struct {
   uint8 *zbuffer, *zbuffer_end;
+  // optional: points zbuffer/zbuffer_end at more input, 0 if there is none
+  int (*refill)(void *user, uint8 **next, uint8 **end);
+  void *refill_user;
   int num_bits;
-  uint32 code_buffer;
+  // bits above num_bits may hold a copy of the next input bits (left over
+  // from a word refill); refills OR the same bits back in, so that's harmless
+  uint64 code_buffer;
 
   char *zout;
   char *zout_start;
@@ -1805,45 +1901,74 @@ typedef struct {
   zhuffman z_length, z_distance;
 } zbuf;
 
+static int zrefill_input(zbuf *z) {
+  if (z->refill == NULL)
+    return 0;
+  return z->refill(z->refill_user, &z->zbuffer, &z->zbuffer_end);
+}
+
 __forceinline static int zget8(zbuf *z) {
   if (z->zbuffer >= z->zbuffer_end)
-    return 0;
+    if (!zrefill_input(z))
+      return 0;
   return *z->zbuffer++;
 }
 
+__forceinline static uint64 zload64le(uint8 const *p) {
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+  int i;
+  uint64 v = 0;
+  for (i = 7; i >= 0; --i)
+    v = (v << 8) | p[i];
+  return v;
+#else
+  uint64 v;
+  memcpy(&v, p, 8);
+  return v;
+#endif
+}
+
+// tops the bit buffer up to at least 56 bits
 static void fill_bits(zbuf *z) {
-  do {
-    assert(z->code_buffer < (1U << z->num_bits));
-    z->code_buffer |= zget8(z) << z->num_bits;
-    z->num_bits += 8;
-  } while (z->num_bits <= 24);
+  if (z->zbuffer_end - z->zbuffer >= 8) {
+    // grab a whole word, and keep only the bytes that fit completely
+    z->code_buffer |= zload64le(z->zbuffer) << z->num_bits;
+    z->zbuffer += (63 - z->num_bits) >> 3;
+    z->num_bits |= 56;
+  } else {
+    // near the end of the input, go byte by byte (reads past the end are 0)
+    do {
+      z->code_buffer |= (uint64)zget8(z) << z->num_bits;
+      z->num_bits += 8;
+    } while (z->num_bits <= 56);
+  }
 }
 
 __forceinline static unsigned int zreceive(zbuf *z, int n) {
   unsigned int k;
   if (z->num_bits < n)
     fill_bits(z);
-  k = z->code_buffer & ((1 << n) - 1);
+  k = (unsigned int)(z->code_buffer & ((1u << n) - 1));
   z->code_buffer >>= n;
   z->num_bits -= n;
   return k;
 }
 
-__forceinline static int zhuffman_decode(zbuf *a, zhuffman *z) {
+__forceinline static int zhuffman_decode(zbuf *a, const zhuffman *z) {
   int b, s, k;
   if (a->num_bits < 16)
     fill_bits(a);
   b = z->fast[a->code_buffer & ZFAST_MASK];
-  if (b < 0xffff) {
-    s = z->size[b];
+  if (b) {
+    s = b >> 9;
     a->code_buffer >>= s;
     a->num_bits -= s;
-    return z->value[b];
+    return b & 511;
   }
 
   // not resolved by fast table, so compute it the slow way
   // use jpeg approach, which requires MSbits at top
-  k = bit_reverse(a->code_buffer, 16);
+  k = bit_reverse((int)(a->code_buffer & 0xffff), 16);
   for (s = ZFAST_BITS + 1;; ++s)
     if (k < z->maxcode[s])
       break;
@@ -1867,7 +1992,7 @@ static int expand(zbuf *z, int n) // need to make room for n bytes
   limit = (int)(z->zout_end - z->zout_start);
   while (cur + n > limit)
     limit *= 2;
-  q = (char *)realloc(z->zout_start, limit);
+  q = (char *)STBI_REALLOC(z->zout_start, limit);
   if (q == NULL)
     return e("outofmem", "Out of memory");
   z->zout_start = q;
@@ -1892,18 +2017,66 @@ static int dist_extra[32] = {0, 0, 0,  0,  1,  1,  2,  2,  3,  3,
                              4, 4, 5,  5,  6,  6,  7,  7,  8,  8,
                              9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
 
-static int parse_huffman_block(zbuf *a) {
+// copy a match of 'len' bytes from 'dist' bytes back; when the output has
+// room to spare, whole 8 or 16 byte words are moved (possibly writing a few
+// bytes past the match, which later output overwrites)
+__forceinline static void zcopy_match(zbuf *a, int len, int dist) {
+  uint8 *q = (uint8 *)a->zout;
+  uint8 const *p = q - dist;
+  a->zout += len;
+  if (a->zout_end - (char *)q >= len + 16) {
+    if (dist >= 16) {
+      do {
+        memcpy(q, p, 16);
+        q += 16;
+        p += 16;
+        len -= 16;
+      } while (len > 0);
+      return;
+    }
+    if (dist >= 8) {
+      do {
+        memcpy(q, p, 8);
+        q += 8;
+        p += 8;
+        len -= 8;
+      } while (len > 0);
+      return;
+    }
+    if (dist == 1) {
+      memset(q, *p, len);
+      return;
+    }
+  }
+  while (len--)
+    *q++ = *p++;
+}
+
+static int parse_huffman_block(zbuf *a, const zhuffman *zlength,
+                               const zhuffman *zdistance) {
   for (;;) {
-    int z = zhuffman_decode(a, &a->z_length);
+    int z = zhuffman_decode(a, zlength);
     if (z < 256) {
       if (z < 0)
         return e("bad huffman code", "Corrupt PNG"); // error in huffman codes
-      if (a->zout >= a->zout_end)
-        if (!expand(a, 1))
-          return 0;
-      *a->zout++ = (char)z;
+      // emit this literal, and any literals right behind it that the fast
+      // table resolves from bits already in the buffer
+      for (;;) {
+        int b;
+        if (a->zout >= a->zout_end)
+          if (!expand(a, 1))
+            return 0;
+        *a->zout++ = (char)z;
+        if (a->num_bits < ZFAST_BITS)
+          break;
+        b = zlength->fast[a->code_buffer & ZFAST_MASK];
+        if (b == 0 || (b & 511) >= 256)
+          break;
+        a->code_buffer >>= b >> 9;
+        a->num_bits -= b >> 9;
+        z = b & 511;
+      }
     } else {
-      uint8 *p;
       int len, dist;
       if (z == 256)
         return 1;
@@ -1911,7 +2084,7 @@ static int parse_huffman_block(zbuf *a) {
       len = length_base[z];
       if (length_extra[z])
         len += zreceive(a, length_extra[z]);
-      z = zhuffman_decode(a, &a->z_distance);
+      z = zhuffman_decode(a, zdistance);
       if (z < 0)
         return e("bad huffman code", "Corrupt PNG");
       dist = dist_base[z];
@@ -1922,9 +2095,7 @@ static int parse_huffman_block(zbuf *a) {
       if (a->zout + len > a->zout_end)
         if (!expand(a, len))
           return 0;
-      p = (uint8 *)(a->zout - dist);
-      while (len--)
-        *a->zout++ = *p++;
+      zcopy_match(a, len, dist);
     }
   }
 }
@@ -1932,7 +2103,7 @@ static int parse_huffman_block(zbuf *a) {
 static int compute_huffman_codes(zbuf *a) {
   static uint8 length_dezigzag[19] = {16, 17, 18, 0, 8,  7, 9,  6, 10, 5,
                                       11, 4,  12, 3, 13, 2, 14, 1, 15};
-  static zhuffman z_codelength;   // static just to save stack space
+  zhuffman z_codelength; // on the stack, as several decodes can run at once
   uint8 lencodes[286 + 32 + 137]; // padding for maximum single op
   uint8 codelength_sizes[19];
   int i, n;
@@ -1952,10 +2123,13 @@ static int compute_huffman_codes(zbuf *a) {
   n = 0;
   while (n < hlit + hdist) {
     int c = zhuffman_decode(a, &z_codelength);
-    assert(c >= 0 && c < 19);
+    if (c < 0 || c >= 19)
+      return e("bad codelengths", "Corrupt PNG");
     if (c < 16)
       lencodes[n++] = (uint8)c;
     else if (c == 16) {
+      if (n == 0)
+        return e("bad codelengths", "Corrupt PNG");
       c = zreceive(a, 2) + 3;
       memset(lencodes + n, lencodes[n - 1], c);
       n += c;
@@ -1984,29 +2158,36 @@ static int parse_uncompressed_block(zbuf *a) {
   int len, nlen, k;
   if (a->num_bits & 7)
     zreceive(a, a->num_bits & 7); // discard
-  // drain the bit-packed data into header
-  k = 0;
-  while (a->num_bits > 0) {
-    header[k++] = (uint8)(a->code_buffer & 255); // wtf this warns?
-    a->code_buffer >>= 8;
-    a->num_bits -= 8;
-  }
-  assert(a->num_bits == 0);
-  // now fill header the normal way
-  while (k < 4)
-    header[k++] = (uint8)zget8(a);
+  for (k = 0; k < 4; ++k)
+    header[k] = (uint8)zreceive(a, 8);
   len = header[1] * 256 + header[0];
   nlen = header[3] * 256 + header[2];
   if (nlen != (len ^ 0xffff))
     return e("zlib corrupt", "Corrupt PNG");
-  if (a->zbuffer + len > a->zbuffer_end)
-    return e("read past buffer", "Corrupt PNG");
   if (a->zout + len > a->zout_end)
     if (!expand(a, len))
       return 0;
-  memcpy(a->zout, a->zbuffer, len);
-  a->zbuffer += len;
-  a->zout += len;
+  // the bit buffer may already hold the first few bytes
+  while (len > 0 && a->num_bits >= 8) {
+    *a->zout++ = (char)zreceive(a, 8);
+    --len;
+  }
+  if (a->num_bits == 0)
+    a->code_buffer = 0; // drop any look-ahead copy, we're reading past it
+  while (len > 0) {
+    int n = (int)(a->zbuffer_end - a->zbuffer);
+    if (n == 0) {
+      if (!zrefill_input(a))
+        return e("read past buffer", "Corrupt PNG");
+      continue;
+    }
+    if (n > len)
+      n = len;
+    memcpy(a->zout, a->zbuffer, n);
+    a->zbuffer += n;
+    a->zout += n;
+    len -= n;
+  }
   return 1;
 }
 
@@ -2026,22 +2207,140 @@ static int parse_zlib_header(zbuf *a) {
   return 1;
 }
 
-// @TODO: should statically initialize these for optimal thread safety
-static uint8 default_length[288], default_distance[32];
-static void init_defaults(void) {
-  int i; // use <= to match clearly with spec
-  for (i = 0; i <= 143; ++i)
-    default_length[i] = 8;
-  for (; i <= 255; ++i)
-    default_length[i] = 9;
-  for (; i <= 279; ++i)
-    default_length[i] = 7;
-  for (; i <= 287; ++i)
-    default_length[i] = 8;
-
-  for (i = 0; i <= 31; ++i)
-    default_distance[i] = 5;
-}
+// the fixed huffman tables, exactly as zbuild_huffman builds them from the
+// DEFLATE code lengths (8, 9, 7 and 8 bits for literals 0-143, 144-255,
+// 256-279 and 280-287, 5 bits for every distance).  They are constant so
+// that every thread can decode fixed blocks without building them first
+static const zhuffman zdefault_length = {
+    {3840, 4176, 4112, 4376, 3856, 4208, 4144, 4800, 3848, 4192, 4128, 4768,
+     4096, 4224, 4160, 4832, 3844, 4184, 4120, 4752, 3860, 4216, 4152, 4816,
+     3852, 4200, 4136, 4784, 4104, 4232, 4168, 4848, 3842, 4180, 4116, 4380,
+     3858, 4212, 4148, 4808, 3850, 4196, 4132, 4776, 4100, 4228, 4164, 4840,
+     3846, 4188, 4124, 4760, 3862, 4220, 4156, 4824, 3854, 4204, 4140, 4792,
+     4108, 4236, 4172, 4856, 3841, 4178, 4114, 4378, 3857, 4210, 4146, 4804,
+     3849, 4194, 4130, 4772, 4098, 4226, 4162, 4836, 3845, 4186, 4122, 4756,
+     3861, 4218, 4154, 4820, 3853, 4202, 4138, 4788, 4106, 4234, 4170, 4852,
+     3843, 4182, 4118, 4382, 3859, 4214, 4150, 4812, 3851, 4198, 4134, 4780,
+     4102, 4230, 4166, 4844, 3847, 4190, 4126, 4764, 3863, 4222, 4158, 4828,
+     3855, 4206, 4142, 4796, 4110, 4238, 4174, 4860, 3840, 4177, 4113, 4377,
+     3856, 4209, 4145, 4802, 3848, 4193, 4129, 4770, 4097, 4225, 4161, 4834,
+     3844, 4185, 4121, 4754, 3860, 4217, 4153, 4818, 3852, 4201, 4137, 4786,
+     4105, 4233, 4169, 4850, 3842, 4181, 4117, 4381, 3858, 4213, 4149, 4810,
+     3850, 4197, 4133, 4778, 4101, 4229, 4165, 4842, 3846, 4189, 4125, 4762,
+     3862, 4221, 4157, 4826, 3854, 4205, 4141, 4794, 4109, 4237, 4173, 4858,
+     3841, 4179, 4115, 4379, 3857, 4211, 4147, 4806, 3849, 4195, 4131, 4774,
+     4099, 4227, 4163, 4838, 3845, 4187, 4123, 4758, 3861, 4219, 4155, 4822,
+     3853, 4203, 4139, 4790, 4107, 4235, 4171, 4854, 3843, 4183, 4119, 4383,
+     3859, 4215, 4151, 4814, 3851, 4199, 4135, 4782, 4103, 4231, 4167, 4846,
+     3847, 4191, 4127, 4766, 3863, 4223, 4159, 4830, 3855, 4207, 4143, 4798,
+     4111, 4239, 4175, 4862, 3840, 4176, 4112, 4376, 3856, 4208, 4144, 4801,
+     3848, 4192, 4128, 4769, 4096, 4224, 4160, 4833, 3844, 4184, 4120, 4753,
+     3860, 4216, 4152, 4817, 3852, 4200, 4136, 4785, 4104, 4232, 4168, 4849,
+     3842, 4180, 4116, 4380, 3858, 4212, 4148, 4809, 3850, 4196, 4132, 4777,
+     4100, 4228, 4164, 4841, 3846, 4188, 4124, 4761, 3862, 4220, 4156, 4825,
+     3854, 4204, 4140, 4793, 4108, 4236, 4172, 4857, 3841, 4178, 4114, 4378,
+     3857, 4210, 4146, 4805, 3849, 4194, 4130, 4773, 4098, 4226, 4162, 4837,
+     3845, 4186, 4122, 4757, 3861, 4218, 4154, 4821, 3853, 4202, 4138, 4789,
+     4106, 4234, 4170, 4853, 3843, 4182, 4118, 4382, 3859, 4214, 4150, 4813,
+     3851, 4198, 4134, 4781, 4102, 4230, 4166, 4845, 3847, 4190, 4126, 4765,
+     3863, 4222, 4158, 4829, 3855, 4206, 4142, 4797, 4110, 4238, 4174, 4861,
+     3840, 4177, 4113, 4377, 3856, 4209, 4145, 4803, 3848, 4193, 4129, 4771,
+     4097, 4225, 4161, 4835, 3844, 4185, 4121, 4755, 3860, 4217, 4153, 4819,
+     3852, 4201, 4137, 4787, 4105, 4233, 4169, 4851, 3842, 4181, 4117, 4381,
+     3858, 4213, 4149, 4811, 3850, 4197, 4133, 4779, 4101, 4229, 4165, 4843,
+     3846, 4189, 4125, 4763, 3862, 4221, 4157, 4827, 3854, 4205, 4141, 4795,
+     4109, 4237, 4173, 4859, 3841, 4179, 4115, 4379, 3857, 4211, 4147, 4807,
+     3849, 4195, 4131, 4775, 4099, 4227, 4163, 4839, 3845, 4187, 4123, 4759,
+     3861, 4219, 4155, 4823, 3853, 4203, 4139, 4791, 4107, 4235, 4171, 4855,
+     3843, 4183, 4119, 4383, 3859, 4215, 4151, 4815, 3851, 4199, 4135, 4783,
+     4103, 4231, 4167, 4847, 3847, 4191, 4127, 4767, 3863, 4223, 4159, 4831,
+     3855, 4207, 4143, 4799, 4111, 4239, 4175, 4863},
+    {0, 0, 0, 0, 0, 0, 0, 0, 48, 400, 1024, 2048, 4096, 8192, 16384, 32768},
+    {0, 0, 0, 0, 0, 0, 0, 12288, 51200, 65536, 65536, 65536, 65536, 65536,
+     65536, 65536, 65536},
+    {0, 0, 0, 0, 0, 0, 0, 0, 24, 176, 288, 288, 288, 288, 288, 288},
+    {7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 8,
+     8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8,
+     8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8,
+     8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8,
+     8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8,
+     8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8,
+     8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8,
+     8, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9,
+     9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9,
+     9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9,
+     9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9,
+     9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9},
+    {256, 257, 258, 259, 260, 261, 262, 263, 264, 265, 266, 267, 268, 269, 270,
+     271, 272, 273, 274, 275, 276, 277, 278, 279, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9,
+     10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27,
+     28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40, 41, 42, 43, 44, 45,
+     46, 47, 48, 49, 50, 51, 52, 53, 54, 55, 56, 57, 58, 59, 60, 61, 62, 63,
+     64, 65, 66, 67, 68, 69, 70, 71, 72, 73, 74, 75, 76, 77, 78, 79, 80, 81,
+     82, 83, 84, 85, 86, 87, 88, 89, 90, 91, 92, 93, 94, 95, 96, 97, 98, 99,
+     100, 101, 102, 103, 104, 105, 106, 107, 108, 109, 110, 111, 112, 113, 114,
+     115, 116, 117, 118, 119, 120, 121, 122, 123, 124, 125, 126, 127, 128, 129,
+     130, 131, 132, 133, 134, 135, 136, 137, 138, 139, 140, 141, 142, 143, 280,
+     281, 282, 283, 284, 285, 286, 287, 144, 145, 146, 147, 148, 149, 150, 151,
+     152, 153, 154, 155, 156, 157, 158, 159, 160, 161, 162, 163, 164, 165, 166,
+     167, 168, 169, 170, 171, 172, 173, 174, 175, 176, 177, 178, 179, 180, 181,
+     182, 183, 184, 185, 186, 187, 188, 189, 190, 191, 192, 193, 194, 195, 196,
+     197, 198, 199, 200, 201, 202, 203, 204, 205, 206, 207, 208, 209, 210, 211,
+     212, 213, 214, 215, 216, 217, 218, 219, 220, 221, 222, 223, 224, 225, 226,
+     227, 228, 229, 230, 231, 232, 233, 234, 235, 236, 237, 238, 239, 240, 241,
+     242, 243, 244, 245, 246, 247, 248, 249, 250, 251, 252, 253, 254, 255}};
+static const zhuffman zdefault_distance = {
+    {2560, 2576, 2568, 2584, 2564, 2580, 2572, 2588, 2562, 2578, 2570, 2586,
+     2566, 2582, 2574, 2590, 2561, 2577, 2569, 2585, 2565, 2581, 2573, 2589,
+     2563, 2579, 2571, 2587, 2567, 2583, 2575, 2591, 2560, 2576, 2568, 2584,
+     2564, 2580, 2572, 2588, 2562, 2578, 2570, 2586, 2566, 2582, 2574, 2590,
+     2561, 2577, 2569, 2585, 2565, 2581, 2573, 2589, 2563, 2579, 2571, 2587,
+     2567, 2583, 2575, 2591, 2560, 2576, 2568, 2584, 2564, 2580, 2572, 2588,
+     2562, 2578, 2570, 2586, 2566, 2582, 2574, 2590, 2561, 2577, 2569, 2585,
+     2565, 2581, 2573, 2589, 2563, 2579, 2571, 2587, 2567, 2583, 2575, 2591,
+     2560, 2576, 2568, 2584, 2564, 2580, 2572, 2588, 2562, 2578, 2570, 2586,
+     2566, 2582, 2574, 2590, 2561, 2577, 2569, 2585, 2565, 2581, 2573, 2589,
+     2563, 2579, 2571, 2587, 2567, 2583, 2575, 2591, 2560, 2576, 2568, 2584,
+     2564, 2580, 2572, 2588, 2562, 2578, 2570, 2586, 2566, 2582, 2574, 2590,
+     2561, 2577, 2569, 2585, 2565, 2581, 2573, 2589, 2563, 2579, 2571, 2587,
+     2567, 2583, 2575, 2591, 2560, 2576, 2568, 2584, 2564, 2580, 2572, 2588,
+     2562, 2578, 2570, 2586, 2566, 2582, 2574, 2590, 2561, 2577, 2569, 2585,
+     2565, 2581, 2573, 2589, 2563, 2579, 2571, 2587, 2567, 2583, 2575, 2591,
+     2560, 2576, 2568, 2584, 2564, 2580, 2572, 2588, 2562, 2578, 2570, 2586,
+     2566, 2582, 2574, 2590, 2561, 2577, 2569, 2585, 2565, 2581, 2573, 2589,
+     2563, 2579, 2571, 2587, 2567, 2583, 2575, 2591, 2560, 2576, 2568, 2584,
+     2564, 2580, 2572, 2588, 2562, 2578, 2570, 2586, 2566, 2582, 2574, 2590,
+     2561, 2577, 2569, 2585, 2565, 2581, 2573, 2589, 2563, 2579, 2571, 2587,
+     2567, 2583, 2575, 2591, 2560, 2576, 2568, 2584, 2564, 2580, 2572, 2588,
+     2562, 2578, 2570, 2586, 2566, 2582, 2574, 2590, 2561, 2577, 2569, 2585,
+     2565, 2581, 2573, 2589, 2563, 2579, 2571, 2587, 2567, 2583, 2575, 2591,
+     2560, 2576, 2568, 2584, 2564, 2580, 2572, 2588, 2562, 2578, 2570, 2586,
+     2566, 2582, 2574, 2590, 2561, 2577, 2569, 2585, 2565, 2581, 2573, 2589,
+     2563, 2579, 2571, 2587, 2567, 2583, 2575, 2591, 2560, 2576, 2568, 2584,
+     2564, 2580, 2572, 2588, 2562, 2578, 2570, 2586, 2566, 2582, 2574, 2590,
+     2561, 2577, 2569, 2585, 2565, 2581, 2573, 2589, 2563, 2579, 2571, 2587,
+     2567, 2583, 2575, 2591, 2560, 2576, 2568, 2584, 2564, 2580, 2572, 2588,
+     2562, 2578, 2570, 2586, 2566, 2582, 2574, 2590, 2561, 2577, 2569, 2585,
+     2565, 2581, 2573, 2589, 2563, 2579, 2571, 2587, 2567, 2583, 2575, 2591,
+     2560, 2576, 2568, 2584, 2564, 2580, 2572, 2588, 2562, 2578, 2570, 2586,
+     2566, 2582, 2574, 2590, 2561, 2577, 2569, 2585, 2565, 2581, 2573, 2589,
+     2563, 2579, 2571, 2587, 2567, 2583, 2575, 2591, 2560, 2576, 2568, 2584,
+     2564, 2580, 2572, 2588, 2562, 2578, 2570, 2586, 2566, 2582, 2574, 2590,
+     2561, 2577, 2569, 2585, 2565, 2581, 2573, 2589, 2563, 2579, 2571, 2587,
+     2567, 2583, 2575, 2591, 2560, 2576, 2568, 2584, 2564, 2580, 2572, 2588,
+     2562, 2578, 2570, 2586, 2566, 2582, 2574, 2590, 2561, 2577, 2569, 2585,
+     2565, 2581, 2573, 2589, 2563, 2579, 2571, 2587, 2567, 2583, 2575, 2591,
+     2560, 2576, 2568, 2584, 2564, 2580, 2572, 2588, 2562, 2578, 2570, 2586,
+     2566, 2582, 2574, 2590, 2561, 2577, 2569, 2585, 2565, 2581, 2573, 2589,
+     2563, 2579, 2571, 2587, 2567, 2583, 2575, 2591},
+    {0, 0, 0, 0, 0, 0, 64, 128, 256, 512, 1024, 2048, 4096, 8192, 16384, 32768},
+    {0, 0, 0, 0, 0, 65536, 65536, 65536, 65536, 65536, 65536, 65536, 65536,
+     65536, 65536, 65536, 65536},
+    {0, 0, 0, 0, 0, 0, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32},
+    {5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5,
+     5, 5, 5, 5, 5, 5, 5},
+    {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20,
+     21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31}};
 
 static int parse_zlib(zbuf *a, int parse_header) {
   int final, type;
@@ -2058,20 +2357,14 @@ static int parse_zlib(zbuf *a, int parse_header) {
         return 0;
     } else if (type == 3) {
       return 0;
+    } else if (type == 1) {
+      // use fixed code lengths
+      if (!parse_huffman_block(a, &zdefault_length, &zdefault_distance))
+        return 0;
     } else {
-      if (type == 1) {
-        // use fixed code lengths
-        if (!default_distance[31])
-          init_defaults();
-        if (!zbuild_huffman(&a->z_length, default_length, 288))
-          return 0;
-        if (!zbuild_huffman(&a->z_distance, default_distance, 32))
-          return 0;
-      } else {
-        if (!compute_huffman_codes(a))
-          return 0;
-      }
-      if (!parse_huffman_block(a))
+      if (!compute_huffman_codes(a))
+        return 0;
+      if (!parse_huffman_block(a, &a->z_length, &a->z_distance))
         return 0;
     }
   } while (!final);
@@ -2090,17 +2383,18 @@ static int do_zlib(zbuf *a, char *obuf, int olen, int exp, int parse_header) {
 char *stbi_zlib_decode_malloc_guesssize(const char *buffer, int len,
                                         int initial_size, int *outlen) {
   zbuf a;
-  char *p = (char *)malloc(initial_size);
+  char *p = (char *)STBI_MALLOC(initial_size);
   if (p == NULL)
     return NULL;
   a.zbuffer = (uint8 *)buffer;
   a.zbuffer_end = (uint8 *)buffer + len;
+  a.refill = NULL;
   if (do_zlib(&a, p, initial_size, 1, 1)) {
     if (outlen)
       *outlen = (int)(a.zout - a.zout_start);
     return a.zout_start;
   } else {
-    free(a.zout_start);
+    STBI_FREE(a.zout_start);
     return NULL;
   }
 }
@@ -2114,6 +2408,7 @@ int stbi_zlib_decode_buffer(char *obuffer, int olen, char const *ibuffer,
   zbuf a;
   a.zbuffer = (uint8 *)ibuffer;
   a.zbuffer_end = (uint8 *)ibuffer + ilen;
+  a.refill = NULL;
   if (do_zlib(&a, obuffer, olen, 0, 1))
     return (int)(a.zout - a.zout_start);
   else
@@ -2123,17 +2418,18 @@ int stbi_zlib_decode_buffer(char *obuffer, int olen, char const *ibuffer,
 char *stbi_zlib_decode_noheader_malloc(char const *buffer, int len,
                                        int *outlen) {
   zbuf a;
-  char *p = (char *)malloc(16384);
+  char *p = (char *)STBI_MALLOC(16384);
   if (p == NULL)
     return NULL;
   a.zbuffer = (uint8 *)buffer;
   a.zbuffer_end = (uint8 *)buffer + len;
+  a.refill = NULL;
   if (do_zlib(&a, p, 16384, 1, 0)) {
     if (outlen)
       *outlen = (int)(a.zout - a.zout_start);
     return a.zout_start;
   } else {
-    free(a.zout_start);
+    STBI_FREE(a.zout_start);
     return NULL;
   }
 }
@@ -2143,6 +2439,7 @@ int stbi_zlib_decode_noheader_buffer(char *obuffer, int olen,
   zbuf a;
   a.zbuffer = (uint8 *)ibuffer;
   a.zbuffer_end = (uint8 *)ibuffer + ilen;
+  a.refill = NULL;
   if (do_zlib(&a, obuffer, olen, 0, 0))
     return (int)(a.zout - a.zout_start);
   else
@@ -2153,9 +2450,8 @@ int stbi_zlib_decode_noheader_buffer(char *obuffer, int olen,
 //    simple implementation
 //      - only 8-bit samples
 //      - no CRC checking
-//      - allocates lots of intermediate memory
-//        - avoids problem of streaming data between subsystems
-//        - avoids explicit window management
+//      - IDATs are streamed into zlib, which inflates into one buffer
+//        sized from the header; unfiltering reuses it when it can
 //    performance
 //      - uses stb_zlib, a PD zlib implementation with fast huffman decoding
 
@@ -2185,8 +2481,91 @@ static int check_png_header(stbi *s) {
 typedef struct {
   stbi s;
   uint8 *idata, *expanded, *out;
+  uint32 idat_left; // bytes of the current IDAT not yet handed to zlib
+  int idat_done;    // 1: read the chunk after the IDATs, 2: ran out of data
+  chunk next;       // the chunk after the IDATs, when idat_done == 1
 } png;
 
+// size of the buffer IDAT data is read through when decoding from a FILE
+#define PNG_IDAT_STAGING 32768
+
+// zbuf refill callback: gives zlib the next piece of the IDAT run, stepping
+// over chunk boundaries as it goes; when decoding from memory it points
+// straight into the source buffer
+static int png_next_idat(void *user, uint8 **next, uint8 **end) {
+  png *z = (png *)user;
+  stbi *s = &z->s;
+  uint8 *p;
+  uint32 n;
+  while (!z->idat_done) {
+    if (z->idat_left == 0) {
+      get32(s); // CRC of the IDAT just finished
+      z->next = get_chunk_header(s);
+      if (z->next.type != PNG_TYPE('I', 'D', 'A', 'T'))
+        z->idat_done = 1;
+      z->idat_left = z->next.length;
+      continue;
+    }
+#ifndef STBI_NO_STDIO
+    if (s->img_file) {
+      n = z->idat_left < PNG_IDAT_STAGING ? z->idat_left : PNG_IDAT_STAGING;
+      n = (uint32)fread(z->idata, 1, n, s->img_file);
+      p = z->idata;
+    } else
+#endif
+    {
+      n = (uint32)(s->img_buffer_end - s->img_buffer);
+      if (n > z->idat_left)
+        n = z->idat_left;
+      p = s->img_buffer;
+      s->img_buffer += n;
+    }
+    if (n == 0) {
+      z->idat_done = 2;
+      break;
+    }
+    *next = p;
+    *end = p + n;
+    z->idat_left -= n;
+    return 1;
+  }
+  return 0;
+}
+
+// inflate the run of IDATs, the first of which is 'length' bytes long,
+// into a buffer sized exactly for the filtered scanlines; on success the
+// chunk following the run has been read into z->next
+static int png_inflate_idats(png *z, uint32 length, uint32 raw_len,
+                             uint32 *out_len) {
+  zbuf a;
+  int ok;
+  z->idat_left = length;
+  z->idat_done = 0;
+#ifndef STBI_NO_STDIO
+  if (z->s.img_file) {
+    z->idata = (uint8 *)STBI_MALLOC(PNG_IDAT_STAGING);
+    if (z->idata == NULL)
+      return e("outofmem", "Out of memory");
+  }
+#endif
+  z->expanded = (uint8 *)STBI_MALLOC(raw_len);
+  if (z->expanded == NULL)
+    return e("outofmem", "Out of memory");
+  a.zbuffer = a.zbuffer_end = NULL;
+  a.refill = png_next_idat;
+  a.refill_user = z;
+  ok = do_zlib(&a, (char *)z->expanded, raw_len, 0, 1);
+  *out_len = (uint32)(a.zout - a.zout_start);
+  // step over whatever zlib didn't need (e.g. the adler32)
+  while (png_next_idat(z, &a.zbuffer, &a.zbuffer_end))
+    ;
+  STBI_FREE(z->idata);
+  z->idata = NULL;
+  if (z->idat_done != 1)
+    return e("outofdata", "Corrupt PNG");
+  return ok; // zlib should set error
+}
+
 enum {
   F_none = 0,
   F_sub = 1,
@@ -2212,16 +2591,146 @@ static int paeth(int a, int b, int c) {
   return c;
 }
 
+#ifdef STBI_SSE2
+// SSE2 unfiltering of a whole scanline, after libpng's
+// filter_sse2_intrinsics.c. Every pixel is loaded before the one in front of
+// it is stored, so 'cur' may sit a little below 'raw' in the same buffer.
+// 3-byte pixels are moved as 4 bytes except at the end of the row; the
+// extra byte is junk that the next pixel's store overwrites.
+
+static __m128i png_load_pixel(const uint8 *p, int size) {
+  uint32 v = 0;
+  if (size == 4)
+    memcpy(&v, p, 4);
+  else
+    memcpy(&v, p, 3);
+  return _mm_cvtsi32_si128((int)v);
+}
+
+static void png_store_pixel(uint8 *p, __m128i v, int size) {
+  uint32 x = (uint32)_mm_cvtsi128_si32(v);
+  if (size == 4)
+    memcpy(p, &x, 4);
+  else
+    memcpy(p, &x, 3);
+}
+
+static void png_unfilter_up_sse2(uint8 *cur, const uint8 *raw,
+                                 const uint8 *prior, uint32 len) {
+  uint32 i = 0;
+  for (; i + 16 <= len; i += 16) {
+    __m128i d = _mm_loadu_si128((const __m128i *)(raw + i));
+    __m128i b = _mm_loadu_si128((const __m128i *)(prior + i));
+    _mm_storeu_si128((__m128i *)(cur + i), _mm_add_epi8(d, b));
+  }
+  for (; i < len; ++i)
+    cur[i] = raw[i] + prior[i];
+}
+
+static void png_unfilter_sub_sse2(uint8 *cur, const uint8 *raw, uint32 w,
+                                  int n) {
+  __m128i a = _mm_setzero_si128();
+  int size = 4;
+  for (; w; --w, raw += n, cur += n) {
+    if (w == 1)
+      size = n;
+    a = _mm_add_epi8(png_load_pixel(raw, size), a);
+    png_store_pixel(cur, a, size);
+  }
+}
+
+static void png_unfilter_avg_sse2(uint8 *cur, const uint8 *raw,
+                                  const uint8 *prior, uint32 w, int n) {
+  __m128i a = _mm_setzero_si128(), one = _mm_set1_epi8(1);
+  int size = 4;
+  for (; w; --w, raw += n, cur += n, prior += n) {
+    __m128i b, avg;
+    if (w == 1)
+      size = n;
+    b = png_load_pixel(prior, size);
+    // pavgb rounds up; take off the carried-in low bit to round down
+    avg = _mm_avg_epu8(a, b);
+    avg = _mm_sub_epi8(avg, _mm_and_si128(_mm_xor_si128(a, b), one));
+    a = _mm_add_epi8(png_load_pixel(raw, size), avg);
+    png_store_pixel(cur, a, size);
+  }
+}
+
+static void png_unfilter_paeth_sse2(uint8 *cur, const uint8 *raw,
+                                    const uint8 *prior, uint32 w, int n) {
+  // work in 16 bits so the distances can't wrap; a, b, c as in paeth()
+  __m128i zero = _mm_setzero_si128(), a = zero, c = zero;
+  int size = 4;
+  for (; w; --w, raw += n, cur += n, prior += n) {
+    __m128i b, pa, pb, pc, smallest, use_a, use_b, pred;
+    if (w == 1)
+      size = n;
+    b = _mm_unpacklo_epi8(png_load_pixel(prior, size), zero);
+    pa = _mm_sub_epi16(b, c);   // p - a
+    pb = _mm_sub_epi16(a, c);   // p - b
+    pc = _mm_add_epi16(pa, pb); // p - c
+    pa = _mm_max_epi16(pa, _mm_sub_epi16(zero, pa));
+    pb = _mm_max_epi16(pb, _mm_sub_epi16(zero, pb));
+    pc = _mm_max_epi16(pc, _mm_sub_epi16(zero, pc));
+    smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+    // same tie-breaking order as paeth(): a, then b, then c
+    use_a = _mm_cmpeq_epi16(smallest, pa);
+    use_b = _mm_andnot_si128(use_a, _mm_cmpeq_epi16(smallest, pb));
+    pred = _mm_or_si128(
+        _mm_or_si128(_mm_and_si128(use_a, a), _mm_and_si128(use_b, b)),
+        _mm_andnot_si128(_mm_or_si128(use_a, use_b), c));
+    // a byte add keeps each 16-bit lane below 256
+    a = _mm_add_epi8(_mm_unpacklo_epi8(png_load_pixel(raw, size), zero),
+                     pred);
+    png_store_pixel(cur, _mm_packus_epi16(a, a), size);
+    c = b;
+  }
+}
+
+// returns 0 if there's no SSE2 path for this filter/pixel size
+static int png_unfilter_row_sse2(int filter, int n, uint8 *cur,
+                                 const uint8 *raw, const uint8 *prior,
+                                 uint32 w) {
+  if (filter == F_up) {
+    png_unfilter_up_sse2(cur, raw, prior, w * n);
+    return 1;
+  }
+  if (n != 3 && n != 4)
+    return 0;
+  switch (filter) {
+  case F_sub:
+    png_unfilter_sub_sse2(cur, raw, w, n);
+    return 1;
+  case F_avg:
+    png_unfilter_avg_sse2(cur, raw, prior, w, n);
+    return 1;
+  case F_paeth:
+    png_unfilter_paeth_sse2(cur, raw, prior, w, n);
+    return 1;
+  }
+  return 0;
+}
+#endif
+
 // create the png data from post-deflated data
 static int create_png_image(png *a, uint8 *raw, uint32 raw_len, int out_n) {
   stbi *s = &a->s;
   uint32 i, j, stride = s->img_x * out_n;
   int k;
   int img_n = s->img_n; // copy it into a local for later
+  int in_place = 0;
   assert(out_n == s->img_n || out_n == s->img_n + 1);
-  a->out = (uint8 *)malloc(s->img_x * s->img_y * out_n);
-  if (!a->out)
-    return e("outofmem", "Out of memory");
+  if (out_n == img_n && raw == a->expanded) {
+    // unfilter in place: every output byte lands before the filtered byte
+    // it comes from, and after all the filtered bytes already consumed
+    a->out = raw;
+    a->expanded = NULL;
+    in_place = 1;
+  } else {
+    a->out = (uint8 *)STBI_MALLOC(s->img_x * s->img_y * out_n);
+    if (!a->out)
+      return e("outofmem", "Out of memory");
+  }
   if (raw_len != (img_n * s->img_x + 1) * s->img_y)
     return e("not enough pixels", "Corrupt PNG");
   for (j = 0; j < s->img_y; ++j) {
@@ -2233,6 +2742,13 @@ static int create_png_image(png *a, uint8 *raw, uint32 raw_len, int out_n) {
     // if first row, use special filter that doesn't sample previous row
     if (j == 0)
       filter = first_row_filter[filter];
+#ifdef STBI_SSE2
+    if (img_n == out_n &&
+        png_unfilter_row_sse2(filter, img_n, cur, raw, prior, s->img_x)) {
+      raw += img_n * s->img_x;
+      continue;
+    }
+#endif
     // handle first pixel explicitly
     for (k = 0; k < img_n; ++k) {
       switch (filter) {
@@ -2321,6 +2837,12 @@ static int create_png_image(png *a, uint8 *raw, uint32 raw_len, int out_n) {
 #undef CASE
     }
   }
+  if (in_place) {
+    // drop the filter bytes' worth of slack at the end
+    uint8 *p = (uint8 *)STBI_REALLOC(a->out, s->img_x * s->img_y * out_n);
+    if (p)
+      a->out = p;
+  }
   return 1;
 }
 
@@ -2352,7 +2874,7 @@ static int expand_palette(png *a, uint8 *palette, int len, int pal_img_n) {
   uint32 i, pixel_count = a->s.img_x * a->s.img_y;
   uint8 *p, *temp_out, *orig = a->out;
 
-  p = (uint8 *)malloc(pixel_count * pal_img_n);
+  p = (uint8 *)STBI_MALLOC(pixel_count * pal_img_n);
   if (p == NULL)
     return e("outofmem", "Out of memory");
 
@@ -2377,7 +2899,7 @@ static int expand_palette(png *a, uint8 *palette, int len, int pal_img_n) {
       p += 4;
     }
   }
-  free(a->out);
+  STBI_FREE(a->out);
   a->out = temp_out;
   return 1;
 }
@@ -2385,8 +2907,8 @@ static int expand_palette(png *a, uint8 *palette, int len, int pal_img_n) {
 static int parse_png_file(png *z, int scan, int req_comp) {
   uint8 palette[1024], pal_img_n = 0;
   uint8 has_trans = 0, tc[3];
-  uint32 ioff = 0, idata_limit = 0, i, pal_len = 0;
-  int first = 1, k;
+  uint32 raw_len = 0, i, pal_len = 0;
+  int first = 1, have_next = 0, k;
   stbi *s = &z->s;
 
   if (!check_png_header(s))
@@ -2396,7 +2918,13 @@ static int parse_png_file(png *z, int scan, int req_comp) {
     return 1;
 
   for (;; first = 0) {
-    chunk c = get_chunk_header(s);
+    chunk c;
+    if (have_next) {
+      // inflating the IDATs already read the header of the chunk after them
+      c = z->next;
+      have_next = 0;
+    } else
+      c = get_chunk_header(s);
     if (first && c.type != PNG_TYPE('I', 'H', 'D', 'R'))
       return e("first not IHDR", "Corrupt PNG");
     switch (c.type) {
@@ -2466,7 +2994,7 @@ static int parse_png_file(png *z, int scan, int req_comp) {
     }
 
     case PNG_TYPE('t', 'R', 'N', 'S'): {
-      if (z->idata)
+      if (z->expanded)
         return e("tRNS after IDAT", "Corrupt PNG");
       if (pal_img_n) {
         if (scan == SCAN_header) {
@@ -2499,43 +3027,20 @@ static int parse_png_file(png *z, int scan, int req_comp) {
         s->img_n = pal_img_n;
         return 1;
       }
-      if (ioff + c.length > idata_limit) {
-        uint8 *p;
-        if (idata_limit == 0)
-          idata_limit = c.length > 4096 ? c.length : 4096;
-        while (ioff + c.length > idata_limit)
-          idata_limit *= 2;
-        p = (uint8 *)realloc(z->idata, idata_limit);
-        if (p == NULL)
-          return e("outofmem", "Out of memory");
-        z->idata = p;
-      }
-#ifndef STBI_NO_STDIO
-      if (s->img_file) {
-        if (fread(z->idata + ioff, 1, c.length, s->img_file) != c.length)
-          return e("outofdata", "Corrupt PNG");
-      } else
-#endif
-      {
-        memcpy(z->idata + ioff, s->img_buffer, c.length);
-        s->img_buffer += c.length;
-      }
-      ioff += c.length;
-      break;
+      if (z->expanded)
+        return e("IDATs not consecutive", "Corrupt PNG");
+      if (!png_inflate_idats(z, c.length, (s->img_n * s->img_x + 1) * s->img_y,
+                             &raw_len))
+        return 0;
+      have_next = 1;
+      continue; // the last IDAT's CRC has been read too
     }
 
     case PNG_TYPE('I', 'E', 'N', 'D'): {
-      uint32 raw_len;
       if (scan != SCAN_load)
         return 1;
-      if (z->idata == NULL)
-        return e("no IDAT", "Corrupt PNG");
-      z->expanded = (uint8 *)stbi_zlib_decode_malloc((char *)z->idata, ioff,
-                                                     (int *)&raw_len);
       if (z->expanded == NULL)
-        return 0; // zlib should set error
-      free(z->idata);
-      z->idata = NULL;
+        return e("no IDAT", "Corrupt PNG");
       if ((req_comp == s->img_n + 1 && req_comp != 3 && !pal_img_n) ||
           has_trans)
         s->img_out_n = s->img_n + 1;
@@ -2555,7 +3060,7 @@ static int parse_png_file(png *z, int scan, int req_comp) {
         if (!expand_palette(z, palette, pal_len, s->img_out_n))
           return 0;
       }
-      free(z->expanded);
+      STBI_FREE(z->expanded);
       z->expanded = NULL;
       return 1;
     }
@@ -2603,11 +3108,11 @@ static unsigned char *do_png(png *p, int *x, int *y, int *n, int req_comp) {
     if (n)
       *n = p->s.img_n;
   }
-  free(p->out);
+  STBI_FREE(p->out);
   p->out = NULL;
-  free(p->expanded);
+  STBI_FREE(p->expanded);
   p->expanded = NULL;
-  free(p->idata);
+  STBI_FREE(p->idata);
   p->idata = NULL;
 
   return result;
@@ -2658,13 +3163,47 @@ int stbi_png_test_memory(stbi_uc const *buffer, int len) {
   return parse_png_file(&p, SCAN_type, STBI_default);
 }
 
-// TODO: load header from png
+static int png_info(png *p, int *x, int *y, int *comp) {
+  p->expanded = NULL;
+  p->idata = NULL;
+  p->out = NULL;
+  if (!parse_png_file(p, SCAN_header, 0))
+    return 0;
+  *x = p->s.img_x;
+  *y = p->s.img_y;
+  if (comp)
+    *comp = p->s.img_n;
+  return 1;
+}
+
 #ifndef STBI_NO_STDIO
-extern int stbi_png_info(char const *filename, int *x, int *y, int *comp);
-extern int stbi_png_info_from_file(FILE *f, int *x, int *y, int *comp);
+int stbi_png_info(char const *filename, int *x, int *y, int *comp) {
+  int r;
+  FILE *f = fopen(filename, "rb");
+  if (!f)
+    return e("can't fopen", "Unable to open file");
+  r = stbi_png_info_from_file(f, x, y, comp);
+  fclose(f);
+  return r;
+}
+
+int stbi_png_info_from_file(FILE *f, int *x, int *y, int *comp) {
+  png p;
+  int n, r;
+  n = ftell(f);
+  start_file(&p.s, f);
+  r = png_info(&p, x, y, comp);
+  fseek(f, n, SEEK_SET);
+  return r;
+}
 #endif
-extern int stbi_png_info_from_memory(stbi_uc const *buffer, int len, int *x,
-                                     int *y, int *comp);
+
+int stbi_png_info_from_memory(stbi_uc const *buffer, int len, int *x, int *y,
+                              int *comp) {
+  png p;
+  start_mem(&p.s, buffer, len);
+  return png_info(&p, x, y, comp);
+}
 
 // Microsoft/Windows BMP image
 
@@ -2837,13 +3376,13 @@ static stbi_uc *bmp_load(stbi *s, int *x, int *y, int *comp, int req_comp) {
     target = req_comp;
   else
     target = s->img_n; // if they want monochrome, we'll post-convert
-  out = (stbi_uc *)malloc(target * s->img_x * s->img_y);
+  out = (stbi_uc *)STBI_MALLOC(target * s->img_x * s->img_y);
   if (!out)
     return epuc("outofmem", "Out of memory");
   if (bpp < 16) {
     int z = 0;
     if (psize == 0 || psize > 256) {
-      free(out);
+      STBI_FREE(out);
       return epuc("invalid", "Corrupt BMP");
     }
     for (i = 0; i < psize; ++i) {
@@ -2860,7 +3399,7 @@ static stbi_uc *bmp_load(stbi *s, int *x, int *y, int *comp, int req_comp) {
     else if (bpp == 8)
       width = s->img_x;
     else {
-      free(out);
+      STBI_FREE(out);
       return epuc("bad bpp", "Corrupt BMP");
     }
     pad = (-width) & 3;
@@ -2997,6 +3536,35 @@ stbi_uc *stbi_bmp_load_from_memory(stbi_uc const *buffer, int len, int *x,
   return bmp_load(&s, x, y, comp, req_comp);
 }
 
+// just the header of bmp_load
+static int bmp_info(stbi *s, int *x, int *y, int *comp) {
+  int hsz;
+  if (get8(s) != 'B' || get8(s) != 'M')
+    return e("not BMP", "Corrupt BMP");
+  skip(s, 12); // discard filesize, reserved, data offset
+  hsz = get32le(s);
+  if (hsz != 12 && hsz != 40 && hsz != 56 && hsz != 108)
+    return e("unknown BMP", "BMP type not supported: unknown");
+  if (hsz == 12) {
+    *x = get16le(s);
+    *y = get16le(s);
+  } else {
+    *x = get32le(s);
+    *y = abs((int)get32le(s));
+  }
+  if (get16le(s) != 1)
+    return e("bad BMP", "bad BMP");
+  if (get16le(s) == 1)
+    return e("monochrome", "BMP type not supported: 1-bit");
+  *comp = 3;
+  if (hsz == 108) {
+    skip(s, 36); // compression, sizes, resolution, colors, r/g/b masks
+    if (get32le(s))
+      *comp = 4;
+  }
+  return 1;
+}
+
 // Targa Truevision - TGA
 // by Jonathan Dummer
 
@@ -3099,7 +3667,7 @@ static stbi_uc *tga_load(stbi *s, int *x, int *y, int *comp, int req_comp) {
     //	force a new number of components
     *comp = tga_bits_per_pixel / 8;
   }
-  tga_data = (unsigned char *)malloc(tga_width * tga_height * req_comp);
+  tga_data = (unsigned char *)STBI_MALLOC(tga_width * tga_height * req_comp);
 
   //	skip to the data's starting position (offset usually = 0)
   skip(s, tga_offset);
@@ -3109,7 +3677,7 @@ static stbi_uc *tga_load(stbi *s, int *x, int *y, int *comp, int req_comp) {
     skip(s, tga_palette_start);
     //	load the palette
     tga_palette =
-        (unsigned char *)malloc(tga_palette_len * tga_palette_bits / 8);
+        (unsigned char *)STBI_MALLOC(tga_palette_len * tga_palette_bits / 8);
     getn(s, tga_palette, tga_palette_len * tga_palette_bits / 8);
   }
   //	load the data
@@ -3228,7 +3796,7 @@ static stbi_uc *tga_load(stbi *s, int *x, int *y, int *comp, int req_comp) {
   }
   //	clear my palette, if I had one
   if (tga_palette != NULL) {
-    free(tga_palette);
+    STBI_FREE(tga_palette);
   }
   //	the things I do to get rid of an error message, and yet keep
   //	Microsoft's C compilers happy... [8^(
@@ -3265,6 +3833,30 @@ stbi_uc *stbi_tga_load_from_memory(stbi_uc const *buffer, int len, int *x,
   return tga_load(&s, x, y, comp, req_comp);
 }
 
+//	just the header of tga_load
+static int tga_info(stbi *s, int *x, int *y, int *comp) {
+  int tga_indexed, tga_image_type, tga_palette_bits, tga_bits_per_pixel;
+  get8u(s); //	discard Offset
+  tga_indexed = get8u(s);
+  tga_image_type = get8u(s);
+  skip(s, 4); //	discard palette start & length
+  tga_palette_bits = get8u(s);
+  skip(s, 4); //	discard x & y origin
+  *x = get16le(s);
+  *y = get16le(s);
+  tga_bits_per_pixel = get8u(s);
+  if (tga_image_type >= 8) {
+    tga_image_type -= 8;
+  }
+  if ((*x < 1) || (*y < 1) || (tga_image_type < 1) || (tga_image_type > 3) ||
+      ((tga_bits_per_pixel != 8) && (tga_bits_per_pixel != 16) &&
+       (tga_bits_per_pixel != 24) && (tga_bits_per_pixel != 32))) {
+    return e("bad TGA", "Corrupt TGA");
+  }
+  *comp = (tga_indexed ? tga_palette_bits : tga_bits_per_pixel) / 8;
+  return 1;
+}
+
 // *************************************************************************************************
 // Photoshop PSD loader -- PD by Thatcher Ulrich, integration by Nicholas
 // Schulz, tweaked by STB
@@ -3357,7 +3949,7 @@ static stbi_uc *psd_load(stbi *s, int *x, int *y, int *comp, int req_comp) {
     return epuc("bad compression", "PSD has an unknown compression format");
 
   // Create the destination image.
-  out = (stbi_uc *)malloc(4 * w * h);
+  out = (stbi_uc *)STBI_MALLOC(4 * w * h);
   if (!out)
     return epuc("outofmem", "Out of memory");
   pixelCount = w * h;
@@ -3486,6 +4078,28 @@ stbi_uc *stbi_psd_load_from_memory(stbi_uc const *buffer, int len, int *x,
   return psd_load(&s, x, y, comp, req_comp);
 }
 
+// just the header of psd_load
+static int psd_info(stbi *s, int *x, int *y, int *comp) {
+  int channelCount;
+  if (get32(s) != 0x38425053) // "8BPS"
+    return e("not PSD", "Corrupt PSD image");
+  if (get16(s) != 1)
+    return e("wrong version", "Unsupported version of PSD image");
+  skip(s, 6);
+  channelCount = get16(s);
+  if (channelCount < 0 || channelCount > 16)
+    return e("wrong channel count",
+             "Unsupported number of channels in PSD image");
+  *y = get32(s);
+  *x = get32(s);
+  if (get16(s) != 8)
+    return e("unsupported bit depth", "PSD bit depth is not 8 bit");
+  if (get16(s) != 3)
+    return e("wrong color format", "PSD is not in RGB color format");
+  *comp = channelCount;
+  return 1;
+}
+
 // *************************************************************************************************
 // Radiance RGBE HDR loader
 // originally by Nicolas Schulz
@@ -3620,7 +4234,7 @@ static float *hdr_load(stbi *s, int *x, int *y, int *comp, int req_comp) {
     req_comp = 3;
 
   // Read data
-  hdr_data = (float *)malloc(height * width * req_comp * sizeof(float));
+  hdr_data = (float *)STBI_MALLOC(height * width * req_comp * sizeof(float));
 
   // Load image data
   // image data is stored as some number of sca
@@ -3651,19 +4265,19 @@ static float *hdr_load(stbi *s, int *x, int *y, int *comp, int req_comp) {
         hdr_convert(hdr_data, rgbe, req_comp);
         i = 1;
         j = 0;
-        free(scanline);
+        STBI_FREE(scanline);
         goto main_decode_loop; // yes, this is fucking insane; blame the fucking
                                // insane format
       }
       len <<= 8;
       len |= get8(s);
       if (len != width) {
-        free(hdr_data);
-        free(scanline);
+        STBI_FREE(hdr_data);
+        STBI_FREE(scanline);
         return epf("invalid decoded scanline length", "corrupt HDR");
       }
       if (scanline == NULL)
-        scanline = (stbi_uc *)malloc(width * 4);
+        scanline = (stbi_uc *)STBI_MALLOC(width * 4);
 
       for (k = 0; k < 4; ++k) {
         i = 0;
@@ -3686,7 +4300,7 @@ static float *hdr_load(stbi *s, int *x, int *y, int *comp, int req_comp) {
         hdr_convert(hdr_data + (j * width + i) * req_comp, scanline + i * 4,
                     req_comp);
     }
-    free(scanline);
+    STBI_FREE(scanline);
   }
 
   return hdr_data;
@@ -3742,7 +4356,7 @@ static stbi_uc *hdr_load_rgbe(stbi *s, int *x, int *y, int *comp,
   req_comp = 4;
 
   // Read data
-  rgbe_data = (stbi_uc *)malloc(height * width * req_comp * sizeof(stbi_uc));
+  rgbe_data = (stbi_uc *)STBI_MALLOC(height * width * req_comp * sizeof(stbi_uc));
   //	point to the beginning
   scanline = rgbe_data;
 
@@ -3780,7 +4394,7 @@ static stbi_uc *hdr_load_rgbe(stbi *s, int *x, int *y, int *comp,
       len <<= 8;
       len |= get8(s);
       if (len != width) {
-        free(rgbe_data);
+        STBI_FREE(rgbe_data);
         return epuc("invalid decoded scanline length", "corrupt HDR");
       }
       for (k = 0; k < 4; ++k) {
@@ -3851,37 +4465,264 @@ stbi_uc *stbi_hdr_load_rgbe_memory(stbi_uc *buffer, int len, int *x, int *y,
 
 #endif // STBI_NO_HDR
 
+//////////////////////////// image info //////////////////////////////////
+//
+// JPEG, PNG, BMP, PSD and TGA only read the header; the others (DDS, HDR
+// and any registered loaders) have no cheap way in, so they get decoded
+
+static int info_by_loading(stbi_uc *data) {
+  if (!data)
+    return 0;
+  STBI_FREE(data);
+  return 1;
+}
+
+#ifndef STBI_NO_STDIO
+int stbi_info(char const *filename, int *x, int *y, int *comp) {
+  int r;
+  FILE *f = fopen(filename, "rb");
+  if (!f)
+    return e("can't fopen", "Unable to open file");
+  r = stbi_info_from_file(f, x, y, comp);
+  fclose(f);
+  return r;
+}
+
+int stbi_info_from_file(FILE *f, int *x, int *y, int *comp) {
+  stbi s;
+  int i, r, n, dummy;
+  if (!comp)
+    comp = &dummy;
+  if (stbi_jpeg_test_file(f))
+    return stbi_jpeg_info_from_file(f, x, y, comp);
+  if (stbi_png_test_file(f))
+    return stbi_png_info_from_file(f, x, y, comp);
+  n = ftell(f);
+  start_file(&s, f);
+  if (stbi_bmp_test_file(f))
+    r = bmp_info(&s, x, y, comp);
+  else if (stbi_psd_test_file(f))
+    r = psd_info(&s, x, y, comp);
+  else {
+    int load = 0;
+#ifndef STBI_NO_DDS
+    load = load || stbi_dds_test_file(f);
+#endif
+#ifndef STBI_NO_HDR
+    load = load || stbi_hdr_test_file(f);
+#endif
+    for (i = 0; i < max_loaders && !load; ++i)
+      load = loaders[i]->test_file(f);
+    if (load)
+      r = info_by_loading(stbi_load_from_file(f, x, y, comp, 0));
+    else if (stbi_tga_test_file(f))
+      r = tga_info(&s, x, y, comp);
+    else
+      r = e("unknown image type", "Image not of any known type, or corrupt");
+  }
+  fseek(f, n, SEEK_SET);
+  return r;
+}
+#endif
+
+int stbi_info_from_memory(stbi_uc const *buffer, int len, int *x, int *y,
+                          int *comp) {
+  stbi s;
+  int i, load = 0, dummy;
+  if (!comp)
+    comp = &dummy;
+  if (stbi_jpeg_test_memory(buffer, len))
+    return stbi_jpeg_info_from_memory(buffer, len, x, y, comp);
+  if (stbi_png_test_memory(buffer, len))
+    return stbi_png_info_from_memory(buffer, len, x, y, comp);
+  start_mem(&s, buffer, len);
+  if (stbi_bmp_test_memory(buffer, len))
+    return bmp_info(&s, x, y, comp);
+  if (stbi_psd_test_memory(buffer, len))
+    return psd_info(&s, x, y, comp);
+#ifndef STBI_NO_DDS
+  load = load || stbi_dds_test_memory(buffer, len);
+#endif
+#ifndef STBI_NO_HDR
+  load = load || stbi_hdr_test_memory(buffer, len);
+#endif
+  for (i = 0; i < max_loaders && !load; ++i)
+    load = loaders[i]->test_memory(buffer, len);
+  if (load)
+    return info_by_loading(stbi_load_from_memory(buffer, len, x, y, comp, 0));
+  if (stbi_tga_test_memory(buffer, len))
+    return tga_info(&s, x, y, comp);
+  return e("unknown image type", "Image not of any known type, or corrupt");
+}
+
+//////////////////////// load into your own memory ////////////////////////
+//
+// JPEGs are decoded straight into out; everything else is decoded as
+// usual and copied in a row at a time
+
+static int copy_into(stbi_uc *data, int x, int y, int n, stbi_uc *out,
+                     int out_size, int stride) {
+  int j;
+  if (!data)
+    return 0;
+  if (!fits_into(x, y, n, out_size, stride)) {
+    STBI_FREE(data);
+    return e("too small", "Destination buffer too small");
+  }
+  for (j = 0; j < y; ++j)
+    memcpy(out + stride * j, data + x * n * j, x * n);
+  STBI_FREE(data);
+  return 1;
+}
+
+#ifndef STBI_NO_STDIO
+int stbi_load_into(char const *filename, stbi_uc *out, int out_size,
+                   int stride, int *x, int *y, int *comp, int req_comp) {
+  int r;
+  FILE *f = fopen(filename, "rb");
+  if (!f)
+    return e("can't fopen", "Unable to open file");
+  r = stbi_load_into_from_file(f, out, out_size, stride, x, y, comp,
+                               req_comp);
+  fclose(f);
+  return r;
+}
+
+int stbi_load_into_from_file(FILE *f, stbi_uc *out, int out_size, int stride,
+                             int *x, int *y, int *comp, int req_comp) {
+  stbi_uc *data;
+  if (req_comp < 1 || req_comp > 4)
+    return e("bad req_comp", "Internal error");
+  if (stbi_jpeg_test_file(f)) {
+    jpeg j;
+    start_file(&j.s, f);
+    return load_jpeg_image(&j, out, out_size, stride, x, y, comp, req_comp) !=
+           NULL;
+  }
+  data = stbi_load_from_file(f, x, y, comp, req_comp);
+  return data ? copy_into(data, *x, *y, req_comp, out, out_size, stride) : 0;
+}
+#endif
+
+int stbi_load_into_from_memory(stbi_uc const *buffer, int len, stbi_uc *out,
+                               int out_size, int stride, int *x, int *y,
+                               int *comp, int req_comp) {
+  stbi_uc *data;
+  if (req_comp < 1 || req_comp > 4)
+    return e("bad req_comp", "Internal error");
+  if (stbi_jpeg_test_memory(buffer, len)) {
+    jpeg j;
+    start_mem(&j.s, buffer, len);
+    return load_jpeg_image(&j, out, out_size, stride, x, y, comp, req_comp) !=
+           NULL;
+  }
+  data = stbi_load_from_memory(buffer, len, x, y, comp, req_comp);
+  return data ? copy_into(data, *x, *y, req_comp, out, out_size, stride) : 0;
+}
+
 /////////////////////// write image ///////////////////////
 
 #ifndef STBI_NO_WRITE
 
-static void write8(FILE *f, int x) {
+// where the writers put their bytes: straight into a FILE, or else into a
+// growing malloc'ed buffer; the bit fields are for the deflate encoder
+typedef struct {
+  FILE *f;
+  uint8 *data;
+  uint32 len, cap;
+  uint32 bits;
+  int num_bits;
+  int failed;
+} wbuf;
+
+static void wbuf_reserve(wbuf *b, uint32 n) {
+  uint8 *p;
+  uint32 cap = b->cap ? b->cap : 4096;
+  if (b->failed || b->len + n <= b->cap)
+    return;
+  while (cap < b->len + n)
+    cap *= 2;
+  p = (uint8 *)STBI_REALLOC(b->data, cap);
+  if (p == NULL) {
+    b->failed = 1;
+    return;
+  }
+  b->data = p;
+  b->cap = cap;
+}
+
+static void wbuf_put(wbuf *b, const void *p, uint32 n) {
+  if (b->f) {
+    if (fwrite(p, 1, n, b->f) != n)
+      b->failed = 1;
+    return;
+  }
+  wbuf_reserve(b, n);
+  if (b->failed)
+    return;
+  memcpy(b->data + b->len, p, n);
+  b->len += n;
+}
+
+static void wbuf_put32be(wbuf *b, uint32 x) {
+  uint8 v[4];
+  v[0] = (uint8)(x >> 24);
+  v[1] = (uint8)(x >> 16);
+  v[2] = (uint8)(x >> 8);
+  v[3] = (uint8)x;
+  wbuf_put(b, v, 4);
+}
+
+static int wbuf_open(wbuf *b, char const *filename) {
+  memset(b, 0, sizeof(*b));
+  b->f = fopen(filename, "wb");
+  return b->f != NULL;
+}
+
+static int wbuf_close(wbuf *b) {
+  if (fclose(b->f))
+    b->failed = 1;
+  return !b->failed;
+}
+
+// hands over the buffer, or frees it and returns NULL if anything failed
+static stbi_uc *wbuf_release(wbuf *b, int *out_len) {
+  if (b->failed) {
+    STBI_FREE(b->data);
+    return NULL;
+  }
+  if (out_len)
+    *out_len = (int)b->len;
+  return b->data;
+}
+
+static void write8(wbuf *b, int x) {
   uint8 z = (uint8)x;
-  fwrite(&z, 1, 1, f);
+  wbuf_put(b, &z, 1);
 }
 
-static void writefv(FILE *f, char *fmt, va_list v) {
+static void writefv(wbuf *b, char *fmt, va_list v) {
   while (*fmt) {
     switch (*fmt++) {
     case ' ':
       break;
     case '1': {
       uint8 x = va_arg(v, int);
-      write8(f, x);
+      write8(b, x);
       break;
     }
     case '2': {
       int16 x = va_arg(v, int);
-      write8(f, x);
-      write8(f, x >> 8);
+      write8(b, x);
+      write8(b, x >> 8);
       break;
     }
     case '4': {
       int32 x = va_arg(v, int);
-      write8(f, x);
-      write8(f, x >> 8);
-      write8(f, x >> 16);
-      write8(f, x >> 24);
+      write8(b, x);
+      write8(b, x >> 8);
+      write8(b, x >> 16);
+      write8(b, x >> 24);
       break;
     }
     default:
@@ -3892,15 +4733,16 @@ static void writefv(FILE *f, char *fmt, va_list v) {
   }
 }
 
-static void writef(FILE *f, char *fmt, ...) {
+static void writef(wbuf *b, char *fmt, ...) {
   va_list v;
   va_start(v, fmt);
-  writefv(f, fmt, v);
+  writefv(b, fmt, v);
   va_end(v);
 }
 
-static void write_pixels(FILE *f, int rgb_dir, int vdir, int x, int y, int comp,
-                         void *data, int write_alpha, int scanline_pad) {
+static void write_pixels(wbuf *b, int rgb_dir, int vdir, int x, int y,
+                         int comp, void *data, int write_alpha,
+                         int scanline_pad) {
   uint8 bg[3] = {255, 0, 255}, px[3];
   uint32 zero = 0;
   int i, j, k, j_end;
@@ -3914,64 +4756,775 @@ static void write_pixels(FILE *f, int rgb_dir, int vdir, int x, int y, int comp,
     for (i = 0; i < x; ++i) {
       uint8 *d = (uint8 *)data + (j * x + i) * comp;
       if (write_alpha < 0)
-        fwrite(&d[comp - 1], 1, 1, f);
+        wbuf_put(b, &d[comp - 1], 1);
       switch (comp) {
       case 1:
       case 2:
-        writef(f, "111", d[0], d[0], d[0]);
+        writef(b, "111", d[0], d[0], d[0]);
         break;
       case 4:
         if (!write_alpha) {
           for (k = 0; k < 3; ++k)
             px[k] = bg[k] + ((d[k] - bg[k]) * d[3]) / 255;
-          writef(f, "111", px[1 - rgb_dir], px[1], px[1 + rgb_dir]);
+          writef(b, "111", px[1 - rgb_dir], px[1], px[1 + rgb_dir]);
           break;
         }
         /* FALLTHROUGH */
       case 3:
-        writef(f, "111", d[1 - rgb_dir], d[1], d[1 + rgb_dir]);
+        writef(b, "111", d[1 - rgb_dir], d[1], d[1 + rgb_dir]);
         break;
       }
       if (write_alpha > 0)
-        fwrite(&d[comp - 1], 1, 1, f);
+        wbuf_put(b, &d[comp - 1], 1);
     }
-    fwrite(&zero, scanline_pad, 1, f);
+    wbuf_put(b, &zero, scanline_pad);
   }
 }
 
-static int outfile(char const *filename, int rgb_dir, int vdir, int x, int y,
-                   int comp, void *data, int alpha, int pad, char *fmt, ...) {
-  FILE *f = fopen(filename, "wb");
-  if (f) {
-    va_list v;
-    va_start(v, fmt);
-    writefv(f, fmt, v);
-    va_end(v);
-    write_pixels(f, rgb_dir, vdir, x, y, comp, data, alpha, pad);
-    fclose(f);
-  }
-  return f != NULL;
+static void outbuf(wbuf *b, int rgb_dir, int vdir, int x, int y, int comp,
+                   void *data, int alpha, int pad, char *fmt, ...) {
+  va_list v;
+  va_start(v, fmt);
+  writefv(b, fmt, v);
+  va_end(v);
+  write_pixels(b, rgb_dir, vdir, x, y, comp, data, alpha, pad);
 }
 
-int stbi_write_bmp(char const *filename, int x, int y, int comp, void *data) {
+static void write_bmp(wbuf *b, int x, int y, int comp, void *data) {
   int pad = (-x * 3) & 3;
-  return outfile(filename, -1, -1, x, y, comp, data, 0, pad,
-                 "11 4 22 4"
-                 "4 44 22 444444",
-                 'B', 'M', 14 + 40 + (x * 3 + pad) * y, 0, 0,
-                 14 + 40,                            // file header
-                 40, x, y, 1, 24, 0, 0, 0, 0, 0, 0); // bitmap header
+  outbuf(b, -1, -1, x, y, comp, data, 0, pad,
+         "11 4 22 4"
+         "4 44 22 444444",
+         'B', 'M', 14 + 40 + (x * 3 + pad) * y, 0, 0,
+         14 + 40,                            // file header
+         40, x, y, 1, 24, 0, 0, 0, 0, 0, 0); // bitmap header
 }
 
-int stbi_write_tga(char const *filename, int x, int y, int comp, void *data) {
+static void write_tga(wbuf *b, int x, int y, int comp, void *data) {
   int has_alpha = !(comp & 1);
-  return outfile(filename, -1, -1, x, y, comp, data, has_alpha, 0,
-                 "111 221 2222 11", 0, 0, 2, 0, 0, 0, 0, 0, x, y,
-                 24 + 8 * has_alpha, 8 * has_alpha);
+  outbuf(b, -1, -1, x, y, comp, data, has_alpha, 0, "111 221 2222 11", 0, 0,
+         2, 0, 0, 0, 0, 0, x, y, 24 + 8 * has_alpha, 8 * has_alpha);
+}
+
+int stbi_write_bmp(char const *filename, int x, int y, int comp, void *data) {
+  wbuf b;
+  if (!wbuf_open(&b, filename))
+    return 0;
+  write_bmp(&b, x, y, comp, data);
+  return wbuf_close(&b);
+}
+
+int stbi_write_tga(char const *filename, int x, int y, int comp, void *data) {
+  wbuf b;
+  if (!wbuf_open(&b, filename))
+    return 0;
+  write_tga(&b, x, y, comp, data);
+  return wbuf_close(&b);
+}
+
+stbi_uc *stbi_write_bmp_to_mem(int x, int y, int comp, void *data,
+                               int *out_len) {
+  wbuf b;
+  memset(&b, 0, sizeof(b));
+  write_bmp(&b, x, y, comp, data);
+  return wbuf_release(&b, out_len);
+}
+
+stbi_uc *stbi_write_tga_to_mem(int x, int y, int comp, void *data,
+                               int *out_len) {
+  wbuf b;
+  memset(&b, 0, sizeof(b));
+  write_tga(&b, x, y, comp, data);
+  return wbuf_release(&b, out_len);
+}
+
+// PNG writer
+//    filters each row with whichever of the five filters gives the smallest
+//    sum of absolute differences (the libpng heuristic), then deflates with
+//    hash-chain LZ77 and per-block fixed or dynamic huffman codes
+
+// codes go in LSB first, so huffman codes are stored bit-reversed
+static void zw_put_bits(wbuf *b, uint32 code, int n) {
+  b->bits |= code << b->num_bits;
+  b->num_bits += n;
+  if (b->num_bits >= 16) {
+    uint8 v[2];
+    v[0] = (uint8)b->bits;
+    v[1] = (uint8)(b->bits >> 8);
+    wbuf_put(b, v, 2);
+    b->bits >>= 16;
+    b->num_bits -= 16;
+  }
+}
+
+static void zw_flush_bits(wbuf *b) {
+  while (b->num_bits > 0) {
+    uint8 v = (uint8)b->bits;
+    wbuf_put(b, &v, 1);
+    b->bits >>= 8;
+    b->num_bits -= 8;
+  }
+  b->bits = 0;
+  b->num_bits = 0;
+}
+
+#define ZW_WINDOW 32768
+#define ZW_HASH_BITS 15
+#define ZW_BLOCK_TOKENS 16384
+
+typedef struct {
+  uint16 litlen; // literal byte, or match length
+  uint16 dist;   // 0 for a literal
+} zwtoken;
+
+typedef struct {
+  uint32 freq;
+  uint16 sym;
+} zwsym;
+
+static int zw_sym_cmp(const void *a, const void *b) {
+  uint32 x = ((const zwsym *)a)->freq, y = ((const zwsym *)b)->freq;
+  return x < y ? -1 : x > y;
+}
+
+// huffman code lengths of at most 'limit' bits for freq[0..n); uses the
+// in-place minimum-redundancy algorithm of Moffat & Katajainen, then
+// rebalances over-long codes the way zlib-derived encoders do
+static void zw_build_lengths(const uint32 *freq, int n, int limit,
+                             uint8 *lens) {
+  zwsym a[288];
+  int count[33];
+  int i, k, used = 0;
+  memset(lens, 0, n);
+  for (i = 0; i < n; ++i)
+    if (freq[i]) {
+      a[used].freq = freq[i];
+      a[used].sym = (uint16)i;
+      ++used;
+    }
+  if (used == 0)
+    return;
+  if (used == 1) {
+    lens[a[0].sym] = 1;
+    return;
+  }
+  qsort(a, used, sizeof(a[0]), zw_sym_cmp);
+  {
+    int root = 0, leaf = 2, next, avail, depth, taken;
+    a[0].freq += a[1].freq;
+    for (next = 1; next < used - 1; ++next) {
+      if (leaf >= used || a[root].freq < a[leaf].freq) {
+        a[next].freq = a[root].freq;
+        a[root++].freq = next;
+      } else
+        a[next].freq = a[leaf++].freq;
+      if (leaf >= used || (root < next && a[root].freq < a[leaf].freq)) {
+        a[next].freq += a[root].freq;
+        a[root++].freq = next;
+      } else
+        a[next].freq += a[leaf++].freq;
+    }
+    a[used - 2].freq = 0;
+    for (next = used - 3; next >= 0; --next)
+      a[next].freq = a[a[next].freq].freq + 1;
+    avail = 1;
+    taken = depth = 0;
+    root = used - 2;
+    next = used - 1;
+    while (avail > 0) {
+      while (root >= 0 && (int)a[root].freq == depth) {
+        ++taken;
+        --root;
+      }
+      while (avail > taken) {
+        a[next--].freq = depth;
+        --avail;
+      }
+      avail = 2 * taken;
+      ++depth;
+      taken = 0;
+    }
+  }
+  memset(count, 0, sizeof(count));
+  for (i = 0; i < used; ++i)
+    ++count[a[i].freq < 32 ? a[i].freq : 32];
+  for (i = limit + 1; i <= 32; ++i) {
+    count[limit] += count[i];
+    count[i] = 0;
+  }
+  {
+    uint32 total = 0;
+    for (i = limit; i > 0; --i)
+      total += (uint32)count[i] << (limit - i);
+    while (total != (1u << limit)) {
+      --count[limit];
+      for (i = limit - 1; i > 0; --i)
+        if (count[i]) {
+          --count[i];
+          count[i + 1] += 2;
+          break;
+        }
+      --total;
+    }
+  }
+  // shortest codes to the most frequent symbols (the end of 'a')
+  for (i = 1, k = used; i <= limit; ++i) {
+    int c = count[i];
+    while (c--)
+      lens[a[--k].sym] = (uint8)i;
+  }
+}
+
+// canonical codes for the given lengths, bit-reversed for zw_put_bits
+static void zw_build_codes(const uint8 *lens, int n, uint16 *codes) {
+  int i, count[16], next[16], code = 0;
+  memset(count, 0, sizeof(count));
+  for (i = 0; i < n; ++i)
+    ++count[lens[i]];
+  count[0] = 0;
+  for (i = 1; i < 16; ++i) {
+    code = (code + count[i - 1]) << 1;
+    next[i] = code;
+  }
+  for (i = 0; i < n; ++i)
+    if (lens[i])
+      codes[i] = (uint16)(bit_reverse(next[lens[i]]++, lens[i]));
+}
+
+typedef struct {
+  wbuf *out;
+  const uint8 *data;
+  zwtoken tokens[ZW_BLOCK_TOKENS];
+  int num_tokens;
+  uint32 block_start; // first input byte of the pending block
+  int stored_only;
+  uint8 len_code[259];
+  uint8 dist_code[512];
+} zwstate;
+
+static int zw_dist_code(zwstate *z, int dist) {
+  return dist <= 256 ? z->dist_code[dist - 1]
+                     : z->dist_code[256 + ((dist - 1) >> 7)];
+}
+
+static void zw_write_tokens(zwstate *z, const uint16 *lcodes,
+                            const uint8 *llens, const uint16 *dcodes,
+                            const uint8 *dlens) {
+  wbuf *b = z->out;
+  int i;
+  for (i = 0; i < z->num_tokens; ++i) {
+    zwtoken t = z->tokens[i];
+    if (t.dist == 0) {
+      zw_put_bits(b, lcodes[t.litlen], llens[t.litlen]);
+    } else {
+      int lc = z->len_code[t.litlen], dc = zw_dist_code(z, t.dist);
+      zw_put_bits(b, lcodes[257 + lc], llens[257 + lc]);
+      if (length_extra[lc])
+        zw_put_bits(b, t.litlen - length_base[lc], length_extra[lc]);
+      zw_put_bits(b, dcodes[dc], dlens[dc]);
+      if (dist_extra[dc])
+        zw_put_bits(b, t.dist - dist_base[dc], dist_extra[dc]);
+    }
+  }
+  zw_put_bits(b, lcodes[256], llens[256]);
+}
+
+static uint8 zw_clen_order[19] = {16, 17, 18, 0, 8,  7, 9,  6, 10, 5,
+                                  11, 4,  12, 3, 13, 2, 14, 1, 15};
+
+// write the pending tokens as one block: stored, fixed or dynamic huffman,
+// whichever is smallest
+static void zw_flush_block(zwstate *z, uint32 block_end, int final) {
+  wbuf *b = z->out;
+  uint32 lfreq[286], dfreq[30], cfreq[19];
+  uint8 llens[286], dlens[30], clens[19], fllens[288], fdlens[30];
+  uint16 lcodes[286], dcodes[30], ccodes[19], flcodes[288], fdcodes[30];
+  uint8 lens[286 + 30], rle[286 + 30], rle_extra[286 + 30];
+  int hlit, hdist, hclen, nlens, nrle = 0, i, j;
+  uint32 extra_bits = 0, dyn_bits, fixed_bits, stored_bits;
+  uint32 raw_len = block_end - z->block_start;
+
+  memset(lfreq, 0, sizeof(lfreq));
+  memset(dfreq, 0, sizeof(dfreq));
+  for (i = 0; i < z->num_tokens; ++i) {
+    zwtoken t = z->tokens[i];
+    if (t.dist == 0)
+      ++lfreq[t.litlen];
+    else {
+      int lc = z->len_code[t.litlen], dc = zw_dist_code(z, t.dist);
+      ++lfreq[257 + lc];
+      ++dfreq[dc];
+      extra_bits += length_extra[lc] + dist_extra[dc];
+    }
+  }
+  lfreq[256] = 1;
+
+  // dynamic code lengths, and their run-length coded form
+  zw_build_lengths(lfreq, 286, 15, llens);
+  zw_build_lengths(dfreq, 30, 15, dlens);
+  for (hlit = 286; hlit > 257 && llens[hlit - 1] == 0; --hlit)
+    ;
+  for (hdist = 30; hdist > 1 && dlens[hdist - 1] == 0; --hdist)
+    ;
+  if (dlens[0] == 0 && hdist == 1)
+    dlens[0] = 1; // no matches: still need one distance code
+  memcpy(lens, llens, hlit);
+  memcpy(lens + hlit, dlens, hdist);
+  nlens = hlit + hdist;
+  memset(cfreq, 0, sizeof(cfreq));
+  for (i = 0; i < nlens; i = j) {
+    int run;
+    for (j = i + 1; j < nlens && lens[j] == lens[i]; ++j)
+      ;
+    run = j - i;
+    if (lens[i] == 0 && run >= 3) {
+      if (run > 138)
+        run = 138;
+      rle[nrle] = run <= 10 ? 17 : 18;
+      rle_extra[nrle++] = (uint8)(run - (run <= 10 ? 3 : 11));
+    } else if (lens[i] != 0 && run >= 4) {
+      // the first copy goes out literally, then repeat 3..6 at a time
+      if (run > 7)
+        run = 7;
+      rle[nrle] = lens[i];
+      rle_extra[nrle++] = 0;
+      rle[nrle] = 16;
+      rle_extra[nrle++] = (uint8)(run - 4);
+    } else {
+      run = 1;
+      rle[nrle] = lens[i];
+      rle_extra[nrle++] = 0;
+    }
+    ++cfreq[rle[nrle - 1]];
+    if (rle[nrle - 1] == 16)
+      ++cfreq[rle[nrle - 2]];
+    j = i + run;
+  }
+  zw_build_lengths(cfreq, 19, 7, clens);
+  for (hclen = 19; hclen > 4 && clens[zw_clen_order[hclen - 1]] == 0; --hclen)
+    ;
+
+  dyn_bits = 3 + 5 + 5 + 4 + 3 * hclen + extra_bits;
+  for (i = 0; i < nrle; ++i)
+    dyn_bits += clens[rle[i]] + (rle[i] == 16 ? 2 : rle[i] == 17 ? 3
+                                                 : rle[i] == 18 ? 7 : 0);
+  for (i = 0; i < 286; ++i)
+    dyn_bits += lfreq[i] * llens[i];
+  for (i = 0; i < 30; ++i)
+    dyn_bits += dfreq[i] * dlens[i];
+
+  for (i = 0; i < 288; ++i)
+    fllens[i] = i < 144 ? 8 : i < 256 ? 9 : i < 280 ? 7 : 8;
+  for (i = 0; i < 30; ++i)
+    fdlens[i] = 5;
+  fixed_bits = 3 + extra_bits;
+  for (i = 0; i < 286; ++i)
+    fixed_bits += lfreq[i] * fllens[i];
+  for (i = 0; i < 30; ++i)
+    fixed_bits += dfreq[i] * 5;
+
+  // 5 bytes of header per 65535 byte piece, plus the byte alignment
+  stored_bits = (raw_len + 5 * ((raw_len + 65534) / 65535 + 1)) * 8;
+
+  if (z->stored_only || (stored_bits <= fixed_bits && stored_bits <= dyn_bits)) {
+    uint32 pos = z->block_start;
+    do {
+      uint32 n = block_end - pos > 65535 ? 65535 : block_end - pos;
+      uint8 hdr[4];
+      zw_put_bits(b, (final && pos + n == block_end) ? 1 : 0, 3);
+      zw_flush_bits(b);
+      hdr[0] = (uint8)n;
+      hdr[1] = (uint8)(n >> 8);
+      hdr[2] = (uint8)~n;
+      hdr[3] = (uint8)(~n >> 8);
+      wbuf_put(b, hdr, 4);
+      wbuf_put(b, z->data + pos, n);
+      pos += n;
+    } while (pos < block_end);
+  } else if (fixed_bits <= dyn_bits) {
+    zw_put_bits(b, final | (1 << 1), 3);
+    zw_build_codes(fllens, 288, flcodes);
+    zw_build_codes(fdlens, 30, fdcodes);
+    zw_write_tokens(z, flcodes, fllens, fdcodes, fdlens);
+  } else {
+    zw_put_bits(b, final | (2 << 1), 3);
+    zw_put_bits(b, hlit - 257, 5);
+    zw_put_bits(b, hdist - 1, 5);
+    zw_put_bits(b, hclen - 4, 4);
+    for (i = 0; i < hclen; ++i)
+      zw_put_bits(b, clens[zw_clen_order[i]], 3);
+    zw_build_codes(clens, 19, ccodes);
+    for (i = 0; i < nrle; ++i) {
+      zw_put_bits(b, ccodes[rle[i]], clens[rle[i]]);
+      if (rle[i] >= 16)
+        zw_put_bits(b, rle_extra[i], rle[i] == 16 ? 2 : rle[i] == 17 ? 3 : 7);
+    }
+    zw_build_codes(llens, 286, lcodes);
+    zw_build_codes(dlens, 30, dcodes);
+    zw_write_tokens(z, lcodes, llens, dcodes, dlens);
+  }
+  z->num_tokens = 0;
+  z->block_start = block_end;
+}
+
+// match search effort per level, as in zlib: reduce the chain when the
+// match to beat is already 'good'; only try a lazy match below 'lazy' (for
+// levels 1-3, only index the bytes inside matches up to that long); stop
+// searching at 'nice'
+typedef struct {
+  int good, lazy, nice, chain;
+} zwlevel;
+
+static zwlevel zw_levels[10] = {
+    {0, 0, 0, 0},      {4, 4, 8, 4},       {4, 5, 16, 8},
+    {4, 6, 32, 32},    {4, 4, 16, 16},     {8, 16, 32, 32},
+    {8, 16, 128, 128}, {8, 32, 128, 256},  {32, 128, 258, 1024},
+    {32, 258, 258, 4096}};
+
+typedef struct {
+  int *head; // most recent position for each hash, or -1
+  int *prev; // previous position with the same hash, per window slot
+  int nice;
+} zwmatcher;
+
+static uint32 zw_hash(const uint8 *p) {
+  uint32 v = (uint32)p[0] | ((uint32)p[1] << 8) | ((uint32)p[2] << 16);
+  return (v * 2654435761u) >> (32 - ZW_HASH_BITS);
+}
+
+// position i must have 3 bytes left to hash
+static void zw_insert(zwmatcher *m, const uint8 *data, int i) {
+  uint32 h = zw_hash(data + i);
+  m->prev[i & (ZW_WINDOW - 1)] = m->head[h];
+  m->head[h] = i;
+}
+
+static int zw_match_len(const uint8 *p, const uint8 *q, int max) {
+  int len = 0;
+#if defined(__GNUC__) && defined(__BYTE_ORDER__) &&                            \
+    __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  while (len + 8 <= max) {
+    uint64 a, b;
+    memcpy(&a, p + len, 8);
+    memcpy(&b, q + len, 8);
+    if (a != b)
+      return len + (__builtin_ctzll(a ^ b) >> 3);
+    len += 8;
+  }
+#endif
+  while (len < max && p[len] == q[len])
+    ++len;
+  return len;
+}
+
+// longest match at i that beats 'best', or 0
+static int zw_find(zwmatcher *m, const uint8 *data, int i, int n, int chain,
+                   int best, int *dist) {
+  int found = 0, max = n - i, cand;
+  if (max < 3)
+    return 0;
+  if (max > 258)
+    max = 258;
+  if (best >= max)
+    return 0;
+  cand = m->head[zw_hash(data + i)];
+  while (cand >= 0 && i - cand <= ZW_WINDOW && chain--) {
+    const uint8 *p = data + cand, *q = data + i;
+    if (p[best] == q[best] && p[0] == q[0] && p[1] == q[1]) {
+      int len = zw_match_len(p, q, max);
+      if (len > best) {
+        best = found = len;
+        *dist = i - cand;
+        if (len >= m->nice || len == max)
+          break;
+      }
+    }
+    cand = m->prev[cand & (ZW_WINDOW - 1)];
+  }
+  return found >= 3 ? found : 0;
+}
+
+static void zw_emit(zwstate *z, int litlen, int dist, uint32 end) {
+  z->tokens[z->num_tokens].litlen = (uint16)litlen;
+  z->tokens[z->num_tokens].dist = (uint16)dist;
+  if (++z->num_tokens == ZW_BLOCK_TOKENS)
+    zw_flush_block(z, end, 0);
+}
+
+// appends a zlib stream holding data[0..n) to 'out'
+static int zw_compress(wbuf *out, const uint8 *data, int n, int level) {
+  static uint8 level_flags[10] = {0, 0, 1, 1, 1, 1, 2, 2, 3, 3};
+  zwstate *z;
+  zwmatcher m;
+  uint32 s1 = 1, s2 = 0;
+  int i, k, cmf = 0x78, flg;
+
+  z = (zwstate *)STBI_MALLOC(sizeof(*z));
+  m.head = (int *)STBI_MALLOC(sizeof(int) << ZW_HASH_BITS);
+  m.prev = (int *)STBI_MALLOC(sizeof(int) * ZW_WINDOW);
+  if (z == NULL || m.head == NULL || m.prev == NULL) {
+    STBI_FREE(z);
+    STBI_FREE(m.head);
+    STBI_FREE(m.prev);
+    return 0;
+  }
+  memset(m.head, 0xff, sizeof(int) << ZW_HASH_BITS);
+  m.nice = zw_levels[level].nice;
+  for (k = 0; k < 28; ++k)
+    for (i = length_base[k]; i < length_base[k + 1]; ++i)
+      z->len_code[i] = (uint8)k;
+  z->len_code[258] = 28;
+  for (k = 0; k < 30; ++k)
+    for (i = dist_base[k]; i < dist_base[k] + (1 << dist_extra[k]); ++i)
+      z->dist_code[i <= 256 ? i - 1 : 256 + ((i - 1) >> 7)] = (uint8)k;
+  z->out = out;
+  z->data = data;
+  z->num_tokens = 0;
+  z->block_start = 0;
+  z->stored_only = level == 0;
+
+  flg = level_flags[level] << 6;
+  flg |= 31 - (cmf * 256 + flg) % 31;
+  zw_put_bits(out, cmf, 8);
+  zw_put_bits(out, flg, 8);
+
+  if (level == 0) {
+    zw_flush_block(z, n, 1);
+  } else {
+    const zwlevel *lv = &zw_levels[level];
+    int lazy = level >= 4, len = -1, dist = 0;
+    i = 0;
+    while (i < n) {
+      int len2, dist2 = 0;
+      if (len < 0) {
+        len = zw_find(&m, data, i, n, lv->chain, 2, &dist);
+        if (i + 3 <= n)
+          zw_insert(&m, data, i);
+      }
+      if (len && lazy && len < lv->lazy && i + 1 < n) {
+        len2 = zw_find(&m, data, i + 1, n,
+                       len >= lv->good ? lv->chain >> 2 : lv->chain, len,
+                       &dist2);
+        if (i + 4 <= n)
+          zw_insert(&m, data, i + 1);
+        if (len2) {
+          zw_emit(z, data[i], 0, i + 1);
+          ++i;
+          len = len2;
+          dist = dist2;
+          continue;
+        }
+        k = i + 2;
+      } else
+        k = i + 1;
+      if (len) {
+        zw_emit(z, len, dist, i + len);
+        if (lazy || len <= lv->lazy)
+          for (; k < i + len && k + 3 <= n; ++k)
+            zw_insert(&m, data, k);
+        i += len;
+      } else {
+        zw_emit(z, data[i], 0, i + 1);
+        ++i;
+      }
+      len = -1;
+    }
+    zw_flush_block(z, n, 1);
+  }
+  zw_flush_bits(out);
+
+  // adler32 of the uncompressed data
+  for (i = 0; i < n;) {
+    int end = n - i > 5552 ? i + 5552 : n;
+    for (; i < end; ++i) {
+      s1 += data[i];
+      s2 += s1;
+    }
+    s1 %= 65521;
+    s2 %= 65521;
+  }
+  wbuf_put32be(out, (s2 << 16) | s1);
+
+  STBI_FREE(z);
+  STBI_FREE(m.head);
+  STBI_FREE(m.prev);
+  return !out->failed;
+}
+
+static uint32 png_crc32(const uint32 *table, const uint8 *p, uint32 n,
+                        uint32 crc) {
+  crc = ~crc;
+  while (n--)
+    crc = table[(crc ^ *p++) & 255] ^ (crc >> 8);
+  return ~crc;
+}
+
+// appends a chunk whose data has already been placed at the end of 'b',
+// starting at 'start' (which leaves room for the length and type)
+static void png_end_chunk(wbuf *b, const uint32 *crc_table, uint32 start) {
+  uint32 len = b->len - start - 8;
+  if (b->failed)
+    return;
+  b->data[start + 0] = (uint8)(len >> 24);
+  b->data[start + 1] = (uint8)(len >> 16);
+  b->data[start + 2] = (uint8)(len >> 8);
+  b->data[start + 3] = (uint8)len;
+  wbuf_put32be(b, png_crc32(crc_table, b->data + start + 4, len + 4, 0));
+}
+
+typedef struct {
+  const uint8 *pixels;
+  uint8 *filtered;
+  int x, y, comp;
+  int rows_per_band;
+  int filter; // -1 to pick per row
+} pngwfilter;
+
+// filter one band of rows into 'filtered'; bands are independent
+static void png_filter_band(void *data, int band) {
+  pngwfilter *f = (pngwfilter *)data;
+  int stride = f->x * f->comp, n = f->comp, j, i;
+  int j_end = (band + 1) * f->rows_per_band;
+  if (j_end > f->y)
+    j_end = f->y;
+  for (j = band * f->rows_per_band; j < j_end; ++j) {
+    const uint8 *cur = f->pixels + (size_t)stride * j;
+    const uint8 *prior = j ? cur - stride : NULL;
+    uint8 *out = f->filtered + (size_t)(stride + 1) * j;
+    int filter = f->filter;
+    if (filter < 0) {
+      // smallest sum of |filtered byte as signed|
+      uint32 cost[5] = {0, 0, 0, 0, 0};
+      int k;
+      for (i = 0; i < stride; ++i) {
+        int a = i >= n ? cur[i - n] : 0;
+        int b = prior ? prior[i] : 0;
+        int c = prior && i >= n ? prior[i - n] : 0;
+        cost[0] += abs((signed char)cur[i]);
+        cost[1] += abs((signed char)(cur[i] - a));
+        cost[2] += abs((signed char)(cur[i] - b));
+        cost[3] += abs((signed char)(cur[i] - ((a + b) >> 1)));
+        cost[4] += abs((signed char)(cur[i] - paeth(a, b, c)));
+      }
+      filter = 0;
+      for (k = 1; k < 5; ++k)
+        if (cost[k] < cost[filter])
+          filter = k;
+    }
+    *out++ = (uint8)filter;
+    for (i = 0; i < stride; ++i) {
+      int a = i >= n ? cur[i - n] : 0;
+      int b = prior ? prior[i] : 0;
+      int c = prior && i >= n ? prior[i - n] : 0;
+      switch (filter) {
+      case F_none:
+        out[i] = cur[i];
+        break;
+      case F_sub:
+        out[i] = (uint8)(cur[i] - a);
+        break;
+      case F_up:
+        out[i] = (uint8)(cur[i] - b);
+        break;
+      case F_avg:
+        out[i] = (uint8)(cur[i] - ((a + b) >> 1));
+        break;
+      case F_paeth:
+        out[i] = (uint8)(cur[i] - paeth(a, b, c));
+        break;
+      }
+    }
+  }
+}
+
+static int png_write(wbuf *b, int x, int y, int comp, const void *data,
+                     int level) {
+  static uint8 png_sig[8] = {137, 80, 78, 71, 13, 10, 26, 10};
+  static uint8 color_type[5] = {0, 0, 4, 2, 6};
+  uint32 crc_table[256], start, i;
+  pngwfilter f;
+  int k;
+  size_t filtered_len;
+
+  if (x <= 0 || y <= 0 || comp < 1 || comp > 4 || data == NULL)
+    return 0;
+  if ((1 << 30) / x / comp < y)
+    return 0;
+  if (level < 0)
+    level = 0;
+  if (level > 9)
+    level = 9;
+  for (i = 0; i < 256; ++i) {
+    uint32 c = i;
+    for (k = 0; k < 8; ++k)
+      c = (c >> 1) ^ (0xedb88320u & (0u - (c & 1)));
+    crc_table[i] = c;
+  }
+
+  filtered_len = (size_t)(x * comp + 1) * y;
+  f.filtered = (uint8 *)STBI_MALLOC(filtered_len);
+  if (f.filtered == NULL)
+    return 0;
+  f.pixels = (const uint8 *)data;
+  f.x = x;
+  f.y = y;
+  f.comp = comp;
+  f.filter = level == 0 ? F_none : -1;
+  f.rows_per_band = 32;
+  stbi_run_parallel((y + f.rows_per_band - 1) / f.rows_per_band,
+                    png_filter_band, &f);
+
+  wbuf_put(b, png_sig, 8);
+  start = b->len;
+  wbuf_put(b, "\0\0\0\0IHDR", 8);
+  wbuf_put32be(b, x);
+  wbuf_put32be(b, y);
+  wbuf_put(b, "\x08", 1); // depth
+  wbuf_put(b, &color_type[comp], 1);
+  wbuf_put(b, "\0\0\0", 3); // compression, filter, interlace
+  png_end_chunk(b, crc_table, start);
+
+  start = b->len;
+  wbuf_put(b, "\0\0\0\0IDAT", 8);
+  if (!zw_compress(b, f.filtered, (int)filtered_len, level))
+    b->failed = 1;
+  png_end_chunk(b, crc_table, start);
+  STBI_FREE(f.filtered);
+
+  start = b->len;
+  wbuf_put(b, "\0\0\0\0IEND", 8);
+  png_end_chunk(b, crc_table, start);
+  return !b->failed;
+}
+
+stbi_uc *stbi_write_png_to_mem(int x, int y, int comp, void *data, int level,
+                               int *out_len) {
+  wbuf b;
+  memset(&b, 0, sizeof(b));
+  if (!png_write(&b, x, y, comp, data, level))
+    b.failed = 1;
+  return wbuf_release(&b, out_len);
+}
+
+// chunk lengths and CRCs are patched in afterwards, so this goes through
+// memory too
+int stbi_write_png(char const *filename, int x, int y, int comp, void *data,
+                   int level) {
+  wbuf b;
+  int len;
+  uint8 *png = stbi_write_png_to_mem(x, y, comp, data, level, &len);
+  if (png == NULL)
+    return 0;
+  if (wbuf_open(&b, filename)) {
+    wbuf_put(&b, png, len);
+    wbuf_close(&b);
+  } else
+    b.failed = 1;
+  STBI_FREE(png);
+  return !b.failed;
 }
 
 // any other image formats that do interleaved rgb data?
-//    PNG: requires adler32,crc32 -- significant amount of code
 //    PSD: no, channels output separately
 //    TIFF: no, stripwise-interleaved... i think
 
@@ -11,12 +11,10 @@
       TGA (not sure what subset, if a subset)
       PSD (composited view only, no extra channels)
       HDR (radiance rgbE format)
-      writes BMP,TGA (define STBI_NO_WRITE to remove code)
+      writes BMP,TGA,PNG (define STBI_NO_WRITE to remove code)
       decoded from memory or through stdio FILE (define STBI_NO_STDIO to remove code)
       supports installable dequantizing-IDCT, YCbCr-to-RGB conversion (define STBI_SIMD)
         
-   TODO:
-      stbi_info_*
   
    history:
       1.16   major bugfix - convert_format converted one too many pixels
@@ -184,6 +182,12 @@ extern "C" {
 // returns TRUE on success, FALSE if couldn't open file, error writing file
 extern int      stbi_write_bmp       (char const *filename,     int x, int y, int comp, void *data);
 extern int      stbi_write_tga       (char const *filename,     int x, int y, int comp, void *data);
+// for PNG, 'level' trades speed for size like zlib's: 0 stores, 1 fastest, 9 smallest
+extern int      stbi_write_png       (char const *filename,     int x, int y, int comp, void *data, int level);
+// the same into a malloc'ed buffer (free it with stbi_image_free), NULL on failure
+extern stbi_uc *stbi_write_bmp_to_mem(int x, int y, int comp, void *data, int *out_len);
+extern stbi_uc *stbi_write_tga_to_mem(int x, int y, int comp, void *data, int *out_len);
+extern stbi_uc *stbi_write_png_to_mem(int x, int y, int comp, void *data, int level, int *out_len);
 #endif
 
 // PRIMARY API - works on images of any type
@@ -197,6 +201,15 @@ extern int      stbi_info_from_file  (FILE *f,                  int *x, int *y,
 extern stbi_uc *stbi_load_from_memory(stbi_uc const *buffer, int len, int *x, int *y, int *comp, int req_comp);
 // for stbi_load_from_file, file pointer is left pointing immediately after image
 
+// load into memory you already have: out_size bytes at out, rows stride
+// bytes apart, req_comp (1..4) components; returns 0 on failure, including
+// when it doesn't fit (stbi_info tells you how much it needs)
+#ifndef STBI_NO_STDIO
+extern int      stbi_load_into            (char const *filename,     stbi_uc *out, int out_size, int stride, int *x, int *y, int *comp, int req_comp);
+extern int      stbi_load_into_from_file  (FILE *f,                  stbi_uc *out, int out_size, int stride, int *x, int *y, int *comp, int req_comp);
+#endif
+extern int      stbi_load_into_from_memory(stbi_uc const *buffer, int len, stbi_uc *out, int out_size, int stride, int *x, int *y, int *comp, int req_comp);
+
 #ifndef STBI_NO_HDR
 #ifndef STBI_NO_STDIO
 extern float *stbi_loadf            (char const *filename,     int *x, int *y, int *comp, int req_comp);
@@ -212,11 +225,11 @@ extern void   stbi_ldr_to_hdr_scale(float scale);
 
 #endif // STBI_NO_HDR
 
-// get a VERY brief reason for failure
-// NOT THREADSAFE
+// get a VERY brief reason for failure (each thread gets its own, where the
+// compiler has thread-local storage)
 extern char    *stbi_failure_reason  (void); 
 
-// free the loaded image -- this is just free()
+// free the loaded image -- this is SOIL's allocator's free()
 extern void     stbi_image_free      (void *retval_from_stbi_load);
 
 // get image dimensions & components without fully decoding
@@ -344,6 +357,15 @@ extern void stbi_install_idct(stbi_idct_8x8 func);
 extern void stbi_install_YCbCr_to_RGB(stbi_YCbCr_to_RGB_run func);
 #endif // STBI_SIMD
 
+// run independent pieces of work (e.g. the PNG writer's row filtering) on
+// your own threads
+typedef void (*stbi_parallel_body)(void *data, int index);
+typedef void (*stbi_parallel_for)(void *context, int count, stbi_parallel_body body, void *data);
+// must call body(data, i) once for each i in [0,count), in any order or
+// concurrently, and return only once all of them have finished; pass NULL
+// to go back to running them in order on the calling thread
+extern void stbi_install_parallel_for(stbi_parallel_for func, void *context);
+
 #ifdef __cplusplus
 }
 #endif
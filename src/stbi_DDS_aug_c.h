@@ -36,6 +36,15 @@ typedef struct {
     unsigned int    dwReserved2;
 } DDS_header ;
 
+///	the "DX10" extended header, when the FourCC is "DX10"
+typedef struct {
+    unsigned int    dxgiFormat;
+    unsigned int    resourceDimension;
+    unsigned int    miscFlag;
+    unsigned int    arraySize;
+    unsigned int    miscFlags2;
+} DDS_header_DXT10 ;
+
 //	the following constants were copied directly off the MSDN website
 
 //	The dwFlags member of the original DDSURFACEDESC2 structure
@@ -113,169 +122,410 @@ void stbi_rgb_888_from_565( unsigned int c, int *r, int *g, int *b )
 	*g = stbi_convert_bit_range( (c >> 05) & 63, 6, 8 );
 	*b = stbi_convert_bit_range( (c >> 00) & 31, 5, 8 );
 }
-void stbi_decode_DXT1_block(
-			unsigned char uncompressed[16*4],
-			unsigned char compressed[8] )
+/*	stbi_convert_bit_range( c, 4|5|6, 8 ) for every c, so the block
+	decoders below never do the arithmetic per pixel	*/
+static const unsigned char stbi_dxt_expand4[16] =
 {
-	int next_bit = 4*8;
-	int i, r, g, b;
-	int c0, c1;
-	unsigned char decode_colors[4*4];
-	//	find the 2 primary colors
-	c0 = compressed[0] + (compressed[1] << 8);
-	c1 = compressed[2] + (compressed[3] << 8);
-	stbi_rgb_888_from_565( c0, &r, &g, &b );
-	decode_colors[0] = r;
-	decode_colors[1] = g;
-	decode_colors[2] = b;
-	decode_colors[3] = 255;
-	stbi_rgb_888_from_565( c1, &r, &g, &b );
-	decode_colors[4] = r;
-	decode_colors[5] = g;
-	decode_colors[6] = b;
-	decode_colors[7] = 255;
-	if( c0 > c1 )
+	0, 17, 34, 51, 68, 85, 102, 119, 136, 152, 169, 186, 203, 220, 237, 254
+};
+static const unsigned char stbi_dxt_expand5[32] =
+{
+	0, 8, 16, 25, 33, 41, 49, 58, 66, 74, 82, 90, 99, 107, 115, 123,
+	132, 140, 148, 156, 164, 173, 181, 189, 197, 205, 214, 222, 230, 238, 247, 255
+};
+static const unsigned char stbi_dxt_expand6[64] =
+{
+	0, 4, 8, 12, 16, 20, 24, 28, 32, 36, 40, 45, 49, 53, 57, 61,
+	65, 69, 73, 77, 81, 85, 89, 93, 97, 101, 105, 109, 113, 117, 121, 125,
+	130, 134, 138, 142, 146, 150, 154, 158, 162, 166, 170, 174, 178, 182, 186, 190,
+	194, 198, 202, 206, 210, 214, 219, 223, 227, 231, 235, 239, 243, 247, 251, 255
+};
+/*	build the 4 entry RGBA palette of a colour block; DXT2-5 colour
+	blocks always use the 4 colour mode	*/
+static void stbi_dxt_color_palette(
+			unsigned char palette[4*4],
+			const unsigned char compressed[8],
+			int is_DXT1 )
+{
+	int c0 = compressed[0] + (compressed[1] << 8);
+	int c1 = compressed[2] + (compressed[3] << 8);
+	int i;
+	palette[0] = stbi_dxt_expand5[c0 >> 11];
+	palette[1] = stbi_dxt_expand6[(c0 >> 5) & 63];
+	palette[2] = stbi_dxt_expand5[c0 & 31];
+	palette[3] = 255;
+	palette[4] = stbi_dxt_expand5[c1 >> 11];
+	palette[5] = stbi_dxt_expand6[(c1 >> 5) & 63];
+	palette[6] = stbi_dxt_expand5[c1 & 31];
+	palette[7] = 255;
+	if( (c0 > c1) || !is_DXT1 )
 	{
 		//	no alpha, 2 interpolated colors
-		decode_colors[8] = (2*decode_colors[0] + decode_colors[4]) / 3;
-		decode_colors[9] = (2*decode_colors[1] + decode_colors[5]) / 3;
-		decode_colors[10] = (2*decode_colors[2] + decode_colors[6]) / 3;
-		decode_colors[11] = 255;
-		decode_colors[12] = (decode_colors[0] + 2*decode_colors[4]) / 3;
-		decode_colors[13] = (decode_colors[1] + 2*decode_colors[5]) / 3;
-		decode_colors[14] = (decode_colors[2] + 2*decode_colors[6]) / 3;
-		decode_colors[15] = 255;
+		for( i = 0; i < 3; ++i )
+		{
+			palette[8+i] = (2*palette[i] + palette[4+i]) / 3;
+			palette[12+i] = (palette[i] + 2*palette[4+i]) / 3;
+		}
+		palette[11] = 255;
+		palette[15] = 255;
 	} else
 	{
 		//	1 interpolated color, alpha
-		decode_colors[8] = (decode_colors[0] + decode_colors[4]) / 2;
-		decode_colors[9] = (decode_colors[1] + decode_colors[5]) / 2;
-		decode_colors[10] = (decode_colors[2] + decode_colors[6]) / 2;
-		decode_colors[11] = 255;
-		decode_colors[12] = 0;
-		decode_colors[13] = 0;
-		decode_colors[14] = 0;
-		decode_colors[15] = 0;
-	}
-	//	decode the block
-	for( i = 0; i < 16*4; i += 4 )
-	{
-		int idx = ((compressed[next_bit>>3] >> (next_bit & 7)) & 3) * 4;
-		next_bit += 2;
-		uncompressed[i+0] = decode_colors[idx+0];
-		uncompressed[i+1] = decode_colors[idx+1];
-		uncompressed[i+2] = decode_colors[idx+2];
-		uncompressed[i+3] = decode_colors[idx+3];
+		for( i = 0; i < 3; ++i )
+		{
+			palette[8+i] = (palette[i] + palette[4+i]) / 2;
+			palette[12+i] = 0;
+		}
+		palette[11] = 255;
+		palette[15] = 0;
 	}
-	//	done
 }
-void stbi_decode_DXT23_alpha_block(
-			unsigned char uncompressed[16*4],
-			unsigned char compressed[8] )
+static unsigned int stbi_dxt_load32( const unsigned char compressed[4] )
 {
-	int i, next_bit = 0;
+	return compressed[0] | (compressed[1] << 8) |
+			(compressed[2] << 16) | ((unsigned int)compressed[3] << 24);
+}
+static uint64 stbi_dxt_load64( const unsigned char compressed[8] )
+{
+	return stbi_dxt_load32( compressed ) |
+			((uint64)stbi_dxt_load32( compressed + 4 ) << 32);
+}
+/*	the 16 alpha values of a DXT2/3 block	*/
+static void stbi_dxt_alpha23(
+			unsigned char alpha[16],
+			const unsigned char compressed[8] )
+{
+	uint64 bits = stbi_dxt_load64( compressed );
+	int i;
 	//	each alpha value gets 4 bits
-	for( i = 3; i < 16*4; i += 4 )
+	for( i = 0; i < 16; ++i, bits >>= 4 )
 	{
-		uncompressed[i] = stbi_convert_bit_range(
-				(compressed[next_bit>>3] >> (next_bit&7)) & 15,
-				4, 8 );
-		next_bit += 4;
+		alpha[i] = stbi_dxt_expand4[bits & 15];
 	}
 }
-void stbi_decode_DXT45_alpha_block(
-			unsigned char uncompressed[16*4],
-			unsigned char compressed[8] )
+/*	the 16 alpha values of a DXT4/5 block	*/
+static void stbi_dxt_alpha45(
+			unsigned char alpha[16],
+			const unsigned char compressed[8] )
 {
-	int i, next_bit = 8*2;
+	uint64 bits = stbi_dxt_load64( compressed ) >> 16;
 	unsigned char decode_alpha[8];
+	int a0 = compressed[0], a1 = compressed[1];
+	int i;
 	//	each alpha value gets 3 bits, and the 1st 2 bytes are the range
-	decode_alpha[0] = compressed[0];
-	decode_alpha[1] = compressed[1];
-	if( decode_alpha[0] > decode_alpha[1] )
+	decode_alpha[0] = a0;
+	decode_alpha[1] = a1;
+	if( a0 > a1 )
 	{
 		//	6 step intermediate
-		decode_alpha[2] = (6*decode_alpha[0] + 1*decode_alpha[1]) / 7;
-		decode_alpha[3] = (5*decode_alpha[0] + 2*decode_alpha[1]) / 7;
-		decode_alpha[4] = (4*decode_alpha[0] + 3*decode_alpha[1]) / 7;
-		decode_alpha[5] = (3*decode_alpha[0] + 4*decode_alpha[1]) / 7;
-		decode_alpha[6] = (2*decode_alpha[0] + 5*decode_alpha[1]) / 7;
-		decode_alpha[7] = (1*decode_alpha[0] + 6*decode_alpha[1]) / 7;
+		for( i = 1; i < 7; ++i )
+		{
+			decode_alpha[1+i] = ((7-i)*a0 + i*a1) / 7;
+		}
 	} else
 	{
-		//	4 step intermediate, pluss full and none
-		decode_alpha[2] = (4*decode_alpha[0] + 1*decode_alpha[1]) / 5;
-		decode_alpha[3] = (3*decode_alpha[0] + 2*decode_alpha[1]) / 5;
-		decode_alpha[4] = (2*decode_alpha[0] + 3*decode_alpha[1]) / 5;
-		decode_alpha[5] = (1*decode_alpha[0] + 4*decode_alpha[1]) / 5;
+		//	4 step intermediate, plus full and none
+		for( i = 1; i < 5; ++i )
+		{
+			decode_alpha[1+i] = ((5-i)*a0 + i*a1) / 5;
+		}
 		decode_alpha[6] = 0;
 		decode_alpha[7] = 255;
 	}
-	for( i = 3; i < 16*4; i += 4 )
+	for( i = 0; i < 16; ++i, bits >>= 3 )
+	{
+		alpha[i] = decode_alpha[bits & 7];
+	}
+}
+#ifdef STBI_SSE2
+/*	the colour palette as 4 RGBA lanes, with the interpolation done in
+	16 bit lanes: x*21846 >> 16 == x/3 for every x up to 3*255	*/
+static __m128i stbi_dxt_color_palette_sse2(
+			const unsigned char compressed[8],
+			int is_DXT1 )
+{
+	int c0 = compressed[0] + (compressed[1] << 8);
+	int c1 = compressed[2] + (compressed[3] << 8);
+	__m128i e = _mm_setr_epi16(
+			stbi_dxt_expand5[c0 >> 11], stbi_dxt_expand6[(c0 >> 5) & 63],
+			stbi_dxt_expand5[c0 & 31], 255,
+			stbi_dxt_expand5[c1 >> 11], stbi_dxt_expand6[(c1 >> 5) & 63],
+			stbi_dxt_expand5[c1 & 31], 255 );
+	//	the same two endpoints, swapped
+	__m128i f = _mm_shuffle_epi32( e, 0x4E );
+	//	both modes get worked out, so random data costs no mispredicts
+	__m128i four = _mm_mulhi_epu16( _mm_add_epi16( _mm_add_epi16( e, e ), f ),
+			_mm_set1_epi16( 21846 ) );
+	__m128i three = _mm_unpacklo_epi64(
+			_mm_srli_epi16( _mm_add_epi16( e, f ), 1 ), _mm_setzero_si128() );
+	__m128i mode = _mm_set1_epi32( -((c0 > c1) | !is_DXT1) );
+	__m128i mid = _mm_or_si128( _mm_and_si128( mode, four ),
+			_mm_andnot_si128( mode, three ) );
+	return _mm_packus_epi16( e, mid );
+}
+/*	the 8 DXT4/5 alpha levels, both modes again worked out side by side:
+	x*9363 >> 16 == x/7 up to 7*255 and x*13108 >> 16 == x/5 up to 5*255	*/
+static __m128i stbi_dxt_alpha45_palette_sse2(
+			const unsigned char compressed[8] )
+{
+	int a0 = compressed[0], a1 = compressed[1];
+	__m128i v0 = _mm_set1_epi16( (short)a0 );
+	__m128i v1 = _mm_set1_epi16( (short)a1 );
+	__m128i six = _mm_add_epi16(
+			_mm_mullo_epi16( v0, _mm_setr_epi16( 7, 0, 6, 5, 4, 3, 2, 1 ) ),
+			_mm_mullo_epi16( v1, _mm_setr_epi16( 0, 7, 1, 2, 3, 4, 5, 6 ) ) );
+	__m128i four = _mm_add_epi16(
+			_mm_mullo_epi16( v0, _mm_setr_epi16( 5, 0, 4, 3, 2, 1, 0, 0 ) ),
+			_mm_mullo_epi16( v1, _mm_setr_epi16( 0, 5, 1, 2, 3, 4, 0, 0 ) ) );
+	__m128i mode = _mm_set1_epi16( (short)-(a0 > a1) );
+	six = _mm_mulhi_epu16( six, _mm_set1_epi16( 9363 ) );
+	four = _mm_or_si128( _mm_mulhi_epu16( four, _mm_set1_epi16( 13108 ) ),
+			_mm_setr_epi16( 0, 0, 0, 0, 0, 0, 0, 255 ) );
+	six = _mm_or_si128( _mm_and_si128( mode, six ), _mm_andnot_si128( mode, four ) );
+	return _mm_packus_epi16( six, six );
+}
+/*	SSE2: each row of 4 pixels picks its palette entries with
+	compare masks on the index bits, gets its alpha merged in and goes
+	out in a single 16 byte store	*/
+static void stbi_dxt_decode_block(
+			unsigned char *dest, int stride,
+			const unsigned char *compressed,
+			int DXT_family )
+{
+	const unsigned char *color = compressed + ((DXT_family == 1) ? 0 : 8);
+	unsigned char levels[8];
+	__m128i pal, p0, p2, x01, x23, lo, hi, bit0, bit1, idx, a;
+	__m128i zero = _mm_setzero_si128();
+	__m128i rgb_mask = _mm_set1_epi32( 0x00FFFFFF );
+	int y;
+	pal = stbi_dxt_color_palette_sse2( color, DXT_family == 1 );
+	p0 = _mm_shuffle_epi32( pal, 0x00 );
+	p2 = _mm_shuffle_epi32( pal, 0xAA );
+	x01 = _mm_xor_si128( p0, _mm_shuffle_epi32( pal, 0x55 ) );
+	x23 = _mm_xor_si128( p2, _mm_shuffle_epi32( pal, 0xFF ) );
+	//	lane i of a row tests index bits 2i and 2i+1
+	bit0 = _mm_set_epi32( 1 << 6, 1 << 4, 1 << 2, 1 << 0 );
+	bit1 = _mm_add_epi32( bit0, bit0 );
+	idx = _mm_set1_epi32( (int)stbi_dxt_load32( color + 4 ) );
+	a = zero;
+	if( DXT_family > 1 )
+	{
+		if( DXT_family < 4 )
+		{
+			//	4 bit alpha, nibbles interleaved back into pixel order;
+			//	c*17, less 1 above 8, is stbi_convert_bit_range( c, 4, 8 )
+			__m128i nib = _mm_set1_epi8( 15 );
+			__m128i v = _mm_loadl_epi64( (const __m128i*)compressed );
+			v = _mm_unpacklo_epi8( _mm_and_si128( v, nib ),
+					_mm_and_si128( _mm_srli_epi16( v, 4 ), nib ) );
+			a = _mm_add_epi8( _mm_or_si128( _mm_slli_epi16( v, 4 ), v ),
+					_mm_cmpgt_epi8( v, _mm_set1_epi8( 8 ) ) );
+		} else
+		{
+			//	3 bit indices into the 8 levels, a row at a time
+			uint64 bits = stbi_dxt_load64( compressed ) >> 16;
+			unsigned int row[4];
+			_mm_storel_epi64( (__m128i*)levels,
+					stbi_dxt_alpha45_palette_sse2( compressed ) );
+			for( y = 0; y < 4; ++y, bits >>= 12 )
+			{
+				row[y] = levels[bits & 7] |
+						(levels[(bits >> 3) & 7] << 8) |
+						(levels[(bits >> 6) & 7] << 16) |
+						((unsigned int)levels[(bits >> 9) & 7] << 24);
+			}
+			a = _mm_setr_epi32( (int)row[0], (int)row[1], (int)row[2], (int)row[3] );
+		}
+	}
+	for( y = 0; y < 4; ++y, dest += stride )
+	{
+		__m128i m0 = _mm_cmpeq_epi32( _mm_and_si128( idx, bit0 ), bit0 );
+		__m128i m1 = _mm_cmpeq_epi32( _mm_and_si128( idx, bit1 ), bit1 );
+		__m128i c;
+		lo = _mm_xor_si128( p0, _mm_and_si128( m0, x01 ) );
+		hi = _mm_xor_si128( p2, _mm_and_si128( m0, x23 ) );
+		c = _mm_xor_si128( lo, _mm_and_si128( m1, _mm_xor_si128( lo, hi ) ) );
+		if( DXT_family > 1 )
+		{
+			//	alpha bytes 4y..4y+3 into the top byte of each lane
+			__m128i ra = _mm_unpacklo_epi16( zero, _mm_unpacklo_epi8( zero, a ) );
+			c = _mm_or_si128( _mm_and_si128( c, rgb_mask ), ra );
+			a = _mm_srli_si128( a, 4 );
+		}
+		_mm_storeu_si128( (__m128i*)dest, c );
+		idx = _mm_srli_epi32( idx, 8 );
+	}
+}
+#else
+/*	decode a block into 4 rows of 4 RGBA pixels: all 32 index bits are
+	fetched at once and each pixel is a single 4 byte palette copy	*/
+static void stbi_dxt_decode_block(
+			unsigned char *dest, int stride,
+			const unsigned char *compressed,
+			int DXT_family )
+{
+	const unsigned char *color = compressed + ((DXT_family == 1) ? 0 : 8);
+	unsigned char palette[4*4];
+	unsigned char alpha[16];
+	unsigned int bits = stbi_dxt_load32( color + 4 );
+	int x, y;
+	stbi_dxt_color_palette( palette, color, DXT_family == 1 );
+	for( y = 0; y < 4; ++y )
+	{
+		for( x = 0; x < 16; x += 4, bits >>= 2 )
+		{
+			memcpy( dest + y*stride + x, palette + 4*(bits & 3), 4 );
+		}
+	}
+	if( DXT_family > 1 )
+	{
+		if( DXT_family < 4 )
+		{
+			stbi_dxt_alpha23( alpha, compressed );
+		} else
+		{
+			stbi_dxt_alpha45( alpha, compressed );
+		}
+		for( y = 0; y < 4; ++y )
+		{
+			for( x = 0; x < 4; ++x )
+			{
+				dest[y*stride + x*4 + 3] = alpha[y*4 + x];
+			}
+		}
+	}
+}
+#endif
+void stbi_decode_DXT1_block(
+			unsigned char uncompressed[16*4],
+			unsigned char compressed[8] )
+{
+	stbi_dxt_decode_block( uncompressed, 16, compressed, 1 );
+}
+void stbi_decode_DXT23_alpha_block(
+			unsigned char uncompressed[16*4],
+			unsigned char compressed[8] )
+{
+	unsigned char alpha[16];
+	int i;
+	stbi_dxt_alpha23( alpha, compressed );
+	for( i = 0; i < 16; ++i )
+	{
+		uncompressed[i*4+3] = alpha[i];
+	}
+}
+void stbi_decode_DXT45_alpha_block(
+			unsigned char uncompressed[16*4],
+			unsigned char compressed[8] )
+{
+	unsigned char alpha[16];
+	int i;
+	stbi_dxt_alpha45( alpha, compressed );
+	for( i = 0; i < 16; ++i )
 	{
-		int idx = 0, bit;
-		bit = (compressed[next_bit>>3] >> (next_bit&7)) & 1;
-		idx += bit << 0;
-		++next_bit;
-		bit = (compressed[next_bit>>3] >> (next_bit&7)) & 1;
-		idx += bit << 1;
-		++next_bit;
-		bit = (compressed[next_bit>>3] >> (next_bit&7)) & 1;
-		idx += bit << 2;
-		++next_bit;
-		uncompressed[i] = decode_alpha[idx & 7];
+		uncompressed[i*4+3] = alpha[i];
 	}
-	//	done
 }
 void stbi_decode_DXT_color_block(
 			unsigned char uncompressed[16*4],
 			unsigned char compressed[8] )
 {
-	int next_bit = 4*8;
-	int i, r, g, b;
-	int c0, c1;
-	unsigned char decode_colors[4*3];
-	//	find the 2 primary colors
-	c0 = compressed[0] + (compressed[1] << 8);
-	c1 = compressed[2] + (compressed[3] << 8);
-	stbi_rgb_888_from_565( c0, &r, &g, &b );
-	decode_colors[0] = r;
-	decode_colors[1] = g;
-	decode_colors[2] = b;
-	stbi_rgb_888_from_565( c1, &r, &g, &b );
-	decode_colors[3] = r;
-	decode_colors[4] = g;
-	decode_colors[5] = b;
-	//	Like DXT1, but no choicees:
-	//	no alpha, 2 interpolated colors
-	decode_colors[6] = (2*decode_colors[0] + decode_colors[3]) / 3;
-	decode_colors[7] = (2*decode_colors[1] + decode_colors[4]) / 3;
-	decode_colors[8] = (2*decode_colors[2] + decode_colors[5]) / 3;
-	decode_colors[9] = (decode_colors[0] + 2*decode_colors[3]) / 3;
-	decode_colors[10] = (decode_colors[1] + 2*decode_colors[4]) / 3;
-	decode_colors[11] = (decode_colors[2] + 2*decode_colors[5]) / 3;
-	//	decode the block
-	for( i = 0; i < 16*4; i += 4 )
+	unsigned int bits = stbi_dxt_load32( compressed + 4 );
+	unsigned char palette[4*4];
+	int i;
+	//	Like DXT1, but no choices, and the alpha is left alone
+	stbi_dxt_color_palette( palette, compressed, 0 );
+	for( i = 0; i < 16*4; i += 4, bits >>= 2 )
+	{
+		memcpy( uncompressed + i, palette + 4*(bits & 3), 3 );
+	}
+}
+/*	BC4 / BC5 (ATI1 / ATI2) blocks are one or two DXT5 style alpha
+	blocks, which come out as grey, or as red & green	*/
+static void stbi_rgtc_decode_block(
+			unsigned char *dest, int stride,
+			const unsigned char *compressed,
+			int rgtc_channels )
+{
+	unsigned char red[16], green[16];
+	int i;
+	stbi_dxt_alpha45( red, compressed );
+	if( rgtc_channels == 2 )
+	{
+		stbi_dxt_alpha45( green, compressed + 8 );
+	}
+	for( i = 0; i < 16; ++i )
 	{
-		int idx = ((compressed[next_bit>>3] >> (next_bit & 7)) & 3) * 3;
-		next_bit += 2;
-		uncompressed[i+0] = decode_colors[idx+0];
-		uncompressed[i+1] = decode_colors[idx+1];
-		uncompressed[i+2] = decode_colors[idx+2];
+		unsigned char *p = dest + (i >> 2)*stride + (i & 3)*4;
+		p[0] = red[i];
+		p[1] = (rgtc_channels == 2) ? green[i] : red[i];
+		p[2] = (rgtc_channels == 2) ? 0 : red[i];
+		p[3] = 255;
+	}
+}
+/*	copy the visible part of a decoded block straight into the
+	output image, converting to the requested channel count on the way
+	(same maths as convert_format)	*/
+static void stbi_dxt_store_block(
+			stbi_uc *dest, int stride,
+			const unsigned char block[16*4],
+			int bw, int bh, int out_n )
+{
+	int bx, by;
+	for( by = 0; by < bh; ++by, dest += stride, block += 16 )
+	{
+		const unsigned char *src = block;
+		stbi_uc *d = dest;
+		switch( out_n )
+		{
+		case 4:
+			if( bw == 4 )
+			{
+				memcpy( d, src, 16 );
+			} else
+			{
+				memcpy( d, src, bw*4 );
+			}
+			break;
+		case 3:
+			for( bx = 0; bx < bw; ++bx, src += 4, d += 3 )
+			{
+				d[0] = src[0];
+				d[1] = src[1];
+				d[2] = src[2];
+			}
+			break;
+		case 2:
+			for( bx = 0; bx < bw; ++bx, src += 4, d += 2 )
+			{
+				d[0] = compute_y( src[0], src[1], src[2] );
+				d[1] = src[3];
+			}
+			break;
+		default:
+			for( bx = 0; bx < bw; ++bx, src += 4, d += 1 )
+			{
+				d[0] = compute_y( src[0], src[1], src[2] );
+			}
+			break;
+		}
 	}
-	//	done
 }
 static stbi_uc *dds_load(stbi *s, int *x, int *y, int *comp, int req_comp)
 {
 	//	all variables go up front
 	stbi_uc *dds_data = NULL;
+	stbi_uc *blocks = NULL;
 	stbi_uc block[16*4];
-	stbi_uc compressed[8];
-	int flags, DXT_family;
+	int flags, DXT_family, rgtc_channels;
+	unsigned int fourcc;
 	int has_alpha, has_mipmap;
 	int is_compressed, cubemap_faces;
-	int block_pitch, num_blocks;
+	int block_pitch, block_size;
+	int out_n, opaque;
 	DDS_header header;
+	DDS_header_DXT10 header10;
+	int swap_rb = 1, layers = 1;
 	int i, sz, cf;
 	//	load the header
 	if( sizeof( DDS_header ) != 128 )
@@ -296,6 +546,56 @@ static stbi_uc *dds_load(stbi *s, int *x, int *y, int *comp, int req_comp)
 	flags = DDPF_FOURCC | DDPF_RGB;
 	if( (header.sPixelFormat.dwFlags & flags) == 0 ) return NULL;
 	if( (header.sCaps.dwCaps1 & DDSCAPS_TEXTURE) == 0 ) return NULL;
+	//	a DX10 header describes the format with a DXGI number instead,
+	//	so turn the ones I can decode back into the old style description
+	if( (header.sPixelFormat.dwFlags & DDPF_FOURCC) &&
+		(header.sPixelFormat.dwFourCC == (('D' << 0) | ('X' << 8) | ('1' << 16) | ('0' << 24))) )
+	{
+		getn( s, (stbi_uc*)(&header10), 20 );
+		//	2D (3) and 3D (4) textures only
+		if( (header10.resourceDimension != 3) && (header10.resourceDimension != 4) ) return NULL;
+		switch( header10.dxgiFormat )
+		{
+		case 71: case 72:	//	BC1
+			header.sPixelFormat.dwFourCC = ('D' << 0) | ('X' << 8) | ('T' << 16) | ('1' << 24);
+			break;
+		case 74: case 75:	//	BC2
+			header.sPixelFormat.dwFourCC = ('D' << 0) | ('X' << 8) | ('T' << 16) | ('3' << 24);
+			break;
+		case 77: case 78:	//	BC3
+			header.sPixelFormat.dwFourCC = ('D' << 0) | ('X' << 8) | ('T' << 16) | ('5' << 24);
+			break;
+		case 80:	//	BC4
+			header.sPixelFormat.dwFourCC = ('A' << 0) | ('T' << 8) | ('I' << 16) | ('1' << 24);
+			break;
+		case 83:	//	BC5
+			header.sPixelFormat.dwFourCC = ('A' << 0) | ('T' << 8) | ('I' << 16) | ('2' << 24);
+			break;
+		case 28: case 87:	//	R8G8B8A8 and B8G8R8A8
+			header.sPixelFormat.dwFlags = DDPF_RGB | DDPF_ALPHAPIXELS;
+			swap_rb = (header10.dxgiFormat == 87);
+			break;
+		default:
+			return epuc("unknown DXGI", "DDS file uses a DXGI format I can't decode");
+		}
+		header.sCaps.dwCaps2 &= ~(DDSCAPS2_CUBEMAP | DDSCAPS2_VOLUME);
+		if( header10.miscFlag & 4 )
+		{
+			header.sCaps.dwCaps2 |= DDSCAPS2_CUBEMAP;
+		}
+		if( header10.resourceDimension == 4 )
+		{
+			header.sCaps.dwCaps2 |= DDSCAPS2_VOLUME;
+			header10.arraySize = 1;
+		}
+		//	array layers get stacked, just like cubemap faces
+		//	(2048 is as many as D3D allows)
+		if( header10.arraySize > 2048 ) return NULL;
+		if( header10.arraySize > 1 )
+		{
+			layers = header10.arraySize;
+		}
+	}
 	//	get the image data
 	s->img_x = header.dwWidth;
 	s->img_y = header.dwHeight;
@@ -308,8 +608,29 @@ static stbi_uc *dds_load(stbi *s, int *x, int *y, int *comp, int req_comp)
 	cubemap_faces &= (s->img_x == s->img_y);
 	cubemap_faces *= 5;
 	cubemap_faces += 1;
+	/*	and no more than 2048 faces in all (D3D's own limit, which
+		keeps the product well inside an int)	*/
+	if( layers > 2048 / cubemap_faces ) return NULL;
+	cubemap_faces *= layers;
+	/*	volume slices get stacked too, but they come one after the
+		other, with all the MIPmaps at the end where I can ignore them	*/
+	if( (header.sCaps.dwCaps2 & DDSCAPS2_VOLUME) && (header.dwDepth > 1) )
+	{
+		if( header.dwDepth > 2048 ) return NULL;
+		cubemap_faces = header.dwDepth;
+		has_mipmap = 0;
+	}
+	/*	all the faces (or slices) come back as one tall image, which
+		has to fit in an int even at 4 bytes a pixel (with room for a
+		row of blocks to round up): check that now, before any of it
+		gets allocated	*/
+	if( (header.dwWidth < 1) || (header.dwHeight < 1) ) return NULL;
+	if( (header.dwHeight > 0x7FFFFFF0u / (4u * cubemap_faces)) ||
+		(header.dwWidth > 0x7FFFFFF0u / (4u * cubemap_faces) / header.dwHeight) )
+	{
+		return epuc("too large", "DDS image is too large to load");
+	}
 	block_pitch = (s->img_x+3) >> 2;
-	num_blocks = block_pitch * ((s->img_y+3) >> 2);
 	/*	let the user know what's going on	*/
 	*x = s->img_x;
 	*y = s->img_y;
@@ -319,62 +640,113 @@ static stbi_uc *dds_load(stbi *s, int *x, int *y, int *comp, int req_comp)
 	{
 		/*	compressed	*/
 		//	note: header.sPixelFormat.dwFourCC is something like (('D'<<0)|('X'<<8)|('T'<<16)|('1'<<24))
-		DXT_family = 1 + (header.sPixelFormat.dwFourCC >> 24) - '1';
-		if( (DXT_family < 1) || (DXT_family > 5) ) return NULL;
+		fourcc = header.sPixelFormat.dwFourCC;
+		DXT_family = 0;
+		rgtc_channels = 0;
+		if( (fourcc & 0x00FFFFFF) == (('D' << 0) | ('X' << 8) | ('T' << 16)) )
+		{
+			DXT_family = 1 + (fourcc >> 24) - '1';
+			if( (DXT_family < 1) || (DXT_family > 5) ) return NULL;
+		} else if( (fourcc == (('A' << 0) | ('T' << 8) | ('I' << 16) | ('1' << 24))) ||
+			(fourcc == (('B' << 0) | ('C' << 8) | ('4' << 16) | ('U' << 24))) )
+		{
+			//	BC4, a single grey channel
+			rgtc_channels = 1;
+			s->img_n = 1;
+		} else if( (fourcc == (('A' << 0) | ('T' << 8) | ('I' << 16) | ('2' << 24))) ||
+			(fourcc == (('B' << 0) | ('C' << 8) | ('5' << 16) | ('U' << 24))) )
+		{
+			//	BC5, red & green (blue is left at 0)
+			rgtc_channels = 2;
+			s->img_n = 3;
+		} else
+		{
+			return NULL;
+		}
+		*comp = s->img_n;
 		/*	check the expected size...oops, nevermind...
 			those non-compliant writers leave
 			dwPitchOrLinearSize == 0	*/
+		block_size = 16;
+		if( (DXT_family == 1) || (rgtc_channels == 1) )
+		{
+			block_size = 8;
+		}
+		/*	decode straight into the requested layout; with no request
+			we go RGBA and drop to RGB at the end if nothing was see-through	*/
+		out_n = s->img_n;
+		if( (req_comp <= 4) && (req_comp >= 1) )
+		{
+			out_n = req_comp;
+		}
+		opaque = 255;
 		//	passed all the tests, get the RAM for decoding
-		sz = (s->img_x)*(s->img_y)*4*cubemap_faces;
-		dds_data = (unsigned char*)malloc( sz );
+		sz = (int)((size_t)s->img_x*s->img_y*out_n*cubemap_faces);
+		dds_data = (unsigned char*)STBI_MALLOC( sz );
+		//	and for one row of blocks at a time
+		blocks = (unsigned char*)STBI_MALLOC( block_pitch*block_size );
+		if( (dds_data == NULL) || (blocks == NULL) )
+		{
+			STBI_FREE( dds_data );
+			STBI_FREE( blocks );
+			return epuc("outofmem", "Out of memory");
+		}
 		/*	do this once for each face	*/
 		for( cf = 0; cf < cubemap_faces; ++ cf )
 		{
-			//	now read and decode all the blocks
-			for( i = 0; i < num_blocks; ++i )
+			int ref_y;
+			//	now read and decode all the blocks, a row at a time
+			for( ref_y = 0; ref_y < s->img_y; ref_y += 4 )
 			{
-				//	where are we?
-				int bx, by, bw=4, bh=4;
-				int ref_x = 4 * (i % block_pitch);
-				int ref_y = 4 * (i / block_pitch);
-				//	get the next block's worth of compressed data, and decompress it
-				if( DXT_family == 1 )
-				{
-					//	DXT1
-					getn( s, compressed, 8 );
-					stbi_decode_DXT1_block( block, compressed );
-				} else if( DXT_family < 4 )
-				{
-					//	DXT2/3
-					getn( s, compressed, 8 );
-					stbi_decode_DXT23_alpha_block ( block, compressed );
-					getn( s, compressed, 8 );
-					stbi_decode_DXT_color_block ( block, compressed );
-				} else
-				{
-					//	DXT4/5
-					getn( s, compressed, 8 );
-					stbi_decode_DXT45_alpha_block ( block, compressed );
-					getn( s, compressed, 8 );
-					stbi_decode_DXT_color_block ( block, compressed );
-				}
-				//	is this a partial block?
-				if( ref_x + 4 > s->img_x )
-				{
-					bw = s->img_x - ref_x;
-				}
+				int bx, by, bh = 4;
+				stbi_uc *dest = dds_data + ((size_t)cf*s->img_y + ref_y)*s->img_x*out_n;
+				//	is this a partial row of blocks?
 				if( ref_y + 4 > s->img_y )
 				{
 					bh = s->img_y - ref_y;
 				}
-				//	now drop our decompressed data into the buffer
-				for( by = 0; by < bh; ++by )
+				getn( s, blocks, block_pitch*block_size );
+				for( bx = 0; bx < block_pitch; ++bx )
 				{
-					int idx = 4*((ref_y+by+cf*s->img_x)*s->img_x + ref_x);
-					for( bx = 0; bx < bw*4; ++bx )
+					const stbi_uc *compressed = blocks + bx*block_size;
+					int ref_x = 4 * bx;
+					int bw = 4;
+					stbi_uc *decoded = block;
+					int stride = 16;
+					//	is this a partial block?
+					if( ref_x + 4 > s->img_x )
 					{
-
-						dds_data[idx+bx] = block[by*16+bx];
+						bw = s->img_x - ref_x;
+					}
+					//	whole RGBA blocks go straight into the image
+					if( (out_n == 4) && (bw == 4) && (bh == 4) )
+					{
+						decoded = dest + ref_x*4;
+						stride = s->img_x*4;
+					}
+					if( rgtc_channels )
+					{
+						stbi_rgtc_decode_block( decoded, stride, compressed, rgtc_channels );
+					} else
+					{
+						stbi_dxt_decode_block( decoded, stride, compressed, DXT_family );
+					}
+					//	only the visible pixels count towards transparency
+					if( (req_comp != out_n) && (opaque == 255) )
+					{
+						for( by = 0; by < bh; ++by )
+						{
+							for( i = 3; i < bw*4; i += 4 )
+							{
+								opaque &= decoded[by*stride+i];
+							}
+						}
+					}
+					//	now drop our decompressed data into the buffer
+					if( decoded == block )
+					{
+						stbi_dxt_store_block( dest + ref_x*out_n, s->img_x*out_n,
+								block, bw, bh, out_n );
 					}
 				}
 			}
@@ -382,15 +754,10 @@ static stbi_uc *dds_load(stbi *s, int *x, int *y, int *comp, int req_comp)
 				skip MIPmaps if present	*/
 			if( has_mipmap )
 			{
-				int block_size = 16;
-				if( DXT_family == 1 )
-				{
-					block_size = 8;
-				}
 				for( i = 1; i < header.dwMipMapCount; ++i )
 				{
-					int mx = s->img_x >> (i + 2);
-					int my = s->img_y >> (i + 2);
+					int mx = s->img_x >> i;
+					int my = s->img_y >> i;
 					if( mx < 1 )
 					{
 						mx = 1;
@@ -399,10 +766,15 @@ static stbi_uc *dds_load(stbi *s, int *x, int *y, int *comp, int req_comp)
 					{
 						my = 1;
 					}
-					skip( s, mx*my*block_size );
+					//	a partial block still takes a whole one
+					skip( s, ((mx+3) >> 2)*((my+3) >> 2)*block_size );
 				}
 			}
 		}/* per cubemap face */
+		STBI_FREE( blocks );
+		/*	the decode loop already knows about transparency	*/
+		s->img_n = out_n;
+		has_alpha = (opaque < 255);
 	} else
 	{
 		/*	uncompressed	*/
@@ -413,13 +785,17 @@ static stbi_uc *dds_load(stbi *s, int *x, int *y, int *comp, int req_comp)
 			s->img_n = 4;
 		}
 		*comp = s->img_n;
-		sz = s->img_x*s->img_y*s->img_n*cubemap_faces;
-		dds_data = (unsigned char*)malloc( sz );
+		sz = (int)((size_t)s->img_x*s->img_y*s->img_n*cubemap_faces);
+		dds_data = (unsigned char*)STBI_MALLOC( sz );
+		if( dds_data == NULL )
+		{
+			return epuc("outofmem", "Out of memory");
+		}
 		/*	do this once for each face	*/
 		for( cf = 0; cf < cubemap_faces; ++ cf )
 		{
 			/*	read the main image for this face	*/
-			getn( s, &dds_data[cf*s->img_x*s->img_y*s->img_n], s->img_x*s->img_y*s->img_n );
+			getn( s, dds_data + (size_t)cf*s->img_x*s->img_y*s->img_n, s->img_x*s->img_y*s->img_n );
 			/*	done reading and decoding the main image...
 				skip MIPmaps if present	*/
 			if( has_mipmap )
@@ -441,26 +817,30 @@ static stbi_uc *dds_load(stbi *s, int *x, int *y, int *comp, int req_comp)
 			}
 		}
 		/*	data was BGR, I need it RGB	*/
-		for( i = 0; i < sz; i += s->img_n )
+		for( i = 0; swap_rb && (i < sz); i += s->img_n )
 		{
 			unsigned char temp = dds_data[i];
 			dds_data[i] = dds_data[i+2];
 			dds_data[i+2] = temp;
 		}
 	}
-	/*	finished decompressing into RGBA,
+	/*	finished decompressing,
 		adjust the y size if we have a cubemap
 		note: sz is already up to date	*/
 	s->img_y *= cubemap_faces;
 	*y = s->img_y;
 	//	did the user want something else, or
 	//	see if all the alpha values are 255 (i.e. no transparency)
-	has_alpha = 0;
-	if( s->img_n == 4)
+	//	(compressed data got checked while it was decoded)
+	if( !is_compressed )
 	{
-		for( i = 3; (i < sz) && (has_alpha == 0); i += 4 )
+		has_alpha = 0;
+		if( s->img_n == 4)
 		{
-			has_alpha |= (dds_data[i] < 255);
+			for( i = 3; (i < sz) && (has_alpha == 0); i += 4 )
+			{
+				has_alpha |= (dds_data[i] < 255);
+			}
 		}
 	}
 	if( (req_comp <= 4) && (req_comp >= 1) )
@@ -476,7 +856,18 @@ static stbi_uc *dds_load(stbi *s, int *x, int *y, int *comp, int req_comp)
 		//	user had no requirements, only drop to RGB is no alpha
 		if( (has_alpha == 0) && (s->img_n == 4) )
 		{
-			dds_data = convert_format( dds_data, 4, 3, s->img_x, s->img_y );
+			//	squeeze out the alpha in place
+			for( i = 0; i < sz/4; ++i )
+			{
+				dds_data[i*3+0] = dds_data[i*4+0];
+				dds_data[i*3+1] = dds_data[i*4+1];
+				dds_data[i*3+2] = dds_data[i*4+2];
+			}
+			blocks = (stbi_uc*)STBI_REALLOC( dds_data, sz/4*3 );
+			if( blocks != NULL )
+			{
+				dds_data = blocks;
+			}
 			*comp = 3;
 		}
 	}
@@ -0,0 +1,102 @@
+/*
+        SOIL_load_image_into has to report the channels it actually wrote:
+        loads an uncompressed RGB DDS as SOIL_LOAD_AUTO and as RGBA, from
+        memory and from a file, and checks *channels against the bytes
+        that were written into the destination buffer.
+*/
+#include <stdio.h>
+#include <string.h>
+
+#include "SOIL.h"
+
+#define WIDTH 8
+#define HEIGHT 6
+#define UNTOUCHED 0xAB
+
+static void put32(unsigned char *p, unsigned int v) {
+  p[0] = (unsigned char)(v & 0xFF);
+  p[1] = (unsigned char)((v >> 8) & 0xFF);
+  p[2] = (unsigned char)((v >> 16) & 0xFF);
+  p[3] = (unsigned char)((v >> 24) & 0xFF);
+}
+
+/*	a 24 bit RGB DDS, with pixel bytes that never look untouched	*/
+static int make_RGB_DDS(unsigned char *dds) {
+  int i;
+  memset(dds, 0, 128);
+  memcpy(dds, "DDS ", 4);
+  put32(dds + 4, 124);
+  put32(dds + 8, 0x1 | 0x2 | 0x4 | 0x8 | 0x1000);
+  put32(dds + 12, HEIGHT);
+  put32(dds + 16, WIDTH);
+  put32(dds + 20, WIDTH * 3);
+  put32(dds + 76, 32);
+  put32(dds + 80, 0x40);
+  put32(dds + 88, 24);
+  put32(dds + 92, 0xFF0000);
+  put32(dds + 96, 0x00FF00);
+  put32(dds + 100, 0x0000FF);
+  put32(dds + 108, 0x1000);
+  for (i = 0; i < WIDTH * HEIGHT * 3; ++i) {
+    dds[128 + i] = (unsigned char)(i & 0x3F);
+  }
+  return 128 + WIDTH * HEIGHT * 3;
+}
+
+static int check(const char *what, int loaded, const unsigned char *dst,
+                 int dst_size, int width, int height, int channels,
+                 int expected_channels) {
+  int i, written = width * height * channels;
+  if (!loaded) {
+    printf("%s: load failed (%s)\n", what, SOIL_last_result());
+    return 1;
+  }
+  if ((width != WIDTH) || (height != HEIGHT) ||
+      (channels != expected_channels)) {
+    printf("%s: got %dx%dx%d, expected %dx%dx%d\n", what, width, height,
+           channels, WIDTH, HEIGHT, expected_channels);
+    return 1;
+  }
+  /*	exactly width * height * channels bytes should have been written	*/
+  for (i = 0; i < dst_size; ++i) {
+    if ((i < written) == (dst[i] == UNTOUCHED)) {
+      printf("%s: byte %d %s, but *channels says %d\n", what, i,
+             (i < written) ? "was not written" : "was written", channels);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+int main(void) {
+  static const char *filename = "load_image_into_dds.dds";
+  unsigned char dds[128 + WIDTH * HEIGHT * 3];
+  unsigned char dst[WIDTH * HEIGHT * 4 + 64];
+  int dds_size = make_RGB_DDS(dds);
+  int force[2] = {SOIL_LOAD_AUTO, SOIL_LOAD_RGBA};
+  int expected[2] = {3, 4};
+  int width, height, channels, loaded, i, failures = 0;
+  FILE *f = fopen(filename, "wb");
+  if ((NULL == f) || (fwrite(dds, 1, dds_size, f) != (size_t)dds_size)) {
+    printf("could not write %s\n", filename);
+    return 1;
+  }
+  fclose(f);
+  for (i = 0; i < 2; ++i) {
+    memset(dst, UNTOUCHED, sizeof(dst));
+    channels = -1;
+    loaded = SOIL_load_image_into_from_memory(dds, dds_size, dst, sizeof(dst),
+                                              0, &width, &height, &channels,
+                                              force[i]);
+    failures += check("from memory", loaded, dst, sizeof(dst), width, height,
+                      channels, expected[i]);
+    memset(dst, UNTOUCHED, sizeof(dst));
+    channels = -1;
+    loaded = SOIL_load_image_into(filename, dst, sizeof(dst), 0, &width,
+                                  &height, &channels, force[i]);
+    failures += check("from a file", loaded, dst, sizeof(dst), width, height,
+                      channels, expected[i]);
+  }
+  remove(filename);
+  return failures ? 1 : 0;
+}